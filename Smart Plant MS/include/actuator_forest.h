@@ -0,0 +1,91 @@
+#ifndef ACTUATOR_FOREST_H
+#define ACTUATOR_FOREST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "profile_presets.h"
+
+// ============ Actuator Model Inference ============
+// On-device inference for the machine-learning module's ActuatorController:
+// one random forest per actuator, exported by
+// machine-learning/export_firmware_model.py into the generated header
+// include/actuator_forest_model.h and compiled into the firmware. Builds
+// without the generated header set FEATURE_ACTUATOR_MODEL=0 (the default)
+// and get no tables; actuator_model_available() is then false.
+//
+// Each tree is a flattened array of 4-byte nodes in preorder, so the left
+// child of a split is always the next node and only the right child is
+// stored. Thresholds are fixed point in FOREST_INPUT_SCALE units of the
+// feature, and inputs are quantized the same way, so a decision is integer
+// compares and one sum: no floats in the tree walk and nothing on the heap.
+//
+// A forest predicts like sklearn's RandomForestClassifier.predict(): the
+// mean of the trees' P(on) leaves, ON when above one half (ties are OFF).
+// Leaves are stored as P(on) * FOREST_LEAF_SCALE, so the mean can differ
+// from the Python model by at most 1 / FOREST_LEAF_SCALE.
+
+#define FOREST_INPUT_SCALE 100        // Hundredths of a unit (°C, %)
+#define FOREST_LEAF_SCALE 32767       // P(on) = 1
+#define FOREST_LEAF 7                 // Feature code of a leaf node
+
+// Feature order of machine-learning/config.py FEATURE_NAMES
+enum ForestFeature : uint8_t {
+  FOREST_TEMPERATURE,                 // °C
+  FOREST_HUMIDITY,                    // %
+  FOREST_SOIL_MOISTURE,               // % (calibrated)
+  FOREST_LIGHT_INTENSITY,             // % of full scale
+  FOREST_FEATURE_COUNT
+};
+
+// Target order of machine-learning/config.py TARGET_ACTUATORS
+enum ModelActuator : uint8_t {
+  MODEL_FAN,
+  MODEL_PUMP,
+  MODEL_LIGHT,
+  MODEL_ACTUATOR_COUNT
+};
+
+// Split: value is the threshold (go left when input <= value), the low 13
+// bits of link are the right child's index within the tree and the top 3
+// bits the feature. Leaf: feature FOREST_LEAF, value is P(on).
+struct ForestNode {
+  int16_t value;
+  uint16_t link;
+};
+
+#define FOREST_NODE_FEATURE(node) ((uint8_t)((node).link >> 13))
+#define FOREST_NODE_RIGHT(node) ((node).link & 0x1FFF)
+
+struct ActuatorForest {
+  const ForestNode* nodes;
+  const uint32_t* trees;              // Index of each tree's root in nodes
+  uint16_t treeCount;
+  uint32_t nodeCount;
+};
+
+struct ActuatorDecision {
+  bool on;
+  float confidence;                   // Share of the vote for the decision, 0.5-1
+};
+
+// Fixed-point inputs for one decision
+struct ForestInputs {
+  int16_t q[FOREST_FEATURE_COUNT];
+};
+
+ForestInputs forest_quantize(float temperature, float humidity, float soilPercent, float lightPercent);
+
+// Sum of the trees' P(on) leaves, in FOREST_LEAF_SCALE units
+uint32_t forest_vote(const ActuatorForest& forest, const ForestInputs& inputs);
+ActuatorDecision forest_decide(const ActuatorForest& forest, const ForestInputs& inputs);
+
+// The compiled-in model (FEATURE_ACTUATOR_MODEL)
+bool actuator_model_available();
+const ActuatorForest& actuator_model_forest(ModelActuator actuator);
+ActuatorDecision actuator_model_predict(ModelActuator actuator, const ForestInputs& inputs);
+const char* actuator_model_version();      // Hash of the exported forests, "" without a model
+size_t actuator_model_bytes();             // Flash taken by the node and root tables
+
+const char* model_actuator_name(ModelActuator actuator);
+
+#endif
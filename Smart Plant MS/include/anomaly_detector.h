@@ -0,0 +1,81 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+
+#include <stdint.h>
+#include "profile_presets.h"
+
+// ============ Anomaly Detection ============
+// On-device port of the sensor-data-service's DataProcessor.detect_anomalies():
+// every smoothed reading is compared with the recent mean of its field, kept
+// as streaming statistics (StreamingStats in sensor_filter.h) instead of a
+// 20-sample history. A reading is anomalous when it deviates from the mean by
+// more than the field's fixed threshold (the service's ANOMALY_THRESHOLDS) or
+// by more than ANOMALY_Z_LIMIT standard deviations.
+//
+// Only transitions are reported: one "raised" event when a field becomes
+// anomalous and one "cleared" event when it has settled again, so the
+// backend can subscribe to events instead of inspecting every sample.
+//
+// Topic: plant-iot/<device>/events/anomaly (plant-iot/events/anomaly in
+// compat mode).
+
+#ifndef ANOMALY_WINDOW
+#define ANOMALY_WINDOW 20             // Samples the statistics follow (and warm-up length)
+#endif
+
+#ifndef ANOMALY_Z_LIMIT
+#define ANOMALY_Z_LIMIT 4.0f          // Standard deviations from the mean
+#endif
+
+// Fixed deviation thresholds, in the units the service uses
+#define ANOMALY_THRESHOLD_TEMPERATURE 15.0f   // °C
+#define ANOMALY_THRESHOLD_HUMIDITY 25.0f      // %
+#define ANOMALY_THRESHOLD_SOIL_MOISTURE 30.0f // % (calibrated)
+#define ANOMALY_THRESHOLD_LIGHT 40.0f         // % of full scale
+
+// Lower bound on the standard deviation used for the z-score, so a very
+// steady signal does not turn sensor noise into anomalies
+#define ANOMALY_MIN_STDDEV_TEMPERATURE 0.5f
+#define ANOMALY_MIN_STDDEV_HUMIDITY 1.0f
+#define ANOMALY_MIN_STDDEV_SOIL_MOISTURE 1.0f
+#define ANOMALY_MIN_STDDEV_LIGHT 2.0f
+
+enum AnomalyField : uint8_t {
+  ANOMALY_TEMPERATURE,
+  ANOMALY_HUMIDITY,
+  ANOMALY_SOIL_MOISTURE,
+  ANOMALY_LIGHT,
+  ANOMALY_FIELD_COUNT
+};
+
+enum AnomalyReason : uint8_t {
+  ANOMALY_REASON_THRESHOLD,       // Deviation above the field's fixed threshold
+  ANOMALY_REASON_ZSCORE           // Statistically unusual for this device
+};
+
+struct AnomalyEvent {
+  AnomalyField field;
+  int8_t plant;                   // Soil probe index, -1 for shared environment fields
+  bool raised;                    // false = cleared
+  AnomalyReason reason;
+  float value;
+  float expected;                 // Streaming mean before this sample
+  float deviation;                // |value - expected|
+  float stddev;
+  float zScore;
+};
+
+// Receives every raised/cleared event; the firmware adds context and publishes
+typedef void (*AnomalySink)(const AnomalyEvent& event);
+
+void anomaly_begin(AnomalySink sink);
+
+// Feed one smoothed reading per sensor cycle
+void anomaly_check_environment(float temperature, float humidity, int lightPercent);
+void anomaly_check_soil(uint8_t plant, int moisturePercent);
+
+bool anomaly_active(AnomalyField field, uint8_t plant = 0);
+const char* anomaly_field_name(AnomalyField field);      // Service field names
+const char* anomaly_reason_name(AnomalyReason reason);
+
+#endif
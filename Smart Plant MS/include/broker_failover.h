@@ -0,0 +1,115 @@
+#ifndef BROKER_FAILOVER_H
+#define BROKER_FAILOVER_H
+
+#include <stdint.h>
+#include "profile_presets.h"
+
+// ============ Broker Failover ============
+// An ordered list of brokers, the primary first. Compiled only with
+// FEATURE_BROKER_FAILOVER; main.cpp asks failover_target() where to
+// connect and reports the outcome.
+//
+//   Failover   When the active broker is lost, the device keeps retrying it
+//              for BROKER_FAILOVER_AFTER_MS, then moves to the first broker
+//              in list order that passed its last probe (the next one if
+//              none did), and so on. Once the loss is noticed, a failover
+//              takes at most BROKER_FAILOVER_AFTER_MS plus one retry delay,
+//              one connect attempt (its CONNACK wait limited to
+//              BROKER_CONNECT_TIMEOUT_S) and one probe.
+//   Probing    Every broker other than the active one is probed each
+//              BROKER_PROBE_INTERVAL_MS from failover_loop(): a TCP connect
+//              (at most BROKER_PROBE_TIMEOUT_MS, the only blocking step)
+//              and, for plain MQTT, a CONNECT answered by CONNACK 0 within
+//              the same timeout, polled across loop passes. Probes use the
+//              client ID "<device>-probe" so they never take over the
+//              device's own session.
+//   Return     Off the primary, the device goes back only once the primary
+//              has passed BROKER_RETURN_PROBES probes in a row spanning
+//              BROKER_RETURN_HOLD_MS, and the device has stayed at least
+//              BROKER_MIN_DWELL_MS on the current broker. A primary that
+//              flaps never collects the streak, so the device stays put.
+//
+// Telemetry produced while no broker is connected waits in the offline
+// backlog (offline_backlog.h) and is replayed to whichever broker is active.
+// failover_stats() feeds the "broker" object of the birth message.
+
+#ifndef BROKER_MAX
+#define BROKER_MAX 4
+#endif
+
+#ifndef BROKER_FAILOVER_AFTER_MS
+#define BROKER_FAILOVER_AFTER_MS 3000UL
+#endif
+
+#ifndef BROKER_RETRY_MS
+#define BROKER_RETRY_MS 500UL         // Between connect attempts during an outage
+#endif
+
+#ifndef BROKER_CONNECT_TIMEOUT_S
+#define BROKER_CONNECT_TIMEOUT_S 2    // CONNACK wait set on the MQTT client
+#endif
+
+#ifndef BROKER_PROBE_INTERVAL_MS
+#define BROKER_PROBE_INTERVAL_MS 5000UL
+#endif
+
+#ifndef BROKER_PROBE_TIMEOUT_MS
+#define BROKER_PROBE_TIMEOUT_MS 1000UL
+#endif
+
+#ifndef BROKER_RETURN_PROBES
+#define BROKER_RETURN_PROBES 3
+#endif
+
+#ifndef BROKER_RETURN_HOLD_MS
+#define BROKER_RETURN_HOLD_MS 30000UL
+#endif
+
+#ifndef BROKER_MIN_DWELL_MS
+#define BROKER_MIN_DWELL_MS 60000UL
+#endif
+
+struct BrokerEndpoint {
+  const char* host;
+  uint16_t port;
+};
+
+struct BrokerHealth {
+  bool healthy;                   // Last probe (or connection) succeeded
+  uint8_t streak;                 // Consecutive probes with that result
+  unsigned long healthySince;     // millis() of the first probe in a healthy streak
+  unsigned long lastProbe;        // millis()
+  uint32_t rttMs;                 // Last successful probe
+};
+
+struct FailoverStats {
+  uint8_t active;                 // Index of the active broker, 0 = primary
+  uint32_t failovers;             // Reconnected to another broker after an outage
+  uint32_t returns;               // Planned moves back to the primary
+  uint32_t lastOutageMs;          // Connection lost to connected again (either broker)
+  uint32_t maxOutageMs;
+  uint32_t lastReturnMs;          // Disconnect to connected on a planned return
+  uint32_t probes;
+  uint32_t probeFailures;
+};
+
+// The list is kept by pointer; brokers[0] is the primary. Probes connect as
+// "<deviceId>-probe". Without mqttProbe (TLS or WebSocket transports) a probe
+// only checks that the port accepts TCP.
+void failover_begin(const BrokerEndpoint* brokers, uint8_t count, const char* deviceId, bool mqttProbe);
+
+// Broker for the next connect attempt; moves on after BROKER_FAILOVER_AFTER_MS
+const BrokerEndpoint& failover_target(unsigned long now);
+
+void failover_connected(unsigned long now);
+void failover_connect_failed(unsigned long now);
+
+// Runs the probes and notices a lost connection; call every loop pass.
+// Returns true when the device should leave the current broker for the
+// primary: disconnect cleanly, and the next failover_target() is the primary.
+bool failover_loop(unsigned long now, bool clientConnected);
+
+const FailoverStats& failover_stats();
+const BrokerHealth& failover_health(uint8_t broker);
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <Arduino.h>
+#include "profile_presets.h"
+#include "soil_probes.h"
+
+// ============ Runtime Configuration ============
+// Tunables that used to be compile-time constants, changeable over MQTT
+// without reflashing. A change is validated as a whole, applied immediately
+// (filters resized, intervals rescheduled, pins moved) and then has to pass
+// health checks for a trial period before it is written to NVS. If the
+// checks fail, the previous configuration is re-applied. A reboot during
+// the trial also falls back to the last committed configuration, because
+// only committed configurations are persisted.
+//
+// Topics (under plant-iot/<device>/):
+//   config/set    partial or full document; omitted fields keep their value
+//   config/get    any payload; the current document is published to config/state
+//   config/state  {"status": ..., "version", "revision", ...current values}
+//
+// Document (all fields optional except "version"):
+//   {"version": 1, "revision": 4,
+//    "sensor_interval_ms": 2000, "publish_interval_ms": 2000,
+//    "smoothing_size": 5, "soil_smoothing_size": 5,
+//    "thresholds": {"pump_on_below": 30, "fan_on_above": 30.0},
+//    "pins": {"light": 35, "pump": 5, "fan": 18, "grow_light": 19},
+//    "soil_calibration": [{"dry": 3100, "wet": 1250}, ...]}
+//
+// "version" is the schema version (CONFIG_SCHEMA_VERSION). "revision" is
+// optional; when present it must be newer than the current revision, which
+// protects against stale or replayed documents.
+//
+// "soil_calibration" holds one entry per pot, in plant order: the raw ADC
+// reading of that probe in dry soil (0%) and in saturated soil (100%). A
+// shorter list only changes the first pots, and an entry may leave out
+// "dry" or "wet" (or be null) to keep it.
+
+#define CONFIG_SCHEMA_VERSION 1
+#define CONFIG_NVS_NAMESPACE "config"
+#define CONFIG_NVS_KEY "active"
+
+// A new configuration is on trial for this long, or for three publish
+// intervals if that is longer
+#define CONFIG_TRIAL_MS 30000UL
+
+// Compiled-in defaults
+#define DEFAULT_SENSOR_INTERVAL_MS 2000UL
+#define DEFAULT_PUBLISH_INTERVAL_MS 2000UL
+#define DEFAULT_PUMP_ON_BELOW_PERCENT 30
+#define DEFAULT_FAN_ON_ABOVE_C 30.0f
+#define DEFAULT_LIGHT_PIN 35
+#define DEFAULT_PUMP_PIN 5
+#define DEFAULT_FAN_PIN 18
+#define DEFAULT_GROW_LIGHT_PIN 19
+
+// The DHT22 pin is fixed at build time; configurable pins may not reuse it
+#define DHTPIN 4
+
+#define CONFIG_SENSOR_INTERVAL_MIN_MS 500UL
+#define CONFIG_SENSOR_INTERVAL_MAX_MS 600000UL
+#define CONFIG_PUBLISH_INTERVAL_MIN_MS 1000UL
+#define CONFIG_PUBLISH_INTERVAL_MAX_MS 3600000UL
+#define CONFIG_SOIL_RAW_MAX 4095          // 12-bit ADC
+#define CONFIG_SOIL_CAL_MIN_SPAN 100      // Closer dry/wet points only amplify ADC noise
+
+// Documents grow by one calibration entry per pot; 384 bytes of config/state
+// hold a single-pot board's document, each further pot adds up to 24
+#define CONFIG_JSON_CAPACITY (512 + JSON_ARRAY_SIZE(PLANT_COUNT) + PLANT_COUNT * JSON_OBJECT_SIZE(2))
+#define CONFIG_STATE_SIZE (384 + (PLANT_COUNT - 1) * 24)
+
+struct ConfigPins {
+  uint8_t light;
+  uint8_t pump;
+  uint8_t fan;
+  uint8_t growLight;
+};
+
+struct DeviceConfig {
+  uint16_t version;               // CONFIG_SCHEMA_VERSION
+  uint32_t revision;              // 0 = compiled-in defaults
+  uint32_t sensorIntervalMs;
+  uint32_t publishIntervalMs;
+  uint8_t smoothingSize;          // Environment (DHT22, LDR) window
+  uint8_t soilSmoothingSize;      // Per soil channel window
+  uint8_t pumpOnBelowPercent;     // Local auto-control thresholds
+  float fanOnAboveC;
+  ConfigPins pins;
+  SoilCalibration soilCalibration[PLANT_COUNT];  // Last, so a blob stored before it can still be loaded
+};
+
+enum ConfigResult : uint8_t {
+  CONFIG_APPLIED,                 // On trial; committed or rolled back later
+  CONFIG_UNCHANGED,
+  CONFIG_REJECTED_PARSE,
+  CONFIG_REJECTED_VERSION,
+  CONFIG_REJECTED_STALE,
+  CONFIG_REJECTED_INVALID,
+  CONFIG_REJECTED_BUSY            // Another change is still on trial
+};
+
+enum ConfigEvent : uint8_t {
+  CONFIG_EVENT_NONE,
+  CONFIG_EVENT_COMMITTED,
+  CONFIG_EVENT_ROLLED_BACK
+};
+
+// Applies a configuration to the running firmware; previous is what was in
+// effect before (equal to next on the first call from config_begin())
+typedef void (*ConfigApplier)(const DeviceConfig& next, const DeviceConfig& previous);
+
+// Loads the committed configuration from NVS (or the defaults) and applies it
+void config_begin(ConfigApplier apply);
+const DeviceConfig& config();
+DeviceConfig config_defaults();
+
+// Parses, validates and applies a config/set document. On rejection, error
+// receives a short reason.
+ConfigResult config_set(const uint8_t* payload, size_t length, unsigned long now, char* error, size_t errorSize);
+const char* config_result_name(ConfigResult result);
+
+// Health signals fed by the main loop while a change is on trial
+void config_note_sensor_read(bool dhtOk);
+void config_note_publish(bool ok);
+
+// Ends the trial when due: commits to NVS or rolls back
+ConfigEvent config_loop(unsigned long now);
+bool config_on_trial();
+const char* config_last_error();
+
+// Serializes the current configuration with a status string
+size_t config_serialize(const char* status, const char* error, char* buffer, size_t size);
+
+// FNV-1a over the settings in effect (not the revision), so devices running
+// the same settings report the same hash whatever path they took there
+uint32_t config_hash();
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef DEVICE_IDENTITY_H
+#define DEVICE_IDENTITY_H
+
+#include <Arduino.h>
+
+// ============ Device Identity ============
+// The device ID namespaces every MQTT topic, so it must be unique per board.
+// A provisioned ID stored in NVS wins; otherwise the ID is derived from the
+// factory-burned eFuse MAC ("plant-" + last three MAC bytes in hex).
+//
+// Provisioning over MQTT (profiles with runtime configuration), under the
+// current plant-iot/<device>/:
+//   identity/set    {"device_id": "greenhouse-03", "restart": true}
+//                   "" goes back to the eFuse MAC ID. The ID takes effect at
+//                   the next boot; "restart" reboots as soon as it is stored.
+//   identity/state  {"status": "provisioned", "device_id": <ID in use>,
+//                    "provisioned": <ID in use came from NVS>, "timestamp": ...}
+//   status is provisioned, cleared, rejected_parse, rejected_invalid or nvs_failed.
+
+#define DEVICE_ID_MAX_LEN 24
+#define DEVICE_ID_NVS_NAMESPACE "identity"
+#define DEVICE_ID_NVS_KEY "device_id"
+
+const char* device_identity_begin();   // Loads or derives the ID, call once in setup()
+const char* device_identity();         // ID loaded by device_identity_begin()
+bool device_identity_is_provisioned(); // true if the ID came from NVS
+
+// Stores an ID in NVS; takes effect on next boot. IDs may only contain
+// letters, digits, '-' and '_' so they are safe as MQTT topic levels. An
+// empty ID removes the stored one.
+bool device_identity_provision(const char* id);
+bool device_identity_valid(const char* id);
+
+#endif
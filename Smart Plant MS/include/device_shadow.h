@@ -0,0 +1,92 @@
+#ifndef DEVICE_SHADOW_H
+#define DEVICE_SHADOW_H
+
+#include <Arduino.h>
+#include "profile_presets.h"
+
+// ============ Device Shadow ============
+// Versioned desired and reported state for the actuators and the runtime
+// configuration, so the backend does not have to infer either from the
+// periodic status/all messages.
+//
+// Topics (under plant-iot/<device>/):
+//   shadow/desired   written (retained) by the backend, subscribed by the device
+//   shadow/reported  published by the device: a full document after every
+//                    (re)connect and on shadow/get, otherwise deltas only
+//   shadow/get       any payload; the device publishes a full reported document
+//
+// Desired document (sections and fields optional except "version"):
+//   {"version": 12,
+//    "actuators": {"pump": "ON", "fan": "OFF", "grow_light": "ON"},
+//    "config": {...a config/set document, see device_config.h...}}
+//
+// Reported document:
+//   {"version": 731, "desired_version": 12, "full": true,
+//    "state": {"actuators": {"pump": "ON", "fan": "OFF", "grow_light": "ON"},
+//              "config": {"revision": 4, "trial": false}}}
+//   A delta has "full": false and only the fields that changed.
+//
+// Reconciliation: subscribing to shadow/desired after a (re)connect fetches
+// the retained document. It is applied only if its version is newer than the
+// last one applied (0 after boot, so desired state is restored after a
+// reboot), so a reconnect never replays an old document over newer changes.
+// A direct command after a desired document supersedes it until the backend
+// writes a newer version; "desired_version" tells the backend which
+// document the reported state already reflects. Nothing compares wall time.
+//
+// The reported version increases by one per document and never goes back,
+// also across reboots: versions are leased from NVS in blocks of
+// SHADOW_VERSION_LEASE, so only one write in that many touches flash.
+// A consumer that sees a gap in the versions asks for a full document on
+// shadow/get.
+
+#define SHADOW_NVS_NAMESPACE "shadow"
+#define SHADOW_NVS_KEY "lease"
+#define SHADOW_VERSION_LEASE 1000UL
+
+// Desired sections are optional; absent fields leave the device as it is
+struct ShadowDesired {
+  uint32_t version;
+  bool hasPump, hasFan, hasGrowLight;
+  bool pump, fan, growLight;
+  const char* config;             // Serialized "config" section, nullptr if absent
+  size_t configLength;
+};
+
+struct ShadowState {
+  bool pump;
+  bool fan;
+  bool growLight;
+  uint32_t configRevision;
+  bool configTrial;
+};
+
+enum ShadowResult : uint8_t {
+  SHADOW_APPLIED,
+  SHADOW_REJECTED_PARSE,
+  SHADOW_REJECTED_STALE           // Version not newer than the last applied
+};
+
+// Applies a desired document to the running firmware
+typedef void (*ShadowApplier)(const ShadowDesired& desired);
+
+// Leases the next block of reported versions from NVS
+void shadow_begin(ShadowApplier apply);
+
+// Parses a shadow/desired document and applies it if its version is newer
+ShadowResult shadow_set_desired(const uint8_t* payload, size_t length);
+const char* shadow_result_name(ShadowResult result);
+uint32_t shadow_desired_version();
+
+// Serializes a reported document: the whole state if full, otherwise only
+// what changed since the last one reported. Returns 0 when a delta has
+// nothing to report. Takes nothing: the same call builds the same document
+// until shadow_reported() is called.
+size_t shadow_report(const ShadowState& state, bool full, char* buffer, size_t size);
+
+// The document shadow_report() built for state was published: takes its
+// version and makes state the base of the next delta
+void shadow_reported(const ShadowState& state);
+uint32_t shadow_reported_version();
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef DRYNESS_PREDICTOR_H
+#define DRYNESS_PREDICTOR_H
+
+#include <stdint.h>
+#include "profile_presets.h"
+
+// ============ Soil Dryness Predictor ============
+// On-device replacement for the analytics service's SoilDrynessPredictor.
+// Instead of fixed coefficients, each pot learns its own drying rate online:
+//
+//   rate (%/h) = a + b * (T - 25) / 10 + c * (H - 55) / 20
+//
+// Every DRYNESS_INTERVAL_MS the moisture drop over the interval is one
+// observation of the rate at the interval's mean temperature and humidity,
+// and the coefficients are updated by recursive least squares with
+// forgetting (older observations fade out, so seasons and pot size changes
+// are tracked). Intervals that include watering are discarded.
+//
+// The estimate is the time until moisture reaches the critical level (the
+// pump threshold of the runtime configuration) at the rate predicted for the
+// current conditions, with a confidence from the model's prediction
+// variance. It is published only when it changes meaningfully.
+//
+// Topic: plant-iot/<device>/predictions/soil-dryness (the analytics
+// service's plant-iot/predictions/soil-dryness in compat mode)
+
+#ifndef DRYNESS_INTERVAL_MS
+#define DRYNESS_INTERVAL_MS 900000UL     // 15 min per rate observation
+#endif
+
+#define DRYNESS_SETTLE_MS 60000UL        // Wait after boot or watering before observing
+#define DRYNESS_FORGETTING 0.98f         // RLS forgetting factor (~50 observations of memory)
+#define DRYNESS_PRIOR_RATE 1.0f          // %/h before anything is learned
+#define DRYNESS_PRIOR_VARIANCE 4.0f      // Initial coefficient uncertainty
+#define DRYNESS_MIN_RATE 0.05f           // %/h; slower counts as "not drying" (no ETA)
+#define DRYNESS_MAX_RISE 0.5f            // %/h; a larger rise means water was added
+#define DRYNESS_MIN_OBSERVATIONS 3       // Confidence is 0 before this many updates
+
+// Republish when the ETA moves by more than this many hours or this fraction
+// of itself (whichever is larger), or the confidence by more than this much
+#define DRYNESS_PUBLISH_ETA_HOURS 0.5f
+#define DRYNESS_PUBLISH_ETA_FRACTION 0.1f
+#define DRYNESS_PUBLISH_CONFIDENCE 0.1f
+
+// The local controller acts on estimates at least this confident and this close
+#define DRYNESS_PLAN_MIN_CONFIDENCE 0.5f
+#define DRYNESS_PLAN_AHEAD_HOURS 2.0f
+
+struct DrynessEstimate {
+  uint8_t plant;
+  bool valid;                     // false until the first observation
+  float moisture;                 // % at the last observation
+  float criticalMoisture;         // %
+  float rate;                     // Predicted drying rate now (%/h)
+  float etaHours;                 // < 0: not drying, no ETA
+  float confidence;               // 0-1
+  uint16_t observations;
+};
+
+// Receives estimates that changed meaningfully
+typedef void (*DrynessSink)(const DrynessEstimate& estimate);
+
+void dryness_begin(DrynessSink sink);
+
+// Feed every sensor cycle with the smoothed readings. watering is true while
+// this pot's pump or valve is running.
+void dryness_observe(uint8_t plant, float moisture, float temperature, float humidity, bool watering,
+                     float criticalMoisture, unsigned long now);
+
+const DrynessEstimate& dryness_estimate(uint8_t plant);
+
+#endif
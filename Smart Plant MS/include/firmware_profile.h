@@ -0,0 +1,97 @@
+#ifndef FIRMWARE_PROFILE_H
+#define FIRMWARE_PROFILE_H
+
+#include <Arduino.h>
+#include "profile_presets.h"
+#include "irrigation_zones.h"
+#include "soil_probes.h"
+#include "topics.h"
+#include "trace_recorder.h"
+
+// ============ Firmware Profile ============
+// Typed, constexpr view of the build configuration selected in
+// profile_presets.h. Code branches on it with `if constexpr`, so a disabled
+// feature is not just skipped at runtime: its calls disappear and the linker
+// drops the module code behind them (-ffunction-sections / --gc-sections).
+
+struct FirmwareProfile {
+  const char* name;
+  uint8_t plants;
+  uint8_t zones;
+  bool soilMux;
+  bool flatTopics;
+  bool legacyTopics;
+  bool trace;
+  bool runtimeConfig;
+  bool serialLog;
+  bool deviceShadow;
+  bool anomalyEvents;
+  bool wateringEvents;
+  bool drynessEta;
+  bool actuatorModel;
+  bool trendModel;
+  bool mqtt5;
+  bool mqttsn;
+  bool mqttTls;
+  bool mqttWs;
+  bool brokerFailover;
+  bool httpServer;
+};
+
+constexpr FirmwareProfile PROFILE = {
+  FIRMWARE_PROFILE == PROFILE_BENCH     ? "bench"
+  : FIRMWARE_PROFILE == PROFILE_FIELD   ? "field"
+  : FIRMWARE_PROFILE == PROFILE_GATEWAY ? "gateway"
+                                        : "default",
+  PLANT_COUNT,
+  ZONE_COUNT,
+  SOIL_MUX_ENABLED != 0,
+  TOPIC_COMPAT_FLAT != 0,
+  FEATURE_LEGACY_TOPICS != 0,
+  TRACE_ENABLED != 0,
+  FEATURE_RUNTIME_CONFIG != 0,
+  FEATURE_SERIAL_LOG != 0,
+  FEATURE_DEVICE_SHADOW != 0,
+  FEATURE_ANOMALY_EVENTS != 0,
+  FEATURE_WATERING_EVENTS != 0,
+  FEATURE_DRYNESS_ETA != 0,
+  FEATURE_ACTUATOR_MODEL != 0,
+  FEATURE_TREND_MODEL != 0,
+  FEATURE_MQTT5 != 0,
+  FEATURE_MQTTSN != 0,
+  FEATURE_MQTT_TLS != 0,
+  FEATURE_MQTT_WS != 0,
+  FEATURE_BROKER_FAILOVER != 0,
+  FEATURE_HTTP_SERVER != 0,
+};
+
+static_assert(!(PROFILE.mqtt5 && PROFILE.mqttsn), "FEATURE_MQTT5 and FEATURE_MQTTSN select different clients");
+static_assert(!(PROFILE.mqttsn && PROFILE.mqttTls), "MQTT-SN runs over UDP; FEATURE_MQTT_TLS is for TCP");
+static_assert(!(PROFILE.mqttsn && PROFILE.mqttWs), "MQTT-SN runs over UDP; FEATURE_MQTT_WS is for TCP");
+static_assert(!(PROFILE.mqttsn && PROFILE.brokerFailover), "FEATURE_BROKER_FAILOVER probes MQTT brokers over TCP");
+
+// ============ Serial Log ============
+// Serial diagnostics that compile to nothing when the profile disables them,
+// including the format strings.
+template <bool Enabled>
+struct SerialLog {
+  template <typename... Args>
+  static void printf(const char* format, Args... args) {
+    if constexpr (Enabled) Serial.printf(format, args...);
+  }
+  template <typename T>
+  static void print(const T& value) {
+    if constexpr (Enabled) Serial.print(value);
+  }
+  template <typename T>
+  static void println(const T& value) {
+    if constexpr (Enabled) Serial.println(value);
+  }
+  static void println() {
+    if constexpr (Enabled) Serial.println();
+  }
+};
+
+using Log = SerialLog<PROFILE.serialLog>;
+
+#endif
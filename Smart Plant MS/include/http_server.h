@@ -0,0 +1,98 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "profile_presets.h"
+#include "soil_probes.h"
+
+// ============ LAN HTTP Server ============
+// Readings for dashboards on the site network, straight from the device
+// instead of through the broker (FEATURE_HTTP_SERVER):
+//
+//   GET /latest          the most recent sample
+//   GET /history         every sample still in the on-device buffer, oldest
+//                        first, as a JSON array; ?since=<id> for the newer ones
+//   GET /events          Server-Sent Events, one "sample" event per reading;
+//                        a reconnecting EventSource resumes after
+//                        Last-Event-ID from the buffer
+//
+// A sample, in the telemetry field names:
+//   {"id": 42, "timestamp": 84000, "device_id": "plant-a1b2c3",
+//    "temperature": 22.5, "humidity": 55.0, "light_intensity": 2048,
+//    "light_percent": 50, "soil_moisture_percent": [45, 60],
+//    "pump": "OFF", "fan": "OFF", "grow_light": "ON"}
+// "id" counts samples since boot; it is the SSE event ID.
+//
+// Cooperative, like the rest of loop(): http_loop() never waits for a
+// client. Each pass it accepts up to HTTP_ACCEPT_PER_LOOP pending
+// connections, reads what has arrived and writes at most
+// HTTP_WRITE_PER_LOOP bytes per connection. At most
+// HTTP_MAX_CLIENTS connections are served at once (HTTP_MAX_STREAMS of them
+// event streams); further ones get an immediate 503, so the time a pass can
+// spend here stays bounded however many dashboards are open.
+//
+// Nothing is allocated per request: every connection has a fixed slot, and
+// responses are formatted into the slot's buffer as the connection drains
+// it. Streams and /history follow the sample buffer with a cursor; a client
+// that falls behind by more than HTTP_HISTORY_SAMPLES skips ahead.
+// Connections close after each response (no keep-alive).
+
+#ifndef HTTP_PORT
+#define HTTP_PORT 80
+#endif
+
+#ifndef HTTP_MAX_CLIENTS
+#define HTTP_MAX_CLIENTS 4
+#endif
+
+#ifndef HTTP_MAX_STREAMS
+#define HTTP_MAX_STREAMS 2
+#endif
+
+#ifndef HTTP_HISTORY_SAMPLES
+#define HTTP_HISTORY_SAMPLES 150          // 5 minutes at the default 2 s sensor interval
+#endif
+
+#define HTTP_ACCEPT_PER_LOOP 4            // Further pending connections wait in the backlog
+#define HTTP_LINE_MAX 128                 // Longer request lines and headers are truncated
+#define HTTP_TX_BUFFER_SIZE 512           // One sample (16 plants) plus its SSE framing
+#define HTTP_WRITE_PER_LOOP 1536          // Per connection and pass; /history takes several
+#define HTTP_REQUEST_TIMEOUT_MS 3000UL    // Whole request must arrive within this
+#define HTTP_KEEPALIVE_MS 15000UL         // SSE comment line on an idle stream
+
+struct HttpSample {
+  unsigned long timestamp;
+  float temperature;
+  float humidity;
+  int lightIntensity;                     // Smoothed raw ADC (0-4095)
+  uint8_t moisturePercent[PLANT_COUNT];
+  bool pump;
+  bool fan;
+  bool growLight;
+};
+
+struct HttpStats {
+  uint32_t accepted;
+  uint32_t refused;                       // 503: all slots, or all stream slots, busy
+  uint32_t latest;
+  uint32_t history;
+  uint32_t streams;
+  uint32_t notFound;                      // 404, 405 and malformed requests
+  uint32_t events;                        // SSE sample events sent
+  uint32_t skipped;                       // Samples a slow stream fell behind on
+  uint8_t open;                           // Connections now
+  uint8_t peakOpen;
+};
+
+void http_begin(const char* deviceId);
+
+// Records a sample: the new /latest, appended to /history, sent to streams
+void http_sample(const HttpSample& sample);
+
+// Accepts, reads and writes; call every loop pass
+void http_loop(unsigned long now);
+
+const HttpStats& http_stats();
+
+#endif
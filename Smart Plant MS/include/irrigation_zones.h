@@ -0,0 +1,74 @@
+#ifndef IRRIGATION_ZONES_H
+#define IRRIGATION_ZONES_H
+
+#include <Arduino.h>
+#include "profile_presets.h"
+
+// ============ Irrigation Zone Configuration ============
+// Each zone has its own solenoid valve; all zones share the pump on PUMP_PIN.
+// Watering requests are queued and started one at a time so that no more than
+// ZONE_MAX_ACTIVE valves (plus the pump) draw current at once, which keeps
+// the supply out of brownout when many pots are served by one controller.
+
+#ifndef ZONE_COUNT
+#define ZONE_COUNT 1              // 1 = legacy single pump, no valves
+#endif
+
+#ifndef ZONE_MAX_ACTIVE
+#define ZONE_MAX_ACTIVE 1         // Valves allowed open at the same time
+#endif
+
+#define ZONE_VALVE_PINS {25, 26, 23, 22, 21, 17, 16, 15}
+#define ZONE_START_STAGGER_MS 500 // Gap between valve starts (inrush current)
+#define ZONE_PUMP_LEAD_MS 200     // Valve opens this long before the pump starts
+#define ZONE_DEFAULT_DURATION_MS 30000UL
+#define ZONE_MAX_DURATION_MS 300000UL
+#define ZONE_MAX_DURATION_S (ZONE_MAX_DURATION_MS / 1000)
+#define ZONE_MIN_INTERVAL_MS 600000UL  // Minimum time between waterings of one zone
+
+#if ZONE_COUNT < 1 || ZONE_COUNT > 8
+#error "ZONE_COUNT must be between 1 and 8"
+#endif
+
+#if ZONE_MAX_ACTIVE < 1
+#error "ZONE_MAX_ACTIVE must be at least 1"
+#endif
+
+// ============ Irrigation Zone API ============
+enum ZoneState : uint8_t {
+  ZONE_IDLE,
+  ZONE_QUEUED,
+  ZONE_WATERING
+};
+
+enum ZoneRequestResult : uint8_t {
+  ZONE_ACCEPTED,
+  ZONE_ALREADY_PENDING,
+  ZONE_REJECTED_INTERVAL,
+  ZONE_REJECTED_INVALID
+};
+
+void zones_begin(uint8_t pumpPin);
+void zones_loop(unsigned long now);
+void zones_set_pump_pin(uint8_t pumpPin);   // Moves the pump to another pin, keeping its state
+
+ZoneRequestResult zones_request(uint8_t zone, unsigned long durationMs, unsigned long now);
+void zones_stop(uint8_t zone);
+void zones_stop_all();
+
+bool zones_pump_on();
+uint8_t zones_active_count();
+uint8_t zones_queued_count();
+
+ZoneState zone_state(uint8_t zone);
+const char* zone_state_name(ZoneState state);
+const char* zone_request_result_name(ZoneRequestResult result);
+const char* zone_id(uint8_t zone);                          // e.g. "zone-02"
+int zone_index(const char* id);                              // -1 if unknown
+unsigned long zone_remaining_ms(uint8_t zone, unsigned long now);
+unsigned long zone_last_watered(uint8_t zone);               // millis() at last start, 0 if never
+
+// Bitmask of zones whose state changed since the last call (bit n = zone n)
+uint16_t zones_take_changed();
+
+#endif
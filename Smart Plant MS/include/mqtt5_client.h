@@ -0,0 +1,139 @@
+#ifndef MQTT5_CLIENT_H
+#define MQTT5_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mqtt_codec.h"
+#include "profile_presets.h"
+
+// ============ MQTT 5.0 Client ============
+// Drop-in for the part of the PubSubClient API the firmware uses, framing
+// packets with mqtt_codec.h over any Arduino Client. It speaks MQTT 5.0 and
+// falls back to 3.1.1 only when the broker explicitly rejects the 5.0
+// CONNECT: a 5.0 CONNACK with reason 0x84 or a 3.1.1 CONNACK with return
+// code 0x01. A connection closed before any CONNACK (a restarting or hung
+// broker, a network drop) is an ordinary connect failure, and the next
+// connect tries 5.0 again. After a fallback it stays on 3.1.1 for that
+// broker; setServer() with another broker starts on 5.0 again.
+//
+// With 5.0 every PUBLISH also gets:
+// - a topic alias: the first message on a topic sends the topic and an
+//   alias, later ones only the two-byte alias (up to MQTT5_TOPIC_ALIASES
+//   topics, or fewer if the broker allows fewer)
+// - a message expiry (setMessageExpiry()) when not retained, so a consumer
+//   that reconnects does not get stale telemetry from its session queue
+// - the user properties set with addUserProperty() (schema version and
+//   encoding)
+// and an incoming message's response topic and correlation data are kept
+// for the callback, which answers with respond().
+//
+// Everything lives in two fixed buffers inside the object; nothing is
+// allocated per message. QoS 0 publishes only, like PubSubClient.
+
+#ifndef MQTT5_BUFFER_SIZE
+#define MQTT5_BUFFER_SIZE 512
+#endif
+
+#ifndef MQTT5_TOPIC_ALIASES
+#define MQTT5_TOPIC_ALIASES 32
+#endif
+
+#ifndef MQTT5_TELEMETRY_EXPIRY_S
+#define MQTT5_TELEMETRY_EXPIRY_S 120 // Message expiry the firmware sets (setup_mqtt5() in main.cpp)
+#endif
+
+#define MQTT5_ALIAS_TOPIC_LEN 80     // Longer topics are published without an alias
+#define MQTT5_USER_PROPERTIES 4
+#define MQTT5_RESPONSE_TOPIC_LEN 96
+#define MQTT5_CORRELATION_LEN 64
+#define MQTT5_CONNECT_TIMEOUT_MS 5000UL   // CONNACK wait unless setSocketTimeout() changes it
+
+// Same values as PubSubClient's state()
+#define MQTT5_CONNECTION_TIMEOUT -4
+#define MQTT5_CONNECTION_LOST -3
+#define MQTT5_CONNECT_FAILED -2
+#define MQTT5_DISCONNECTED -1
+#define MQTT5_CONNECTED 0
+
+typedef void (*Mqtt5Callback)(char* topic, uint8_t* payload, unsigned int length);
+
+class Mqtt5Client {
+ public:
+  explicit Mqtt5Client(Client& client);
+
+  Mqtt5Client& setServer(const char* domain, uint16_t port);
+  Mqtt5Client& setCallback(Mqtt5Callback callback);
+  Mqtt5Client& setKeepAlive(uint16_t seconds);
+  Mqtt5Client& setSocketTimeout(uint16_t seconds);
+  bool setBufferSize(uint16_t size);      // Up to MQTT5_BUFFER_SIZE
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage);
+  void disconnect();
+  bool connected();
+  int state();
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained);
+  bool subscribe(const char* topic, uint8_t qos = 0);
+  bool loop();
+
+  // ---- MQTT 5.0 ----
+  uint8_t protocolLevel() const { return protocol_; }   // mqtt::PROTOCOL_V5, or V311 after a fallback
+  void setMessageExpiry(uint32_t seconds);               // Non-retained publishes; 0 = never
+  bool addUserProperty(const char* key, const char* value);  // Kept by pointer
+
+  // Valid inside the callback: the response topic of the message being
+  // delivered, or nullptr if it asked for no response
+  const char* responseTopic() const;
+  bool respond(const uint8_t* payload, size_t length);
+
+  // Wire statistics since boot
+  uint32_t bytesSent = 0;
+  uint32_t publishes = 0;
+  uint32_t aliasedPublishes = 0;          // Sent with an established alias, no topic
+
+ private:
+  bool open(const mqtt::ConnectOptions& options, bool& versionRejected);
+  bool send(const uint8_t* data, size_t length);
+  bool read_packet(mqtt::Packet& packet);
+  void handle(const mqtt::Packet& packet);
+  void drop(int state);
+  uint16_t alias_for(const char* topic, size_t length, bool& established);
+
+  Client& client_;
+  const char* domain_ = nullptr;
+  uint16_t port_ = 1883;
+  Mqtt5Callback callback_ = nullptr;
+  uint16_t keepAlive_ = 15;
+  unsigned long connectTimeoutMs_ = MQTT5_CONNECT_TIMEOUT_MS;
+  uint16_t bufferSize_ = MQTT5_BUFFER_SIZE;
+  int state_ = MQTT5_DISCONNECTED;
+  uint8_t protocol_ = mqtt::PROTOCOL_V5;
+  bool pingOutstanding_ = false;
+  unsigned long lastSend_ = 0;
+  uint16_t nextPacketId_ = 1;
+
+  uint8_t rx_[MQTT5_BUFFER_SIZE];
+  size_t rxLength_ = 0;
+  size_t rxPending_ = 0;                  // Size of the packet last returned by read_packet()
+  uint32_t rxSkip_ = 0;                   // Bytes left of an oversized packet being discarded
+  uint8_t tx_[MQTT5_BUFFER_SIZE];
+
+  // Topic aliases are per connection; the broker's maximum comes with CONNACK
+  char aliasTopics_[MQTT5_TOPIC_ALIASES][MQTT5_ALIAS_TOPIC_LEN];
+  uint16_t aliasCount_ = 0;
+  uint16_t aliasMaximum_ = 0;
+
+  uint32_t messageExpiry_ = 0;
+  mqtt::UserProperty userProperties_[MQTT5_USER_PROPERTIES];
+  uint8_t userPropertyCount_ = 0;
+
+  char responseTopic_[MQTT5_RESPONSE_TOPIC_LEN];
+  uint8_t correlation_[MQTT5_CORRELATION_LEN];
+  uint16_t correlationLength_ = 0;
+};
+
+#endif
@@ -0,0 +1,605 @@
+#ifndef MQTT_CODEC_H
+#define MQTT_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ============ MQTT 3.1.1 / 5.0 Packet Codec ============
+// Allocation-free encoder/decoder for the subset of MQTT 3.1.1 and MQTT 5.0
+// the firmware uses. It has no Arduino or socket dependencies so the same
+// code frames packets on the device and in the host-side tools (load
+// generator, simulation harness). Encoders return the number of bytes
+// written, or 0 if the packet does not fit in the supplied buffer.
+//
+// MQTT 5.0 differs on the wire mostly by a property block in CONNECT,
+// CONNACK, PUBLISH and SUBSCRIBE; the *_v5 functions below add and read it.
+// Packets without properties (PUBACK with reason 0, PINGREQ, DISCONNECT with
+// reason 0) are encoded the same way in both versions.
+
+namespace mqtt {
+
+enum PacketType : uint8_t {
+  CONNECT = 1,
+  CONNACK = 2,
+  PUBLISH = 3,
+  PUBACK = 4,
+  SUBSCRIBE = 8,
+  SUBACK = 9,
+  UNSUBSCRIBE = 10,
+  UNSUBACK = 11,
+  PINGREQ = 12,
+  PINGRESP = 13,
+  DISCONNECT = 14
+};
+
+static const uint32_t MAX_REMAINING_LENGTH = 268435455UL;
+
+static const uint8_t PROTOCOL_V311 = 4;
+static const uint8_t PROTOCOL_V5 = 5;
+
+// ============ Decoded Views (point into the caller's buffer) ============
+struct Packet {
+  uint8_t type;
+  uint8_t flags;
+  const uint8_t* body;
+  uint32_t length;          // Remaining length (body size)
+};
+
+struct PublishView {
+  const char* topic;        // Not NUL-terminated
+  uint16_t topicLength;
+  uint16_t packetId;        // 0 for QoS 0
+  uint8_t qos;
+  bool retain;
+  bool dup;
+  const uint8_t* payload;
+  uint32_t payloadLength;
+};
+
+struct ConnectOptions {
+  uint8_t protocolLevel;    // PROTOCOL_V311 (also when 0) or PROTOCOL_V5
+  const char* clientId;
+  uint16_t keepAliveSeconds;
+  bool cleanSession;
+  const char* username;     // nullptr = none
+  const char* password;     // nullptr = none
+  const char* willTopic;    // nullptr = no Last Will
+  const uint8_t* willPayload;
+  uint16_t willPayloadLength;
+  uint8_t willQos;
+  bool willRetain;
+};
+
+// ============ Primitive Writers ============
+class Writer {
+ public:
+  Writer(uint8_t* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity), size_(0), ok_(true) {}
+
+  void byte(uint8_t value) {
+    if (size_ + 1 > capacity_) { ok_ = false; return; }
+    buffer_[size_++] = value;
+  }
+
+  void u16(uint16_t value) {
+    byte(value >> 8);
+    byte(value & 0xFF);
+  }
+
+  void bytes(const void* data, size_t length) {
+    if (size_ + length > capacity_) { ok_ = false; return; }
+    memcpy(buffer_ + size_, data, length);
+    size_ += length;
+  }
+
+  void string(const char* value, size_t length) {
+    u16((uint16_t)length);
+    bytes(value, length);
+  }
+
+  void string(const char* value) {
+    string(value, strlen(value));
+  }
+
+  void varint(uint32_t value) {
+    do {
+      uint8_t encoded = value % 128;
+      value /= 128;
+      if (value > 0) encoded |= 0x80;
+      byte(encoded);
+    } while (value > 0);
+  }
+
+  size_t size() const { return ok_ ? size_ : 0; }
+  bool ok() const { return ok_; }
+
+ private:
+  uint8_t* buffer_;
+  size_t capacity_;
+  size_t size_;
+  bool ok_;
+};
+
+inline size_t varint_size(uint32_t value) {
+  return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+// ============ Encoders ============
+// MQTT 5.0 CONNECTs carry empty connect and will property blocks: every
+// property the client could send there has the default it wants
+inline size_t encode_connect(uint8_t* buffer, size_t capacity, const ConnectOptions& options) {
+  bool v5 = options.protocolLevel == PROTOCOL_V5;
+  size_t clientIdLength = strlen(options.clientId);
+  uint32_t length = 10 + (v5 ? 1 : 0) + 2 + clientIdLength;
+  uint8_t flags = options.cleanSession ? 0x02 : 0x00;
+
+  if (options.willTopic) {
+    length += (v5 ? 1 : 0) + 2 + strlen(options.willTopic) + 2 + options.willPayloadLength;
+    flags |= 0x04 | ((options.willQos & 0x03) << 3) | (options.willRetain ? 0x20 : 0x00);
+  }
+  if (options.username) {
+    length += 2 + strlen(options.username);
+    flags |= 0x80;
+  }
+  if (options.password) {
+    length += 2 + strlen(options.password);
+    flags |= 0x40;
+  }
+
+  Writer w(buffer, capacity);
+  w.byte(CONNECT << 4);
+  w.varint(length);
+  w.string("MQTT", 4);
+  w.byte(v5 ? PROTOCOL_V5 : PROTOCOL_V311);
+  w.byte(flags);
+  w.u16(options.keepAliveSeconds);
+  if (v5) w.varint(0);                    // Connect properties
+  w.string(options.clientId, clientIdLength);
+  if (options.willTopic) {
+    if (v5) w.varint(0);                  // Will properties
+    w.string(options.willTopic);
+    w.u16(options.willPayloadLength);
+    w.bytes(options.willPayload, options.willPayloadLength);
+  }
+  if (options.username) w.string(options.username);
+  if (options.password) w.string(options.password);
+  return w.size();
+}
+
+inline size_t encode_publish(uint8_t* buffer, size_t capacity, const char* topic, size_t topicLength,
+                             const uint8_t* payload, size_t payloadLength,
+                             uint8_t qos = 0, bool retain = false, uint16_t packetId = 0) {
+  uint32_t length = 2 + topicLength + (qos > 0 ? 2 : 0) + payloadLength;
+  if (length > MAX_REMAINING_LENGTH) return 0;
+
+  Writer w(buffer, capacity);
+  w.byte((PUBLISH << 4) | ((qos & 0x03) << 1) | (retain ? 0x01 : 0x00));
+  w.varint(length);
+  w.string(topic, topicLength);
+  if (qos > 0) w.u16(packetId);
+  w.bytes(payload, payloadLength);
+  return w.size();
+}
+
+inline size_t encode_publish(uint8_t* buffer, size_t capacity, const char* topic,
+                             const char* payload, uint8_t qos = 0, bool retain = false, uint16_t packetId = 0) {
+  return encode_publish(buffer, capacity, topic, strlen(topic), (const uint8_t*)payload, strlen(payload),
+                        qos, retain, packetId);
+}
+
+inline size_t encode_subscribe(uint8_t* buffer, size_t capacity, uint16_t packetId, const char* filter, uint8_t qos = 0) {
+  size_t filterLength = strlen(filter);
+  Writer w(buffer, capacity);
+  w.byte((SUBSCRIBE << 4) | 0x02);
+  w.varint(2 + 2 + filterLength + 1);
+  w.u16(packetId);
+  w.string(filter, filterLength);
+  w.byte(qos & 0x03);
+  return w.size();
+}
+
+inline size_t encode_ack(uint8_t* buffer, size_t capacity, PacketType type, uint16_t packetId) {
+  Writer w(buffer, capacity);
+  w.byte(type << 4);
+  w.byte(2);
+  w.u16(packetId);
+  return w.size();
+}
+
+inline size_t encode_empty(uint8_t* buffer, size_t capacity, PacketType type) {
+  Writer w(buffer, capacity);
+  w.byte(type << 4);
+  w.byte(0);
+  return w.size();
+}
+
+// ============ Decoders ============
+// Frames one packet from a byte stream. Returns the total packet size if a
+// complete packet is available, 0 if more bytes are needed, -1 if malformed.
+inline long decode_packet(const uint8_t* data, size_t available, Packet& packet) {
+  if (available < 2) return 0;
+
+  uint32_t length = 0;
+  uint32_t multiplier = 1;
+  size_t pos = 1;
+  for (;;) {
+    if (pos >= available) return 0;
+    if (pos > 4) return -1;
+    uint8_t encoded = data[pos++];
+    length += (encoded & 0x7F) * multiplier;
+    if ((encoded & 0x80) == 0) break;
+    multiplier *= 128;
+  }
+
+  if (available - pos < length) return 0;
+
+  packet.type = data[0] >> 4;
+  packet.flags = data[0] & 0x0F;
+  packet.body = data + pos;
+  packet.length = length;
+  return (long)(pos + length);
+}
+
+inline bool parse_publish(const Packet& packet, PublishView& view) {
+  if (packet.type != PUBLISH || packet.length < 2) return false;
+
+  view.qos = (packet.flags >> 1) & 0x03;
+  view.retain = packet.flags & 0x01;
+  view.dup = packet.flags & 0x08;
+  view.topicLength = (packet.body[0] << 8) | packet.body[1];
+
+  uint32_t pos = 2 + view.topicLength;
+  if (pos > packet.length) return false;
+  view.topic = (const char*)packet.body + 2;
+
+  view.packetId = 0;
+  if (view.qos > 0) {
+    if (pos + 2 > packet.length) return false;
+    view.packetId = (packet.body[pos] << 8) | packet.body[pos + 1];
+    pos += 2;
+  }
+
+  view.payload = packet.body + pos;
+  view.payloadLength = packet.length - pos;
+  return true;
+}
+
+// Packet ID of PUBACK/SUBACK/UNSUBACK, 0 if not applicable
+inline uint16_t packet_id(const Packet& packet) {
+  if (packet.length < 2) return 0;
+  return (packet.body[0] << 8) | packet.body[1];
+}
+
+// CONNACK return code (0 = accepted), or -1 if not a CONNACK
+inline int connack_code(const Packet& packet) {
+  if (packet.type != CONNACK || packet.length < 2) return -1;
+  return packet.body[1];
+}
+
+// ============ MQTT 5.0 Properties ============
+enum PropertyId : uint8_t {
+  PROP_PAYLOAD_FORMAT = 0x01,
+  PROP_MESSAGE_EXPIRY = 0x02,
+  PROP_CONTENT_TYPE = 0x03,
+  PROP_RESPONSE_TOPIC = 0x08,
+  PROP_CORRELATION_DATA = 0x09,
+  PROP_SUBSCRIPTION_ID = 0x0B,
+  PROP_SESSION_EXPIRY = 0x11,
+  PROP_ASSIGNED_CLIENT_ID = 0x12,
+  PROP_SERVER_KEEP_ALIVE = 0x13,
+  PROP_AUTH_METHOD = 0x15,
+  PROP_AUTH_DATA = 0x16,
+  PROP_REQUEST_PROBLEM_INFO = 0x17,
+  PROP_WILL_DELAY = 0x18,
+  PROP_REQUEST_RESPONSE_INFO = 0x19,
+  PROP_RESPONSE_INFO = 0x1A,
+  PROP_SERVER_REFERENCE = 0x1C,
+  PROP_REASON_STRING = 0x1F,
+  PROP_RECEIVE_MAXIMUM = 0x21,
+  PROP_TOPIC_ALIAS_MAXIMUM = 0x22,
+  PROP_TOPIC_ALIAS = 0x23,
+  PROP_MAXIMUM_QOS = 0x24,
+  PROP_RETAIN_AVAILABLE = 0x25,
+  PROP_USER_PROPERTY = 0x26,
+  PROP_MAXIMUM_PACKET_SIZE = 0x27,
+  PROP_WILDCARD_SUB_AVAILABLE = 0x28,
+  PROP_SUB_ID_AVAILABLE = 0x29,
+  PROP_SHARED_SUB_AVAILABLE = 0x2A
+};
+
+// CONNACK reason codes that mean "speak MQTT 3.1.1 to me": the 3.1.1
+// "unacceptable protocol version" return code and its 5.0 equivalent
+static const uint8_t CONNACK_V311_BAD_PROTOCOL = 0x01;
+static const uint8_t CONNACK_UNSUPPORTED_PROTOCOL = 0x84;
+
+struct UserProperty {
+  const char* key;
+  const char* value;
+};
+
+// Properties of an outgoing PUBLISH; zero/nullptr fields are left out
+struct PublishProperties {
+  uint32_t messageExpiry;       // Seconds, 0 = never expires
+  uint16_t topicAlias;          // 0 = none
+  bool utf8Payload;             // Payload format indicator
+  const char* contentType;
+  const char* responseTopic;
+  const uint8_t* correlationData;
+  uint16_t correlationLength;
+  const UserProperty* userProperties;
+  uint8_t userPropertyCount;
+};
+
+inline uint32_t publish_properties_size(const PublishProperties& p) {
+  uint32_t size = 0;
+  if (p.utf8Payload) size += 2;
+  if (p.messageExpiry) size += 5;
+  if (p.topicAlias) size += 3;
+  if (p.contentType) size += 3 + strlen(p.contentType);
+  if (p.responseTopic) size += 3 + strlen(p.responseTopic);
+  if (p.correlationData) size += 3 + p.correlationLength;
+  for (uint8_t i = 0; i < p.userPropertyCount; i++) {
+    size += 5 + strlen(p.userProperties[i].key) + strlen(p.userProperties[i].value);
+  }
+  return size;
+}
+
+inline void write_publish_properties(Writer& w, const PublishProperties& p, uint32_t size) {
+  w.varint(size);
+  if (p.utf8Payload) {
+    w.byte(PROP_PAYLOAD_FORMAT);
+    w.byte(1);
+  }
+  if (p.messageExpiry) {
+    w.byte(PROP_MESSAGE_EXPIRY);
+    w.u16(p.messageExpiry >> 16);
+    w.u16(p.messageExpiry & 0xFFFF);
+  }
+  if (p.topicAlias) {
+    w.byte(PROP_TOPIC_ALIAS);
+    w.u16(p.topicAlias);
+  }
+  if (p.contentType) {
+    w.byte(PROP_CONTENT_TYPE);
+    w.string(p.contentType);
+  }
+  if (p.responseTopic) {
+    w.byte(PROP_RESPONSE_TOPIC);
+    w.string(p.responseTopic);
+  }
+  if (p.correlationData) {
+    w.byte(PROP_CORRELATION_DATA);
+    w.u16(p.correlationLength);
+    w.bytes(p.correlationData, p.correlationLength);
+  }
+  for (uint8_t i = 0; i < p.userPropertyCount; i++) {
+    w.byte(PROP_USER_PROPERTY);
+    w.string(p.userProperties[i].key);
+    w.string(p.userProperties[i].value);
+  }
+}
+
+// A topic alias that is already established goes with topicLength 0
+inline size_t encode_publish_v5(uint8_t* buffer, size_t capacity, const char* topic, size_t topicLength,
+                                const PublishProperties& properties, const uint8_t* payload, size_t payloadLength,
+                                uint8_t qos = 0, bool retain = false, uint16_t packetId = 0) {
+  uint32_t propertiesSize = publish_properties_size(properties);
+  uint32_t length = 2 + topicLength + (qos > 0 ? 2 : 0) + varint_size(propertiesSize) + propertiesSize +
+                    payloadLength;
+  if (length > MAX_REMAINING_LENGTH) return 0;
+
+  Writer w(buffer, capacity);
+  w.byte((PUBLISH << 4) | ((qos & 0x03) << 1) | (retain ? 0x01 : 0x00));
+  w.varint(length);
+  w.string(topic, topicLength);
+  if (qos > 0) w.u16(packetId);
+  write_publish_properties(w, properties, propertiesSize);
+  w.bytes(payload, payloadLength);
+  return w.size();
+}
+
+inline size_t encode_subscribe_v5(uint8_t* buffer, size_t capacity, uint16_t packetId, const char* filter,
+                                  uint8_t qos = 0) {
+  size_t filterLength = strlen(filter);
+  Writer w(buffer, capacity);
+  w.byte((SUBSCRIBE << 4) | 0x02);
+  w.varint(2 + 1 + 2 + filterLength + 1);
+  w.u16(packetId);
+  w.varint(0);                            // Subscribe properties
+  w.string(filter, filterLength);
+  w.byte(qos & 0x03);                     // Options: no-local, retain-as-published off
+  return w.size();
+}
+
+// One decoded property. Strings and binary data point into the packet;
+// a user property has its key in data and its value in data2.
+struct Property {
+  uint8_t id;
+  uint32_t value;               // Byte, two-byte, four-byte and varint properties
+  const uint8_t* data;
+  uint16_t length;
+  const uint8_t* data2;
+  uint16_t length2;
+};
+
+class PropertyReader {
+ public:
+  PropertyReader(const uint8_t* data, uint32_t length) : data_(data), length_(length), pos_(0), ok_(true) {}
+
+  // Returns false at the end of the block or on a malformed property
+  bool next(Property& p) {
+    if (!ok_ || pos_ >= length_) return false;
+    memset(&p, 0, sizeof(p));
+    p.id = data_[pos_++];
+    switch (p.id) {
+      case PROP_PAYLOAD_FORMAT: case PROP_REQUEST_PROBLEM_INFO: case PROP_REQUEST_RESPONSE_INFO:
+      case PROP_MAXIMUM_QOS: case PROP_RETAIN_AVAILABLE: case PROP_WILDCARD_SUB_AVAILABLE:
+      case PROP_SUB_ID_AVAILABLE: case PROP_SHARED_SUB_AVAILABLE:
+        return fixed(p, 1);
+      case PROP_SERVER_KEEP_ALIVE: case PROP_RECEIVE_MAXIMUM: case PROP_TOPIC_ALIAS_MAXIMUM: case PROP_TOPIC_ALIAS:
+        return fixed(p, 2);
+      case PROP_MESSAGE_EXPIRY: case PROP_SESSION_EXPIRY: case PROP_WILL_DELAY: case PROP_MAXIMUM_PACKET_SIZE:
+        return fixed(p, 4);
+      case PROP_SUBSCRIPTION_ID:
+        return varint(p);
+      case PROP_CONTENT_TYPE: case PROP_RESPONSE_TOPIC: case PROP_ASSIGNED_CLIENT_ID: case PROP_AUTH_METHOD:
+      case PROP_RESPONSE_INFO: case PROP_SERVER_REFERENCE: case PROP_REASON_STRING:
+      case PROP_CORRELATION_DATA: case PROP_AUTH_DATA:
+        return block(p.data, p.length);
+      case PROP_USER_PROPERTY:
+        return block(p.data, p.length) && block(p.data2, p.length2);
+      default:
+        ok_ = false;                      // Unknown ID: the rest cannot be framed
+        return false;
+    }
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  bool fixed(Property& p, uint8_t size) {
+    if (pos_ + size > length_) return ok_ = false;
+    for (uint8_t i = 0; i < size; i++) p.value = (p.value << 8) | data_[pos_++];
+    return true;
+  }
+
+  bool varint(Property& p) {
+    uint32_t multiplier = 1;
+    for (int i = 0; i < 4; i++) {
+      if (pos_ >= length_) return ok_ = false;
+      uint8_t encoded = data_[pos_++];
+      p.value += (encoded & 0x7F) * multiplier;
+      if ((encoded & 0x80) == 0) return true;
+      multiplier *= 128;
+    }
+    return ok_ = false;
+  }
+
+  bool block(const uint8_t*& data, uint16_t& length) {
+    if (pos_ + 2 > length_) return ok_ = false;
+    length = (data_[pos_] << 8) | data_[pos_ + 1];
+    pos_ += 2;
+    if (pos_ + length > length_) return ok_ = false;
+    data = data_ + pos_;
+    pos_ += length;
+    return true;
+  }
+
+  const uint8_t* data_;
+  uint32_t length_;
+  uint32_t pos_;
+  bool ok_;
+};
+
+// Reads a variable byte integer at body[pos]; false if malformed or short
+inline bool read_varint(const uint8_t* body, uint32_t length, uint32_t& pos, uint32_t& value) {
+  value = 0;
+  uint32_t multiplier = 1;
+  for (int i = 0; i < 4; i++) {
+    if (pos >= length) return false;
+    uint8_t encoded = body[pos++];
+    value += (encoded & 0x7F) * multiplier;
+    if ((encoded & 0x80) == 0) return true;
+    multiplier *= 128;
+  }
+  return false;
+}
+
+struct ConnackView {
+  uint8_t reasonCode;
+  bool sessionPresent;
+  uint16_t topicAliasMaximum;   // 0 = the broker accepts no aliases
+  uint16_t receiveMaximum;
+  uint32_t maximumPacketSize;   // 0 = no limit
+  uint16_t serverKeepAlive;     // 0 = not sent
+  const uint8_t* properties;    // Whole block, for PropertyReader
+  uint32_t propertiesLength;
+};
+
+// Returns false if the packet is not a well-formed 5.0 CONNACK (a 3.1.1
+// broker answers a 5.0 CONNECT with a two-byte CONNACK)
+inline bool parse_connack_v5(const Packet& packet, ConnackView& view) {
+  if (packet.type != CONNACK || packet.length < 3) return false;
+  memset(&view, 0, sizeof(view));
+  view.sessionPresent = packet.body[0] & 0x01;
+  view.reasonCode = packet.body[1];
+  view.receiveMaximum = 65535;
+
+  uint32_t pos = 2;
+  if (!read_varint(packet.body, packet.length, pos, view.propertiesLength)) return false;
+  if (pos + view.propertiesLength > packet.length) return false;
+  view.properties = packet.body + pos;
+
+  PropertyReader reader(view.properties, view.propertiesLength);
+  Property p;
+  while (reader.next(p)) {
+    if (p.id == PROP_TOPIC_ALIAS_MAXIMUM) view.topicAliasMaximum = p.value;
+    else if (p.id == PROP_RECEIVE_MAXIMUM) view.receiveMaximum = p.value;
+    else if (p.id == PROP_MAXIMUM_PACKET_SIZE) view.maximumPacketSize = p.value;
+    else if (p.id == PROP_SERVER_KEEP_ALIVE) view.serverKeepAlive = p.value;
+  }
+  return reader.ok();
+}
+
+// PublishView plus the properties the firmware acts on
+struct PublishPropertiesView {
+  uint16_t topicAlias;
+  uint32_t messageExpiry;
+  const char* responseTopic;    // Not NUL-terminated
+  uint16_t responseTopicLength;
+  const uint8_t* correlationData;
+  uint16_t correlationLength;
+  const uint8_t* properties;    // Whole block, for user properties
+  uint32_t propertiesLength;
+};
+
+inline bool parse_publish_v5(const Packet& packet, PublishView& view, PublishPropertiesView& props) {
+  if (packet.type != PUBLISH || packet.length < 2) return false;
+  memset(&props, 0, sizeof(props));
+
+  view.qos = (packet.flags >> 1) & 0x03;
+  view.retain = packet.flags & 0x01;
+  view.dup = packet.flags & 0x08;
+  view.topicLength = (packet.body[0] << 8) | packet.body[1];
+
+  uint32_t pos = 2 + view.topicLength;
+  if (pos > packet.length) return false;
+  view.topic = (const char*)packet.body + 2;
+
+  view.packetId = 0;
+  if (view.qos > 0) {
+    if (pos + 2 > packet.length) return false;
+    view.packetId = (packet.body[pos] << 8) | packet.body[pos + 1];
+    pos += 2;
+  }
+
+  if (!read_varint(packet.body, packet.length, pos, props.propertiesLength)) return false;
+  if (pos + props.propertiesLength > packet.length) return false;
+  props.properties = packet.body + pos;
+  pos += props.propertiesLength;
+
+  PropertyReader reader(props.properties, props.propertiesLength);
+  Property p;
+  while (reader.next(p)) {
+    if (p.id == PROP_TOPIC_ALIAS) {
+      props.topicAlias = p.value;
+    } else if (p.id == PROP_MESSAGE_EXPIRY) {
+      props.messageExpiry = p.value;
+    } else if (p.id == PROP_RESPONSE_TOPIC) {
+      props.responseTopic = (const char*)p.data;
+      props.responseTopicLength = p.length;
+    } else if (p.id == PROP_CORRELATION_DATA) {
+      props.correlationData = p.data;
+      props.correlationLength = p.length;
+    }
+  }
+  if (!reader.ok()) return false;
+
+  view.payload = packet.body + pos;
+  view.payloadLength = packet.length - pos;
+  return true;
+}
+
+}  // namespace mqtt
+
+#endif
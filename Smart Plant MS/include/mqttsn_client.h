@@ -0,0 +1,160 @@
+#ifndef MQTTSN_CLIENT_H
+#define MQTTSN_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mqttsn_codec.h"
+#include "topics.h"
+#include "profile_presets.h"
+
+// ============ MQTT-SN Client ============
+// Drop-in for the part of the PubSubClient API the firmware uses, speaking
+// MQTT-SN 1.2 over UDP to a gateway (the host-side stand-in is
+// src/host/mqttsn/). A PUBLISH costs 7 bytes of header plus the payload,
+// and there is no TCP connection to keep up.
+//
+// Topics are sent as two-byte IDs:
+// - predefined: the topics.h table, ID = TopicId + 1 (mqttsn_predefined_id()),
+//   set with predefine(); the gateway derives the same table from the
+//   client ID, so these never need a REGISTER
+// - registered: any other topic is registered with the gateway on its first
+//   publish or subscribe, once per connection
+//
+// Publishes go at QoS 1 by default. Each waits in one of MQTTSN_INFLIGHT
+// slots until its PUBACK and is re-sent (DUP) every MQTTSN_RETRY_MS. After
+// MQTTSN_RETRIES unanswered attempts the gateway is taken as lost and the
+// client reports itself disconnected, as the specification prescribes.
+// With every slot taken, publish() blocks (re-sending) until a PUBACK frees
+// one or the gateway is lost.
+//
+// CONNECT, REGISTER and SUBSCRIBE wait for their answer (re-sent on the
+// same schedule). A PUBLISH from the gateway that arrives during such a
+// wait is not acknowledged; at QoS 1 the gateway sends it again.
+
+#ifndef MQTTSN_GATEWAY_PORT
+#define MQTTSN_GATEWAY_PORT 1885
+#endif
+
+#ifndef MQTTSN_BUFFER_SIZE
+#define MQTTSN_BUFFER_SIZE 512
+#endif
+
+#ifndef MQTTSN_RETRY_MS
+#define MQTTSN_RETRY_MS 1000UL      // T_retry
+#endif
+
+#ifndef MQTTSN_RETRIES
+#define MQTTSN_RETRIES 4            // N_retry
+#endif
+
+#define MQTTSN_INFLIGHT 4           // Unacknowledged QoS 1 publishes
+#define MQTTSN_TOPICS 40            // Registered topics per connection
+#define MQTTSN_TOPIC_LEN 80
+#define MQTTSN_PREDEFINED TOPIC_COUNT
+
+// Same values as PubSubClient's state()
+#define MQTTSN_CONNECTION_TIMEOUT -4
+#define MQTTSN_CONNECTION_LOST -3
+#define MQTTSN_CONNECT_FAILED -2
+#define MQTTSN_DISCONNECTED -1
+#define MQTTSN_CONNECTED 0
+
+typedef void (*MqttSnCallback)(char* topic, uint8_t* payload, unsigned int length);
+
+inline uint16_t mqttsn_predefined_id(TopicId id) {
+  return (uint16_t)id + 1;
+}
+
+class MqttSnClient {
+ public:
+  explicit MqttSnClient(UDP& udp);
+
+  MqttSnClient& setServer(const char* domain, uint16_t port);
+  MqttSnClient& setCallback(MqttSnCallback callback);
+  MqttSnClient& setKeepAlive(uint16_t seconds);
+  bool setBufferSize(uint16_t size);      // Up to MQTTSN_BUFFER_SIZE
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage);
+  void disconnect();
+  bool connected();
+  int state();
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained);
+  bool subscribe(const char* topic, uint8_t qos = 1);
+  bool loop();
+
+  // ---- MQTT-SN ----
+  bool predefine(uint16_t topicId, const char* topic);  // Kept by pointer
+  void setPublishQos(uint8_t qos);                       // 0 or 1
+
+  // Wire statistics since boot
+  uint32_t bytesSent = 0;
+  uint32_t bytesReceived = 0;
+  uint32_t publishes = 0;
+  uint32_t retransmissions = 0;
+  uint32_t registrations = 0;
+
+ private:
+  struct Topic {
+    uint16_t id;
+    char name[MQTTSN_TOPIC_LEN];
+  };
+
+  struct Inflight {
+    bool used;
+    uint16_t msgId;
+    uint8_t attempts;
+    unsigned long sentAt;
+    uint16_t length;
+    uint8_t packet[MQTTSN_BUFFER_SIZE];
+  };
+
+  bool send(const uint8_t* data, size_t length);
+  Inflight* free_slot();
+  bool retransmit();
+  bool exchange(const uint8_t* data, size_t length, uint8_t replyType, uint16_t msgId);
+  bool receive(mqttsn::Message& message);
+  void handle(const mqttsn::Message& message, bool deliver);
+  void drop(int state);
+  uint16_t next_msg_id();
+  uint16_t topic_id(const char* topic, mqttsn::TopicIdType& type);
+  const char* topic_name(uint16_t id, mqttsn::TopicIdType type);
+  bool remember(uint16_t id, const char* name, size_t length);
+
+  UDP& udp_;
+  const char* domain_ = nullptr;
+  uint16_t port_ = MQTTSN_GATEWAY_PORT;
+  MqttSnCallback callback_ = nullptr;
+  uint16_t keepAlive_ = 15;
+  uint16_t bufferSize_ = MQTTSN_BUFFER_SIZE;
+  int state_ = MQTTSN_DISCONNECTED;
+  uint8_t publishQos_ = 1;
+  uint16_t nextMsgId_ = 1;
+  unsigned long lastSend_ = 0;
+  unsigned long pingSentAt_ = 0;
+  uint8_t pingAttempts_ = 0;              // 0 = no PINGREQ outstanding
+
+  const char* willTopic_ = nullptr;
+  const char* willMessage_ = nullptr;
+  uint8_t willQos_ = 0;
+  bool willRetain_ = false;
+
+  uint8_t rx_[MQTTSN_BUFFER_SIZE];
+  uint8_t tx_[MQTTSN_BUFFER_SIZE];
+  char topicBuffer_[MQTTSN_TOPIC_LEN];    // Topic and payload handed to the callback
+  uint8_t message_[MQTTSN_BUFFER_SIZE];
+
+  // The answer exchange() waited for, valid until the next receive
+  mqttsn::Message reply_;
+
+  const char* predefined_[MQTTSN_PREDEFINED + 1] = {nullptr};
+  Topic topics_[MQTTSN_TOPICS];
+  uint8_t topicCount_ = 0;
+  Inflight inflight_[MQTTSN_INFLIGHT];
+};
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef MQTTSN_CODEC_H
+#define MQTTSN_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ============ MQTT-SN 1.2 Message Codec ============
+// Allocation-free encoder/decoder for the MQTT-SN messages the firmware and
+// the host-side gateway stand-in exchange over UDP. One datagram carries one
+// message:
+//
+//   Length (1 byte, or 0x01 + 2 bytes above 255) | MsgType | body
+//
+// PUBLISH names its topic by a two-byte topic ID instead of the topic
+// string. The ID is either registered per session (REGISTER / REGACK, or
+// the SUBACK of a subscription by name), or predefined on both ends
+// (mqttsn_client.h uses TopicId + 1 for the topics.h table).
+//
+// Encoders return the number of bytes written, or 0 if the message does
+// not fit in the supplied buffer.
+
+namespace mqttsn {
+
+enum MsgType : uint8_t {
+  CONNECT = 0x04,
+  CONNACK = 0x05,
+  WILLTOPICREQ = 0x06,
+  WILLTOPIC = 0x07,
+  WILLMSGREQ = 0x08,
+  WILLMSG = 0x09,
+  REGISTER = 0x0A,
+  REGACK = 0x0B,
+  PUBLISH = 0x0C,
+  PUBACK = 0x0D,
+  SUBSCRIBE = 0x12,
+  SUBACK = 0x13,
+  PINGREQ = 0x16,
+  PINGRESP = 0x17,
+  DISCONNECT = 0x18
+};
+
+enum TopicIdType : uint8_t {
+  TOPIC_NORMAL = 0,             // Registered for this session
+  TOPIC_PREDEFINED = 1,         // Known to both ends in advance
+  TOPIC_SHORT = 2               // Two-character topic name in the ID field
+};
+
+enum ReturnCode : uint8_t {
+  ACCEPTED = 0,
+  REJECTED_CONGESTION = 1,
+  REJECTED_INVALID_TOPIC = 2,
+  REJECTED_NOT_SUPPORTED = 3
+};
+
+static const uint8_t FLAG_DUP = 0x80;
+static const uint8_t FLAG_RETAIN = 0x10;
+static const uint8_t FLAG_WILL = 0x08;
+static const uint8_t FLAG_CLEAN_SESSION = 0x04;
+static const uint8_t PROTOCOL_ID = 0x01;
+
+inline uint8_t qos_flags(uint8_t qos) {
+  return (qos & 0x03) << 5;
+}
+
+inline uint8_t flags_qos(uint8_t flags) {
+  return (flags >> 5) & 0x03;
+}
+
+inline uint8_t publish_flags(uint8_t qos, bool retain, TopicIdType type) {
+  return qos_flags(qos) | (retain ? FLAG_RETAIN : 0) | type;
+}
+
+// ============ Encoders ============
+// Writes the length field and type for a body of bodyLength bytes; returns
+// the header size, or 0 if the whole message would not fit
+inline size_t write_header(uint8_t* buffer, size_t capacity, MsgType type, size_t bodyLength) {
+  size_t total = bodyLength + 2;
+  if (total > 255) total += 2;
+  if (total > capacity || total > 0xFFFF) return 0;
+  if (total <= 255) {
+    buffer[0] = total;
+    buffer[1] = type;
+    return 2;
+  }
+  buffer[0] = 0x01;
+  buffer[1] = total >> 8;
+  buffer[2] = total & 0xFF;
+  buffer[3] = type;
+  return 4;
+}
+
+inline void put_u16(uint8_t* out, uint16_t value) {
+  out[0] = value >> 8;
+  out[1] = value & 0xFF;
+}
+
+inline size_t encode_empty(uint8_t* buffer, size_t capacity, MsgType type) {
+  return write_header(buffer, capacity, type, 0);
+}
+
+inline size_t encode_connect(uint8_t* buffer, size_t capacity, const char* clientId, uint16_t keepAliveSeconds,
+                             bool cleanSession, bool will) {
+  size_t idLength = strlen(clientId);
+  size_t pos = write_header(buffer, capacity, CONNECT, 4 + idLength);
+  if (!pos) return 0;
+  buffer[pos++] = (will ? FLAG_WILL : 0) | (cleanSession ? FLAG_CLEAN_SESSION : 0);
+  buffer[pos++] = PROTOCOL_ID;
+  put_u16(buffer + pos, keepAliveSeconds);
+  memcpy(buffer + pos + 2, clientId, idLength);
+  return pos + 2 + idLength;
+}
+
+inline size_t encode_connack(uint8_t* buffer, size_t capacity, uint8_t returnCode) {
+  size_t pos = write_header(buffer, capacity, CONNACK, 1);
+  if (!pos) return 0;
+  buffer[pos] = returnCode;
+  return pos + 1;
+}
+
+inline size_t encode_willtopic(uint8_t* buffer, size_t capacity, uint8_t qos, bool retain, const char* topic) {
+  size_t topicLength = strlen(topic);
+  size_t pos = write_header(buffer, capacity, WILLTOPIC, 1 + topicLength);
+  if (!pos) return 0;
+  buffer[pos++] = qos_flags(qos) | (retain ? FLAG_RETAIN : 0);
+  memcpy(buffer + pos, topic, topicLength);
+  return pos + topicLength;
+}
+
+inline size_t encode_willmsg(uint8_t* buffer, size_t capacity, const uint8_t* message, size_t length) {
+  size_t pos = write_header(buffer, capacity, WILLMSG, length);
+  if (!pos) return 0;
+  memcpy(buffer + pos, message, length);
+  return pos + length;
+}
+
+// REGISTER from the client carries topic ID 0; the gateway assigns it in REGACK
+inline size_t encode_register(uint8_t* buffer, size_t capacity, uint16_t topicId, uint16_t msgId, const char* topic,
+                              size_t topicLength) {
+  size_t pos = write_header(buffer, capacity, REGISTER, 4 + topicLength);
+  if (!pos) return 0;
+  put_u16(buffer + pos, topicId);
+  put_u16(buffer + pos + 2, msgId);
+  memcpy(buffer + pos + 4, topic, topicLength);
+  return pos + 4 + topicLength;
+}
+
+// REGACK and PUBACK share a layout
+inline size_t encode_ack(uint8_t* buffer, size_t capacity, MsgType type, uint16_t topicId, uint16_t msgId,
+                         uint8_t returnCode) {
+  size_t pos = write_header(buffer, capacity, type, 5);
+  if (!pos) return 0;
+  put_u16(buffer + pos, topicId);
+  put_u16(buffer + pos + 2, msgId);
+  buffer[pos + 4] = returnCode;
+  return pos + 5;
+}
+
+inline size_t encode_publish(uint8_t* buffer, size_t capacity, uint8_t flags, uint16_t topicId, uint16_t msgId,
+                             const uint8_t* data, size_t length) {
+  size_t pos = write_header(buffer, capacity, PUBLISH, 5 + length);
+  if (!pos) return 0;
+  buffer[pos] = flags;
+  put_u16(buffer + pos + 1, topicId);
+  put_u16(buffer + pos + 3, msgId);
+  memcpy(buffer + pos + 5, data, length);
+  return pos + 5 + length;
+}
+
+// By topic name (may hold wildcards)
+inline size_t encode_subscribe(uint8_t* buffer, size_t capacity, uint8_t qos, uint16_t msgId, const char* filter) {
+  size_t filterLength = strlen(filter);
+  size_t pos = write_header(buffer, capacity, SUBSCRIBE, 3 + filterLength);
+  if (!pos) return 0;
+  buffer[pos] = qos_flags(qos) | TOPIC_NORMAL;
+  put_u16(buffer + pos + 1, msgId);
+  memcpy(buffer + pos + 3, filter, filterLength);
+  return pos + 3 + filterLength;
+}
+
+// By predefined topic ID
+inline size_t encode_subscribe_id(uint8_t* buffer, size_t capacity, uint8_t qos, uint16_t msgId, uint16_t topicId) {
+  size_t pos = write_header(buffer, capacity, SUBSCRIBE, 5);
+  if (!pos) return 0;
+  buffer[pos] = qos_flags(qos) | TOPIC_PREDEFINED;
+  put_u16(buffer + pos + 1, msgId);
+  put_u16(buffer + pos + 3, topicId);
+  return pos + 5;
+}
+
+inline size_t encode_suback(uint8_t* buffer, size_t capacity, uint8_t qos, uint16_t topicId, uint16_t msgId,
+                            uint8_t returnCode) {
+  size_t pos = write_header(buffer, capacity, SUBACK, 6);
+  if (!pos) return 0;
+  buffer[pos] = qos_flags(qos);
+  put_u16(buffer + pos + 1, topicId);
+  put_u16(buffer + pos + 3, msgId);
+  buffer[pos + 5] = returnCode;
+  return pos + 6;
+}
+
+// ============ Decoders ============
+struct Message {
+  uint8_t type;
+  const uint8_t* body;
+  size_t length;              // Body size
+};
+
+inline uint16_t get_u16(const uint8_t* in) {
+  return (in[0] << 8) | in[1];
+}
+
+// Decodes one datagram; false if it is shorter than its length field says
+inline bool decode(const uint8_t* data, size_t size, Message& message) {
+  if (size < 2) return false;
+  size_t header = 2;
+  size_t total = data[0];
+  if (data[0] == 0x01) {
+    if (size < 4) return false;
+    header = 4;
+    total = get_u16(data + 1);
+  }
+  if (total < header || total > size) return false;
+  message.type = data[header - 1];
+  message.body = data + header;
+  message.length = total - header;
+  return true;
+}
+
+struct PublishView {
+  uint8_t flags;
+  uint8_t qos;
+  bool retain;
+  bool dup;
+  TopicIdType topicIdType;
+  uint16_t topicId;
+  uint16_t msgId;
+  const uint8_t* data;
+  size_t length;
+};
+
+inline bool parse_publish(const Message& m, PublishView& view) {
+  if (m.type != PUBLISH || m.length < 5) return false;
+  view.flags = m.body[0];
+  view.qos = flags_qos(view.flags);
+  view.retain = view.flags & FLAG_RETAIN;
+  view.dup = view.flags & FLAG_DUP;
+  view.topicIdType = (TopicIdType)(view.flags & 0x03);
+  view.topicId = get_u16(m.body + 1);
+  view.msgId = get_u16(m.body + 3);
+  view.data = m.body + 5;
+  view.length = m.length - 5;
+  return true;
+}
+
+// REGACK, PUBACK
+struct AckView {
+  uint16_t topicId;
+  uint16_t msgId;
+  uint8_t returnCode;
+};
+
+inline bool parse_ack(const Message& m, AckView& view) {
+  if ((m.type != REGACK && m.type != PUBACK) || m.length < 5) return false;
+  view.topicId = get_u16(m.body);
+  view.msgId = get_u16(m.body + 2);
+  view.returnCode = m.body[4];
+  return true;
+}
+
+struct RegisterView {
+  uint16_t topicId;
+  uint16_t msgId;
+  const char* topic;            // Not NUL-terminated
+  size_t topicLength;
+};
+
+inline bool parse_register(const Message& m, RegisterView& view) {
+  if (m.type != REGISTER || m.length < 4) return false;
+  view.topicId = get_u16(m.body);
+  view.msgId = get_u16(m.body + 2);
+  view.topic = (const char*)m.body + 4;
+  view.topicLength = m.length - 4;
+  return true;
+}
+
+struct SubackView {
+  uint8_t qos;
+  uint16_t topicId;
+  uint16_t msgId;
+  uint8_t returnCode;
+};
+
+inline bool parse_suback(const Message& m, SubackView& view) {
+  if (m.type != SUBACK || m.length < 6) return false;
+  view.qos = flags_qos(m.body[0]);
+  view.topicId = get_u16(m.body + 1);
+  view.msgId = get_u16(m.body + 3);
+  view.returnCode = m.body[5];
+  return true;
+}
+
+// ---- Gateway side ----
+struct ConnectView {
+  bool will;
+  bool cleanSession;
+  uint16_t keepAliveSeconds;
+  const char* clientId;         // Not NUL-terminated
+  size_t clientIdLength;
+};
+
+inline bool parse_connect(const Message& m, ConnectView& view) {
+  if (m.type != CONNECT || m.length < 4 || m.body[1] != PROTOCOL_ID) return false;
+  view.will = m.body[0] & FLAG_WILL;
+  view.cleanSession = m.body[0] & FLAG_CLEAN_SESSION;
+  view.keepAliveSeconds = get_u16(m.body + 2);
+  view.clientId = (const char*)m.body + 4;
+  view.clientIdLength = m.length - 4;
+  return true;
+}
+
+struct SubscribeView {
+  uint8_t qos;
+  TopicIdType topicIdType;
+  uint16_t msgId;
+  uint16_t topicId;             // TOPIC_PREDEFINED / TOPIC_SHORT
+  const char* filter;           // TOPIC_NORMAL; not NUL-terminated
+  size_t filterLength;
+};
+
+inline bool parse_subscribe(const Message& m, SubscribeView& view) {
+  if (m.type != SUBSCRIBE || m.length < 3) return false;
+  view.qos = flags_qos(m.body[0]);
+  view.topicIdType = (TopicIdType)(m.body[0] & 0x03);
+  view.msgId = get_u16(m.body + 1);
+  view.topicId = 0;
+  view.filter = (const char*)m.body + 3;
+  view.filterLength = m.length - 3;
+  if (view.topicIdType != TOPIC_NORMAL) {
+    if (m.length < 5) return false;
+    view.topicId = get_u16(m.body + 3);
+    view.filterLength = 0;
+  }
+  return true;
+}
+
+}  // namespace mqttsn
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef OFFLINE_BACKLOG_H
+#define OFFLINE_BACKLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "profile_presets.h"
+#include "topics.h"
+
+// ============ Offline Backlog ============
+// Telemetry serialized while no broker is connected (FEATURE_BROKER_FAILOVER):
+// sensor readings and events, not status, which the next publish restates.
+// Messages keep the boot/seq they were stamped with, so after the replay a
+// consumer sees every seq once, and a gap only where a message was dropped.
+//
+// BACKLOG_SLOTS fixed slots in RAM, oldest first; when full the oldest
+// message is dropped. Nothing survives a reboot. After a (re)connect,
+// loop() replays BACKLOG_REPLAY_PER_LOOP messages per pass to whichever
+// broker is active, and new telemetry queues behind the backlog until it
+// is empty, so each stream stays in seq order.
+
+#ifndef BACKLOG_SLOTS
+#define BACKLOG_SLOTS 16
+#endif
+
+#define BACKLOG_PAYLOAD_MAX 512       // Fits TELEMETRY_PAYLOAD_MAX; larger payloads are dropped (and counted)
+#define BACKLOG_REPLAY_PER_LOOP 8
+
+struct BacklogStats {
+  uint32_t queued;
+  uint32_t replayed;
+  uint32_t dropped;               // Overwritten when full, or too large
+};
+
+// Publishes one replayed message; false leaves it at the head of the backlog
+typedef bool (*BacklogPublisher)(const char* topic, const char* payload);
+
+// Copies topic and payload into the next slot
+bool backlog_push(const char* topic, const char* payload);
+
+// Publishes up to max messages, oldest first; returns how many went out
+uint8_t backlog_replay(BacklogPublisher publish, uint8_t max);
+
+bool backlog_empty();
+uint8_t backlog_count();
+const BacklogStats& backlog_stats();
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include <stdint.h>
+#include "profile_presets.h"
+#include "broker_failover.h"
+#include "offline_backlog.h"
+
+// ============ Presence ============
+// Retained online/offline state, so services learn that a device went away
+// from an event instead of from data that stops (which dedup suppression
+// also causes).
+//
+// Topic: plant-iot/<device>/online (always namespaced), retained
+//
+//   Birth, published after every (re)connect:
+//     {"state": "online", "device_id": "plant-a1b2c3", "firmware": "1.0.0",
+//      "profile": "default", "boot": 42, "boot_reason": "power_on",
+//      "connects": 1, "config_revision": 4, "config_hash": "9e3779b9",
+//      "timestamp": 2150}
+//   With FEATURE_BROKER_FAILOVER also the broker in use (0 = primary) and
+//   what the device went through to get there:
+//     "broker": {"active": 1, "failovers": 1, "returns": 0,
+//                "last_outage_ms": 3120, "max_outage_ms": 3120,
+//                "backlog_replayed": 12, "backlog_dropped": 0}
+//
+//   Last Will, published by the broker when the connection is lost without
+//   a clean disconnect (after 1.5 keep-alive intervals):
+//     {"state": "offline", "device_id": "plant-a1b2c3", "boot": 42}
+//
+// "boot" matches the telemetry boot counter (stream_sequence.h), so a birth
+// with the same boot and connects > 1 is a reconnect, a new boot is a
+// restart and "boot_reason" says why. "config_hash" lets a service find
+// devices whose settings drifted from the rest of the fleet.
+
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "1.0.0"
+#endif
+
+#define PRESENCE_TOPIC_SUFFIX "online"
+#define PRESENCE_WILL_QOS 1
+
+struct BirthInfo {
+  const char* firmware;
+  const char* profile;
+  uint32_t boot;
+  const char* bootReason;
+  uint32_t connects;              // Successful connects since boot, 1 for the first
+  uint32_t configRevision;
+  uint32_t configHash;
+  const FailoverStats* failover;  // nullptr without FEATURE_BROKER_FAILOVER
+  const BacklogStats* backlog;
+};
+
+// Reason for the last reset (esp_reset_reason()) as a short name
+const char* presence_boot_reason();
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef PROFILE_PRESETS_H
+#define PROFILE_PRESETS_H
+
+// ============ Firmware Profile Presets ============
+// A profile picks defaults for the build-time options of every module so one
+// flag selects a whole deployment shape:
+//
+//   -DFIRMWARE_PROFILE=PROFILE_BENCH     bench debugging: one pot, every
+//                                        feature, verbose Serial
+//   -DFIRMWARE_PROFILE=PROFILE_FIELD     low-power field node: one pot, no
+//                                        legacy topics, trace recorder or Serial
+//   -DFIRMWARE_PROFILE=PROFILE_GATEWAY   multi-plant gateway: 16 pots behind a
+//                                        multiplexer, four valve zones
+//
+// Individual -D flags still override a preset. Included by the module headers
+// before their own defaults, so this file only defines macros (the typed view
+// is in firmware_profile.h).
+
+#define PROFILE_DEFAULT 0
+#define PROFILE_BENCH 1
+#define PROFILE_FIELD 2
+#define PROFILE_GATEWAY 3
+
+#ifndef FIRMWARE_PROFILE
+#define FIRMWARE_PROFILE PROFILE_DEFAULT
+#endif
+
+#if FIRMWARE_PROFILE == PROFILE_FIELD
+  #ifndef FEATURE_LEGACY_TOPICS
+  #define FEATURE_LEGACY_TOPICS 0
+  #endif
+  #ifndef FEATURE_SERIAL_LOG
+  #define FEATURE_SERIAL_LOG 0
+  #endif
+  #ifndef TRACE_ENABLED
+  #define TRACE_ENABLED 0
+  #endif
+#elif FIRMWARE_PROFILE == PROFILE_GATEWAY
+  #ifndef PLANT_COUNT
+  #define PLANT_COUNT 16
+  #endif
+  #ifndef SOIL_MUX_ENABLED
+  #define SOIL_MUX_ENABLED 1
+  #endif
+  #ifndef ZONE_COUNT
+  #define ZONE_COUNT 4
+  #endif
+  #ifndef TOPIC_COMPAT_FLAT
+  #define TOPIC_COMPAT_FLAT 0
+  #endif
+  #ifndef FEATURE_LEGACY_TOPICS
+  #define FEATURE_LEGACY_TOPICS 0
+  #endif
+  #ifndef FEATURE_SERIAL_LOG
+  #define FEATURE_SERIAL_LOG 0
+  #endif
+#elif FIRMWARE_PROFILE != PROFILE_DEFAULT && FIRMWARE_PROFILE != PROFILE_BENCH
+  #error "Unknown FIRMWARE_PROFILE"
+#endif
+
+// ============ Feature Switches ============
+#ifndef FEATURE_LEGACY_TOPICS
+#define FEATURE_LEGACY_TOPICS 1   // Per-sensor topics next to sensors/aggregated
+#endif
+
+#ifndef FEATURE_RUNTIME_CONFIG
+#define FEATURE_RUNTIME_CONFIG 1  // config/set over MQTT (device_config.h)
+#endif
+
+#ifndef FEATURE_SERIAL_LOG
+#define FEATURE_SERIAL_LOG 1      // Serial diagnostics
+#endif
+
+#ifndef FEATURE_DEVICE_SHADOW
+#define FEATURE_DEVICE_SHADOW 1   // shadow/desired and shadow/reported (device_shadow.h)
+#endif
+
+#ifndef FEATURE_ANOMALY_EVENTS
+#define FEATURE_ANOMALY_EVENTS 1  // events/anomaly (anomaly_detector.h)
+#endif
+
+#ifndef FEATURE_WATERING_EVENTS
+#define FEATURE_WATERING_EVENTS 1 // events/watering (watering_monitor.h)
+#endif
+
+#ifndef FEATURE_DRYNESS_ETA
+#define FEATURE_DRYNESS_ETA 1     // predictions/soil-dryness (dryness_predictor.h)
+#endif
+
+#ifndef FEATURE_ACTUATOR_MODEL
+#define FEATURE_ACTUATOR_MODEL 0  // Exported actuator forests (actuator_forest.h); needs the generated header
+#endif
+
+#ifndef FEATURE_TREND_MODEL
+#define FEATURE_TREND_MODEL 0     // predictions/trend (trend_model.h); needs the "trendmodel" partition
+#endif
+
+#ifndef FEATURE_MQTT5
+#define FEATURE_MQTT5 0           // MQTT 5.0 client (mqtt5_client.h) instead of PubSubClient
+#endif
+
+#ifndef FEATURE_MQTTSN
+#define FEATURE_MQTTSN 0          // MQTT-SN over UDP (mqttsn_client.h) to a gateway on MQTTSN_GATEWAY_PORT
+#endif
+
+#ifndef FEATURE_MQTT_TLS
+#define FEATURE_MQTT_TLS 0        // MQTT over TLS on MQTT_TLS_PORT (tls_client.h); needs the generated CA header
+#endif
+
+#ifndef FEATURE_MQTT_WS
+#define FEATURE_MQTT_WS 0         // MQTT over WebSocket on MQTT_WS_PORT (ws_client.h); wss with FEATURE_MQTT_TLS
+#endif
+
+#ifndef FEATURE_BROKER_FAILOVER
+#define FEATURE_BROKER_FAILOVER 0 // Standby brokers with probing and offline backlog (broker_failover.h)
+#endif
+
+#ifndef FEATURE_HTTP_SERVER
+#define FEATURE_HTTP_SERVER 0     // LAN /latest, /history and SSE /events (http_server.h)
+#endif
+
+#endif
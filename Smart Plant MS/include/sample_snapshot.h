@@ -0,0 +1,50 @@
+#ifndef SAMPLE_SNAPSHOT_H
+#define SAMPLE_SNAPSHOT_H
+
+#include <stdint.h>
+#include "soil_probes.h"
+
+// ============ Sample Snapshot ============
+// The latest sensor reading and the actuator states as one value, written
+// by read_sensors() and the actuator setters and read by everything that
+// reports them: publish_sensor_data(), publish_status(), command responses,
+// events, the shadow and the HTTP server. A reader gets one whole reading
+// with the actuator states of one moment, even when reading and reporting
+// run in different tasks (see seqlock.h); within loop() it costs a copy of
+// 32 bytes on the ESP32 with one plant.
+
+struct SensorReading {
+  unsigned long timestamp;                // millis() of the reading
+  float temperature;                      // Smoothed
+  float humidity;
+  int lightIntensity;                     // Smoothed raw ADC (0-4095)
+  int soilMoisture[PLANT_COUNT];          // Smoothed raw ADC; plant 0 is the legacy single pot
+  uint8_t soilMoisturePercent[PLANT_COUNT];
+};
+
+struct ActuatorState {
+  bool pump;
+  bool fan;
+  bool growLight;
+};
+
+struct SampleSnapshot {
+  uint32_t readings;                      // Readings stored since boot (0: none yet)
+  SensorReading sensors;
+  ActuatorState actuators;
+};
+
+// Replaces the reading; the actuator states are kept
+void snapshot_store_reading(const SensorReading& reading);
+
+// Each replaces one actuator state, the others are kept
+void snapshot_set_pump(bool on);
+void snapshot_set_fan(bool on);
+void snapshot_set_grow_light(bool on);
+void snapshot_set_actuators(const ActuatorState& state);
+
+// A coherent copy; never blocks
+SampleSnapshot snapshot_read();
+ActuatorState snapshot_actuators();
+
+#endif
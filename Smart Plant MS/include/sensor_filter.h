@@ -0,0 +1,170 @@
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <math.h>
+#include <string.h>
+
+// ============ Sensor Smoothing ============
+// Portable filter state shared by the firmware and the host-side tools. Each
+// instance carries its own buffers so one process can simulate many devices.
+
+#ifndef SMOOTHING_SIZE
+#define SMOOTHING_SIZE 5          // Rolling average window (samples)
+#endif
+
+// Windows can be resized at runtime (device_config.h) up to this many samples
+#ifndef SMOOTHING_MAX_SIZE
+#define SMOOTHING_MAX_SIZE 16
+#endif
+
+#if SMOOTHING_SIZE < 1 || SMOOTHING_SIZE > SMOOTHING_MAX_SIZE
+#error "SMOOTHING_SIZE must be between 1 and SMOOTHING_MAX_SIZE"
+#endif
+
+inline float getSmoothedFloat(const float* buffer, int size) {
+  float sum = 0.0;
+  for (int i = 0; i < size; i++) {
+    sum += buffer[i];
+  }
+  return sum / size;
+}
+
+inline int getSmoothedInt(const int* buffer, int size) {
+  long sum = 0;
+  for (int i = 0; i < size; i++) {
+    sum += buffer[i];
+  }
+  return sum / size;
+}
+
+// Rolling average over the shared environment sensors (DHT22 and LDR).
+// Failed DHT reads (NaN) keep the previous sample in that slot.
+struct EnvironmentFilter {
+  float tempBuffer[SMOOTHING_MAX_SIZE];
+  float humidityBuffer[SMOOTHING_MAX_SIZE];
+  int lightBuffer[SMOOTHING_MAX_SIZE];
+  int bufferIndex;
+  int size = SMOOTHING_SIZE;
+
+  EnvironmentFilter() { reset(); }
+
+  void reset() {
+    memset(tempBuffer, 0, sizeof(tempBuffer));
+    memset(humidityBuffer, 0, sizeof(humidityBuffer));
+    memset(lightBuffer, 0, sizeof(lightBuffer));
+    bufferIndex = 0;
+  }
+
+  // Changes the window length; the new window is seeded with the current
+  // averages so the output does not jump
+  void resize(int newSize) {
+    if (newSize < 1) newSize = 1;
+    if (newSize > SMOOTHING_MAX_SIZE) newSize = SMOOTHING_MAX_SIZE;
+    float t = temperature();
+    float h = humidity();
+    int l = light();
+    for (int i = 0; i < newSize; i++) {
+      tempBuffer[i] = t;
+      humidityBuffer[i] = h;
+      lightBuffer[i] = l;
+    }
+    bufferIndex = 0;
+    size = newSize;
+  }
+
+  void push(float temperature, float humidity, int light) {
+    if (!isnan(humidity)) {
+      humidityBuffer[bufferIndex] = humidity;
+    }
+    if (!isnan(temperature)) {
+      tempBuffer[bufferIndex] = temperature;
+    }
+    lightBuffer[bufferIndex] = light;
+    bufferIndex = (bufferIndex + 1) % size;
+  }
+
+  float temperature() const { return getSmoothedFloat(tempBuffer, size); }
+  float humidity() const { return getSmoothedFloat(humidityBuffer, size); }
+  int light() const { return getSmoothedInt(lightBuffer, size); }
+};
+
+// Linear two-point calibration (dry = 0 %, wet = 100 %), clamped to 0-100
+inline int soil_percent(int raw, int dryRaw, int wetRaw) {
+  if (dryRaw == wetRaw) return 0;
+  long percent = (long)(raw - dryRaw) * 100 / (wetRaw - dryRaw);
+  return percent < 0 ? 0 : percent > 100 ? 100 : (int)percent;
+}
+
+// Rolling average with a running sum, O(1) per sample (used per soil channel).
+// N is the capacity; the window can be shortened at runtime with resize().
+template <int N>
+struct RollingAverage {
+  int buffer[N];
+  long sum;
+  int index;
+  int size = N;
+
+  RollingAverage() { reset(); }
+
+  void reset() {
+    memset(buffer, 0, sizeof(buffer));
+    sum = 0;
+    index = 0;
+  }
+
+  int push(int sample) {
+    sum += sample - buffer[index];
+    buffer[index] = sample;
+    if (++index >= size) index = 0;
+    return value();
+  }
+
+  // Seeds the resized window with the current average so the output does not jump
+  void resize(int newSize) {
+    if (newSize < 1) newSize = 1;
+    if (newSize > N) newSize = N;
+    int current = value();
+    for (int i = 0; i < newSize; i++) buffer[i] = current;
+    sum = (long)current * newSize;
+    index = 0;
+    size = newSize;
+  }
+
+  int value() const { return sum / size; }
+};
+
+// Streaming mean and variance (Welford), O(1) per sample. The count stops
+// growing at Window; from then on each update first forgets 1/Window of the
+// accumulated spread, so the statistics follow the last ~Window samples like
+// a rolling window but without a buffer.
+template <int Window>
+struct StreamingStats {
+  float mean;
+  float m2;                   // Sum of squared deviations from the mean
+  int count;
+
+  StreamingStats() { reset(); }
+
+  void reset() {
+    mean = 0;
+    m2 = 0;
+    count = 0;
+  }
+
+  void push(float sample) {
+    if (count < Window) {
+      count++;
+    } else {
+      m2 -= m2 / count;
+    }
+    float delta = sample - mean;
+    mean += delta / count;
+    m2 += delta * (sample - mean);
+  }
+
+  bool warm() const { return count >= Window; }
+  float variance() const { return count > 1 ? m2 / count : 0; }
+  float stddev() const { return sqrtf(variance()); }
+};
+
+#endif
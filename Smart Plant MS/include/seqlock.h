@@ -0,0 +1,112 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#else
+#include <mutex>
+#endif
+
+// ============ Seqlock ============
+// A value shared between tasks (or cores) that readers copy out whole,
+// never half old and half new, without taking a lock.
+//
+// Two copies and a sequence counter (a "latch" seqlock): readers copy the
+// copy the counter points at, then check the counter did not move. A writer
+// steps the counter to the other copy, rewrites this one, steps it back and
+// rewrites the other. So a reader never waits for a writer to finish; it
+// only copies again when a write overlapped its copy. Writes are short
+// (two copies of the value), so that is rare and a retry is immediate.
+//
+// Writers are serialized by a short critical section (portMUX on the ESP32,
+// a mutex on the host); they never wait for readers. The copies are held in
+// atomic words, written with release and read with acquire ordering rather
+// than with fences: a reader that sees any word of a newer write also sees
+// the counter step that preceded it. So the concurrent copying is
+// well-defined C++ and clean under ThreadSanitizer, which does not model
+// fences; on the ESP32 each word costs a memory barrier.
+
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock copies T byte-wise");
+
+ public:
+  SeqLock() : current_() {
+    publish();
+  }
+
+  // Copies out a coherent value; returns how many times it had to copy again
+  uint32_t read(T& out) const {
+    uint32_t words[WORDS];
+    uint32_t retries = 0;
+    for (;;) {
+      uint32_t seq = seq_.load(std::memory_order_acquire);
+      const std::atomic<uint32_t>* copy = copies_[seq & 1];
+      for (size_t i = 0; i < WORDS; i++) {
+        words[i] = copy[i].load(std::memory_order_acquire);
+      }
+      if (seq_.load(std::memory_order_relaxed) == seq) break;
+      retries++;
+    }
+    memcpy(&out, words, sizeof(T));
+    return retries;
+  }
+
+  T load() const {
+    T value;
+    read(value);
+    return value;
+  }
+
+  void store(const T& value) {
+    update([&value](T& current) { current = value; });
+  }
+
+  // Changes part of the value: change(T&) runs on the writers' own copy
+  template <typename Change>
+  void update(Change change) {
+    lock();
+    change(current_);
+    publish();
+    unlock();
+  }
+
+ private:
+  static constexpr size_t WORDS = (sizeof(T) + 3) / 4;
+
+  // Readers follow the counter to the other copy while this one is rewritten
+  void publish() {
+    uint32_t words[WORDS] = {};
+    memcpy(words, &current_, sizeof(T));
+    for (uint8_t c = 0; c < 2; c++) {
+      uint32_t seq = seq_.load(std::memory_order_relaxed) + 1;
+      seq_.store(seq, std::memory_order_release);
+      // Odd: readers are on copy 1, copy 0 is rewritten; then the other way round
+      std::atomic<uint32_t>* copy = copies_[(seq + 1) & 1];
+      for (size_t i = 0; i < WORDS; i++) {
+        copy[i].store(words[i], std::memory_order_release);
+      }
+    }
+  }
+
+#if defined(ARDUINO_ARCH_ESP32)
+  void lock() { portENTER_CRITICAL(&mux_); }
+  void unlock() { portEXIT_CRITICAL(&mux_); }
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+#else
+  void lock() { mutex_.lock(); }
+  void unlock() { mutex_.unlock(); }
+  std::mutex mutex_;
+#endif
+
+  T current_;                             // Writers only
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<uint32_t> copies_[2][WORDS] = {};
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SEQUENCE_STAMP_H
+#define SEQUENCE_STAMP_H
+
+#include <stdint.h>
+
+// ============ Sequence Stamp ============
+// The "boot"/"seq" pair every telemetry payload carries (stream_sequence.h).
+// Kept apart so the serializers (telemetry.h) and the host-side consumers
+// need neither Arduino nor the zone and probe headers.
+struct SequenceStamp {
+  uint32_t boot;
+  uint32_t seq;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SOIL_PROBES_H
+#define SOIL_PROBES_H
+
+#include <Arduino.h>
+#include "profile_presets.h"
+
+// ============ Soil Probe Configuration ============
+// One board can monitor several pots. Probes are either scanned through a
+// CD74HC4067-style 16:1 analog multiplexer whose common SIG line is wired to
+// SOIL_MUX_SIG_PIN, or read from individual ADC1 pins (ADC2 is unusable while
+// WiFi is active). All values can be overridden with -D build flags.
+
+#ifndef PLANT_COUNT
+#define PLANT_COUNT 1             // Number of pots served by this board (1-16)
+#endif
+
+#ifndef SOIL_MUX_ENABLED
+#define SOIL_MUX_ENABLED 0        // 1 = CD74HC4067 multiplexer, 0 = direct ADC1 pins
+#endif
+
+#define SOIL_MUX_SIG_PIN 34       // Mux common output (ADC1_CH6)
+#define SOIL_MUX_S0_PIN 13        // Mux select lines S0..S3
+#define SOIL_MUX_S1_PIN 12
+#define SOIL_MUX_S2_PIN 14
+#define SOIL_MUX_S3_PIN 27
+
+// Direct-wired probes, one ADC1 pin per plant (used when SOIL_MUX_ENABLED is 0)
+#define SOIL_PROBE_PINS {34, 32, 33, 36, 39}
+
+#define SOIL_MUX_SETTLE_US 10     // Analog settle time after switching channel
+#define SOIL_OVERSAMPLE 4         // ADC conversions averaged per channel per scan
+#define SOIL_SMOOTHING_SIZE 5     // Per-channel rolling average window (runtime adjustable)
+
+// Default calibration keeps the original single-probe mapping (1023 = 0%, 0 = 100%)
+#define SOIL_DEFAULT_DRY_RAW 1023
+#define SOIL_DEFAULT_WET_RAW 0
+
+#if PLANT_COUNT < 1 || PLANT_COUNT > 16
+#error "PLANT_COUNT must be between 1 and 16"
+#endif
+
+// ============ Soil Probe API ============
+struct SoilCalibration {
+  int dryRaw;   // ADC reading of the probe in dry soil (0%)
+  int wetRaw;   // ADC reading of the probe in saturated soil (100%)
+};
+
+void soil_probes_begin();
+void soil_probes_scan();
+
+int soil_probe_raw(uint8_t plant);        // Smoothed raw ADC value
+int soil_probe_sample(uint8_t plant);     // Last oversampled reading, before smoothing
+int soil_probe_percent(uint8_t plant);    // Calibrated 0-100 %
+float soil_probe_moisture(uint8_t plant); // Calibrated 0-100 % with the ADC's full resolution
+const char* soil_probe_id(uint8_t plant); // Logical plant ID, e.g. "plant-03"
+
+// Set from the runtime configuration ("soil_calibration", see device_config.h)
+void soil_probe_set_calibration(uint8_t plant, int dryRaw, int wetRaw);
+
+// Resizes every channel's window (1 - SMOOTHING_MAX_SIZE) without a jump in output
+void soil_probes_set_smoothing(uint8_t size);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef STREAM_SEQUENCE_H
+#define STREAM_SEQUENCE_H
+
+#include <stdint.h>
+#include "profile_presets.h"
+#include "sequence_stamp.h"
+#include "topics.h"
+
+// ============ Stream Sequence Numbers ============
+// Every telemetry payload carries "boot" and "seq":
+//
+//   boot  boot counter, incremented in NVS once per power-up
+//   seq   1, 2, 3, ... per stream (topic) since that boot
+//
+// A message is stamped with sequence_peek() and the number is taken with
+// sequence_commit() once a publish of it was attempted, whether or not it
+// got out. Every message the device produced but lost (a failed publish, a
+// payload too large for the offline backlog, offline_backlog.h, or one the
+// full backlog dropped) is a gap, so a consumer can tell the three reasons a
+// stream goes quiet apart:
+//
+//   dedup suppression  silence, and the next seq follows on directly
+//   loss               a gap in seq within the same boot
+//   reboot             a new boot value; seq restarts at 1
+//
+// Streams are the telemetry topics of topics.h plus the per-plant aggregated
+// topics and the per-zone status topics. The counters live in RAM; only the
+// boot counter touches flash, one write per boot. The consumer side is
+// host/common/sequence_tracker.h.
+
+#define SEQUENCE_NVS_NAMESPACE "boot"
+#define SEQUENCE_NVS_KEY "count"
+
+// Stream IDs: topics first, then one per plant, then one per zone. PLANT_COUNT
+// and ZONE_COUNT come from soil_probes.h and irrigation_zones.h, which the
+// code using these macros includes.
+#define SEQUENCE_PLANT_STREAM(plant) (TOPIC_FIRST_COMMAND + (plant))
+#define SEQUENCE_ZONE_STREAM(zone) (TOPIC_FIRST_COMMAND + PLANT_COUNT + (zone))
+#define SEQUENCE_STREAM_COUNT (TOPIC_FIRST_COMMAND + PLANT_COUNT + ZONE_COUNT)
+
+// Increments the boot counter in NVS and restarts every stream
+void sequence_begin();
+uint32_t sequence_boot();
+
+// Stamp for the next message on a stream; it stays the same until committed
+SequenceStamp sequence_peek(uint16_t stream);
+
+// A publish of the message stamped by sequence_peek() was attempted; the
+// stream moves on
+void sequence_commit(uint16_t stream);
+
+#endif
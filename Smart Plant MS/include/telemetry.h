@@ -0,0 +1,306 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <ArduinoJson.h>
+#include "topics.h"
+#include "anomaly_detector.h"
+#include "watering_monitor.h"
+#include "dryness_predictor.h"
+#include "trend_model.h"
+#include "sequence_stamp.h"
+#include "presence.h"
+
+// ============ Telemetry Payloads ============
+// Serialization of every message the firmware publishes. Shared with the
+// host-side tools so they produce byte-identical payloads. Each function
+// returns the payload length (0 if the buffer was too small).
+//
+// Every telemetry payload carries the stream's "boot" and "seq"
+// (stream_sequence.h); presence messages carry only "boot".
+
+// Bumped when a payload changes incompatibly. Sent as the "schema" user
+// property with MQTT 5.0 (mqtt5_client.h).
+#define TELEMETRY_SCHEMA_VERSION "1"
+
+// Buffer size for the largest telemetry payload (aggregated readings,
+// anomaly events, trend predictions); the offline backlog holds this much
+#define TELEMETRY_PAYLOAD_MAX 512
+
+struct SensorSample {
+  float temperature;
+  float humidity;
+  int soilMoisture;          // Smoothed raw ADC
+  int soilMoisturePercent;   // Calibrated 0-100 %
+  int lightIntensity;        // Smoothed raw ADC (0-4095)
+};
+
+inline int light_percent(int lightIntensity) {
+  return (long)lightIntensity * 100 / 4095;
+}
+
+inline void add_sequence(JsonDocument& doc, const SequenceStamp& stamp) {
+  doc["boot"] = stamp.boot;
+  doc["seq"] = stamp.seq;
+}
+
+// plantId may be nullptr for single-pot boards
+inline size_t serialize_aggregated(const SensorSample& sample, const char* deviceId, const char* plantId,
+                                   unsigned long timestamp, const SequenceStamp& stamp, char* buffer, size_t size) {
+  StaticJsonDocument<384> doc;
+  doc["temperature"] = sample.temperature;
+  doc["humidity"] = sample.humidity;
+  doc["soil_moisture"] = sample.soilMoisture;
+  doc["soil_moisture_percent"] = sample.soilMoisturePercent;
+  doc["light_intensity"] = sample.lightIntensity;
+  doc["light_percent"] = light_percent(sample.lightIntensity);
+  doc["timestamp"] = timestamp;
+  doc["device_id"] = deviceId;
+  if (plantId) {
+    doc["plant_id"] = plantId;
+  }
+  doc["quality"] = "excellent";
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+// Individual sensor topics kept for backward compatibility
+inline size_t serialize_legacy_reading(TopicId id, const SensorSample& sample, unsigned long timestamp,
+                                       const SequenceStamp& stamp, char* buffer, size_t size) {
+  StaticJsonDocument<192> doc;
+  switch (id) {
+    case TOPIC_SENSORS_TEMPERATURE:
+      doc["temperature"] = sample.temperature;
+      doc["unit"] = "celsius";
+      break;
+    case TOPIC_SENSORS_HUMIDITY:
+      doc["humidity"] = sample.humidity;
+      doc["unit"] = "percent";
+      break;
+    case TOPIC_SENSORS_SOIL_MOISTURE:
+      doc["moisture"] = sample.soilMoisture;
+      doc["unit"] = "adc_0-4095";
+      doc["moisture_percent"] = sample.soilMoisturePercent;
+      break;
+    case TOPIC_SENSORS_LIGHT:
+      doc["light"] = sample.lightIntensity;
+      doc["unit"] = "adc_0-4095";
+      doc["light_percent"] = light_percent(sample.lightIntensity);
+      break;
+    default:
+      return 0;
+  }
+  doc["timestamp"] = timestamp;
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+inline size_t serialize_actuator_status(bool on, unsigned long timestamp, const SequenceStamp& stamp, char* buffer,
+                                        size_t size) {
+  StaticJsonDocument<128> doc;
+  doc["status"] = on ? "ON" : "OFF";
+  doc["timestamp"] = timestamp;
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+inline size_t serialize_status_all(bool pump, bool fan, bool growLight, long rssi, unsigned long uptime,
+                                   const SequenceStamp& stamp, char* buffer, size_t size) {
+  StaticJsonDocument<256> doc;
+  doc["pump"] = pump ? "ON" : "OFF";
+  doc["fan"] = fan ? "ON" : "OFF";
+  doc["grow_light"] = growLight ? "ON" : "OFF";
+  doc["rssi"] = rssi;
+  doc["uptime"] = uptime;
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+// Anomaly event with a snapshot of the readings and actuators at the time,
+// so the event is self-contained for the subscriber
+inline size_t serialize_anomaly_event(const AnomalyEvent& event, const SensorSample& context, bool pump, bool fan,
+                                      bool growLight, const char* deviceId, const char* plantId,
+                                      unsigned long timestamp, const SequenceStamp& stamp, char* buffer,
+                                      size_t size) {
+  StaticJsonDocument<576> doc;
+  doc["event"] = event.raised ? "anomaly_raised" : "anomaly_cleared";
+  doc["sensor"] = anomaly_field_name(event.field);
+  if (event.raised) {
+    doc["reason"] = anomaly_reason_name(event.reason);
+  }
+  doc["value"] = event.value;
+  doc["expected"] = event.expected;
+  doc["deviation"] = event.deviation;
+  doc["stddev"] = event.stddev;
+  doc["z_score"] = event.zScore;
+  doc["timestamp"] = timestamp;
+  doc["device_id"] = deviceId;
+  if (plantId) {
+    doc["plant_id"] = plantId;
+  }
+  JsonObject snapshot = doc.createNestedObject("context");
+  snapshot["temperature"] = context.temperature;
+  snapshot["humidity"] = context.humidity;
+  snapshot["soil_moisture_percent"] = context.soilMoisturePercent;
+  snapshot["light_percent"] = light_percent(context.lightIntensity);
+  snapshot["pump"] = pump ? "ON" : "OFF";
+  snapshot["fan"] = fan ? "ON" : "OFF";
+  snapshot["grow_light"] = growLight ? "ON" : "OFF";
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+// Watering event; "state" tells a raised event from its clearing
+inline size_t serialize_watering_event(const WateringEvent& event, bool pump, const char* deviceId,
+                                       const char* plantId, unsigned long timestamp, const SequenceStamp& stamp,
+                                       char* buffer, size_t size) {
+  StaticJsonDocument<384> doc;
+  doc["event"] = watering_event_name(event.type);
+  doc["state"] = event.raised ? "raised" : "cleared";
+  doc["moisture"] = event.moisture;
+  doc["baseline"] = event.baseline;
+  doc["change"] = event.change;
+  doc["statistic"] = event.statistic;
+  doc["elapsed_ms"] = event.elapsedMs;
+  doc["pump"] = pump ? "ON" : "OFF";
+  doc["timestamp"] = timestamp;
+  doc["device_id"] = deviceId;
+  if (plantId) {
+    doc["plant_id"] = plantId;
+  }
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+// Same fields as the analytics service's soil-dryness prediction, plus the
+// learned drying rate; eta_hours is null while the soil is not drying
+inline size_t serialize_dryness_estimate(const DrynessEstimate& estimate, const char* deviceId, const char* plantId,
+                                         unsigned long timestamp, const SequenceStamp& stamp, char* buffer,
+                                         size_t size) {
+  StaticJsonDocument<448> doc;
+  doc["timestamp"] = timestamp;
+  doc["current_moisture"] = estimate.moisture;
+  doc["critical_moisture"] = estimate.criticalMoisture;
+  if (estimate.etaHours >= 0) {
+    doc["eta_hours"] = estimate.etaHours;
+  } else {
+    doc["eta_hours"] = (char*)0;  // null
+  }
+  doc["confidence"] = estimate.confidence;
+  doc["drying_rate"] = estimate.rate;
+  doc["observations"] = estimate.observations;
+  if (estimate.etaHours < 0) {
+    doc["recommendation"] = "Soil is not drying";
+  } else if (estimate.etaHours < 3) {
+    doc["recommendation"] = "Water immediately!";
+  } else if (estimate.etaHours < 12) {
+    doc["recommendation"] = "Water soon";
+  } else {
+    doc["recommendation"] = "Soil moisture is good";
+  }
+  doc["source"] = "device";
+  doc["device_id"] = deviceId;
+  if (plantId) {
+    doc["plant_id"] = plantId;
+  }
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+// One-step forecast of the on-device int8 model, in the units of the ML
+// module's TrendPredictor.predict_future()
+inline size_t serialize_trend_prediction(const TrendPrediction& prediction, const char* modelId, const char* deviceId,
+                                         unsigned long timestamp, const SequenceStamp& stamp, char* buffer,
+                                         size_t size) {
+  static const char* const metrics[TREND_CHANNELS] = {"temperature", "humidity", "soil_moisture", "light_intensity"};
+  StaticJsonDocument<512> doc;
+  doc["timestamp"] = timestamp;
+  doc["minutes_ahead"] = prediction.horizonMinutes;
+  JsonObject current = doc.createNestedObject("current");
+  JsonObject predicted = doc.createNestedObject("predicted");
+  for (uint8_t c = 0; c < TREND_CHANNELS; c++) {
+    current[metrics[c]] = prediction.current.value[c];
+    predicted[metrics[c]] = prediction.predicted.value[c];
+  }
+  doc["model"] = modelId;
+  doc["source"] = "device";
+  doc["device_id"] = deviceId;
+  add_sequence(doc, stamp);
+  return serializeJson(doc, buffer, size);
+}
+
+// Birth message on plant-iot/<device>/online (presence.h)
+inline size_t serialize_birth(const BirthInfo& birth, const char* deviceId, unsigned long timestamp, char* buffer,
+                              size_t size) {
+  char hash[9];
+  snprintf(hash, sizeof(hash), "%08lx", (unsigned long)birth.configHash);
+  StaticJsonDocument<512> doc;
+  doc["state"] = "online";
+  doc["device_id"] = deviceId;
+  doc["firmware"] = birth.firmware;
+  doc["profile"] = birth.profile;
+  doc["boot"] = birth.boot;
+  doc["boot_reason"] = birth.bootReason;
+  doc["connects"] = birth.connects;
+  doc["config_revision"] = birth.configRevision;
+  doc["config_hash"] = hash;
+  if (birth.failover) {
+    JsonObject broker = doc.createNestedObject("broker");
+    broker["active"] = birth.failover->active;
+    broker["failovers"] = birth.failover->failovers;
+    broker["returns"] = birth.failover->returns;
+    broker["last_outage_ms"] = birth.failover->lastOutageMs;
+    broker["max_outage_ms"] = birth.failover->maxOutageMs;
+    if (birth.backlog) {
+      broker["backlog_replayed"] = birth.backlog->replayed;
+      broker["backlog_dropped"] = birth.backlog->dropped;
+    }
+  }
+  doc["timestamp"] = timestamp;
+  return serializeJson(doc, buffer, size);
+}
+
+// Outcome of an identity/set request (see device_identity.h)
+inline size_t serialize_identity_state(const char* status, const char* deviceId, bool provisioned,
+                                       unsigned long timestamp, char* buffer, size_t size) {
+  StaticJsonDocument<128> doc;
+  doc["status"] = status;
+  doc["device_id"] = deviceId;
+  doc["provisioned"] = provisioned;
+  doc["timestamp"] = timestamp;
+  return serializeJson(doc, buffer, size);
+}
+
+// Last Will, registered with the broker at connect time
+inline size_t serialize_offline(const char* deviceId, uint32_t boot, char* buffer, size_t size) {
+  StaticJsonDocument<128> doc;
+  doc["state"] = "offline";
+  doc["device_id"] = deviceId;
+  doc["boot"] = boot;
+  return serializeJson(doc, buffer, size);
+}
+
+// Most zone IDs a command response lists (irrigation_zones.h allows 8 zones)
+#define COMMAND_RESPONSE_MAX_ZONES 8
+
+// Answer to a command that asked for one (MQTT 5.0 response topic): the
+// outcome, the IDs of the zones a pump command could not queue and the
+// actuator states after it
+inline size_t serialize_command_response(const char* status, const char* const* rejectedZones, uint8_t rejectedCount,
+                                         bool pump, bool fan, bool growLight, unsigned long timestamp, char* buffer,
+                                         size_t size) {
+  StaticJsonDocument<160 + JSON_ARRAY_SIZE(COMMAND_RESPONSE_MAX_ZONES)> doc;
+  doc["status"] = status;
+  if (rejectedCount > 0) {
+    JsonArray rejected = doc.createNestedArray("rejected_zones");
+    for (uint8_t i = 0; i < rejectedCount && i < COMMAND_RESPONSE_MAX_ZONES; i++) {
+      rejected.add(rejectedZones[i]);
+    }
+  }
+  doc["pump"] = pump ? "ON" : "OFF";
+  doc["fan"] = fan ? "ON" : "OFF";
+  doc["grow_light"] = growLight ? "ON" : "OFF";
+  doc["timestamp"] = timestamp;
+  return serializeJson(doc, buffer, size);
+}
+
+#endif
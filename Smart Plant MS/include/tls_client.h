@@ -0,0 +1,119 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "profile_presets.h"
+
+// ============ TLS Transport ============
+// MQTT over TLS 1.2 with mbedTLS, layered on a plain Client (the WiFiClient
+// TCP connection). PubSubClient / Mqtt5Client take it in place of the
+// WiFiClient. Compiled only with FEATURE_MQTT_TLS; the broker certificate
+// is verified against the CA set with setCACert().
+//
+// What keeps a reconnect cheap:
+// - Session resumption. After every handshake the session is saved to RTC
+//   memory (RTC_NOINIT_ATTR: survives deep sleep, software resets and
+//   watchdog resets, not power loss). It holds the broker's session ticket
+//   (RFC 5077), or its session ID. The next connect to the same host and
+//   port offers it. A broker that accepts skips the certificate exchange
+//   and the key exchange: one round trip and no public-key operations.
+// - Hardware crypto. ESP-IDF builds mbedTLS with the AES, SHA and
+//   big-number (RSA) accelerators. The offered ciphersuites are limited to
+//   what those cover: AES-128-GCM, SHA-256 and RSA certificates. ECDHE
+//   (MQTT_TLS_ECDHE) adds forward secrecy but runs its curve arithmetic in
+//   software, so it makes a full handshake slower; a resumed one does no
+//   key exchange either way.
+// - A static buffer pool. Every mbedTLS allocation is served from
+//   TLS_POOL_SIZE bytes reserved at link time, so TLS never competes with
+//   the rest of the firmware for heap and a reconnect cannot fail on a
+//   fragmented heap. An allocation that does not fit falls back to the
+//   heap and is counted in tls_pool_stats().
+//
+// There is one set of mbedTLS state, so there can be one TlsClient.
+
+#ifndef MQTT_TLS_PORT
+#define MQTT_TLS_PORT 8883
+#endif
+
+#ifndef MQTT_TLS_ECDHE
+#define MQTT_TLS_ECDHE 1            // Offer ECDHE-RSA before plain RSA key exchange
+#endif
+
+// 16 KB incoming and 4 KB outgoing record buffers (ESP-IDF defaults),
+// handshake state and the parsed CA certificate
+#ifndef TLS_POOL_SIZE
+#define TLS_POOL_SIZE (40 * 1024)
+#endif
+
+// A saved session: the ticket and, with MBEDTLS_SSL_KEEP_PEER_CERTIFICATE,
+// the broker's certificate
+#ifndef TLS_SESSION_CACHE_SIZE
+#define TLS_SESSION_CACHE_SIZE 2048
+#endif
+
+#define TLS_HANDSHAKE_TIMEOUT_MS 10000UL
+#define TLS_WRITE_TIMEOUT_MS 5000UL
+
+struct TlsPoolStats {
+  bool installed;               // False if mbedTLS was built without MBEDTLS_PLATFORM_MEMORY
+  size_t size;
+  size_t inUse;
+  size_t peak;                  // Since boot or tls_pool_reset_peak()
+  uint32_t allocations;
+  uint32_t fallbacks;           // Served from the heap: the pool was full
+  size_t fallbackBytes;
+};
+
+struct TlsHandshake {
+  bool resumed;                 // The broker accepted the saved session
+  bool offered;                 // A saved session was offered
+  uint32_t durationMs;
+  const char* ciphersuite;
+  int error;                    // mbedTLS error code of the last failure, 0 if none
+};
+
+class TlsClient : public Client {
+ public:
+  explicit TlsClient(Client& transport);
+  ~TlsClient() override;
+
+  void setCACert(const char* pem);          // Kept by pointer
+  void setResumption(bool enabled);         // On by default
+
+  int connect(const char* host, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port);
+  size_t write(uint8_t byte);
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  int peek();
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() { return connected(); }
+
+  const TlsHandshake& lastHandshake() const { return handshake_; }
+
+  // Drops the session saved in RTC memory: the next connect is a full handshake
+  static void forgetSession();
+
+  // True when mbedTLS uses the AES, SHA and big-number accelerators
+  static bool hardwareCrypto();
+
+ private:
+  void fail(int error);
+
+  Client& transport_;
+  const char* caPem_ = nullptr;
+  bool resumption_ = true;
+  bool open_ = false;
+  int peeked_ = -1;
+  TlsHandshake handshake_ = {};
+};
+
+TlsPoolStats tls_pool_stats();
+void tls_pool_reset_peak();
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TOPICS_H
+#define TOPICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "profile_presets.h"
+
+// ============ MQTT Topic Table ============
+// All fixed topic strings are built once at boot into a static table so the
+// publish and dispatch paths never format or allocate topic names.
+//
+// Namespaced mode:  plant-iot/<device_id>/sensors/aggregated
+// Compat mode:      plant-iot/sensors/aggregated   (original flat topics)
+//
+// Compat mode is the default so the existing backend services keep working;
+// fleet builds set -DTOPIC_COMPAT_FLAT=0 so boards never collide on topics.
+// Per-plant and per-zone topics are always namespaced.
+
+#ifndef TOPIC_COMPAT_FLAT
+#define TOPIC_COMPAT_FLAT 1
+#endif
+
+#define TOPIC_ROOT "plant-iot"
+#define TOPIC_MAX_LEN 72
+
+enum TopicId : uint8_t {
+  // Telemetry
+  TOPIC_SENSORS_AGGREGATED,
+  TOPIC_SENSORS_TEMPERATURE,
+  TOPIC_SENSORS_HUMIDITY,
+  TOPIC_SENSORS_SOIL_MOISTURE,
+  TOPIC_SENSORS_LIGHT,
+  TOPIC_STATUS_PUMP,
+  TOPIC_STATUS_FAN,
+  TOPIC_STATUS_GROW_LIGHT,
+  TOPIC_STATUS_ALL,
+  TOPIC_EVENTS_ANOMALY,
+  TOPIC_EVENTS_WATERING,
+  TOPIC_PREDICTIONS_SOIL_DRYNESS,
+  TOPIC_PREDICTIONS_TREND,
+  // Commands (subscribed)
+  TOPIC_CMD_PUMP,
+  TOPIC_CMD_FAN,
+  TOPIC_CMD_GROW_LIGHT,
+  TOPIC_CMD_CONTROL_ALL,
+  TOPIC_COUNT
+};
+
+#define TOPIC_FIRST_COMMAND TOPIC_CMD_PUMP
+
+void topics_begin(const char* deviceId);
+
+const char* topic_name(TopicId id);
+const char* topic_device_prefix();     // "plant-iot/<device_id>/" regardless of compat mode
+
+// Maps an incoming topic to a command TopicId, or returns -1
+int topic_lookup(const char* name);
+
+// Builds a topic under an arbitrary prefix ("plant-iot/" or "plant-iot/<id>/").
+// Used by host tools that simulate many devices in one process.
+const char* topic_suffix(TopicId id);
+size_t topic_build(char* out, size_t size, const char* prefix, TopicId id);
+
+#endif
@@ -0,0 +1,343 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ============ Sensor Trace Format ============
+// Compact binary log of what a device saw: raw sensor reads, received MQTT
+// commands and actuator changes, with millisecond timing. Written on the
+// device by trace_recorder.cpp and read by the host replay engine, so both
+// sides share this header (no Arduino dependencies).
+//
+// A trace is a sequence of self-contained chunks; each one can be decoded on
+// its own, so chunks lost in transit only lose their own records.
+//
+// Chunk:   'P' 'T' version plantCount | u16 bodyLength | u32 sequence |
+//          u32 baseMillis | records...            (little-endian)
+// Record:  u8 type | varint dtMs (since previous record or baseMillis) | body
+//
+//   TRACE_START     u8 idLength, id                   recorder started
+//   TRACE_SAMPLE    u8 flags, [zz temp], [zz humidity], zz light, zz soil * plantCount
+//                   (zigzag deltas from the previous sample in the chunk;
+//                   temperature and humidity in 0.01 units, omitted when the
+//                   DHT read failed)
+//   TRACE_COMMAND   u8 topicLength, topic, varint payloadLength, payload
+//   TRACE_ACTUATORS u8 mask (TRACE_PUMP | TRACE_FAN | TRACE_GROW_LIGHT)
+//
+// A single-plant sample costs about 8 bytes (roughly 370 KB/day at 2 s).
+
+namespace trace {
+
+static const uint8_t VERSION = 1;
+static const size_t CHUNK_HEADER_SIZE = 14;
+static const uint8_t MAX_PLANTS = 16;
+
+enum RecordType : uint8_t {
+  TRACE_START = 0,
+  TRACE_SAMPLE = 1,
+  TRACE_COMMAND = 2,
+  TRACE_ACTUATORS = 3
+};
+
+enum ActuatorBits : uint8_t {
+  TRACE_PUMP = 0x01,
+  TRACE_FAN = 0x02,
+  TRACE_GROW_LIGHT = 0x04
+};
+
+enum SampleFlags : uint8_t {
+  SAMPLE_TEMPERATURE = 0x01,
+  SAMPLE_HUMIDITY = 0x02
+};
+
+inline uint32_t zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+inline int32_t unzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+// ============ Chunk Writer ============
+// Builds one chunk in a caller-supplied buffer. Record methods return false
+// (and write nothing) when the record does not fit; the caller then flushes
+// the chunk with finish() and starts the next one with begin().
+class ChunkWriter {
+ public:
+  ChunkWriter(uint8_t* buffer, size_t capacity, uint8_t plantCount)
+      : buffer_(buffer), capacity_(capacity), plantCount_(plantCount > MAX_PLANTS ? MAX_PLANTS : plantCount) {}
+
+  void begin(uint32_t sequence, uint32_t baseMillis) {
+    size_ = CHUNK_HEADER_SIZE;
+    lastMs_ = baseMillis;
+    prev_ = Sample();
+    buffer_[0] = 'P';
+    buffer_[1] = 'T';
+    buffer_[2] = VERSION;
+    buffer_[3] = plantCount_;
+    put32(buffer_ + 6, sequence);
+    put32(buffer_ + 10, baseMillis);
+  }
+
+  bool start(uint32_t nowMs, const char* deviceId) {
+    size_t idLength = strlen(deviceId);
+    if (idLength > 255) idLength = 255;
+    Mark mark = this->mark();
+    if (!header(TRACE_START, nowMs)) return rollback(mark);
+    put(idLength);
+    bytes(deviceId, idLength);
+    return commit(mark, nowMs);
+  }
+
+  bool sample(uint32_t nowMs, float temperature, float humidity, int light, const int* soil) {
+    Mark mark = this->mark();
+    Sample s = prev_;
+    uint8_t flags = 0;
+    if (!isnan(temperature)) {
+      flags |= SAMPLE_TEMPERATURE;
+      s.temperature = (int32_t)lroundf(temperature * 100.0f);
+    }
+    if (!isnan(humidity)) {
+      flags |= SAMPLE_HUMIDITY;
+      s.humidity = (int32_t)lroundf(humidity * 100.0f);
+    }
+    s.light = light;
+    for (uint8_t p = 0; p < plantCount_; p++) s.soil[p] = soil[p];
+
+    if (!header(TRACE_SAMPLE, nowMs)) return rollback(mark);
+    put(flags);
+    if (flags & SAMPLE_TEMPERATURE) varint(zigzag(s.temperature - prev_.temperature));
+    if (flags & SAMPLE_HUMIDITY) varint(zigzag(s.humidity - prev_.humidity));
+    varint(zigzag(s.light - prev_.light));
+    for (uint8_t p = 0; p < plantCount_; p++) varint(zigzag(s.soil[p] - prev_.soil[p]));
+    if (!commit(mark, nowMs)) return false;
+    prev_ = s;
+    return true;
+  }
+
+  bool command(uint32_t nowMs, const char* topic, const uint8_t* payload, size_t length) {
+    size_t topicLength = strlen(topic);
+    if (topicLength > 255) topicLength = 255;
+    Mark mark = this->mark();
+    if (!header(TRACE_COMMAND, nowMs)) return rollback(mark);
+    put(topicLength);
+    bytes(topic, topicLength);
+    varint(length);
+    bytes(payload, length);
+    return commit(mark, nowMs);
+  }
+
+  bool actuators(uint32_t nowMs, uint8_t mask) {
+    Mark mark = this->mark();
+    if (!header(TRACE_ACTUATORS, nowMs)) return rollback(mark);
+    put(mask);
+    return commit(mark, nowMs);
+  }
+
+  // Writes the body length; returns the chunk size in bytes
+  size_t finish() {
+    uint16_t body = (uint16_t)(size_ - CHUNK_HEADER_SIZE);
+    buffer_[4] = body & 0xFF;
+    buffer_[5] = body >> 8;
+    return size_;
+  }
+
+  bool empty() const { return size_ <= CHUNK_HEADER_SIZE; }
+  size_t size() const { return size_; }
+
+ private:
+  struct Sample {
+    int32_t temperature = 0;
+    int32_t humidity = 0;
+    int32_t light = 0;
+    int32_t soil[MAX_PLANTS] = {0};
+  };
+
+  struct Mark {
+    size_t size;
+  };
+
+  Mark mark() {
+    overflow_ = false;
+    return Mark{size_};
+  }
+
+  bool rollback(Mark mark) {
+    size_ = mark.size;
+    return false;
+  }
+
+  bool commit(Mark mark, uint32_t nowMs) {
+    if (overflow_) return rollback(mark);
+    lastMs_ = nowMs;
+    return true;
+  }
+
+  bool header(RecordType type, uint32_t nowMs) {
+    put(type);
+    varint(nowMs - lastMs_);
+    return !overflow_;
+  }
+
+  void put(size_t value) {
+    if (size_ + 1 > capacity_) { overflow_ = true; return; }
+    buffer_[size_++] = (uint8_t)value;
+  }
+
+  void bytes(const void* data, size_t length) {
+    if (size_ + length > capacity_) { overflow_ = true; return; }
+    memcpy(buffer_ + size_, data, length);
+    size_ += length;
+  }
+
+  void varint(uint32_t value) {
+    while (value >= 0x80) {
+      put((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    put(value);
+  }
+
+  static void put32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[i] = (value >> (8 * i)) & 0xFF;
+  }
+
+  uint8_t* buffer_;
+  size_t capacity_;
+  uint8_t plantCount_;
+  size_t size_ = 0;
+  uint32_t lastMs_ = 0;
+  bool overflow_ = false;
+  Sample prev_;
+};
+
+// ============ Chunk Reader ============
+struct ChunkInfo {
+  uint8_t plantCount;
+  uint32_t sequence;
+  uint32_t baseMillis;
+  const uint8_t* body;
+  size_t bodyLength;
+};
+
+// Decoded record; pointers refer into the chunk buffer
+struct Record {
+  RecordType type;
+  uint32_t timeMs;            // Device millis()
+  // TRACE_START
+  const char* deviceId;
+  uint8_t deviceIdLength;
+  // TRACE_SAMPLE (temperature / humidity are NaN for failed DHT reads)
+  float temperature;
+  float humidity;
+  int light;
+  int soil[MAX_PLANTS];
+  // TRACE_COMMAND
+  const char* topic;
+  uint8_t topicLength;
+  const uint8_t* payload;
+  uint32_t payloadLength;
+  // TRACE_ACTUATORS
+  uint8_t actuators;
+};
+
+// Frames one chunk from a byte stream. Returns the total chunk size if a
+// complete chunk is available, 0 if more bytes are needed, -1 if malformed.
+inline long decode_chunk(const uint8_t* data, size_t available, ChunkInfo& info) {
+  if (available < CHUNK_HEADER_SIZE) return 0;
+  if (data[0] != 'P' || data[1] != 'T' || data[2] != VERSION || data[3] > MAX_PLANTS) return -1;
+  size_t body = data[4] | (data[5] << 8);
+  if (available < CHUNK_HEADER_SIZE + body) return 0;
+
+  info.plantCount = data[3];
+  info.sequence = data[6] | (data[7] << 8) | (data[8] << 16) | ((uint32_t)data[9] << 24);
+  info.baseMillis = data[10] | (data[11] << 8) | (data[12] << 16) | ((uint32_t)data[13] << 24);
+  info.body = data + CHUNK_HEADER_SIZE;
+  info.bodyLength = body;
+  return (long)(CHUNK_HEADER_SIZE + body);
+}
+
+// Iterates the records of one chunk
+class ChunkReader {
+ public:
+  explicit ChunkReader(const ChunkInfo& info)
+      : info_(info), pos_(0), timeMs_(info.baseMillis), ok_(true) {}
+
+  // Returns false at the end of the chunk or on a malformed record (see ok())
+  bool next(Record& r) {
+    if (pos_ >= info_.bodyLength || !ok_) return false;
+
+    uint8_t type = get();
+    timeMs_ += varint();
+    r.type = (RecordType)type;
+    r.timeMs = timeMs_;
+
+    switch (type) {
+      case TRACE_START:
+        r.deviceIdLength = get();
+        r.deviceId = (const char*)take(r.deviceIdLength);
+        break;
+      case TRACE_SAMPLE: {
+        uint8_t flags = get();
+        if (flags & SAMPLE_TEMPERATURE) temperature_ += unzigzag(varint());
+        if (flags & SAMPLE_HUMIDITY) humidity_ += unzigzag(varint());
+        light_ += unzigzag(varint());
+        for (uint8_t p = 0; p < info_.plantCount; p++) soil_[p] += unzigzag(varint());
+        r.temperature = (flags & SAMPLE_TEMPERATURE) ? temperature_ / 100.0f : NAN;
+        r.humidity = (flags & SAMPLE_HUMIDITY) ? humidity_ / 100.0f : NAN;
+        r.light = light_;
+        for (uint8_t p = 0; p < MAX_PLANTS; p++) r.soil[p] = p < info_.plantCount ? soil_[p] : 0;
+        break;
+      }
+      case TRACE_COMMAND:
+        r.topicLength = get();
+        r.topic = (const char*)take(r.topicLength);
+        r.payloadLength = varint();
+        r.payload = take(r.payloadLength);
+        break;
+      case TRACE_ACTUATORS:
+        r.actuators = get();
+        break;
+      default:
+        ok_ = false;
+    }
+    return ok_;
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  uint8_t get() {
+    if (pos_ >= info_.bodyLength) { ok_ = false; return 0; }
+    return info_.body[pos_++];
+  }
+
+  const uint8_t* take(size_t length) {
+    if (pos_ + length > info_.bodyLength) { ok_ = false; return info_.body; }
+    const uint8_t* p = info_.body + pos_;
+    pos_ += length;
+    return p;
+  }
+
+  uint32_t varint() {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t b = get();
+      value |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return value;
+    }
+    ok_ = false;
+    return 0;
+  }
+
+  ChunkInfo info_;
+  size_t pos_;
+  uint32_t timeMs_;
+  bool ok_;
+  int32_t temperature_ = 0;
+  int32_t humidity_ = 0;
+  int32_t light_ = 0;
+  int32_t soil_[MAX_PLANTS] = {0};
+};
+
+}  // namespace trace
+
+#endif
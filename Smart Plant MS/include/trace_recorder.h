@@ -0,0 +1,66 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <Arduino.h>
+#include "profile_presets.h"
+
+// ============ Trace Recorder ============
+// Records raw sensor reads, received commands and actuator changes in the
+// compact format described in trace_format.h, so odd field behaviour (pump
+// cycling, missed commands) can be replayed bit-for-bit on a host with
+// src/host/replay. Chunks are either streamed over MQTT as they fill, or
+// appended to a flash file and dumped over MQTT later.
+//
+// Control topic: plant-iot/<device>/trace/command
+//   {"action": "start", "sink": "mqtt" | "flash"}
+//   {"action": "stop"}
+//   {"action": "dump"}   (flash only: publish the stored trace)
+//   {"action": "erase"}  (flash only)
+// Chunks are published to plant-iot/<device>/trace.
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1           // 0 = trace_start() always fails
+#endif
+
+#ifndef TRACE_FLASH_ENABLED
+#define TRACE_FLASH_ENABLED 0     // 1 = allow the SPIFFS sink
+#endif
+
+// Fits a trace publish (topic + chunk) in the MQTT client's 512-byte buffer
+#define TRACE_CHUNK_SIZE 384
+#define TRACE_FLUSH_MS 60000UL            // Flush partial chunks at least this often
+#define TRACE_FLASH_PATH "/trace.bin"
+#define TRACE_FLASH_MAX_BYTES 262144UL    // About 20 hours of single-plant samples
+
+enum TraceSink : uint8_t {
+  TRACE_SINK_OFF,
+  TRACE_SINK_MQTT,
+  TRACE_SINK_FLASH
+};
+
+// Publishes one finished chunk; returns false if it could not be sent
+typedef bool (*TraceChunkWriter)(const uint8_t* data, size_t length);
+
+void trace_begin(const char* deviceId, TraceChunkWriter mqttWriter);
+bool trace_start(TraceSink sink, unsigned long now);
+void trace_stop();
+bool trace_active();
+TraceSink trace_sink();
+const char* trace_sink_name(TraceSink sink);
+
+// Recording hooks; no-ops while the recorder is stopped
+void trace_sample(unsigned long now, float temperature, float humidity, int light, const int* soil);
+void trace_command(unsigned long now, const char* topic, const uint8_t* payload, unsigned int length);
+void trace_actuators(unsigned long now, bool pump, bool fan, bool growLight);
+
+// Flushes stale chunks and advances a pending flash dump; call from loop()
+void trace_loop(unsigned long now);
+
+// Flash sink maintenance (no-ops unless TRACE_FLASH_ENABLED)
+bool trace_dump();
+bool trace_erase();
+
+uint32_t trace_bytes_written();
+uint32_t trace_chunks_dropped();
+
+#endif
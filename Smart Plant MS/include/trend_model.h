@@ -0,0 +1,113 @@
+#ifndef TREND_MODEL_H
+#define TREND_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "profile_presets.h"
+
+// ============ Int8 Trend Model ============
+// On-device counterpart of the machine-learning module's TrendPredictor: a
+// small MLP, trained and quantized by machine-learning/trend_tinyml.py, that
+// looks at the last TREND_WINDOW one-minute means of the four readings and
+// predicts each of them the model's horizon ahead (30 minutes, the first
+// step of the service's forecast).
+//
+// The weights live in their own flash partition (label "trendmodel", see
+// partitions_trend.csv) and are memory-mapped, not copied: the kernel reads
+// them through the flash cache. Everything that changes per inference sits
+// in one static arena, so a prediction never touches the heap.
+//
+// Quantization is symmetric int8 throughout: one scale for each layer's
+// input, one per output row for its weights, int32 biases and accumulators.
+// Hidden layers requantize with a fixed-point multiplier and shift (fused
+// ReLU); the last layer's accumulators are scaled straight to floats.
+//
+// Blob layout (little-endian, every section 4-byte aligned):
+//   TrendBlobHeader
+//   per layer: TrendLayerHeader, int32 bias[outputs], int32 multiplier[outputs],
+//              int32 shift[outputs], float outScale[outputs],
+//              int8 weights[outputs][stride]   (rows zero-padded to stride)
+// crc32 covers everything after the header.
+
+#ifndef TREND_WINDOW
+#define TREND_WINDOW 32               // One-minute steps the model looks at
+#endif
+
+#define TREND_CHANNELS 4              // temperature, humidity, soil moisture %, light %
+#define TREND_STEP_MS 60000UL         // History resolution (matches the training data)
+#define TREND_MAX_WIDTH 128           // Widest layer input or output the arena holds
+#define TREND_MAX_LAYERS 4
+#define TREND_PARTITION_LABEL "trendmodel"
+
+#ifndef TREND_PUBLISH_MS
+#define TREND_PUBLISH_MS 600000UL     // predictions/trend at most this often
+#endif
+
+#define TREND_BLOB_MAGIC 0x444E5254UL // "TRND"
+#define TREND_BLOB_VERSION 1
+
+struct TrendBlobHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t window;                     // Must equal TREND_WINDOW
+  uint8_t channels;                   // Must equal TREND_CHANNELS
+  uint8_t layerCount;
+  uint8_t horizonMinutes;
+  uint16_t reserved;
+  float inputScale;                   // int8 step of the normalized input
+  float center[TREND_CHANNELS];       // normalized = (value - center) / span
+  float span[TREND_CHANNELS];
+  uint32_t payloadBytes;              // Bytes after this header
+  uint32_t crc32;
+  char modelId[16];                   // NUL-terminated hash of the float model
+};
+
+struct TrendLayerHeader {
+  uint16_t inputs;
+  uint16_t outputs;
+  uint16_t stride;                    // inputs rounded up to a multiple of 4
+  uint8_t relu;                       // Hidden layer: requantize with ReLU
+  uint8_t reserved;
+};
+
+// Readings in physical units: °C, %, % (calibrated), % of full scale
+struct TrendReading {
+  float value[TREND_CHANNELS];
+};
+
+struct TrendPrediction {
+  bool valid;
+  uint8_t horizonMinutes;
+  TrendReading current;               // Latest one-minute mean
+  TrendReading predicted;
+};
+
+// Receives each prediction that is due for publishing
+typedef void (*TrendSink)(const TrendPrediction& prediction);
+
+// Maps the "trendmodel" partition (ESP32 only) and validates the blob.
+// Returns false without a valid model; the module then stays idle.
+bool trend_model_begin(TrendSink sink);
+
+// Validates a blob and uses it in place (the memory must stay valid)
+bool trend_model_load(const uint8_t* blob, size_t size);
+bool trend_model_ready();
+const char* trend_model_id();
+uint8_t trend_model_horizon();
+size_t trend_model_blob_bytes();
+size_t trend_model_arena_bytes();
+
+// Runs one inference on a window of readings, oldest first
+bool trend_model_infer(const TrendReading* window, TrendReading& predicted);
+
+// Feed every sensor cycle; keeps the one-minute history and predicts when due
+void trend_observe(float temperature, float humidity, float soilPercent, float lightPercent, unsigned long now);
+const TrendPrediction& trend_latest();
+
+// Int8 matrix-vector product with requantization (exposed for the benchmark):
+// out[o] = clamp(round((bias[o] + sum_i w[o][i] * in[i]) * multiplier[o] / 2^shift[o]))
+void trend_gemv_requant(const int8_t* weights, uint16_t stride, uint16_t rows, const int8_t* input,
+                        const int32_t* bias, const int32_t* multiplier, const int32_t* shift, bool relu,
+                        int8_t* out);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef WATERING_MONITOR_H
+#define WATERING_MONITOR_H
+
+#include <stdint.h>
+#include "profile_presets.h"
+
+// ============ Watering Monitor ============
+// Change-point detectors on each pot's soil moisture, tied to the pump
+// transitions the firmware makes (commands from callback(), zone sequencing):
+//
+// - Watering ineffective: when the pump starts, the moisture before watering
+//   is the baseline and a one-sided CUSUM sums how far the pot rises above
+//   it. If the sum has not crossed WATERING_RISE_LIMIT WATERING_RESPONSE_MS
+//   after the start, no water reached the pot (empty reservoir, disconnected
+//   line, blocked valve). The event clears at the next watering that works.
+//
+// - Unexpected moisture drop: while no water is flowing, a Page-Hinkley test
+//   watches the sample-to-sample change of moisture for a fall below its own
+//   recent mean (the pot's normal drying). A leak, a tipped pot or a probe
+//   pulled out of the soil raises it within a few samples; ordinary drying
+//   never does. The event clears once the level has been steady for
+//   WATERING_DROP_QUIET_MS.
+//
+// Both run on the smoothed moisture at full ADC resolution
+// (soil_probe_moisture()), cost O(1) per sample and keep no history.
+// Only transitions are reported, like the anomaly events.
+//
+// Topic: plant-iot/<device>/events/watering (plant-iot/events/watering in
+// compat mode).
+
+#ifndef WATERING_RESPONSE_MS
+#define WATERING_RESPONSE_MS 30000UL  // Time from pump start for the pot to respond
+#endif
+
+#define WATERING_MIN_PUMP_MS 3000UL   // Shorter runs are not judged
+#define WATERING_RISE_SLACK 0.5f      // % above the baseline each sample may be by chance (CUSUM k)
+#define WATERING_RISE_LIMIT 3.0f      // CUSUM sum (%) that confirms the pot is taking water (h)
+
+#define WATERING_SETTLE_MS 120000UL   // After watering, drainage is not an unexpected drop
+#define WATERING_DROP_WINDOW 120      // Samples the normal rate of change is averaged over
+#define WATERING_DROP_DELTA 0.05f     // % per sample the rate may fall below normal (Page-Hinkley delta)
+#define WATERING_DROP_LIMIT 4.0f      // Page-Hinkley statistic (%) that raises a drop (lambda)
+#define WATERING_DROP_QUIET_MS 60000UL
+
+enum WateringEventType : uint8_t {
+  WATERING_INEFFECTIVE,
+  WATERING_MOISTURE_DROP
+};
+
+struct WateringEvent {
+  WateringEventType type;
+  uint8_t plant;
+  bool raised;                    // false = cleared
+  float moisture;                 // % now
+  float baseline;                 // % before watering / before the drop began
+  float change;                   // moisture - baseline
+  float statistic;                // CUSUM or Page-Hinkley value at the transition
+  unsigned long elapsedMs;        // Since the pump started / the drop began
+};
+
+// Receives every raised/cleared event; the firmware adds context and publishes
+typedef void (*WateringSink)(const WateringEvent& event);
+
+void watering_begin(WateringSink sink);
+
+// Call on every pump (or zone valve) transition for the pots it waters
+void watering_pump(uint8_t plant, bool on, unsigned long now);
+
+// Feed one smoothed moisture reading per sensor cycle
+void watering_observe(uint8_t plant, float moisture, unsigned long now);
+
+bool watering_active(WateringEventType type, uint8_t plant = 0);
+const char* watering_event_name(WateringEventType type);
+
+#endif
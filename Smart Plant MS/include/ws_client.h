@@ -0,0 +1,109 @@
+#ifndef WS_CLIENT_H
+#define WS_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "profile_presets.h"
+
+// ============ WebSocket Transport ============
+// MQTT over WebSocket (RFC 6455, subprotocol "mqtt"), layered on a plain
+// Client: the WiFiClient, or the TlsClient for wss://. PubSubClient /
+// Mqtt5Client take it in place of the WiFiClient. The upgrade is an
+// ordinary HTTP/1.1 GET, which gets through networks that only let HTTP(S)
+// out.
+//
+// connect() opens the transport and performs the upgrade. After that each
+// write() goes out as one masked binary frame (larger writes as several),
+// and read() returns the payload of the broker's binary frames. An MQTT
+// packet may span frames in either direction. Pings are answered and a
+// close frame is echoed before the connection is dropped. Text frames are
+// a protocol error for MQTT and close the connection.
+//
+// No per-message allocation: outgoing frames are masked into one
+// WS_FRAME_BUFFER_SIZE buffer that every write() reuses, and incoming
+// payload is read straight from the transport into the caller's buffer.
+// Only frame headers and control frames (at most 125 bytes) are buffered.
+
+#ifndef MQTT_WS_PORT
+#if FEATURE_MQTT_TLS
+#define MQTT_WS_PORT 8884           // wss listener in mqtt-broker/tls/mosquitto-tls.conf
+#else
+#define MQTT_WS_PORT 9001           // ws listener in mqtt-broker/mosquitto.conf
+#endif
+#endif
+
+#ifndef MQTT_WS_PATH
+#define MQTT_WS_PATH "/mqtt"
+#endif
+
+// Header (up to 8 bytes) plus payload per outgoing frame. Sized for one
+// PubSubClient packet (setBufferSize(512) in main.cpp); also holds the
+// upgrade request.
+#ifndef WS_FRAME_BUFFER_SIZE
+#define WS_FRAME_BUFFER_SIZE (512 + 8)
+#endif
+
+#define WS_HANDSHAKE_TIMEOUT_MS 5000UL
+
+struct WsStats {
+  uint32_t framesSent;
+  uint32_t framesReceived;      // Binary and continuation frames
+  uint32_t pings;               // Answered with a pong
+  uint32_t overheadBytes;       // Frame headers and mask keys sent and received
+};
+
+class WsClient : public Client {
+ public:
+  explicit WsClient(Client& transport) : transport_(transport) {}
+  ~WsClient() override { stop(); }
+
+  void setPath(const char* path) { path_ = path; }   // Kept by pointer
+
+  int connect(const char* host, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port);
+  size_t write(uint8_t byte);
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  int peek();
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() { return connected(); }
+
+  const WsStats& stats() const { return stats_; }
+
+ private:
+  enum class Rx : uint8_t { Header, Payload, Control };
+
+  bool upgrade(const char* host, uint16_t port);
+  size_t send_frame(uint8_t opcode, const uint8_t* payload, size_t length);
+  void receive();
+  bool header_complete();
+  void control_complete();
+  void fail(const char* reason);
+
+  Client& transport_;
+  const char* path_ = MQTT_WS_PATH;
+  bool open_ = false;
+  int peeked_ = -1;
+  WsStats stats_ = {};
+
+  // Incoming frame: header bytes until complete, then payload or control data
+  Rx rx_ = Rx::Header;
+  uint8_t header_[14];
+  uint8_t headerLength_ = 0;
+  uint8_t opcode_ = 0;
+  uint64_t remaining_ = 0;
+  uint8_t control_[125];
+  uint8_t controlLength_ = 0;
+
+  uint8_t frame_[WS_FRAME_BUFFER_SIZE];
+};
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key (RFC 6455 4.2.2): 28
+// characters and a NUL
+void ws_accept_key(const char* key, char accept[29]);
+
+#endif
@@ -0,0 +1,92 @@
+#include "actuator_forest.h"
+#include <math.h>
+
+#if FEATURE_ACTUATOR_MODEL
+// Generated by machine-learning/export_firmware_model.py; defines
+// actuatorForests[MODEL_ACTUATOR_COUNT] and ACTUATOR_MODEL_VERSION
+#include "actuator_forest_model.h"
+#endif
+
+// ============ Inference ============
+static int16_t quantize(float value) {
+  if (isnan(value)) value = 0;
+  long q = lroundf(value * FOREST_INPUT_SCALE);
+  return q < INT16_MIN ? INT16_MIN : q > INT16_MAX ? INT16_MAX : (int16_t)q;
+}
+
+ForestInputs forest_quantize(float temperature, float humidity, float soilPercent, float lightPercent) {
+  ForestInputs inputs;
+  inputs.q[FOREST_TEMPERATURE] = quantize(temperature);
+  inputs.q[FOREST_HUMIDITY] = quantize(humidity);
+  inputs.q[FOREST_SOIL_MOISTURE] = quantize(soilPercent);
+  inputs.q[FOREST_LIGHT_INTENSITY] = quantize(lightPercent);
+  return inputs;
+}
+
+uint32_t forest_vote(const ActuatorForest& forest, const ForestInputs& inputs) {
+  uint32_t sum = 0;
+  for (uint16_t t = 0; t < forest.treeCount; t++) {
+    const ForestNode* tree = forest.nodes + forest.trees[t];
+    uint16_t i = 0;
+    for (;;) {
+      const ForestNode& node = tree[i];
+      uint8_t feature = FOREST_NODE_FEATURE(node);
+      if (feature == FOREST_LEAF) {
+        sum += (uint16_t)node.value;
+        break;
+      }
+      i = inputs.q[feature] <= node.value ? i + 1 : FOREST_NODE_RIGHT(node);
+    }
+  }
+  return sum;
+}
+
+ActuatorDecision forest_decide(const ActuatorForest& forest, const ForestInputs& inputs) {
+  ActuatorDecision decision = {false, 0};
+  if (forest.treeCount == 0) return decision;
+
+  uint32_t total = (uint32_t)forest.treeCount * FOREST_LEAF_SCALE;
+  uint32_t on = forest_vote(forest, inputs);
+  decision.on = 2 * on > total;  // argmax picks OFF on a tie, as sklearn does
+  decision.confidence = (float)(decision.on ? on : total - on) / total;
+  return decision;
+}
+
+// ============ Compiled-in Model ============
+#if !FEATURE_ACTUATOR_MODEL
+static const ActuatorForest actuatorForests[MODEL_ACTUATOR_COUNT] = {};
+#define ACTUATOR_MODEL_VERSION ""
+#endif
+
+bool actuator_model_available() {
+  return FEATURE_ACTUATOR_MODEL != 0;
+}
+
+const ActuatorForest& actuator_model_forest(ModelActuator actuator) {
+  return actuatorForests[actuator < MODEL_ACTUATOR_COUNT ? actuator : 0];
+}
+
+ActuatorDecision actuator_model_predict(ModelActuator actuator, const ForestInputs& inputs) {
+  return forest_decide(actuator_model_forest(actuator), inputs);
+}
+
+const char* actuator_model_version() {
+  return ACTUATOR_MODEL_VERSION;
+}
+
+size_t actuator_model_bytes() {
+  size_t bytes = 0;
+  for (uint8_t a = 0; a < MODEL_ACTUATOR_COUNT; a++) {
+    bytes += actuatorForests[a].nodeCount * sizeof(ForestNode) + actuatorForests[a].treeCount * sizeof(uint32_t);
+  }
+  return bytes;
+}
+
+const char* model_actuator_name(ModelActuator actuator) {
+  switch (actuator) {
+    case MODEL_FAN: return "fan";
+    case MODEL_PUMP: return "pump";
+    case MODEL_LIGHT: return "light";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,110 @@
+#include "anomaly_detector.h"
+#include "sensor_filter.h"
+#include "soil_probes.h"
+
+// ============ Detector State ============
+struct FieldDetector {
+  StreamingStats<ANOMALY_WINDOW> stats;
+  bool active;
+};
+
+struct FieldLimits {
+  float threshold;
+  float minStddev;
+};
+
+static const FieldLimits limits[ANOMALY_FIELD_COUNT] = {
+  {ANOMALY_THRESHOLD_TEMPERATURE, ANOMALY_MIN_STDDEV_TEMPERATURE},
+  {ANOMALY_THRESHOLD_HUMIDITY, ANOMALY_MIN_STDDEV_HUMIDITY},
+  {ANOMALY_THRESHOLD_SOIL_MOISTURE, ANOMALY_MIN_STDDEV_SOIL_MOISTURE},
+  {ANOMALY_THRESHOLD_LIGHT, ANOMALY_MIN_STDDEV_LIGHT},
+};
+
+static FieldDetector environment[ANOMALY_FIELD_COUNT];   // Soil slot unused
+static FieldDetector soil[PLANT_COUNT];
+static AnomalySink sink = nullptr;
+
+// ============ Detection ============
+// Compares the sample with the statistics of the samples before it, reports
+// a transition if there is one, then folds the sample in. Anomalous samples
+// are folded in too, so a lasting change of level becomes the new normal
+// after about ANOMALY_WINDOW samples, as with the service's rolling mean.
+static void check(FieldDetector& d, AnomalyField field, int8_t plant, float value) {
+  if (isnan(value)) return;
+
+  if (d.stats.warm()) {
+    const FieldLimits& limit = limits[field];
+    float expected = d.stats.mean;
+    float deviation = fabsf(value - expected);
+    float stddev = d.stats.stddev();
+    float z = deviation / (stddev > limit.minStddev ? stddev : limit.minStddev);
+
+    bool overThreshold = deviation > limit.threshold;
+    bool overZ = z > ANOMALY_Z_LIMIT;
+    // Clear only once well inside both limits, so a value hovering at the
+    // boundary does not flap
+    bool settled = deviation < limit.threshold / 2 && z < ANOMALY_Z_LIMIT / 2;
+
+    if ((!d.active && (overThreshold || overZ)) || (d.active && settled)) {
+      d.active = !d.active;
+      if (sink) {
+        AnomalyEvent event;
+        event.field = field;
+        event.plant = plant;
+        event.raised = d.active;
+        event.reason = overThreshold ? ANOMALY_REASON_THRESHOLD : ANOMALY_REASON_ZSCORE;
+        event.value = value;
+        event.expected = expected;
+        event.deviation = deviation;
+        event.stddev = stddev;
+        event.zScore = z;
+        sink(event);
+      }
+    }
+  }
+
+  d.stats.push(value);
+}
+
+// ============ Public API ============
+void anomaly_begin(AnomalySink anomalySink) {
+  sink = anomalySink;
+  for (uint8_t f = 0; f < ANOMALY_FIELD_COUNT; f++) {
+    environment[f].stats.reset();
+    environment[f].active = false;
+  }
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    soil[p].stats.reset();
+    soil[p].active = false;
+  }
+}
+
+void anomaly_check_environment(float temperature, float humidity, int lightPercent) {
+  check(environment[ANOMALY_TEMPERATURE], ANOMALY_TEMPERATURE, -1, temperature);
+  check(environment[ANOMALY_HUMIDITY], ANOMALY_HUMIDITY, -1, humidity);
+  check(environment[ANOMALY_LIGHT], ANOMALY_LIGHT, -1, lightPercent);
+}
+
+void anomaly_check_soil(uint8_t plant, int moisturePercent) {
+  if (plant >= PLANT_COUNT) return;
+  check(soil[plant], ANOMALY_SOIL_MOISTURE, plant, moisturePercent);
+}
+
+bool anomaly_active(AnomalyField field, uint8_t plant) {
+  if (field == ANOMALY_SOIL_MOISTURE) return plant < PLANT_COUNT && soil[plant].active;
+  return field < ANOMALY_FIELD_COUNT && environment[field].active;
+}
+
+const char* anomaly_field_name(AnomalyField field) {
+  switch (field) {
+    case ANOMALY_TEMPERATURE: return "temperature";
+    case ANOMALY_HUMIDITY: return "humidity";
+    case ANOMALY_SOIL_MOISTURE: return "soil_moisture";
+    case ANOMALY_LIGHT: return "light_intensity";
+    default: return "unknown";
+  }
+}
+
+const char* anomaly_reason_name(AnomalyReason reason) {
+  return reason == ANOMALY_REASON_THRESHOLD ? "threshold" : "zscore";
+}
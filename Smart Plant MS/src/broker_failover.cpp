@@ -0,0 +1,223 @@
+#include "broker_failover.h"
+
+#if FEATURE_BROKER_FAILOVER
+#include <WiFi.h>
+#include "firmware_profile.h"
+#include "mqtt_codec.h"
+
+// ============ Failover State ============
+static const BrokerEndpoint* brokers = nullptr;
+static uint8_t brokerCount = 0;
+static char probeClientId[48];
+static bool mqttProbes = true;
+
+static BrokerHealth health[BROKER_MAX];
+static FailoverStats stats = {};
+
+static uint8_t target = 0;                // Broker the next connect attempt goes to
+static bool connected = false;
+static unsigned long connectedSince = 0;
+static bool failing = false;              // Attempts on the target are failing
+static unsigned long failingSince = 0;
+static bool outage = false;               // Lost a connection, not connected again yet
+static unsigned long lostAt = 0;
+static bool returning = false;            // Left a standby for the primary on purpose
+
+// One probe at a time: the TCP connect blocks for up to
+// BROKER_PROBE_TIMEOUT_MS, the CONNACK is polled across loop passes
+static WiFiClient probeClient;
+static int8_t probing = -1;
+static unsigned long probeStarted = 0;
+static uint8_t probeRx[8];
+static uint8_t probeRxLength = 0;
+static uint8_t nextProbe = 0;
+
+// ============ Health ============
+static void record(uint8_t broker, bool ok, unsigned long now) {
+  BrokerHealth& h = health[broker];
+  if (h.healthy != ok) {
+    h.healthy = ok;
+    h.streak = 0;
+    if (ok) h.healthySince = now;
+  }
+  if (h.streak < 255) h.streak++;
+}
+
+static void probe_finished(bool ok, unsigned long now) {
+  if (ok) {
+    health[probing].rttMs = now - probeStarted;
+    if (mqttProbes) {
+      uint8_t packet[2];
+      probeClient.write(packet, mqtt::encode_empty(packet, sizeof(packet), mqtt::DISCONNECT));
+    }
+  } else {
+    stats.probeFailures++;
+  }
+  probeClient.stop();
+  record(probing, ok, now);
+  probing = -1;
+}
+
+static void probe_start(uint8_t broker, unsigned long now) {
+  probing = broker;
+  probeStarted = now;
+  probeRxLength = 0;
+  health[broker].lastProbe = now;
+  stats.probes++;
+
+  if (!probeClient.connect(brokers[broker].host, brokers[broker].port, BROKER_PROBE_TIMEOUT_MS)) {
+    probe_finished(false, millis());
+    return;
+  }
+  if (!mqttProbes) {
+    probe_finished(true, millis());
+    return;
+  }
+
+  uint8_t packet[64];
+  mqtt::ConnectOptions options = {};
+  options.clientId = probeClientId;
+  options.keepAliveSeconds = 10;
+  options.cleanSession = true;
+  size_t size = mqtt::encode_connect(packet, sizeof(packet), options);
+  if (size == 0 || probeClient.write(packet, size) != size) probe_finished(false, millis());
+}
+
+static void probe_poll(unsigned long now) {
+  while (probeRxLength < sizeof(probeRx)) {
+    int n = probeClient.read(probeRx + probeRxLength, sizeof(probeRx) - probeRxLength);
+    if (n <= 0) break;
+    probeRxLength += n;
+  }
+  mqtt::Packet reply;
+  if (mqtt::decode_packet(probeRx, probeRxLength, reply) > 0) {
+    probe_finished(mqtt::connack_code(reply) == 0, now);
+  } else if (now - probeStarted >= BROKER_PROBE_TIMEOUT_MS || !probeClient.connected()) {
+    probe_finished(false, now);
+  }
+}
+
+static void probe_step(unsigned long now) {
+  if (probing >= 0) {
+    probe_poll(now);
+    return;
+  }
+  // The broker in use (or being retried) is not probed; its connection says enough
+  uint8_t current = connected ? stats.active : target;
+  for (uint8_t k = 0; k < brokerCount; k++) {
+    uint8_t broker = (nextProbe + k) % brokerCount;
+    if (broker == current || now - health[broker].lastProbe < BROKER_PROBE_INTERVAL_MS) continue;
+    nextProbe = (broker + 1) % brokerCount;
+    probe_start(broker, now);
+    return;
+  }
+}
+
+// ============ Failover ============
+void failover_begin(const BrokerEndpoint* list, uint8_t count, const char* deviceId, bool mqttProbe) {
+  brokers = list;
+  brokerCount = count < BROKER_MAX ? count : BROKER_MAX;
+  mqttProbes = mqttProbe;
+  snprintf(probeClientId, sizeof(probeClientId), "%s-probe", deviceId);
+
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < brokerCount; i++) {
+    health[i] = {};
+    health[i].lastProbe = now - BROKER_PROBE_INTERVAL_MS;   // Due right away
+  }
+  Log::printf("[Failover] %u brokers, primary %s:%u\n", brokerCount, brokers[0].host, brokers[0].port);
+}
+
+const BrokerEndpoint& failover_target(unsigned long now) {
+  if (failing && brokerCount > 1 && now - failingSince >= BROKER_FAILOVER_AFTER_MS) {
+    // First broker in list order that passed its last probe, else simply the next one
+    uint8_t next = (target + 1) % brokerCount;
+    for (uint8_t i = 0; i < brokerCount; i++) {
+      if (i != target && health[i].healthy) {
+        next = i;
+        break;
+      }
+    }
+    Log::printf("[Failover] %s:%u down for %lu ms, trying %s:%u\n", brokers[target].host, brokers[target].port,
+                now - failingSince, brokers[next].host, brokers[next].port);
+    target = next;
+    failingSince = now;
+    if (probing == (int8_t)target) probe_finished(false, now);
+  }
+  return brokers[target];
+}
+
+void failover_connected(unsigned long now) {
+  if (probing == (int8_t)target) probe_finished(true, now);
+  record(target, true, now);
+
+  if (returning && target == 0) {
+    stats.returns++;
+    stats.lastReturnMs = now - lostAt;
+    Log::printf("[Failover] Back on primary after %lu ms\n", now - lostAt);
+  } else {
+    if (outage) {
+      stats.lastOutageMs = now - lostAt;
+      if (stats.lastOutageMs > stats.maxOutageMs) stats.maxOutageMs = stats.lastOutageMs;
+      Log::printf("[Failover] Connected to %s:%u after %lu ms outage\n", brokers[target].host, brokers[target].port,
+                  now - lostAt);
+    }
+    if (target != stats.active) stats.failovers++;
+  }
+
+  stats.active = target;
+  connected = true;
+  connectedSince = now;
+  failing = false;
+  outage = false;
+  returning = false;
+}
+
+void failover_connect_failed(unsigned long now) {
+  record(target, false, now);
+  if (!failing) {
+    failing = true;
+    failingSince = now;
+  }
+}
+
+bool failover_loop(unsigned long now, bool clientConnected) {
+  if (brokerCount == 0) return false;
+
+  if (connected && !clientConnected) {
+    Log::printf("[Failover] Lost %s:%u\n", brokers[stats.active].host, brokers[stats.active].port);
+    record(stats.active, false, now);
+    connected = false;
+    outage = true;
+    lostAt = now;
+    failing = true;
+    failingSince = now;
+  }
+
+  probe_step(now);
+
+  // Sticky: stay on the standby until the primary has been healthy for a while
+  const BrokerHealth& primary = health[0];
+  if (connected && stats.active != 0 && primary.healthy && primary.streak >= BROKER_RETURN_PROBES &&
+      now - primary.healthySince >= BROKER_RETURN_HOLD_MS && now - connectedSince >= BROKER_MIN_DWELL_MS) {
+    Log::printf("[Failover] Primary healthy for %lu ms, returning\n", now - primary.healthySince);
+    connected = false;
+    outage = true;
+    lostAt = now;
+    returning = true;
+    target = 0;
+    failing = false;
+    return true;
+  }
+  return false;
+}
+
+const FailoverStats& failover_stats() {
+  return stats;
+}
+
+const BrokerHealth& failover_health(uint8_t broker) {
+  return health[broker < BROKER_MAX ? broker : 0];
+}
+
+#endif
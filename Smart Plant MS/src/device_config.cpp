@@ -0,0 +1,474 @@
+#include "device_config.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include "irrigation_zones.h"
+#include "sensor_filter.h"
+#include "soil_probes.h"
+#include "firmware_profile.h"
+
+// ============ Configuration State ============
+static ConfigApplier applier = nullptr;
+static DeviceConfig active;
+static DeviceConfig previous;   // Re-applied if the trial fails
+
+static bool onTrial = false;
+static unsigned long trialStart = 0;
+static unsigned long trialLength = 0;
+static uint16_t trialReads = 0;
+static uint16_t trialDhtOk = 0;
+static uint16_t trialPublishes = 0;
+static bool dhtHealthy = false;        // Last DHT22 read succeeded
+static bool dhtHealthyBefore = false;  // ... when the change was applied
+static char lastError[48] = "";
+
+// Pins owned by other modules at build time
+#if SOIL_MUX_ENABLED
+static const uint8_t soilPins[] = {SOIL_MUX_SIG_PIN, SOIL_MUX_S0_PIN, SOIL_MUX_S1_PIN, SOIL_MUX_S2_PIN,
+                                   SOIL_MUX_S3_PIN};
+static const uint8_t soilPinCount = sizeof(soilPins);
+#else
+static const uint8_t soilPins[] = SOIL_PROBE_PINS;
+static const uint8_t soilPinCount = PLANT_COUNT;
+#endif
+static const uint8_t valvePins[] = ZONE_VALVE_PINS;
+
+// ============ Validation ============
+static bool set_error(char* error, size_t size, const char* message) {
+  if (error && size > 0) {
+    strncpy(error, message, size - 1);
+    error[size - 1] = '\0';
+  }
+  return false;
+}
+
+// GPIO 6-11 drive the flash chip, 1/3 are the Serial console and 34-39 are input-only
+static bool output_pin_ok(uint8_t pin) {
+  return pin <= 33 && !(pin >= 6 && pin <= 11) && pin != 1 && pin != 3;
+}
+
+// ADC2 is unusable while WiFi is active, so analog inputs must be on ADC1
+static bool adc1_pin_ok(uint8_t pin) {
+  return pin >= 32 && pin <= 39;
+}
+
+static bool pin_reserved(uint8_t pin) {
+  if (pin == DHTPIN) return true;
+  for (uint8_t i = 0; i < soilPinCount; i++) {
+    if (soilPins[i] == pin) return true;
+  }
+  if (ZONE_COUNT > 1) {
+    for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+      if (valvePins[z] == pin) return true;
+    }
+  }
+  return false;
+}
+
+static bool validate(const DeviceConfig& c, char* error, size_t size) {
+  if (c.sensorIntervalMs < CONFIG_SENSOR_INTERVAL_MIN_MS || c.sensorIntervalMs > CONFIG_SENSOR_INTERVAL_MAX_MS) {
+    return set_error(error, size, "sensor_interval_ms out of range");
+  }
+  if (c.publishIntervalMs < CONFIG_PUBLISH_INTERVAL_MIN_MS || c.publishIntervalMs > CONFIG_PUBLISH_INTERVAL_MAX_MS) {
+    return set_error(error, size, "publish_interval_ms out of range");
+  }
+  if (c.smoothingSize < 1 || c.smoothingSize > SMOOTHING_MAX_SIZE) {
+    return set_error(error, size, "smoothing_size out of range");
+  }
+  if (c.soilSmoothingSize < 1 || c.soilSmoothingSize > SMOOTHING_MAX_SIZE) {
+    return set_error(error, size, "soil_smoothing_size out of range");
+  }
+  if (c.pumpOnBelowPercent > 100) {
+    return set_error(error, size, "pump_on_below out of range");
+  }
+  if (isnan(c.fanOnAboveC) || c.fanOnAboveC < -20.0f || c.fanOnAboveC > 60.0f) {
+    return set_error(error, size, "fan_on_above out of range");
+  }
+
+  if (!adc1_pin_ok(c.pins.light)) return set_error(error, size, "pins.light must be an ADC1 pin");
+  const uint8_t outputs[] = {c.pins.pump, c.pins.fan, c.pins.growLight};
+  for (uint8_t pin : outputs) {
+    if (!output_pin_ok(pin)) return set_error(error, size, "actuator pin is not an output GPIO");
+  }
+  const uint8_t all[] = {c.pins.light, c.pins.pump, c.pins.fan, c.pins.growLight};
+  for (uint8_t i = 0; i < 4; i++) {
+    if (pin_reserved(all[i])) return set_error(error, size, "pin is used by another peripheral");
+    for (uint8_t j = i + 1; j < 4; j++) {
+      if (all[i] == all[j]) return set_error(error, size, "pins must be distinct");
+    }
+  }
+
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    const SoilCalibration& cal = c.soilCalibration[p];
+    if (cal.dryRaw < 0 || cal.dryRaw > CONFIG_SOIL_RAW_MAX || cal.wetRaw < 0 || cal.wetRaw > CONFIG_SOIL_RAW_MAX) {
+      return set_error(error, size, "soil_calibration out of range");
+    }
+    if (abs(cal.dryRaw - cal.wetRaw) < CONFIG_SOIL_CAL_MIN_SPAN) {
+      return set_error(error, size, "soil_calibration dry and wet too close");
+    }
+  }
+  return true;
+}
+
+static bool same_calibration(const DeviceConfig& a, const DeviceConfig& b) {
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    if (a.soilCalibration[p].dryRaw != b.soilCalibration[p].dryRaw ||
+        a.soilCalibration[p].wetRaw != b.soilCalibration[p].wetRaw) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool same_settings(const DeviceConfig& a, const DeviceConfig& b) {
+  return a.sensorIntervalMs == b.sensorIntervalMs && a.publishIntervalMs == b.publishIntervalMs &&
+         a.smoothingSize == b.smoothingSize && a.soilSmoothingSize == b.soilSmoothingSize &&
+         a.pumpOnBelowPercent == b.pumpOnBelowPercent && a.fanOnAboveC == b.fanOnAboveC &&
+         a.pins.light == b.pins.light && a.pins.pump == b.pins.pump && a.pins.fan == b.pins.fan &&
+         a.pins.growLight == b.pins.growLight && same_calibration(a, b);
+}
+
+// ============ Document Parsing ============
+// Present fields must be non-negative integers no larger than max
+static bool read_uint(JsonVariantConst value, uint32_t max, uint32_t& out) {
+  if (value.isNull()) return true;
+  if (!value.is<long>() || value.as<long>() < 0 || (unsigned long)value.as<long>() > max) return false;
+  out = value.as<long>();
+  return true;
+}
+
+template <typename T>
+static bool read_field(JsonVariantConst value, T& out) {
+  uint32_t v = out;
+  if (!read_uint(value, (T)~(T)0, v)) return false;
+  out = (T)v;
+  return true;
+}
+
+static bool known_key(const char* key, const char* const* keys, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (strcmp(key, keys[i]) == 0) return true;
+  }
+  return false;
+}
+
+// Merges a document into next; unknown keys are rejected so typos do not
+// silently leave a setting unchanged
+static bool merge(JsonObjectConst doc, DeviceConfig& next, char* error, size_t size) {
+  static const char* const TOP[] = {"version", "revision", "sensor_interval_ms", "publish_interval_ms",
+                                    "smoothing_size", "soil_smoothing_size", "thresholds", "pins",
+                                    "soil_calibration"};
+  static const char* const THRESHOLDS[] = {"pump_on_below", "fan_on_above"};
+  static const char* const PINS[] = {"light", "pump", "fan", "grow_light"};
+  static const char* const CALIBRATION[] = {"dry", "wet"};
+
+  for (JsonPairConst kv : doc) {
+    if (!known_key(kv.key().c_str(), TOP, sizeof(TOP) / sizeof(TOP[0]))) return set_error(error, size, "unknown key");
+  }
+  if (!read_field(doc["sensor_interval_ms"], next.sensorIntervalMs) ||
+      !read_field(doc["publish_interval_ms"], next.publishIntervalMs) ||
+      !read_field(doc["smoothing_size"], next.smoothingSize) ||
+      !read_field(doc["soil_smoothing_size"], next.soilSmoothingSize)) {
+    return set_error(error, size, "invalid number");
+  }
+
+  JsonVariantConst thresholds = doc["thresholds"];
+  if (!thresholds.isNull()) {
+    if (!thresholds.is<JsonObjectConst>()) return set_error(error, size, "thresholds must be an object");
+    for (JsonPairConst kv : thresholds.as<JsonObjectConst>()) {
+      if (!known_key(kv.key().c_str(), THRESHOLDS, 2)) return set_error(error, size, "unknown threshold");
+    }
+    if (!read_field(thresholds["pump_on_below"], next.pumpOnBelowPercent)) {
+      return set_error(error, size, "invalid number");
+    }
+    JsonVariantConst fan = thresholds["fan_on_above"];
+    if (!fan.isNull()) {
+      if (!fan.is<float>()) return set_error(error, size, "invalid number");
+      next.fanOnAboveC = fan.as<float>();
+    }
+  }
+
+  JsonVariantConst pins = doc["pins"];
+  if (!pins.isNull()) {
+    if (!pins.is<JsonObjectConst>()) return set_error(error, size, "pins must be an object");
+    for (JsonPairConst kv : pins.as<JsonObjectConst>()) {
+      if (!known_key(kv.key().c_str(), PINS, 4)) return set_error(error, size, "unknown pin");
+    }
+    if (!read_field(pins["light"], next.pins.light) || !read_field(pins["pump"], next.pins.pump) ||
+        !read_field(pins["fan"], next.pins.fan) || !read_field(pins["grow_light"], next.pins.growLight)) {
+      return set_error(error, size, "invalid pin");
+    }
+  }
+
+  JsonVariantConst calibration = doc["soil_calibration"];
+  if (!calibration.isNull()) {
+    if (!calibration.is<JsonArrayConst>()) return set_error(error, size, "soil_calibration must be an array");
+    JsonArrayConst entries = calibration.as<JsonArrayConst>();
+    if (entries.size() > (size_t)PLANT_COUNT) {
+      return set_error(error, size, "soil_calibration has more entries than pots");
+    }
+    uint8_t p = 0;
+    for (JsonVariantConst entry : entries) {
+      SoilCalibration& cal = next.soilCalibration[p++];
+      if (entry.isNull()) continue;
+      if (!entry.is<JsonObjectConst>()) return set_error(error, size, "soil_calibration entries must be objects");
+      for (JsonPairConst kv : entry.as<JsonObjectConst>()) {
+        if (!known_key(kv.key().c_str(), CALIBRATION, 2)) return set_error(error, size, "unknown calibration key");
+      }
+      uint32_t dry = cal.dryRaw;
+      uint32_t wet = cal.wetRaw;
+      if (!read_uint(entry["dry"], CONFIG_SOIL_RAW_MAX, dry) || !read_uint(entry["wet"], CONFIG_SOIL_RAW_MAX, wet)) {
+        return set_error(error, size, "soil_calibration out of range");
+      }
+      cal.dryRaw = dry;
+      cal.wetRaw = wet;
+    }
+  }
+  return true;
+}
+
+// ============ Persistence ============
+static void default_calibration(DeviceConfig& c) {
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    c.soilCalibration[p] = {SOIL_DEFAULT_DRY_RAW, SOIL_DEFAULT_WET_RAW};
+  }
+}
+
+// A blob committed before soil calibration existed is the same layout
+// without the trailing calibration; it loads with the default calibration
+static bool load(DeviceConfig& out) {
+  Preferences prefs;
+  if (!prefs.begin(CONFIG_NVS_NAMESPACE, true)) return false;
+  DeviceConfig stored;
+  default_calibration(stored);
+  size_t length = prefs.getBytesLength(CONFIG_NVS_KEY);
+  bool ok = (length == sizeof(stored) || length == offsetof(DeviceConfig, soilCalibration)) &&
+            prefs.getBytes(CONFIG_NVS_KEY, &stored, length) == length;
+  prefs.end();
+  if (!ok || stored.version != CONFIG_SCHEMA_VERSION || !validate(stored, nullptr, 0)) return false;
+  out = stored;
+  return true;
+}
+
+static bool save(const DeviceConfig& c) {
+  Preferences prefs;
+  if (!prefs.begin(CONFIG_NVS_NAMESPACE, false)) return false;
+  bool ok = prefs.putBytes(CONFIG_NVS_KEY, &c, sizeof(c)) == sizeof(c);
+  prefs.end();
+  return ok;
+}
+
+// ============ Runtime Configuration API ============
+DeviceConfig config_defaults() {
+  DeviceConfig c;
+  memset(&c, 0, sizeof(c));
+  c.version = CONFIG_SCHEMA_VERSION;
+  c.revision = 0;
+  c.sensorIntervalMs = DEFAULT_SENSOR_INTERVAL_MS;
+  c.publishIntervalMs = DEFAULT_PUBLISH_INTERVAL_MS;
+  c.smoothingSize = SMOOTHING_SIZE;
+  c.soilSmoothingSize = SOIL_SMOOTHING_SIZE;
+  c.pumpOnBelowPercent = DEFAULT_PUMP_ON_BELOW_PERCENT;
+  c.fanOnAboveC = DEFAULT_FAN_ON_ABOVE_C;
+  c.pins.light = DEFAULT_LIGHT_PIN;
+  c.pins.pump = DEFAULT_PUMP_PIN;
+  c.pins.fan = DEFAULT_FAN_PIN;
+  c.pins.growLight = DEFAULT_GROW_LIGHT_PIN;
+  default_calibration(c);
+  return c;
+}
+
+void config_begin(ConfigApplier apply) {
+  applier = apply;
+  onTrial = false;
+  lastError[0] = '\0';
+
+  // Without runtime configuration a previously stored document is ignored, so
+  // the build's compiled-in defaults are what runs
+  bool stored = PROFILE.runtimeConfig && load(active);
+  if (!stored) active = config_defaults();
+  previous = active;
+  Log::printf("[Config] Revision %lu (%s)\n", (unsigned long)active.revision, stored ? "NVS" : "defaults");
+  if (applier) applier(active, active);
+}
+
+const DeviceConfig& config() {
+  return active;
+}
+
+ConfigResult config_set(const uint8_t* payload, size_t length, unsigned long now, char* error, size_t errorSize) {
+  set_error(error, errorSize, "");
+  if (onTrial) {
+    set_error(error, errorSize, "previous change still on trial");
+    return CONFIG_REJECTED_BUSY;
+  }
+
+  StaticJsonDocument<CONFIG_JSON_CAPACITY> doc;
+  if (deserializeJson(doc, payload, length) || !doc.is<JsonObject>()) {
+    set_error(error, errorSize, "not a JSON object");
+    return CONFIG_REJECTED_PARSE;
+  }
+  JsonObjectConst root = doc.as<JsonObjectConst>();
+
+  if (!root["version"].is<int>() || root["version"].as<int>() != CONFIG_SCHEMA_VERSION) {
+    set_error(error, errorSize, "unsupported version");
+    return CONFIG_REJECTED_VERSION;
+  }
+
+  DeviceConfig next = active;
+  if (!root["revision"].isNull()) {
+    uint32_t revision = 0;
+    if (!read_uint(root["revision"], 0xFFFFFFFFUL, revision)) {
+      set_error(error, errorSize, "invalid revision");
+      return CONFIG_REJECTED_INVALID;
+    }
+    if (revision <= active.revision) {
+      set_error(error, errorSize, "revision is not newer");
+      return CONFIG_REJECTED_STALE;
+    }
+    next.revision = revision;
+  } else {
+    next.revision = active.revision + 1;
+  }
+
+  if (!merge(root, next, error, errorSize) || !validate(next, error, errorSize)) {
+    return CONFIG_REJECTED_INVALID;
+  }
+  if (same_settings(next, active)) {
+    return CONFIG_UNCHANGED;
+  }
+
+  // Apply everything at once; the trial decides whether it sticks
+  previous = active;
+  active = next;
+  if (applier) applier(active, previous);
+
+  unsigned long slowest = max(active.publishIntervalMs, active.sensorIntervalMs);
+  onTrial = true;
+  trialStart = now;
+  trialLength = max(CONFIG_TRIAL_MS, 3 * slowest);
+  trialReads = 0;
+  trialDhtOk = 0;
+  trialPublishes = 0;
+  dhtHealthyBefore = dhtHealthy;
+  Log::printf("[Config] Revision %lu applied, on trial for %lu s\n", (unsigned long)active.revision,
+                trialLength / 1000);
+  return CONFIG_APPLIED;
+}
+
+const char* config_result_name(ConfigResult result) {
+  switch (result) {
+    case CONFIG_APPLIED: return "trial";
+    case CONFIG_UNCHANGED: return "unchanged";
+    case CONFIG_REJECTED_PARSE: return "rejected_parse";
+    case CONFIG_REJECTED_VERSION: return "rejected_version";
+    case CONFIG_REJECTED_STALE: return "rejected_stale";
+    case CONFIG_REJECTED_INVALID: return "rejected_invalid";
+    case CONFIG_REJECTED_BUSY: return "rejected_busy";
+  }
+  return "unknown";
+}
+
+void config_note_sensor_read(bool dhtOk) {
+  dhtHealthy = dhtOk;
+  if (!onTrial) return;
+  if (trialReads < 0xFFFF) trialReads++;
+  if (dhtOk && trialDhtOk < 0xFFFF) trialDhtOk++;
+}
+
+void config_note_publish(bool ok) {
+  if (onTrial && ok && trialPublishes < 0xFFFF) trialPublishes++;
+}
+
+ConfigEvent config_loop(unsigned long now) {
+  if (!onTrial || now - trialStart < trialLength) return CONFIG_EVENT_NONE;
+  onTrial = false;
+
+  // Health checks: the device kept sampling, most DHT22 reads succeed if
+  // they did before, and status publishes still reach the broker
+  const char* failure = nullptr;
+  if (trialReads == 0) {
+    failure = "no sensor reads";
+  } else if (dhtHealthyBefore && trialDhtOk * 2 < trialReads) {
+    failure = "DHT22 reads failing";
+  } else if (trialPublishes == 0) {
+    failure = "no successful publishes";
+  }
+
+  if (failure) {
+    DeviceConfig failed = active;
+    active = previous;
+    if (applier) applier(active, failed);
+    set_error(lastError, sizeof(lastError), failure);
+    Log::printf("[Config] Revision %lu rolled back: %s\n", (unsigned long)failed.revision, failure);
+    return CONFIG_EVENT_ROLLED_BACK;
+  }
+
+  previous = active;
+  if (save(active)) {
+    lastError[0] = '\0';
+  } else {
+    set_error(lastError, sizeof(lastError), "NVS write failed");
+  }
+  Log::printf("[Config] Revision %lu committed\n", (unsigned long)active.revision);
+  return CONFIG_EVENT_COMMITTED;
+}
+
+bool config_on_trial() {
+  return onTrial;
+}
+
+const char* config_last_error() {
+  return lastError;
+}
+
+size_t config_serialize(const char* status, const char* error, char* buffer, size_t size) {
+  StaticJsonDocument<CONFIG_JSON_CAPACITY> doc;
+  doc["status"] = status;
+  if (error && error[0]) {
+    doc["error"] = error;
+  }
+  doc["version"] = active.version;
+  doc["revision"] = active.revision;
+  doc["sensor_interval_ms"] = active.sensorIntervalMs;
+  doc["publish_interval_ms"] = active.publishIntervalMs;
+  doc["smoothing_size"] = active.smoothingSize;
+  doc["soil_smoothing_size"] = active.soilSmoothingSize;
+  JsonObject thresholds = doc.createNestedObject("thresholds");
+  thresholds["pump_on_below"] = active.pumpOnBelowPercent;
+  thresholds["fan_on_above"] = active.fanOnAboveC;
+  JsonObject pins = doc.createNestedObject("pins");
+  pins["light"] = active.pins.light;
+  pins["pump"] = active.pins.pump;
+  pins["fan"] = active.pins.fan;
+  pins["grow_light"] = active.pins.growLight;
+  JsonArray calibration = doc.createNestedArray("soil_calibration");
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    JsonObject entry = calibration.createNestedObject();
+    entry["dry"] = active.soilCalibration[p].dryRaw;
+    entry["wet"] = active.soilCalibration[p].wetRaw;
+  }
+  return serializeJson(doc, buffer, size);
+}
+
+static uint32_t fnv1a(uint32_t hash, const void* data, size_t length) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+// Field by field, so struct padding never enters the hash
+uint32_t config_hash() {
+  uint32_t hash = 2166136261UL;
+  hash = fnv1a(hash, &active.version, sizeof(active.version));
+  hash = fnv1a(hash, &active.sensorIntervalMs, sizeof(active.sensorIntervalMs));
+  hash = fnv1a(hash, &active.publishIntervalMs, sizeof(active.publishIntervalMs));
+  hash = fnv1a(hash, &active.smoothingSize, sizeof(active.smoothingSize));
+  hash = fnv1a(hash, &active.soilSmoothingSize, sizeof(active.soilSmoothingSize));
+  hash = fnv1a(hash, &active.pumpOnBelowPercent, sizeof(active.pumpOnBelowPercent));
+  hash = fnv1a(hash, &active.fanOnAboveC, sizeof(active.fanOnAboveC));
+  hash = fnv1a(hash, &active.pins, sizeof(active.pins));
+  hash = fnv1a(hash, &active.soilCalibration, sizeof(active.soilCalibration));
+  return hash;
+}
@@ -0,0 +1,60 @@
+#include "device_identity.h"
+#include <Preferences.h>
+#include <esp_system.h>
+#include "firmware_profile.h"
+
+static char deviceId[DEVICE_ID_MAX_LEN + 1] = "";
+static bool provisioned = false;
+
+bool device_identity_valid(const char* id) {
+  size_t length = strlen(id);
+  if (length == 0 || length > DEVICE_ID_MAX_LEN) return false;
+  for (size_t i = 0; i < length; i++) {
+    char c = id[i];
+    if (!isalnum((unsigned char)c) && c != '-' && c != '_') return false;
+  }
+  return true;
+}
+
+const char* device_identity_begin() {
+  Preferences prefs;
+  provisioned = false;
+
+  if (prefs.begin(DEVICE_ID_NVS_NAMESPACE, true)) {
+    char stored[DEVICE_ID_MAX_LEN + 1] = "";
+    if (prefs.isKey(DEVICE_ID_NVS_KEY) && prefs.getString(DEVICE_ID_NVS_KEY, stored, sizeof(stored)) > 0 &&
+        device_identity_valid(stored)) {
+      strcpy(deviceId, stored);
+      provisioned = true;
+    }
+    prefs.end();
+  }
+
+  if (!provisioned) {
+    uint8_t mac[6];
+    esp_efuse_mac_get_default(mac);
+    snprintf(deviceId, sizeof(deviceId), "plant-%02x%02x%02x", mac[3], mac[4], mac[5]);
+  }
+
+  Log::printf("[Identity] Device ID: %s (%s)\n", deviceId, provisioned ? "provisioned" : "eFuse MAC");
+  return deviceId;
+}
+
+const char* device_identity() {
+  return deviceId;
+}
+
+bool device_identity_is_provisioned() {
+  return provisioned;
+}
+
+bool device_identity_provision(const char* id) {
+  if (id[0] && !device_identity_valid(id)) return false;
+
+  Preferences prefs;
+  if (!prefs.begin(DEVICE_ID_NVS_NAMESPACE, false)) return false;
+  bool ok = id[0] ? prefs.putString(DEVICE_ID_NVS_KEY, id) > 0
+                  : !prefs.isKey(DEVICE_ID_NVS_KEY) || prefs.remove(DEVICE_ID_NVS_KEY);
+  prefs.end();
+  return ok;
+}
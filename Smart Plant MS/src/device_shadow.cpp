@@ -0,0 +1,159 @@
+#include "device_shadow.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include "device_config.h"
+#include "firmware_profile.h"
+
+// ============ Shadow State ============
+static ShadowApplier applier = nullptr;
+static uint32_t desiredVersion = 0;     // Last desired document applied (0 = none since boot)
+static uint32_t reportedVersion = 0;    // Last reported document published
+static uint32_t leaseEnd = 0;           // Versions up to here are reserved in NVS
+static char configSection[CONFIG_STATE_SIZE];  // "config" section handed to the applier
+
+static ShadowState reported;            // What the last reported document left the backend with
+static uint32_t reportedDesired = 0;
+static bool haveReported = false;
+
+// ============ Version Lease ============
+static bool store_lease(uint32_t end) {
+  Preferences prefs;
+  if (!prefs.begin(SHADOW_NVS_NAMESPACE, false)) return false;
+  bool ok = prefs.putUInt(SHADOW_NVS_KEY, end) == sizeof(end);
+  prefs.end();
+  return ok;
+}
+
+// Versions handed out in this boot all lie above the last stored lease, so
+// they stay newer than anything published before the reboot. The next
+// version is leased before a document carrying it is built.
+static uint32_t lease_next_version() {
+  if (reportedVersion >= leaseEnd) {
+    leaseEnd = reportedVersion + SHADOW_VERSION_LEASE;
+    if (!store_lease(leaseEnd)) Log::println("[Shadow] Could not store the version lease");
+  }
+  return reportedVersion + 1;
+}
+
+void shadow_begin(ShadowApplier apply) {
+  applier = apply;
+  desiredVersion = 0;
+  haveReported = false;
+
+  Preferences prefs;
+  uint32_t stored = 0;
+  if (prefs.begin(SHADOW_NVS_NAMESPACE, true)) {
+    stored = prefs.getUInt(SHADOW_NVS_KEY, 0);
+    prefs.end();
+  }
+  reportedVersion = leaseEnd = stored;
+}
+
+// ============ Desired State ============
+static bool read_switch(JsonVariantConst value, bool& has, bool& on) {
+  has = !value.isNull();
+  if (!has) return true;
+  if (value == "ON") {
+    on = true;
+  } else if (value == "OFF") {
+    on = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+ShadowResult shadow_set_desired(const uint8_t* payload, size_t length) {
+  StaticJsonDocument<256 + CONFIG_JSON_CAPACITY> doc;
+  if (deserializeJson(doc, payload, length) || !doc.is<JsonObject>() || !doc["version"].is<uint32_t>()) {
+    return SHADOW_REJECTED_PARSE;
+  }
+
+  ShadowDesired desired;
+  memset(&desired, 0, sizeof(desired));
+  desired.version = doc["version"];
+  if (desired.version <= desiredVersion) return SHADOW_REJECTED_STALE;
+
+  JsonVariantConst actuators = doc["actuators"];
+  if (!actuators.isNull() &&
+      (!actuators.is<JsonObjectConst>() || !read_switch(actuators["pump"], desired.hasPump, desired.pump) ||
+       !read_switch(actuators["fan"], desired.hasFan, desired.fan) ||
+       !read_switch(actuators["grow_light"], desired.hasGrowLight, desired.growLight))) {
+    return SHADOW_REJECTED_PARSE;
+  }
+
+  // A config revision already in effect is not handed on again, which would
+  // only be rejected as stale after every reboot
+  JsonVariantConst section = doc["config"];
+  if (!section.isNull()) {
+    if (!section.is<JsonObjectConst>()) return SHADOW_REJECTED_PARSE;
+    JsonVariantConst revision = section["revision"];
+    if (revision.isNull() || revision.as<uint32_t>() > config().revision) {
+      desired.configLength = serializeJson(section, configSection, sizeof(configSection));
+      if (desired.configLength == 0 || desired.configLength != measureJson(section)) {
+        return SHADOW_REJECTED_PARSE;
+      }
+      desired.config = configSection;
+    }
+  }
+
+  desiredVersion = desired.version;
+  if (applier) applier(desired);
+  return SHADOW_APPLIED;
+}
+
+const char* shadow_result_name(ShadowResult result) {
+  switch (result) {
+    case SHADOW_APPLIED: return "applied";
+    case SHADOW_REJECTED_PARSE: return "rejected_parse";
+    case SHADOW_REJECTED_STALE: return "rejected_stale";
+    default: return "unknown";
+  }
+}
+
+uint32_t shadow_desired_version() {
+  return desiredVersion;
+}
+
+// ============ Reported State ============
+size_t shadow_report(const ShadowState& state, bool full, char* buffer, size_t size) {
+  full = full || !haveReported;
+  bool pump = full || state.pump != reported.pump;
+  bool fan = full || state.fan != reported.fan;
+  bool growLight = full || state.growLight != reported.growLight;
+  bool revision = full || state.configRevision != reported.configRevision;
+  bool trial = full || state.configTrial != reported.configTrial;
+  if (!pump && !fan && !growLight && !revision && !trial && desiredVersion == reportedDesired) return 0;
+
+  StaticJsonDocument<384> doc;
+  doc["version"] = lease_next_version();
+  doc["desired_version"] = desiredVersion;
+  doc["full"] = full;
+  JsonObject body = doc.createNestedObject("state");
+  if (pump || fan || growLight) {
+    JsonObject actuators = body.createNestedObject("actuators");
+    if (pump) actuators["pump"] = state.pump ? "ON" : "OFF";
+    if (fan) actuators["fan"] = state.fan ? "ON" : "OFF";
+    if (growLight) actuators["grow_light"] = state.growLight ? "ON" : "OFF";
+  }
+  if (revision || trial) {
+    JsonObject section = body.createNestedObject("config");
+    if (revision) section["revision"] = state.configRevision;
+    if (trial) section["trial"] = state.configTrial;
+  }
+
+  size_t length = serializeJson(doc, buffer, size);
+  if (length == 0 || length != measureJson(doc)) return 0;  // Did not fit
+  return length;
+}
+
+void shadow_reported(const ShadowState& state) {
+  reportedVersion++;
+  reported = state;
+  reportedDesired = desiredVersion;
+  haveReported = true;
+}
+
+uint32_t shadow_reported_version() {
+  return reportedVersion;
+}
@@ -0,0 +1,215 @@
+#include "dryness_predictor.h"
+#include <math.h>
+#include "soil_probes.h"
+
+// ============ Model State ============
+#define DRYNESS_FEATURES 3
+
+struct RateModel {
+  float theta[DRYNESS_FEATURES];                  // a, b, c of the rate model
+  float P[DRYNESS_FEATURES][DRYNESS_FEATURES];    // Coefficient covariance (unscaled)
+  float residualVariance;                         // (%/h)^2
+};
+
+struct PlantPredictor {
+  RateModel model;
+  // Current observation interval
+  unsigned long intervalStart;
+  float startMoisture;
+  float temperatureSum;
+  float humiditySum;
+  uint16_t samples;
+  bool started;
+  bool quiet;                     // Not watering since quietSince
+  unsigned long quietSince;
+  // What was last handed to the sink
+  bool published;
+  float publishedEta;
+  float publishedConfidence;
+  DrynessEstimate estimate;
+};
+
+static PlantPredictor predictors[PLANT_COUNT];
+static DrynessSink sink = nullptr;
+
+// Weight of each new squared prediction error in the noise estimate
+static const float noiseWeight = 0.05f;
+
+// ============ Recursive Least Squares ============
+static void features(float temperature, float humidity, float x[DRYNESS_FEATURES]) {
+  x[0] = 1.0f;
+  x[1] = (temperature - 25.0f) / 10.0f;
+  x[2] = (humidity - 55.0f) / 20.0f;
+}
+
+static void model_reset(RateModel& m) {
+  for (int i = 0; i < DRYNESS_FEATURES; i++) {
+    m.theta[i] = 0;
+    for (int j = 0; j < DRYNESS_FEATURES; j++) m.P[i][j] = i == j ? DRYNESS_PRIOR_VARIANCE : 0;
+  }
+  m.theta[0] = DRYNESS_PRIOR_RATE;
+  m.residualVariance = DRYNESS_PRIOR_RATE * DRYNESS_PRIOR_RATE;
+}
+
+static float predict(const RateModel& m, const float x[DRYNESS_FEATURES]) {
+  float y = 0;
+  for (int i = 0; i < DRYNESS_FEATURES; i++) y += m.theta[i] * x[i];
+  return y;
+}
+
+// x' P x: how uncertain the prediction at x is, relative to the noise level
+static float leverage(const RateModel& m, const float x[DRYNESS_FEATURES]) {
+  float sum = 0;
+  for (int i = 0; i < DRYNESS_FEATURES; i++) {
+    for (int j = 0; j < DRYNESS_FEATURES; j++) sum += x[i] * m.P[i][j] * x[j];
+  }
+  return sum;
+}
+
+static void model_update(RateModel& m, const float x[DRYNESS_FEATURES], float y) {
+  float Px[DRYNESS_FEATURES];
+  for (int i = 0; i < DRYNESS_FEATURES; i++) {
+    Px[i] = 0;
+    for (int j = 0; j < DRYNESS_FEATURES; j++) Px[i] += m.P[i][j] * x[j];
+  }
+  float denom = DRYNESS_FORGETTING;
+  for (int i = 0; i < DRYNESS_FEATURES; i++) denom += x[i] * Px[i];
+
+  float error = y - predict(m, x);
+  for (int i = 0; i < DRYNESS_FEATURES; i++) m.theta[i] += Px[i] / denom * error;
+
+  float trace = 0;
+  for (int i = 0; i < DRYNESS_FEATURES; i++) {
+    for (int j = 0; j < DRYNESS_FEATURES; j++) {
+      m.P[i][j] = (m.P[i][j] - Px[i] * Px[j] / denom) / DRYNESS_FORGETTING;
+    }
+    trace += m.P[i][i];
+  }
+  // Forgetting inflates P in directions the data never excites (temperature
+  // and humidity often barely change); cap it at the prior so one unusual
+  // day cannot swing those coefficients wildly
+  float maxTrace = DRYNESS_PRIOR_VARIANCE * DRYNESS_FEATURES;
+  if (trace > maxTrace) {
+    for (int i = 0; i < DRYNESS_FEATURES; i++) {
+      for (int j = 0; j < DRYNESS_FEATURES; j++) m.P[i][j] *= maxTrace / trace;
+    }
+  }
+
+  m.residualVariance += noiseWeight * (error * error - m.residualVariance);
+}
+
+// ============ Estimate ============
+static void update_estimate(PlantPredictor& p, float moisture, float temperature, float humidity,
+                            float criticalMoisture) {
+  float x[DRYNESS_FEATURES];
+  features(temperature, humidity, x);
+  DrynessEstimate& e = p.estimate;
+  e.valid = true;
+  e.moisture = moisture;
+  e.criticalMoisture = criticalMoisture;
+  e.rate = predict(p.model, x);
+
+  float stddev = sqrtf(p.model.residualVariance * leverage(p.model, x));
+  if (moisture <= criticalMoisture) {
+    e.etaHours = 0;
+  } else if (e.rate < DRYNESS_MIN_RATE) {
+    e.etaHours = -1;
+  } else {
+    e.etaHours = (moisture - criticalMoisture) / e.rate;
+  }
+  // Confidence that the rate is really positive and about right: a rate two
+  // standard deviations wide gives 0.5
+  e.confidence = 0;
+  if (e.observations >= DRYNESS_MIN_OBSERVATIONS && e.rate > 0) {
+    e.confidence = e.rate / (e.rate + 2.0f * stddev);
+  }
+  if (moisture <= criticalMoisture) e.confidence = 1.0f;
+}
+
+static bool changed_meaningfully(const PlantPredictor& p) {
+  const DrynessEstimate& e = p.estimate;
+  if (!p.published) return true;
+  if ((e.etaHours < 0) != (p.publishedEta < 0)) return true;
+  if (fabsf(e.confidence - p.publishedConfidence) > DRYNESS_PUBLISH_CONFIDENCE) return true;
+  if (e.etaHours < 0) return false;
+  float tolerance = fmaxf(DRYNESS_PUBLISH_ETA_HOURS, p.publishedEta * DRYNESS_PUBLISH_ETA_FRACTION);
+  return fabsf(e.etaHours - p.publishedEta) > tolerance;
+}
+
+static void start_interval(PlantPredictor& p, float moisture, unsigned long now) {
+  p.started = true;
+  p.intervalStart = now;
+  p.startMoisture = moisture;
+  p.temperatureSum = 0;
+  p.humiditySum = 0;
+  p.samples = 0;
+}
+
+// ============ Public API ============
+void dryness_begin(DrynessSink drynessSink) {
+  sink = drynessSink;
+  for (uint8_t i = 0; i < PLANT_COUNT; i++) {
+    PlantPredictor& p = predictors[i];
+    model_reset(p.model);
+    p.started = false;
+    p.quiet = false;
+    p.published = false;
+    p.estimate = DrynessEstimate();
+    p.estimate.plant = i;
+    p.estimate.etaHours = -1;
+  }
+}
+
+void dryness_observe(uint8_t plant, float moisture, float temperature, float humidity, bool watering,
+                     float criticalMoisture, unsigned long now) {
+  if (plant >= PLANT_COUNT || isnan(temperature) || isnan(humidity)) return;
+  PlantPredictor& p = predictors[plant];
+
+  // Watering voids the current interval. A new one starts once the smoothed
+  // reading has caught up with the soil (also after boot).
+  if (watering) {
+    p.started = false;
+    p.quiet = false;
+    return;
+  }
+  if (!p.quiet) {
+    p.quiet = true;
+    p.quietSince = now;
+  }
+  if (!p.started) {
+    if (now - p.quietSince < DRYNESS_SETTLE_MS) return;
+    start_interval(p, moisture, now);
+  }
+
+  p.temperatureSum += temperature;
+  p.humiditySum += humidity;
+  p.samples++;
+  if (now - p.intervalStart < DRYNESS_INTERVAL_MS) return;
+
+  float hours = (now - p.intervalStart) / 3600000.0f;
+  float rate = (p.startMoisture - moisture) / hours;
+  float meanTemperature = p.temperatureSum / p.samples;
+  float meanHumidity = p.humiditySum / p.samples;
+  start_interval(p, moisture, now);
+
+  // A rise without our own watering (manual watering, rain) says nothing
+  // about the drying rate
+  if (rate >= -DRYNESS_MAX_RISE) {
+    float x[DRYNESS_FEATURES];
+    features(meanTemperature, meanHumidity, x);
+    model_update(p.model, x, rate);
+    if (p.estimate.observations < UINT16_MAX) p.estimate.observations++;
+  }
+
+  update_estimate(p, moisture, temperature, humidity, criticalMoisture);
+  if (changed_meaningfully(p)) {
+    p.published = true;
+    p.publishedEta = p.estimate.etaHours;
+    p.publishedConfidence = p.estimate.confidence;
+    if (sink) sink(p.estimate);
+  }
+}
+
+const DrynessEstimate& dryness_estimate(uint8_t plant) {
+  return predictors[plant < PLANT_COUNT ? plant : 0].estimate;
+}
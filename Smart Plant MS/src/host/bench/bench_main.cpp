@@ -0,0 +1,463 @@
+// ============ Firmware Hot-Path Benchmarks ============
+// Times the code that runs on every loop pass or message - smoothing, change
+// detection, JSON serialization, command parsing and topic dispatch - by
+// linking the unmodified firmware against the host shim. Results are written
+// as JSON lines and can be compared with a stored baseline, flagging only
+// slowdowns larger than both the threshold and the measured run-to-run noise.
+//
+// Build: pio run -e native-bench
+// Run:   .pio/build/native-bench/program --save-baseline bench-baseline.jsonl
+//        (change code)
+//        .pio/build/native-bench/program --baseline bench-baseline.jsonl
+//
+// Exit status is 1 if any benchmark regressed against the baseline.
+
+#include <getopt.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "sample_snapshot.h"
+#include "sensor_filter.h"
+#include "soil_probes.h"
+#include "telemetry.h"
+#include "topics.h"
+#include "../common/plant_model.h"
+
+// Firmware entry points and state (src/main.cpp)
+void setup();
+boolean hasSensorDataChanged(const SensorReading& reading, uint8_t plant);
+void callback(char* topic, byte* payload, unsigned int length);
+extern const char* device_id;
+
+namespace {
+
+// ============ Options ============
+struct Options {
+  int repeat = 15;                // Timed samples per benchmark
+  double minSampleMs = 20;        // Minimum duration of one sample
+  double thresholdPct = 5;        // Smallest slowdown reported as a regression
+  const char* filter = nullptr;   // Substring of benchmark names to run
+  const char* json = nullptr;     // Write results as JSON lines
+  const char* baseline = nullptr;
+  const char* saveBaseline = nullptr;
+  bool normalize = true;          // Scale by the reference benchmark when comparing
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --filter TEXT          run benchmarks whose name contains TEXT\n"
+         "  --repeat N             timed samples per benchmark (15)\n"
+         "  --min-time MS          minimum duration of one sample (20)\n"
+         "  --threshold PCT        smallest slowdown reported as a regression (5)\n"
+         "  --json FILE            write results as JSON lines\n"
+         "  --baseline FILE        compare against a saved baseline\n"
+         "  --save-baseline FILE   save these results as the baseline\n"
+         "  --no-normalize         compare raw times (no machine-speed correction)\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"filter", required_argument, nullptr, 'f'},
+    {"repeat", required_argument, nullptr, 'r'},
+    {"min-time", required_argument, nullptr, 'm'},
+    {"threshold", required_argument, nullptr, 't'},
+    {"json", required_argument, nullptr, 'j'},
+    {"baseline", required_argument, nullptr, 'b'},
+    {"save-baseline", required_argument, nullptr, 's'},
+    {"no-normalize", no_argument, nullptr, 'N'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'f': opt.filter = optarg; break;
+      case 'r': opt.repeat = atoi(optarg); break;
+      case 'm': opt.minSampleMs = atof(optarg); break;
+      case 't': opt.thresholdPct = atof(optarg); break;
+      case 'j': opt.json = optarg; break;
+      case 'b': opt.baseline = optarg; break;
+      case 's': opt.saveBaseline = optarg; break;
+      case 'N': opt.normalize = false; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.repeat < 3 || opt.minSampleMs <= 0 || opt.thresholdPct < 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Measurement ============
+// Keeps a value alive without letting the compiler see what it is used for
+template <typename T>
+inline void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct Result {
+  std::string name;
+  double medianNs = 0;            // Per operation
+  double madNs = 0;               // Median absolute deviation of the samples
+  double minNs = 0;
+  uint64_t iterations = 0;        // Per sample
+};
+
+double median(std::vector<double> v) {
+  std::sort(v.begin(), v.end());
+  size_t n = v.size();
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// Finds an iteration count that makes one sample last at least minSampleMs
+uint64_t calibrate(const std::function<void(uint64_t)>& body, const Options& opt) {
+  uint64_t iterations = 1;
+  for (;;) {
+    uint64_t start = now_ns();
+    body(iterations);
+    double elapsedMs = (now_ns() - start) / 1e6;
+    if (elapsedMs >= opt.minSampleMs || iterations >= (1ULL << 40)) return iterations;
+    double scale = elapsedMs > 0 ? opt.minSampleMs / elapsedMs * 1.2 : 10;
+    iterations = (uint64_t)(iterations * std::min(10.0, std::max(2.0, scale)));
+  }
+}
+
+double sample_ns(const std::function<void(uint64_t)>& body, uint64_t iterations) {
+  uint64_t start = now_ns();
+  body(iterations);
+  return (double)(now_ns() - start) / iterations;
+}
+
+Result summarize(const std::string& name, uint64_t iterations, const std::vector<double>& samples) {
+  Result result;
+  result.name = name;
+  result.iterations = iterations;
+  result.medianNs = median(samples);
+  result.minNs = *std::min_element(samples.begin(), samples.end());
+  std::vector<double> deviations;
+  for (double s : samples) deviations.push_back(fabs(s - result.medianNs));
+  result.madNs = median(deviations);
+  return result;
+}
+
+// ============ Benchmarks ============
+struct Benchmark {
+  const char* name;
+  std::function<void(uint64_t)> body;
+};
+
+// Sensor values that wander like real readings, so change detection and
+// serialization see realistic number widths
+struct Inputs {
+  float temperature[64];
+  float humidity[64];
+  int light[64];
+  int soil[64];
+
+  Inputs() {
+    host::Rng rng(42);
+    for (int i = 0; i < 64; i++) {
+      temperature[i] = 24.0f + 3.0f * rng.symmetric();
+      humidity[i] = 55.0f + 10.0f * rng.symmetric();
+      light[i] = 2000 + (int)(1500 * rng.symmetric());
+      soil[i] = 500 + (int)(300 * rng.symmetric());
+    }
+  }
+};
+
+const char* const REFERENCE = "reference/cpu";
+
+std::vector<Benchmark> benchmarks() {
+  static Inputs in;
+  std::vector<Benchmark> list;
+
+  // ---- Machine speed reference (not firmware code) ----
+  // A fixed dependent integer chain; its time relative to the baseline run
+  // corrects for a machine that is slower or faster overall (VM neighbours,
+  // frequency scaling) when comparing.
+  list.push_back({REFERENCE, [](uint64_t n) {
+    uint32_t x = 2463534242u;
+    for (uint64_t i = 0; i < n; i++) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+    }
+    keep(x);
+  }});
+
+  // ---- Smoothing ----
+  list.push_back({"smooth/getSmoothedFloat", [](uint64_t n) {
+    float buffer[SMOOTHING_SIZE];
+    for (int i = 0; i < SMOOTHING_SIZE; i++) buffer[i] = in.temperature[i];
+    for (uint64_t i = 0; i < n; i++) {
+      buffer[i % SMOOTHING_SIZE] = in.temperature[i & 63];
+      keep(getSmoothedFloat(buffer, SMOOTHING_SIZE));
+    }
+  }});
+  list.push_back({"smooth/getSmoothedInt", [](uint64_t n) {
+    int buffer[SMOOTHING_SIZE];
+    for (int i = 0; i < SMOOTHING_SIZE; i++) buffer[i] = in.light[i];
+    for (uint64_t i = 0; i < n; i++) {
+      buffer[i % SMOOTHING_SIZE] = in.light[i & 63];
+      keep(getSmoothedInt(buffer, SMOOTHING_SIZE));
+    }
+  }});
+  list.push_back({"smooth/EnvironmentFilter", [](uint64_t n) {
+    EnvironmentFilter filter;
+    for (uint64_t i = 0; i < n; i++) {
+      filter.push(in.temperature[i & 63], in.humidity[i & 63], in.light[i & 63]);
+      keep(filter.temperature());
+      keep(filter.humidity());
+      keep(filter.light());
+    }
+  }});
+  list.push_back({"smooth/RollingAverage", [](uint64_t n) {
+    RollingAverage<SOIL_SMOOTHING_SIZE> filter;
+    for (uint64_t i = 0; i < n; i++) keep(filter.push(in.soil[i & 63]));
+  }});
+
+  // ---- Change detection ----
+  list.push_back({"dedup/hasSensorDataChanged/changed", [](uint64_t n) {
+    SensorReading reading = {};
+    for (uint64_t i = 0; i < n; i++) {
+      reading.temperature = in.temperature[i & 63];
+      reading.humidity = in.humidity[i & 63];
+      reading.lightIntensity = in.light[i & 63];
+      keep(hasSensorDataChanged(reading, 0));
+    }
+  }});
+  list.push_back({"dedup/hasSensorDataChanged/unchanged", [](uint64_t n) {
+    SensorReading reading = {};
+    reading.temperature = in.temperature[0];
+    reading.humidity = in.humidity[0];
+    reading.lightIntensity = in.light[0];
+    for (uint64_t i = 0; i < n; i++) keep(hasSensorDataChanged(reading, 0));
+  }});
+
+  // ---- Sample snapshot ----
+  list.push_back({"snapshot/store_reading", [](uint64_t n) {
+    SensorReading reading = {};
+    for (uint64_t i = 0; i < n; i++) {
+      reading.temperature = in.temperature[i & 63];
+      snapshot_store_reading(reading);
+    }
+  }});
+  list.push_back({"snapshot/read", [](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) keep(snapshot_read().sensors.temperature);
+  }});
+
+  // ---- Serialization ----
+  list.push_back({"serialize/aggregated", [](uint64_t n) {
+    char buffer[512];
+    for (uint64_t i = 0; i < n; i++) {
+      SensorSample s = {in.temperature[i & 63], in.humidity[i & 63], in.soil[i & 63], 50, in.light[i & 63]};
+      keep(serialize_aggregated(s, device_id, nullptr, 1000 + i, {1, (uint32_t)i}, buffer, sizeof(buffer)));
+    }
+  }});
+  list.push_back({"serialize/aggregated_plant", [](uint64_t n) {
+    char buffer[384];
+    for (uint64_t i = 0; i < n; i++) {
+      SensorSample s = {in.temperature[i & 63], in.humidity[i & 63], in.soil[i & 63], 50, in.light[i & 63]};
+      keep(serialize_aggregated(s, device_id, "plant-01", 1000 + i, {1, (uint32_t)i}, buffer, sizeof(buffer)));
+    }
+  }});
+  list.push_back({"serialize/legacy_x4", [](uint64_t n) {
+    char buffer[512];
+    for (uint64_t i = 0; i < n; i++) {
+      SensorSample s = {in.temperature[i & 63], in.humidity[i & 63], in.soil[i & 63], 50, in.light[i & 63]};
+      for (int t = TOPIC_SENSORS_TEMPERATURE; t <= TOPIC_SENSORS_LIGHT; t++) {
+        keep(serialize_legacy_reading((TopicId)t, s, 1000 + i, {1, (uint32_t)i}, buffer, sizeof(buffer)));
+      }
+    }
+  }});
+  list.push_back({"serialize/status_all", [](uint64_t n) {
+    char buffer[256];
+    for (uint64_t i = 0; i < n; i++) {
+      keep(serialize_status_all(i & 1, i & 2, i & 4, -55, 1000 + i, {1, (uint32_t)i}, buffer, sizeof(buffer)));
+    }
+  }});
+
+  // ---- Command parsing (full callback: JSON parse, dispatch, actuation) ----
+  list.push_back({"command/pump", [](uint64_t n) {
+    static char topic[TOPIC_MAX_LEN];
+    strcpy(topic, topic_name(TOPIC_CMD_PUMP));
+    char on[] = "{\"action\":\"ON\"}";
+    char off[] = "{\"action\":\"OFF\"}";
+    for (uint64_t i = 0; i < n; i++) {
+      char* payload = i & 1 ? off : on;
+      callback(topic, (byte*)payload, strlen(payload));
+    }
+  }});
+  list.push_back({"command/control_all", [](uint64_t n) {
+    static char topic[TOPIC_MAX_LEN];
+    strcpy(topic, topic_name(TOPIC_CMD_CONTROL_ALL));
+    char on[] = "{\"enable\":true}";
+    char off[] = "{\"enable\":false}";
+    for (uint64_t i = 0; i < n; i++) {
+      char* payload = i & 1 ? off : on;
+      callback(topic, (byte*)payload, strlen(payload));
+    }
+  }});
+  list.push_back({"command/malformed", [](uint64_t n) {
+    static char topic[TOPIC_MAX_LEN];
+    strcpy(topic, topic_name(TOPIC_CMD_FAN));
+    char payload[] = "{\"action\":";
+    for (uint64_t i = 0; i < n; i++) callback(topic, (byte*)payload, strlen(payload));
+  }});
+
+  // ---- Topic dispatch ----
+  list.push_back({"topic/lookup_hit", [](uint64_t n) {
+    const char* topics[TOPIC_COUNT - TOPIC_FIRST_COMMAND];
+    for (int t = TOPIC_FIRST_COMMAND; t < TOPIC_COUNT; t++) topics[t - TOPIC_FIRST_COMMAND] = topic_name((TopicId)t);
+    for (uint64_t i = 0; i < n; i++) keep(topic_lookup(topics[i % (TOPIC_COUNT - TOPIC_FIRST_COMMAND)]));
+  }});
+  list.push_back({"topic/lookup_miss", [](uint64_t n) {
+    const char* sensor = topic_name(TOPIC_SENSORS_AGGREGATED);
+    static char zone[TOPIC_MAX_LEN + 32];
+    snprintf(zone, sizeof(zone), "%szones/zone-01/command", topic_device_prefix());
+    for (uint64_t i = 0; i < n; i++) keep(topic_lookup(i & 1 ? zone : sensor));
+  }});
+  list.push_back({"topic/lookup_foreign", [](uint64_t n) {
+    const char* other = "plant-iot/plant-ffffff/actuators/pump";
+    for (uint64_t i = 0; i < n; i++) keep(topic_lookup(other));
+  }});
+
+  return list;
+}
+
+// ============ Results and Baselines ============
+void write_jsonl(FILE* f, const Result& r) {
+  fprintf(f, "{\"name\":\"%s\",\"median_ns\":%.3f,\"mad_ns\":%.3f,\"min_ns\":%.3f,\"iterations\":%" PRIu64 "}\n",
+          r.name.c_str(), r.medianNs, r.madNs, r.minNs, r.iterations);
+}
+
+bool write_results(const char* path, const std::vector<Result>& results) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  for (const Result& r : results) write_jsonl(f, r);
+  fclose(f);
+  return true;
+}
+
+// Reads the JSON lines written by write_jsonl()
+bool read_baseline(const char* path, std::map<std::string, Result>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    char name[128];
+    Result r;
+    const char* p = strstr(line, "\"name\":\"");
+    if (!p || sscanf(p, "\"name\":\"%127[^\"]\"", name) != 1) continue;
+    const char* median = strstr(line, "\"median_ns\":");
+    const char* mad = strstr(line, "\"mad_ns\":");
+    if (!median || !mad) continue;
+    r.name = name;
+    r.medianNs = atof(median + 12);
+    r.madNs = atof(mad + 9);
+    out[r.name] = r;
+  }
+  fclose(f);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 1;
+
+  std::map<std::string, Result> baseline;
+  if (opt.baseline && !read_baseline(opt.baseline, baseline)) return 1;
+
+  // Bring the firmware up once (topic table, soil channels, identity)
+  host::Board& b = host::board();
+  b.serialEcho = false;
+  setup();
+
+  printf("%-40s %12s %10s %12s", "benchmark", "ns/op", "+/-", "iterations");
+  if (opt.baseline) printf(" %12s %9s", "baseline", "change");
+  printf("\n");
+
+  std::vector<Benchmark> selected;
+  for (const Benchmark& bench : benchmarks()) {
+    if (!opt.filter || strstr(bench.name, opt.filter) || bench.name == REFERENCE) selected.push_back(bench);
+  }
+
+  // Samples are taken in interleaved rounds so that slow drift (frequency
+  // scaling, other load) shows up as noise in every benchmark instead of
+  // biasing whichever one happened to run during it
+  std::vector<uint64_t> iterations;
+  for (const Benchmark& bench : selected) iterations.push_back(calibrate(bench.body, opt));
+  std::vector<std::vector<double>> samples(selected.size());
+  for (int round = 0; round < opt.repeat; round++) {
+    for (size_t i = 0; i < selected.size(); i++) samples[i].push_back(sample_ns(selected[i].body, iterations[i]));
+  }
+
+  std::vector<Result> results;
+  for (size_t i = 0; i < selected.size(); i++) results.push_back(summarize(selected[i].name, iterations[i], samples[i]));
+
+  // Machine speed relative to the baseline run
+  double speed = 1.0;
+  auto baseReference = baseline.find(REFERENCE);
+  if (opt.normalize && baseReference != baseline.end() && baseReference->second.medianNs > 0) {
+    speed = results[0].medianNs / baseReference->second.medianNs;
+  }
+
+  int regressions = 0;
+  for (const Result& r : results) {
+    printf("%-40s %12.2f %10.2f %12" PRIu64, r.name.c_str(), r.medianNs, r.madNs, r.iterations);
+
+    auto base = baseline.find(r.name);
+    if (base != baseline.end() && base->second.medianNs > 0 && r.name != REFERENCE) {
+      // A change only counts if it exceeds the threshold and three times the
+      // relative noise (MAD) of either run
+      const Result& b0 = base->second;
+      double change = (r.medianNs / speed - b0.medianNs) / b0.medianNs * 100;
+      double noise = 3 * 100 * std::max(r.madNs / r.medianNs, b0.madNs / b0.medianNs);
+      double limit = std::max(opt.thresholdPct, noise);
+      const char* verdict = change > limit ? "REGRESSED" : change < -limit ? "improved" : "";
+      if (change > limit) regressions++;
+      printf(" %12.2f %+8.1f%% %s", b0.medianNs, change, verdict);
+    } else if (opt.baseline && base == baseline.end()) {
+      printf(" %12s", "(new)");
+    }
+    printf("\n");
+  }
+
+  if (opt.json && !write_results(opt.json, results)) return 1;
+  if (opt.saveBaseline && !write_results(opt.saveBaseline, results)) return 1;
+
+  if (opt.baseline) {
+    printf("\n%d regression%s against %s (threshold %.1f%%, noise-adjusted, machine speed x%.2f)\n",
+           regressions, regressions == 1 ? "" : "s", opt.baseline, opt.thresholdPct, 1 / speed);
+  }
+  return regressions ? 1 : 0;
+}
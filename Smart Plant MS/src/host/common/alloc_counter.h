@@ -0,0 +1,112 @@
+#ifndef HOST_ALLOC_COUNTER_H
+#define HOST_ALLOC_COUNTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+// ============ Allocation Counter ============
+// Replaces the whole global operator new/delete family (plain, array,
+// nothrow, sized and aligned) with malloc/free versions that count the
+// allocations a thread makes while it has counting switched on. Host tools
+// use it to show that a firmware hot path never touches the heap:
+//
+//   {
+//     host::CountAllocations scope;   // this thread, until the scope ends
+//     http_loop(now);
+//   }
+//   ... host::allocations() ...
+//
+// Other threads (clients, brokers, the measuring itself) allocate freely.
+// The replacements are definitions, not inline functions, so include this
+// header in exactly one source file of a program.
+//
+// counted_alloc() stays out of line: when GCC can see the malloc() behind
+// operator new it flags the free() in operator delete as mismatched.
+
+namespace host {
+
+inline thread_local bool countingAllocations = false;
+inline std::atomic<uint64_t> allocationCount{0};
+
+inline uint64_t allocations() {
+  return allocationCount.load();
+}
+
+class CountAllocations {
+ public:
+  CountAllocations() : previous_(countingAllocations) { countingAllocations = true; }
+  ~CountAllocations() { countingAllocations = previous_; }
+  CountAllocations(const CountAllocations&) = delete;
+  CountAllocations& operator=(const CountAllocations&) = delete;
+
+ private:
+  bool previous_;
+};
+
+__attribute__((noinline)) inline void* counted_alloc(size_t size, size_t alignment) {
+  if (countingAllocations) allocationCount++;
+  if (size == 0) size = 1;
+  if (alignment <= alignof(max_align_t)) return malloc(size);
+  void* p = nullptr;
+  return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+}
+
+}  // namespace host
+
+void* operator new(size_t size) {
+  void* p = host::counted_alloc(size, 0);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  void* p = host::counted_alloc(size, 0);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return host::counted_alloc(size, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return host::counted_alloc(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  void* p = host::counted_alloc(size, (size_t)alignment);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  void* p = host::counted_alloc(size, (size_t)alignment);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return host::counted_alloc(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return host::counted_alloc(size, (size_t)alignment);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { free(p); }
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef HOST_PLANT_MODEL_H
+#define HOST_PLANT_MODEL_H
+
+#include <math.h>
+#include <stdint.h>
+
+// ============ Simulated Plant Environment ============
+// Deterministic physics-lite model of one pot used by the host-side tools in
+// place of the DHT22, soil probe and LDR. Time is passed in explicitly (ms)
+// so the model runs equally well against a wall clock or a virtual clock.
+
+namespace host {
+
+// xorshift32: cheap, seedable, identical on every platform
+struct Rng {
+  uint32_t state;
+
+  explicit Rng(uint32_t seed = 1) : state(seed ? seed : 1) {}
+
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // Uniform in [-1, 1)
+  float symmetric() { return (next() >> 8) * (2.0f / 16777216.0f) - 1.0f; }
+};
+
+struct PlantModel {
+  // Parameters
+  float baseTemperature = 24.0f;     // Daily mean (°C)
+  float temperatureSwing = 5.0f;     // Day/night amplitude (°C)
+  float baseHumidity = 55.0f;        // %
+  float dryingPerHour = 1.5f;        // Moisture % lost per hour at 25 °C
+  float wateringPerSecond = 0.5f;    // Moisture % gained per second of pumping
+  float fanCooling = 4.0f;           // Air temperature drop with the fan running (°C)
+  float fanTimeConstantMs = 600000;  // How quickly the fan's effect builds / decays
+  float growLightRaw = 1500.0f;      // LDR reading added by the grow light
+  float sensorNoise = 0.3f;          // Relative noise on ADC readings (%)
+  uint32_t dayLengthMs = 86400000UL;
+  uint32_t phaseMs = 0;              // Offset so a fleet is not in lockstep
+
+  // State
+  float moisturePercent = 70.0f;
+  bool pumpOn = false;
+  bool fanOn = false;
+  bool growLightOn = false;
+  float coolingOffset = 0.0f;        // Current fan cooling (°C)
+  Rng rng;
+
+  explicit PlantModel(uint32_t seed = 1) : rng(seed) {}
+
+  // Fraction of the day in [0, 1), 0 = midnight
+  float day_fraction(uint64_t nowMs) const {
+    return (float)((nowMs + phaseMs) % dayLengthMs) / dayLengthMs;
+  }
+
+  float temperature(uint64_t nowMs) const {
+    // Coldest around 05:00, warmest around 15:00
+    return baseTemperature + temperatureSwing * sinf(2.0f * (float)M_PI * (day_fraction(nowMs) - 0.375f));
+  }
+
+  // Ambient temperature minus the fan's current cooling
+  float air_temperature(uint64_t nowMs) const { return temperature(nowMs) - coolingOffset; }
+
+  float humidity(uint64_t nowMs) const {
+    return baseHumidity - 1.5f * (air_temperature(nowMs) - baseTemperature);
+  }
+
+  // 0..1 daylight, zero between 18:00 and 06:00
+  float daylight(uint64_t nowMs) const {
+    float s = sinf(2.0f * (float)M_PI * (day_fraction(nowMs) - 0.25f));
+    return s > 0 ? s : 0;
+  }
+
+  // Advance soil moisture by dtMs of evaporation / watering, and the fan's
+  // cooling towards its target
+  void step(uint64_t nowMs, uint32_t dtMs) {
+    float target = fanOn ? fanCooling : 0.0f;
+    float k = dtMs / (fanTimeConstantMs + dtMs);
+    coolingOffset += (target - coolingOffset) * k;
+
+    float hours = dtMs / 3600000.0f;
+    float rate = dryingPerHour * (1.0f + 0.04f * (air_temperature(nowMs) - 25.0f)) * (0.5f + daylight(nowMs));
+    moisturePercent -= rate * hours;
+    if (pumpOn) moisturePercent += wateringPerSecond * dtMs / 1000.0f;
+    if (moisturePercent < 0) moisturePercent = 0;
+    if (moisturePercent > 100) moisturePercent = 100;
+  }
+
+  // ============ Sensor Readings (what the firmware would see) ============
+  float read_temperature(uint64_t nowMs) { return air_temperature(nowMs) + 0.1f * rng.symmetric(); }
+  float read_humidity(uint64_t nowMs) { return humidity(nowMs) + 0.5f * rng.symmetric(); }
+
+  // Inverse of the default soil calibration (1023 = 0 %, 0 = 100 %)
+  int read_soil_raw() {
+    float raw = 1023.0f * (1.0f - moisturePercent / 100.0f);
+    raw *= 1.0f + sensorNoise / 100.0f * rng.symmetric();
+    return raw < 0 ? 0 : raw > 4095 ? 4095 : (int)raw;
+  }
+
+  int read_light_raw(uint64_t nowMs) {
+    float raw = (4095.0f * daylight(nowMs) + (growLightOn ? growLightRaw : 0.0f)) *
+                (1.0f + sensorNoise / 100.0f * rng.symmetric());
+    return raw < 0 ? 0 : raw > 4095 ? 4095 : (int)raw;
+  }
+};
+
+}  // namespace host
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef HOST_SEQUENCE_TRACKER_H
+#define HOST_SEQUENCE_TRACKER_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+#include "sequence_stamp.h"
+
+// ============ Telemetry Loss Accounting ============
+// Consumer side of stream_sequence.h: feed it the "boot"/"seq" of every
+// telemetry message received and it classifies the message and keeps loss
+// counters per device. A stream is whatever the caller uses as its key
+// (normally the topic); the device key is the device_id or topic prefix.
+//
+// Per stream it remembers the boot, the highest seq and a 64-message window
+// below it, so reordering within 64 messages is told apart from loss:
+//
+//   First      first message seen on the stream
+//   InOrder    seq == highest + 1
+//   Gap        seq > highest + 1; the skipped numbers are counted as lost
+//   Late       a skipped number arriving after all; un-counts one loss
+//   Duplicate  already seen (broker redelivery at QoS 1)
+//   Stale      older than the window, or from an earlier boot; not counted
+//   Reboot     a newer boot; seq restarts and numbers before it in the new
+//              boot are counted as lost
+//
+// Messages lost at the very end of a boot cannot be seen (nothing follows
+// them in that boot), so the loss rate is a lower bound across reboots.
+// Suppressed duplicates on the device (dedup) take no numbers and are never
+// counted as loss.
+
+namespace host {
+
+enum class SequenceVerdict : uint8_t { First, InOrder, Gap, Late, Duplicate, Stale, Reboot };
+
+inline const char* sequence_verdict_name(SequenceVerdict verdict) {
+  switch (verdict) {
+    case SequenceVerdict::First: return "first";
+    case SequenceVerdict::InOrder: return "in_order";
+    case SequenceVerdict::Gap: return "gap";
+    case SequenceVerdict::Late: return "late";
+    case SequenceVerdict::Duplicate: return "duplicate";
+    case SequenceVerdict::Stale: return "stale";
+    case SequenceVerdict::Reboot: return "reboot";
+    default: return "unknown";
+  }
+}
+
+struct LossCounters {
+  uint64_t received = 0;          // Distinct messages
+  uint64_t lost = 0;              // Numbers skipped and not (yet) arrived late
+  uint64_t late = 0;
+  uint64_t duplicates = 0;
+  uint64_t stale = 0;
+  uint32_t reboots = 0;           // Boot counter increases seen (not counted for boot 0)
+  uint32_t boot = 0;              // Latest boot seen
+
+  // Fraction of the messages sent (received + lost) that never arrived
+  double loss_rate() const {
+    uint64_t sent = received + lost;
+    return sent ? (double)lost / sent : 0;
+  }
+};
+
+class SequenceTracker {
+ public:
+  static const uint32_t WINDOW = 64;
+
+  SequenceVerdict observe(const std::string& device, const std::string& stream, const SequenceStamp& stamp) {
+    Device& dev = devices_[device];
+    Stream& s = dev.streams[stream];
+    LossCounters& c = dev.counters;
+
+    // Boot 0 means the device has no boot counter: a restart shows only as
+    // seq going back to 1
+    bool restarted = stamp.boot == 0 && s.seen && stamp.seq == 1 && s.highest > 1;
+    if (!s.seen || stamp.boot > s.boot || restarted) {
+      bool reboot = s.seen || (dev.seen && stamp.boot > c.boot);
+      if (dev.seen && stamp.boot > c.boot) c.reboots++;
+      if (!dev.seen || stamp.boot > c.boot) c.boot = stamp.boot;
+      dev.seen = true;
+      s.seen = true;
+      s.boot = stamp.boot;
+      s.highest = stamp.seq;
+      s.window = 1;
+      c.received++;
+      // Only a stream seen before the reboot knows that the numbers before
+      // this one were sent in the new boot
+      if (reboot && stamp.seq > 1) c.lost += stamp.seq - 1;
+      return reboot ? SequenceVerdict::Reboot : SequenceVerdict::First;
+    }
+    if (stamp.boot < s.boot) {
+      c.stale++;
+      return SequenceVerdict::Stale;
+    }
+
+    if (stamp.seq > s.highest) {
+      uint32_t shift = stamp.seq - s.highest;
+      s.window = shift >= WINDOW ? 1 : (s.window << shift) | 1;
+      s.highest = stamp.seq;
+      c.received++;
+      if (shift == 1) return SequenceVerdict::InOrder;
+      c.lost += shift - 1;
+      return SequenceVerdict::Gap;
+    }
+
+    uint32_t age = s.highest - stamp.seq;
+    if (age >= WINDOW) {
+      c.stale++;
+      return SequenceVerdict::Stale;
+    }
+    uint64_t bit = 1ULL << age;
+    if (s.window & bit) {
+      c.duplicates++;
+      return SequenceVerdict::Duplicate;
+    }
+    s.window |= bit;
+    c.received++;
+    c.late++;
+    if (c.lost) c.lost--;
+    return SequenceVerdict::Late;
+  }
+
+  const LossCounters* counters(const std::string& device) const {
+    auto it = devices_.find(device);
+    return it == devices_.end() ? nullptr : &it->second.counters;
+  }
+
+  // Calls fn(device, counters) for every device, in key order
+  template <typename Fn>
+  void for_each(Fn fn) const {
+    for (const auto& d : devices_) fn(d.first, d.second.counters);
+  }
+
+  LossCounters total() const {
+    LossCounters sum;
+    for (const auto& d : devices_) {
+      sum.received += d.second.counters.received;
+      sum.lost += d.second.counters.lost;
+      sum.late += d.second.counters.late;
+      sum.duplicates += d.second.counters.duplicates;
+      sum.stale += d.second.counters.stale;
+      sum.reboots += d.second.counters.reboots;
+    }
+    return sum;
+  }
+
+  size_t device_count() const { return devices_.size(); }
+
+  void reset() { devices_.clear(); }
+
+ private:
+  struct Stream {
+    bool seen = false;
+    uint32_t boot = 0;
+    uint32_t highest = 0;
+    uint64_t window = 0;          // Bit n: highest - n has arrived
+  };
+
+  struct Device {
+    bool seen = false;
+    LossCounters counters;
+    std::map<std::string, Stream> streams;
+  };
+
+  std::map<std::string, Device> devices_;
+};
+
+}  // namespace host
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef HOST_SOIL_INPUTS_H
+#define HOST_SOIL_INPUTS_H
+
+#include "host_board.h"
+#include "soil_probes.h"
+
+// ============ Soil Probe Wiring (host side) ============
+// Maps an analogRead() to the pot the firmware is sampling, following the
+// same configuration as soil_probes.cpp: multiplexer select lines when
+// SOIL_MUX_ENABLED, otherwise one SOIL_PROBE_PINS entry per plant.
+
+namespace host {
+
+// Returns the plant index, or -1 if the pin is not a soil probe input
+inline int soil_channel_for_pin(uint8_t pin) {
+  const Board& b = board();
+  if (SOIL_MUX_ENABLED) {
+    if (pin != SOIL_MUX_SIG_PIN) return -1;
+    int channel = b.pinLevels[SOIL_MUX_S0_PIN] | b.pinLevels[SOIL_MUX_S1_PIN] << 1 |
+                  b.pinLevels[SOIL_MUX_S2_PIN] << 2 | b.pinLevels[SOIL_MUX_S3_PIN] << 3;
+    return channel < PLANT_COUNT ? channel : -1;
+  }
+  static const uint8_t pins[] = SOIL_PROBE_PINS;
+  for (int p = 0; p < PLANT_COUNT && p < (int)sizeof(pins); p++) {
+    if (pins[p] == pin) return p;
+  }
+  return -1;
+}
+
+}  // namespace host
+
+#endif
@@ -0,0 +1,481 @@
+// ============ End-to-End Latency Harness ============
+// Runs the unmodified firmware (src/*.cpp) in real time against a real
+// Mosquitto broker and the Python backend services, steps the soil probe
+// between dry and wet, and timestamps every hop of the resulting control
+// loop:
+//
+//   step     soil probe changes (harness)
+//   sample   firmware reads the probe (analogRead)
+//   publish  firmware publishes the aggregated reading that crosses the
+//            actuator-control threshold (< 30 % / > 70 %)
+//   broker   an observer connection receives that reading
+//   service  the observer sees actuator-control's pump command
+//   command  the firmware's MQTT callback receives it
+//   actuate  the firmware drives PUMP_PIN
+//
+// All timestamps come from one monotonic clock, so no clock sync is needed.
+// Jitter between trials (seeded) keeps the step from phase-locking to the
+// firmware's 2 s sensor interval.
+//
+// Build: pio run -e native-e2e
+// Run:   src/host/e2e/run.sh --trials 20      (starts the compose services)
+//        .pio/build/native-e2e/program --host 127.0.0.1 --trials 20
+
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ArduinoJson.h>
+
+#include "Arduino.h"
+#include "PubSubClient.h"
+#include "host_board.h"
+#include "mqtt_codec.h"
+#include "topics.h"
+#include "../common/soil_inputs.h"
+
+// Firmware entry points and state (src/main.cpp)
+void setup();
+void loop();
+extern PubSubClient client;
+
+namespace {
+
+const uint8_t PUMP_PIN = 5;
+
+// Probe readings on either side of the actuator-control thresholds with the
+// default calibration (1023 = 0 %, 0 = 100 %)
+const uint16_t SOIL_DRY_RAW = 900;    // ~12 %
+const uint16_t SOIL_WET_RAW = 100;    // ~90 %
+const int PUMP_ON_BELOW = 30;
+const int PUMP_OFF_ABOVE = 70;
+
+// ============ Options ============
+struct Options {
+  const char* host = "127.0.0.1";
+  uint16_t port = 1883;
+  int trials = 20;                // Each trial measures one ON and one OFF path
+  uint32_t seed = 1;
+  uint32_t jitterMs = 2000;       // Random wait before each step
+  uint32_t timeoutS = 30;         // Give up on a path after this long
+  bool json = false;
+  bool verbose = false;           // Echo firmware Serial output
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --host HOST            MQTT broker (127.0.0.1)\n"
+         "  --port N               broker port (1883)\n"
+         "  --trials N             ON/OFF cycles to measure (20)\n"
+         "  --seed N               jitter seed (1)\n"
+         "  --jitter-ms MS         maximum random wait before each step (2000)\n"
+         "  --timeout S            per-path timeout in seconds (30)\n"
+         "  --json                 print the summary as JSON\n"
+         "  --verbose              echo the firmware's Serial output\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"host", required_argument, nullptr, 'h'},
+    {"port", required_argument, nullptr, 'p'},
+    {"trials", required_argument, nullptr, 'n'},
+    {"seed", required_argument, nullptr, 's'},
+    {"jitter-ms", required_argument, nullptr, 'j'},
+    {"timeout", required_argument, nullptr, 't'},
+    {"json", no_argument, nullptr, 'J'},
+    {"verbose", no_argument, nullptr, 'v'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'h': opt.host = optarg; break;
+      case 'p': opt.port = (uint16_t)atoi(optarg); break;
+      case 'n': opt.trials = atoi(optarg); break;
+      case 's': opt.seed = strtoul(optarg, nullptr, 10); break;
+      case 'j': opt.jitterMs = strtoul(optarg, nullptr, 10); break;
+      case 't': opt.timeoutS = strtoul(optarg, nullptr, 10); break;
+      case 'J': opt.json = true; break;
+      case 'v': opt.verbose = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.trials <= 0 || opt.timeoutS == 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Trial Timeline ============
+enum Hop { STEP, SAMPLE, PUBLISH, BROKER, SERVICE, COMMAND, ACTUATE, HOP_COUNT };
+
+const char* HOP_NAMES[HOP_COUNT] = {"step", "sample", "publish", "broker", "service", "command", "actuate"};
+
+// Marks are written by the firmware hooks (main thread) and the observer
+// thread; each is set once, on the first matching event after the step.
+struct Trial {
+  std::mutex lock;
+  bool pumpOn = false;            // Direction being measured
+  bool armed = false;
+  uint64_t marks[HOP_COUNT] = {0};
+
+  void arm(bool on) {
+    std::lock_guard<std::mutex> guard(lock);
+    pumpOn = on;
+    for (int h = 0; h < HOP_COUNT; h++) marks[h] = 0;
+    marks[STEP] = host::monotonic_us();
+    armed = true;
+  }
+
+  void mark(Hop hop) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (armed && marks[hop] == 0) marks[hop] = host::monotonic_us();
+  }
+
+  bool direction() {
+    std::lock_guard<std::mutex> guard(lock);
+    return pumpOn;
+  }
+
+  bool done() {
+    std::lock_guard<std::mutex> guard(lock);
+    return marks[ACTUATE] != 0;
+  }
+};
+
+Trial trial;
+
+// Does an aggregated payload cross the threshold for the current direction?
+bool crosses_threshold(const uint8_t* payload, size_t length, bool pumpOn) {
+  StaticJsonDocument<384> doc;
+  if (deserializeJson(doc, payload, length)) return false;
+  if (!doc.containsKey("soil_moisture_percent")) return false;
+  int percent = doc["soil_moisture_percent"];
+  return pumpOn ? percent < PUMP_ON_BELOW : percent > PUMP_OFF_ABOVE;
+}
+
+bool is_pump_command(const uint8_t* payload, size_t length, bool pumpOn) {
+  StaticJsonDocument<128> doc;
+  if (deserializeJson(doc, payload, length)) return false;
+  const char* action = doc["action"] | "";
+  return strcmp(action, pumpOn ? "ON" : "OFF") == 0;
+}
+
+// ============ Observer ============
+// A second MQTT client, standing in for a network tap between the broker and
+// the services: it sees readings leave the broker and commands enter it.
+class Observer {
+ public:
+  bool start(const char* host, uint16_t port, const std::string& readings, const std::string& commands) {
+    readings_ = readings;
+    commands_ = commands;
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host, service.c_str(), &hints, &addresses) != 0) return false;
+    for (struct addrinfo* a = addresses; a && fd_ < 0; a = a->ai_next) {
+      fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (fd_ >= 0 && connect(fd_, a->ai_addr, a->ai_addrlen) != 0) {
+        close(fd_);
+        fd_ = -1;
+      }
+    }
+    freeaddrinfo(addresses);
+    if (fd_ < 0) return false;
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    uint8_t packet[256];
+    mqtt::ConnectOptions options = {};
+    options.clientId = "e2e-observer";
+    options.keepAliveSeconds = 60;
+    options.cleanSession = true;
+    if (!send_all(packet, mqtt::encode_connect(packet, sizeof(packet), options))) return false;
+    if (!send_all(packet, mqtt::encode_subscribe(packet, sizeof(packet), 1, readings_.c_str()))) return false;
+    if (!send_all(packet, mqtt::encode_subscribe(packet, sizeof(packet), 2, commands_.c_str()))) return false;
+
+    // Wait for CONNACK and both SUBACKs so no event is missed
+    int acks = 0;
+    uint64_t deadline = host::monotonic_us() + 5000000;
+    while (acks < 3 && host::monotonic_us() < deadline) {
+      if (!read(100, [&](const mqtt::Packet& p) {
+            if ((p.type == mqtt::CONNACK && mqtt::connack_code(p) == 0) || p.type == mqtt::SUBACK) acks++;
+          })) {
+        return false;
+      }
+    }
+    if (acks < 3) return false;
+
+    thread_ = std::thread([this]() { run(); });
+    return true;
+  }
+
+  void stop() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+  }
+
+ private:
+  void run() {
+    uint64_t lastPing = host::monotonic_us();
+    while (running_) {
+      bool ok = read(100, [this](const mqtt::Packet& p) {
+        mqtt::PublishView view;
+        if (!mqtt::parse_publish(p, view)) return;
+        std::string topic(view.topic, view.topicLength);
+        bool pumpOn = trial.direction();
+        if (topic == readings_ && crosses_threshold(view.payload, view.payloadLength, pumpOn)) {
+          trial.mark(BROKER);
+        } else if (topic == commands_ && is_pump_command(view.payload, view.payloadLength, pumpOn)) {
+          trial.mark(SERVICE);
+        }
+        if (view.qos == 1) {
+          uint8_t ack[4];
+          send_all(ack, mqtt::encode_ack(ack, sizeof(ack), mqtt::PUBACK, view.packetId));
+        }
+      });
+      if (!ok) {
+        fprintf(stderr, "Observer: broker connection lost\n");
+        return;
+      }
+      if (host::monotonic_us() - lastPing > 30000000) {
+        uint8_t ping[2];
+        send_all(ping, mqtt::encode_empty(ping, sizeof(ping), mqtt::PINGREQ));
+        lastPing = host::monotonic_us();
+      }
+    }
+  }
+
+  template <typename Handler>
+  bool read(int timeoutMs, Handler handler) {
+    struct pollfd p = {fd_, POLLIN, 0};
+    if (poll(&p, 1, timeoutMs) <= 0) return true;
+    uint8_t chunk[4096];
+    ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    rx_.insert(rx_.end(), chunk, chunk + n);
+
+    size_t pos = 0;
+    mqtt::Packet packet;
+    long size;
+    while ((size = mqtt::decode_packet(rx_.data() + pos, rx_.size() - pos, packet)) > 0) {
+      pos += size;
+      handler(packet);
+    }
+    if (size < 0) return false;
+    rx_.erase(rx_.begin(), rx_.begin() + pos);
+    return true;
+  }
+
+  bool send_all(const uint8_t* data, size_t length) {
+    size_t sent = 0;
+    while (length > 0 && sent < length) {
+      ssize_t n = send(fd_, data + sent, length - sent, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      sent += n;
+    }
+    return length > 0;
+  }
+
+  int fd_ = -1;
+  std::atomic<bool> running_{true};
+  std::thread thread_;
+  std::string readings_;
+  std::string commands_;
+  std::vector<uint8_t> rx_;
+};
+
+// ============ Statistics ============
+struct Series {
+  std::vector<double> ms;
+
+  double percentile(double p) const {
+    if (ms.empty()) return 0;
+    std::vector<double> sorted(ms);
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > sorted.size()) rank = sorted.size();
+    return sorted[rank - 1];
+  }
+};
+
+// Hop h is measured from the previous mark; TOTAL is step -> actuate
+struct PathStats {
+  Series hops[HOP_COUNT];
+  int completed = 0;
+  int timedOut = 0;
+};
+
+void record(PathStats& stats, const uint64_t* marks) {
+  for (int h = SAMPLE; h < HOP_COUNT; h++) {
+    if (marks[h] && marks[h - 1]) stats.hops[h].ms.push_back((marks[h] - marks[h - 1]) / 1000.0);
+  }
+  stats.hops[STEP].ms.push_back((marks[ACTUATE] - marks[STEP]) / 1000.0);   // STEP slot holds the total
+  stats.completed++;
+}
+
+void print_path(const char* name, const PathStats& stats) {
+  printf("\n%s path (%d completed, %d timed out)\n", name, stats.completed, stats.timedOut);
+  printf("  %-20s %9s %9s %9s %9s\n", "hop (ms)", "p50", "p90", "p99", "max");
+  for (int h = SAMPLE; h <= HOP_COUNT; h++) {
+    const Series& s = stats.hops[h == HOP_COUNT ? STEP : h];
+    std::string label = h == HOP_COUNT ? std::string("total") : std::string(HOP_NAMES[h - 1]) + " -> " + HOP_NAMES[h];
+    printf("  %-20s %9.1f %9.1f %9.1f %9.1f\n", label.c_str(), s.percentile(50), s.percentile(90),
+           s.percentile(99), s.percentile(100));
+  }
+}
+
+void print_path_json(const char* name, const PathStats& stats, bool last) {
+  printf("  \"%s\": {\"completed\": %d, \"timed_out\": %d", name, stats.completed, stats.timedOut);
+  for (int h = SAMPLE; h <= HOP_COUNT; h++) {
+    const Series& s = stats.hops[h == HOP_COUNT ? STEP : h];
+    std::string label = h == HOP_COUNT ? std::string("total") : std::string(HOP_NAMES[h - 1]) + "_" + HOP_NAMES[h];
+    printf(", \"%s\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}", label.c_str(),
+           s.percentile(50), s.percentile(90), s.percentile(99), s.percentile(100));
+  }
+  printf("}%s\n", last ? "" : ",");
+}
+
+// Runs the firmware loop until the pump reaches the requested state
+bool run_until_pump(bool on, uint64_t timeoutUs) {
+  uint64_t deadline = host::monotonic_us() + timeoutUs;
+  while (host::monotonic_us() < deadline) {
+    loop();
+    if ((host::board().pinLevels[PUMP_PIN] != 0) == on && trial.done()) return true;
+  }
+  return false;
+}
+
+void run_for(uint64_t us) {
+  uint64_t deadline = host::monotonic_us() + us;
+  while (host::monotonic_us() < deadline) loop();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 1;
+
+  uint16_t soilRaw = SOIL_WET_RAW;
+
+  host::reset_board();
+  host::Board& b = host::board();
+  b.serialEcho = opt.verbose;
+  b.mqttHost = opt.host;
+  b.mqttPort = opt.port;
+  b.dhtTemperature = []() { return 24.0f; };    // Between the fan thresholds
+  b.dhtHumidity = []() { return 55.0f; };
+  b.analogSource = [&](uint8_t pin) -> uint16_t {
+    if (host::soil_channel_for_pin(pin) < 0) return 2048;   // LDR: 50 %, grow light stays put
+    trial.mark(SAMPLE);
+    return soilRaw;
+  };
+
+  std::string readings;
+  std::string commands;
+  b.onMqttPublish = [&](const char* topic, const uint8_t* payload, size_t length) {
+    if (readings == topic && crosses_threshold(payload, length, trial.direction())) trial.mark(PUBLISH);
+  };
+  b.onMqttMessage = [&](const char* topic, const uint8_t* payload, size_t length) {
+    if (commands == topic && is_pump_command(payload, length, trial.direction())) trial.mark(COMMAND);
+  };
+  b.onDigitalWrite = [&](uint8_t pin, uint8_t level) {
+    if (pin == PUMP_PIN && (level != 0) == trial.direction()) trial.mark(ACTUATE);
+  };
+
+  // Boot in virtual time (setup() has multi-second delays), then switch the
+  // clock over to real time; the first loop() connects to the broker
+  setup();
+  host::use_real_time();
+  loop();
+  if (!client.connected()) {
+    fprintf(stderr, "Cannot connect to MQTT broker %s:%u\n", opt.host, opt.port);
+    return 1;
+  }
+  readings = topic_name(TOPIC_SENSORS_AGGREGATED);
+  commands = topic_name(TOPIC_CMD_PUMP);
+
+  Observer observer;
+  if (!observer.start(opt.host, opt.port, readings, commands)) {
+    fprintf(stderr, "Observer cannot subscribe on %s:%u\n", opt.host, opt.port);
+    return 1;
+  }
+
+  // Settle into the wet state so every trial starts with the pump off
+  trial.arm(false);
+  run_for(5000000);
+  if (b.pinLevels[PUMP_PIN]) run_until_pump(false, (uint64_t)opt.timeoutS * 1000000);
+
+  PathStats on;
+  PathStats off;
+  uint32_t rng = opt.seed ? opt.seed : 1;
+  uint64_t timeoutUs = (uint64_t)opt.timeoutS * 1000000;
+  uint64_t started = host::monotonic_us();
+
+  for (int t = 0; t < opt.trials; t++) {
+    for (int phase = 0; phase < 2; phase++) {
+      bool pumpOn = phase == 0;
+      PathStats& stats = pumpOn ? on : off;
+
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      run_for((uint64_t)(opt.jitterMs ? rng % opt.jitterMs : 0) * 1000);
+
+      trial.arm(pumpOn);
+      soilRaw = pumpOn ? SOIL_DRY_RAW : SOIL_WET_RAW;
+      if (run_until_pump(pumpOn, timeoutUs)) {
+        uint64_t marks[HOP_COUNT];
+        {
+          std::lock_guard<std::mutex> guard(trial.lock);
+          std::copy(trial.marks, trial.marks + HOP_COUNT, marks);
+        }
+        record(stats, marks);
+      } else {
+        stats.timedOut++;
+        if (!opt.json) printf("Trial %d: pump %s timed out\n", t + 1, pumpOn ? "ON" : "OFF");
+      }
+    }
+  }
+  observer.stop();
+
+  if (opt.json) {
+    printf("{\n  \"broker\": \"%s:%u\",\n  \"trials\": %d,\n", opt.host, opt.port, opt.trials);
+    print_path_json("on", on, false);
+    print_path_json("off", off, true);
+    printf("}\n");
+  } else {
+    printf("\n============ End-to-End Latency Summary ============\n");
+    printf("Broker:             %s:%u\n", opt.host, opt.port);
+    printf("Trials:             %d\n", opt.trials);
+    printf("Wall time:          %.1f s\n", (host::monotonic_us() - started) / 1e6);
+    print_path("Pump ON", on);
+    print_path("Pump OFF", off);
+  }
+  return on.timedOut + off.timedOut > 0 ? 2 : 0;
+}
@@ -0,0 +1,22 @@
+#!/bin/bash
+# End-to-end latency run: brings up Mosquitto and the backend services with
+# docker-compose, builds the harness and measures the sensor-to-pump loop.
+# Extra arguments are passed to the harness (e.g. --trials 50 --json).
+set -e
+
+FIRMWARE_DIR="$(cd "$(dirname "$0")/../../.." && pwd)"
+REPO_DIR="$(cd "$FIRMWARE_DIR/.." && pwd)"
+
+cd "$REPO_DIR"
+docker-compose up -d --build mosquitto sensor-service actuator-service
+
+# Wait for the broker to accept connections
+for i in $(seq 1 30); do
+  if (exec 3<>/dev/tcp/127.0.0.1/1883) 2>/dev/null; then break; fi
+  sleep 1
+done
+sleep 2   # Let the services subscribe
+
+cd "$FIRMWARE_DIR"
+pio run -e native-e2e
+.pio/build/native-e2e/program --host 127.0.0.1 --port 1883 "$@"
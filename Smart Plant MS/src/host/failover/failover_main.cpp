@@ -0,0 +1,531 @@
+// ============ Broker Failover Checks ============
+// Runs the firmware's failover path (src/broker_failover.cpp,
+// src/offline_backlog.cpp and Mqtt5Client over the WiFiClient shim) inside
+// the connection handling of main.cpp's loop(), against two in-process
+// stand-in brokers, a primary and a standby, that can be killed, hung and
+// restarted on their ports:
+//
+//   failover   primary killed: outage until the device is connected to the
+//              standby, against the bound in broker_failover.h
+//   hung       primary accepts TCP but never answers CONNECT; same bound
+//              plus one BROKER_CONNECT_TIMEOUT_S
+//   return     primary back and stable: one return after the hold, and the
+//              retained offline message left on the standby
+//   flapping   primary up for less than the hold, down, up again...: the
+//              device stays on the standby
+//   backlog    telemetry produced during every outage above reaches one of
+//              the brokers, each seq exactly once and in order
+//
+// The timing constants are shortened in [env:native-failover] so a run
+// takes seconds instead of minutes; outages scale with them.
+//
+// Build: pio run -e native-failover
+// Run:   .pio/build/native-failover/program
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "broker_failover.h"
+#include "offline_backlog.h"
+#include "mqtt5_client.h"
+#include "mqtt_codec.h"
+
+namespace {
+
+const char* DEVICE_ID = "failover-check";
+const char* TELEMETRY_TOPIC = "plant-iot/failover-check/sensors/aggregated";
+const char* ONLINE_TOPIC = "plant-iot/failover-check/online";
+const char* BIRTH_PAYLOAD = "{\"state\":\"online\",\"device_id\":\"failover-check\",\"boot\":1}";
+const char* OFFLINE_PAYLOAD = "{\"state\":\"offline\",\"device_id\":\"failover-check\",\"boot\":1}";
+
+// ============ Options ============
+struct Options {
+  int runs = 5;                   // Primary kills (and returns) measured
+  unsigned long publishMs = 250;  // Telemetry interval of the emulated device
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --runs N               primary kills, each followed by a return (5)\n"
+         "  --publish-ms N         telemetry interval of the emulated device (250)\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"runs", required_argument, nullptr, 'r'},
+    {"publish-ms", required_argument, nullptr, 'p'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'r': opt.runs = atoi(optarg); break;
+      case 'p': opt.publishMs = strtoul(optarg, nullptr, 10); break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.runs <= 0 || opt.publishMs == 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Results ============
+int failures = 0;
+
+void check(bool ok, const char* name, const std::string& detail = "") {
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+  if (!ok) failures++;
+}
+
+bool send_all(int fd, const uint8_t* data, size_t length) {
+  size_t sent = 0;
+  while (sent < length) {
+    ssize_t n = send(fd, data + sent, length - sent, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+// ============ Stand-in Broker ============
+// The MQTT 3.1.1 subset the device uses: CONNECT (5.0 is refused with
+// CONNACK 0x01, so Mqtt5Client falls back), PUBLISH (recorded), PINGREQ and
+// DISCONNECT. kill() drops every connection without a word, like a crashed
+// broker, after taking in what the device had already sent. start() again
+// brings it back on the same port. A HUNG broker accepts connections and
+// never answers.
+struct Received {
+  std::string clientId;
+  std::string topic;
+  std::string payload;
+  bool retain;
+};
+
+class Broker {
+ public:
+  enum Mode { UP, HUNG };
+
+  ~Broker() { kill(); }
+
+  bool start(Mode mode = UP) {
+    mode_ = mode;
+    listen_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port_);
+    socklen_t length = sizeof(address);
+    if (bind(listen_, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_, 8) != 0) {
+      close(listen_);
+      return false;
+    }
+    getsockname(listen_, (struct sockaddr*)&address, &length);
+    port_ = ntohs(address.sin_port);
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+    return true;
+  }
+
+  void kill() {
+    if (!thread_.joinable()) return;
+    running_ = false;
+    thread_.join();
+  }
+
+  uint16_t port() const { return port_; }
+
+  std::vector<Received> received() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return received_;
+  }
+
+  int probeConnects() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return probeConnects_;
+  }
+
+ private:
+  struct Connection {
+    int fd;
+    std::vector<uint8_t> rx;
+    std::string clientId;
+  };
+
+  void run() {
+    std::vector<Connection> connections;
+    while (running_) {
+      std::vector<struct pollfd> fds = {{listen_, POLLIN, 0}};
+      for (const Connection& c : connections) fds.push_back({c.fd, POLLIN, 0});
+      poll(fds.data(), fds.size(), 10);
+      if (fds[0].revents & POLLIN) {
+        int fd = accept(listen_, nullptr, nullptr);
+        if (fd >= 0) connections.push_back({fd, {}, {}});
+      }
+      for (size_t i = 0; i < connections.size();) {
+        if (serve(connections[i])) {
+          i++;
+        } else {
+          close(connections[i].fd);
+          connections.erase(connections.begin() + i);
+        }
+      }
+    }
+    for (Connection& c : connections) {
+      serve(c);
+      close(c.fd);
+    }
+    close(listen_);
+  }
+
+  // Reads what has arrived and handles every complete packet; false closes
+  bool serve(Connection& c) {
+    uint8_t chunk[1024];
+    bool open = true;
+    for (;;) {
+      ssize_t n = recv(c.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+      if (n > 0) {
+        c.rx.insert(c.rx.end(), chunk, chunk + n);
+        continue;
+      }
+      open = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+      break;
+    }
+    if (mode_ == HUNG) {
+      c.rx.clear();
+      return open;
+    }
+    for (;;) {
+      mqtt::Packet packet;
+      long size = mqtt::decode_packet(c.rx.data(), c.rx.size(), packet);
+      if (size < 0) return false;
+      if (size == 0) return open;
+      bool keep = handle(c, packet);
+      c.rx.erase(c.rx.begin(), c.rx.begin() + size);
+      if (!keep) return false;
+    }
+  }
+
+  bool handle(Connection& c, const mqtt::Packet& packet) {
+    switch (packet.type) {
+      case mqtt::CONNECT: {
+        // "MQTT", level at body[6], client ID length at body[10]
+        if (packet.length < 12 || packet.body[6] != mqtt::PROTOCOL_V311) {
+          const uint8_t refused[] = {0x20, 0x02, 0x00, 0x01};
+          send_all(c.fd, refused, sizeof(refused));
+          return false;
+        }
+        size_t idLength = std::min<size_t>((packet.body[10] << 8) | packet.body[11], packet.length - 12);
+        c.clientId.assign((const char*)packet.body + 12, idLength);
+        if (c.clientId != DEVICE_ID) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          probeConnects_++;
+        }
+        const uint8_t accepted[] = {0x20, 0x02, 0x00, 0x00};
+        return send_all(c.fd, accepted, sizeof(accepted));
+      }
+      case mqtt::PUBLISH: {
+        mqtt::PublishView view;
+        if (!mqtt::parse_publish(packet, view)) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        received_.push_back({c.clientId, std::string(view.topic, view.topicLength),
+                             std::string((const char*)view.payload, view.payloadLength), view.retain});
+        return true;
+      }
+      case mqtt::PINGREQ: {
+        const uint8_t pong[] = {0xD0, 0x00};
+        return send_all(c.fd, pong, sizeof(pong));
+      }
+      case mqtt::DISCONNECT:
+        return false;
+      default:
+        return true;
+    }
+  }
+
+  Mode mode_ = UP;
+  int listen_ = -1;
+  uint16_t port_ = 0;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+  std::mutex mutex_;
+  std::vector<Received> received_;
+  int probeConnects_ = 0;
+};
+
+// ============ Device ============
+// main.cpp's loop() reduced to the connection handling: the failover
+// module, reconnect_mqtt() with its three attempts, the offline backlog and
+// one telemetry stream with a seq per message
+WiFiClient socket;
+Mqtt5Client client(socket);
+BrokerEndpoint brokers[2];
+uint32_t nextSeq = 1;
+unsigned long lastPublish = 0;
+bool publishing = true;
+
+bool publish_telemetry(const char* topic, const char* payload) {
+  if (!client.connected() || !backlog_empty() || !client.publish(topic, payload)) {
+    return backlog_push(topic, payload);
+  }
+  return true;
+}
+
+bool publish_backlogged(const char* topic, const char* payload) {
+  return client.publish(topic, payload);
+}
+
+void reconnect_mqtt() {
+  int attempts = 0;
+  while (!client.connected() && attempts < 3) {
+    const BrokerEndpoint& broker = failover_target(millis());
+    client.setServer(broker.host, broker.port);
+    if (client.connect(DEVICE_ID, ONLINE_TOPIC, 1, true, OFFLINE_PAYLOAD)) {
+      failover_connected(millis());
+      client.publish(ONLINE_TOPIC, BIRTH_PAYLOAD, true);
+    } else {
+      failover_connect_failed(millis());
+      delay(BROKER_RETRY_MS);
+    }
+    attempts++;
+  }
+}
+
+void device_loop(const Options& opt) {
+  if (failover_loop(millis(), client.connected())) {
+    client.publish(ONLINE_TOPIC, OFFLINE_PAYLOAD, true);
+    client.disconnect();
+  }
+  if (!client.connected()) reconnect_mqtt();
+  client.loop();
+  if (client.connected()) backlog_replay(publish_backlogged, BACKLOG_REPLAY_PER_LOOP);
+
+  if (publishing && millis() - lastPublish >= opt.publishMs) {
+    char payload[64];
+    snprintf(payload, sizeof(payload), "{\"boot\":1,\"seq\":%u}", (unsigned)nextSeq++);
+    publish_telemetry(TELEMETRY_TOPIC, payload);
+    lastPublish = millis();
+  }
+  delay(5);
+}
+
+// Runs the device until done() holds; false after timeoutMs
+template <typename Done>
+bool run_until(const Options& opt, unsigned long timeoutMs, Done done) {
+  unsigned long start = millis();
+  while (millis() - start < timeoutMs) {
+    device_loop(opt);
+    if (done()) return true;
+  }
+  return false;
+}
+
+void run_for(const Options& opt, unsigned long ms) {
+  run_until(opt, ms, []() { return false; });
+}
+
+bool connected_to(uint8_t broker) {
+  return client.connected() && failover_stats().active == broker;
+}
+
+// ============ Measurements ============
+struct Series {
+  std::vector<double> ms;
+  int missed = 0;
+};
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+void report(const char* name, const Series& s, double boundMs) {
+  printf("%-26s %5zu %9.0f %9.0f ", name, s.ms.size(), percentile(s.ms, 0.5),
+         s.ms.empty() ? 0.0 : *std::max_element(s.ms.begin(), s.ms.end()));
+  if (boundMs > 0) {
+    printf("%9.0f\n", boundMs);
+  } else {
+    printf("%9s\n", "-");
+  }
+}
+
+// Primary goes away (killed, or replaced by a hung one); the outage is the
+// device's own measurement, from noticing the loss to connected again
+void measure_failover(const Options& opt, Broker& primary, bool hung, Series& series) {
+  uint32_t failovers = failover_stats().failovers;
+  primary.kill();
+  if (hung) primary.start(Broker::HUNG);
+  bool ok = run_until(opt, 30000, [&]() { return connected_to(1) && failover_stats().failovers > failovers; });
+  if (ok) {
+    series.ms.push_back(failover_stats().lastOutageMs);
+  } else {
+    series.missed++;
+  }
+}
+
+// Primary back for good: the device returns once the hold and dwell are over
+void measure_return(const Options& opt, Broker& primary, Series& series) {
+  uint32_t returns = failover_stats().returns;
+  primary.kill();
+  primary.start();
+  bool ok = run_until(opt, BROKER_MIN_DWELL_MS + BROKER_RETURN_HOLD_MS + 30000,
+                      [&]() { return connected_to(0) && failover_stats().returns > returns; });
+  if (ok) {
+    series.ms.push_back(failover_stats().lastReturnMs);
+  } else {
+    series.missed++;
+  }
+}
+
+// Every telemetry seq from 1 to last, exactly once across both brokers, and
+// in increasing order on each
+std::string check_sequence(Broker& primary, Broker& standby, uint32_t last) {
+  std::vector<int> seen(last + 1, 0);
+  int outOfOrder = 0;
+  for (Broker* broker : {&primary, &standby}) {
+    uint32_t previous = 0;
+    for (const Received& r : broker->received()) {
+      if (r.clientId != DEVICE_ID || r.topic != TELEMETRY_TOPIC) continue;
+      unsigned seq = 0;
+      if (sscanf(r.payload.c_str(), "{\"boot\":1,\"seq\":%u}", &seq) != 1 || seq == 0 || seq > last) continue;
+      seen[seq]++;
+      if (seq <= previous) outOfOrder++;
+      previous = seq;
+    }
+  }
+  int missing = 0;
+  int duplicated = 0;
+  for (uint32_t s = 1; s <= last; s++) {
+    if (seen[s] == 0) missing++;
+    if (seen[s] > 1) duplicated++;
+  }
+  if (missing == 0 && duplicated == 0 && outOfOrder == 0) return "";
+  return std::to_string(missing) + " missing, " + std::to_string(duplicated) + " duplicated, " +
+         std::to_string(outOfOrder) + " out of order";
+}
+
+int offline_marks(Broker& broker) {
+  int marks = 0;
+  for (const Received& r : broker.received()) {
+    if (r.clientId == DEVICE_ID && r.topic == ONLINE_TOPIC && r.retain && r.payload == OFFLINE_PAYLOAD) marks++;
+  }
+  return marks;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+  host::use_real_time();
+  host::board().serialEcho = false;
+
+  Broker primary;
+  Broker standby;
+  if (!primary.start() || !standby.start()) {
+    check(false, "stand-in brokers", "cannot listen");
+    return 1;
+  }
+  brokers[0] = {"127.0.0.1", primary.port()};
+  brokers[1] = {"127.0.0.1", standby.port()};
+  failover_begin(brokers, 2, DEVICE_ID, true);
+  client.setSocketTimeout(BROKER_CONNECT_TIMEOUT_S);
+
+  if (!run_until(opt, 10000, []() { return connected_to(0); })) {
+    check(false, "connect to primary");
+    return 1;
+  }
+  // Settle on the primary and let the standby collect its probe streak
+  run_for(opt, BROKER_PROBE_INTERVAL_MS * (BROKER_RETURN_PROBES + 1));
+
+  Series killed;
+  Series hung;
+  Series returned;
+  for (int i = 0; i < opt.runs; i++) {
+    measure_failover(opt, primary, false, killed);
+    measure_return(opt, primary, returned);
+  }
+  measure_failover(opt, primary, true, hung);
+  measure_return(opt, primary, returned);
+
+  // Flapping: kill the primary, then let it come back repeatedly for less
+  // than the hold, for longer than dwell and hold together
+  measure_failover(opt, primary, false, killed);
+  uint32_t returnsBefore = failover_stats().returns;
+  unsigned long flapUntil = millis() + BROKER_MIN_DWELL_MS + 2 * BROKER_RETURN_HOLD_MS;
+  int flaps = 0;
+  while (millis() < flapUntil) {
+    primary.start();
+    run_for(opt, BROKER_RETURN_HOLD_MS / 2);
+    primary.kill();
+    run_for(opt, 3 * BROKER_PROBE_INTERVAL_MS);
+    flaps++;
+  }
+  bool stayed = connected_to(1) && failover_stats().returns == returnsBefore;
+  measure_return(opt, primary, returned);
+
+  // Let the backlog drain before counting
+  publishing = false;
+  run_until(opt, 5000, []() { return backlog_empty() && client.connected(); });
+  run_for(opt, 200);
+  uint32_t last = nextSeq - 1;
+
+  const FailoverStats& stats = failover_stats();
+  const BacklogStats& backlog = backlog_stats();
+  double killedBound = BROKER_FAILOVER_AFTER_MS + BROKER_RETRY_MS + BROKER_PROBE_TIMEOUT_MS + 100;
+  double hungBound = killedBound + BROKER_CONNECT_TIMEOUT_S * 1000.0;
+
+  printf("\nFailover after %lu ms, retry every %lu ms, CONNACK wait %d s, probe every %lu ms (%lu ms timeout)\n",
+         (unsigned long)BROKER_FAILOVER_AFTER_MS, (unsigned long)BROKER_RETRY_MS, BROKER_CONNECT_TIMEOUT_S,
+         (unsigned long)BROKER_PROBE_INTERVAL_MS, (unsigned long)BROKER_PROBE_TIMEOUT_MS);
+  printf("Return after %d probes and %lu ms healthy, %lu ms minimum on the standby\n", BROKER_RETURN_PROBES,
+         (unsigned long)BROKER_RETURN_HOLD_MS, (unsigned long)BROKER_MIN_DWELL_MS);
+  printf("%-26s %5s %9s %9s %9s\n", "outage", "runs", "p50 ms", "max ms", "bound ms");
+  report("failover (primary killed)", killed, killedBound);
+  report("failover (primary hung)", hung, hungBound);
+  report("return to primary", returned, 0);
+  printf("Failovers %u, returns %u, probes %u (%u failed), backlog %u queued / %u replayed / %u dropped, %u seq\n\n",
+         (unsigned)stats.failovers, (unsigned)stats.returns, (unsigned)stats.probes, (unsigned)stats.probeFailures,
+         (unsigned)backlog.queued, (unsigned)backlog.replayed, (unsigned)backlog.dropped, (unsigned)last);
+
+  check(killed.missed == 0 && !killed.ms.empty(), "failover to standby", std::to_string(killed.missed) + " missed");
+  check(!killed.ms.empty() && *std::max_element(killed.ms.begin(), killed.ms.end()) <= killedBound,
+        "failover within bound (primary killed)");
+  check(hung.missed == 0 && !hung.ms.empty() && hung.ms[0] <= hungBound, "failover within bound (primary hung)");
+  check(returned.missed == 0 && stats.returns == (uint32_t)opt.runs + 2, "return to primary",
+        std::to_string(stats.returns) + " returns, " + std::to_string(returned.missed) + " missed");
+  check(offline_marks(standby) == (int)stats.returns, "offline marked on the standby when leaving",
+        std::to_string(offline_marks(standby)) + " of " + std::to_string(stats.returns));
+  check(stayed, "flapping primary ignored", std::to_string(flaps) + " flaps");
+  check(primary.probeConnects() > 0 && standby.probeConnects() > 0, "probes use their own client ID");
+  check(backlog.replayed > 0 && backlog.dropped == 0 && backlog_empty(), "backlog replayed",
+        std::to_string(backlog.replayed) + " replayed, " + std::to_string(backlog.dropped) + " dropped");
+  std::string sequence = check_sequence(primary, standby, last);
+  check(sequence.empty(), "every seq exactly once, in order", sequence);
+
+  printf("%s\n", failures ? "FAILED" : "All checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+// ============ Actuator Forest Parity and Timing ============
+// Checks the compiled-in actuator forests (include/actuator_forest_model.h,
+// generated by machine-learning/export_firmware_model.py) against the
+// Python model's predictions on the same inputs, then times one decision.
+//
+// The parity CSV comes from the exporter: synthetic readings from
+// data_handler.py on the firmware's fixed-point grid, with the predicted
+// state and mean P(on) of each actuator's forest. A decision may only differ
+// where P(on) is within the leaf quantization of one half; any other
+// difference is a parity failure.
+//
+// Build: pio run -e native-forest
+// Run:   python machine-learning/export_firmware_model.py --parity parity.csv
+//        .pio/build/native-forest/program parity.csv
+//
+// Exit status is 1 on a parity failure.
+
+#include <getopt.h>
+#include <time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "actuator_forest.h"
+
+namespace {
+
+// ============ Options ============
+struct Options {
+  const char* parity = nullptr;
+  double minTimeMs = 200;         // Minimum duration of the timing run
+  bool json = false;              // One JSON object instead of the summary
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s PARITY.csv [options]\n"
+         "  --min-time MS          minimum duration of the timing run (200)\n"
+         "  --json                 print the result as one JSON object\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"min-time", required_argument, nullptr, 'm'},
+    {"json", no_argument, nullptr, 'j'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'm': opt.minTimeMs = atof(optarg); break;
+      case 'j': opt.json = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (optind != argc - 1 || opt.minTimeMs <= 0) {
+    usage(argv[0]);
+    return false;
+  }
+  opt.parity = argv[optind];
+  return true;
+}
+
+// ============ Parity Samples ============
+struct Sample {
+  float features[FOREST_FEATURE_COUNT];
+  bool expected[MODEL_ACTUATOR_COUNT];
+  double probability[MODEL_ACTUATOR_COUNT];   // Python mean P(on)
+};
+
+// Columns: temperature,humidity,soil_moisture,light_intensity, then
+// <actuator>,<actuator>_p for fan, pump and light
+bool read_parity(const char* path, std::vector<Sample>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  char line[512];
+  bool header = true;
+  while (fgets(line, sizeof(line), f)) {
+    if (header) {
+      header = false;
+      continue;
+    }
+    Sample s;
+    double v[FOREST_FEATURE_COUNT + 2 * MODEL_ACTUATOR_COUNT];
+    int n = 0;
+    char* p = line;
+    while (n < (int)(sizeof(v) / sizeof(v[0]))) {
+      char* end;
+      v[n] = strtod(p, &end);
+      if (end == p) break;
+      n++;
+      p = *end == ',' ? end + 1 : end;
+    }
+    if (n != (int)(sizeof(v) / sizeof(v[0]))) continue;
+    for (int i = 0; i < FOREST_FEATURE_COUNT; i++) s.features[i] = (float)v[i];
+    for (int a = 0; a < MODEL_ACTUATOR_COUNT; a++) {
+      s.expected[a] = v[FOREST_FEATURE_COUNT + 2 * a] > 0.5;
+      s.probability[a] = v[FOREST_FEATURE_COUNT + 2 * a + 1];
+    }
+    out.push_back(s);
+  }
+  fclose(f);
+  return true;
+}
+
+ForestInputs inputs_of(const Sample& s) {
+  return forest_quantize(s.features[FOREST_TEMPERATURE], s.features[FOREST_HUMIDITY],
+                         s.features[FOREST_SOIL_MOISTURE], s.features[FOREST_LIGHT_INTENSITY]);
+}
+
+// ============ Measurement ============
+template <typename T>
+inline void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Mean time of one decision for the actuator over the samples
+double time_decision(ModelActuator actuator, const std::vector<ForestInputs>& inputs, double minTimeMs) {
+  uint64_t decisions = 0;
+  uint64_t start = now_ns();
+  uint64_t elapsed = 0;
+  do {
+    for (const ForestInputs& in : inputs) keep(actuator_model_predict(actuator, in));
+    decisions += inputs.size();
+    elapsed = now_ns() - start;
+  } while (elapsed < minTimeMs * 1e6);
+  return (double)elapsed / decisions;
+}
+
+struct ActuatorReport {
+  long mismatches = 0;            // Outside the quantization band: parity failures
+  long ties = 0;                  // Differ only within the band around one half
+  double maxProbabilityError = 0;
+  double ns = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+
+  if (!actuator_model_available()) {
+    fprintf(stderr, "Built without an actuator model (FEATURE_ACTUATOR_MODEL=0)\n");
+    return 2;
+  }
+
+  std::vector<Sample> samples;
+  if (!read_parity(opt.parity, samples)) return 2;
+  if (samples.empty()) {
+    fprintf(stderr, "%s: no samples\n", opt.parity);
+    return 2;
+  }
+
+  std::vector<ForestInputs> inputs;
+  for (const Sample& s : samples) inputs.push_back(inputs_of(s));
+
+  // The firmware's mean P(on) differs from the Python one by at most half a
+  // leaf step per tree, so decisions may only flip this close to one half
+  const double band = 1.0 / FOREST_LEAF_SCALE;
+
+  ActuatorReport reports[MODEL_ACTUATOR_COUNT];
+  long failures = 0;
+  for (uint8_t a = 0; a < MODEL_ACTUATOR_COUNT; a++) {
+    const ActuatorForest& forest = actuator_model_forest((ModelActuator)a);
+    ActuatorReport& r = reports[a];
+    for (size_t i = 0; i < samples.size(); i++) {
+      double probability = (double)forest_vote(forest, inputs[i]) / ((double)forest.treeCount * FOREST_LEAF_SCALE);
+      double error = fabs(probability - samples[i].probability[a]);
+      if (error > r.maxProbabilityError) r.maxProbabilityError = error;
+
+      bool on = actuator_model_predict((ModelActuator)a, inputs[i]).on;
+      if (on != samples[i].expected[a]) {
+        if (fabs(samples[i].probability[a] - 0.5) <= band) {
+          r.ties++;
+        } else {
+          r.mismatches++;
+          if (r.mismatches <= 5) {
+            const Sample& s = samples[i];
+            fprintf(stderr, "%s mismatch at %.2f,%.2f,%.2f,%.2f: python %d (p %.6f), firmware %d (p %.6f)\n",
+                    model_actuator_name((ModelActuator)a), s.features[0], s.features[1], s.features[2],
+                    s.features[3], s.expected[a], s.probability[a], on, probability);
+          }
+        }
+      }
+    }
+    failures += r.mismatches;
+    r.ns = time_decision((ModelActuator)a, inputs, opt.minTimeMs);
+  }
+
+  double totalNs = 0;
+  for (const ActuatorReport& r : reports) totalNs += r.ns;
+
+  if (opt.json) {
+    printf("{\"model\":\"%s\",\"samples\":%zu,\"flash_bytes\":%zu,\"stack_bytes\":%zu,\"heap_bytes\":0,",
+           actuator_model_version(), samples.size(), actuator_model_bytes(), sizeof(ForestInputs));
+    for (uint8_t a = 0; a < MODEL_ACTUATOR_COUNT; a++) {
+      const ActuatorForest& forest = actuator_model_forest((ModelActuator)a);
+      const ActuatorReport& r = reports[a];
+      printf("\"%s\":{\"trees\":%u,\"nodes\":%u,\"mismatches\":%ld,\"ties\":%ld,\"max_p_error\":%.3g,"
+             "\"ns_per_decision\":%.1f},",
+             model_actuator_name((ModelActuator)a), forest.treeCount, forest.nodeCount, r.mismatches, r.ties,
+             r.maxProbabilityError, r.ns);
+    }
+    printf("\"ns_per_sample\":%.1f,\"parity\":%s}\n", totalNs, failures ? "false" : "true");
+    return failures ? 1 : 0;
+  }
+
+  printf("============ Actuator Forest ============\n");
+  printf("Model:              %s, %zu parity samples\n", actuator_model_version(), samples.size());
+  printf("Memory:             %zu bytes of flash tables, %zu bytes of stack, no heap\n", actuator_model_bytes(),
+         sizeof(ForestInputs));
+  printf("%-8s %6s %8s %11s %6s %12s %14s\n", "actuator", "trees", "nodes", "mismatches", "ties", "max |dp|",
+         "ns/decision");
+  for (uint8_t a = 0; a < MODEL_ACTUATOR_COUNT; a++) {
+    const ActuatorForest& forest = actuator_model_forest((ModelActuator)a);
+    const ActuatorReport& r = reports[a];
+    printf("%-8s %6u %8u %11ld %6ld %12.3g %14.1f\n", model_actuator_name((ModelActuator)a), forest.treeCount,
+           forest.nodeCount, r.mismatches, r.ties, r.maxProbabilityError, r.ns);
+  }
+  printf("All three actuators: %.1f ns per sample\n", totalNs);
+  printf("Parity:             %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
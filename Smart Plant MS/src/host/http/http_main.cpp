@@ -0,0 +1,485 @@
+// ============ LAN HTTP Server Checks ============
+// Runs the firmware's HTTP server (src/http_server.cpp over the WiFiServer
+// shim) on a device thread that, like loop(), calls http_loop() every pass
+// and records a sample every --sample-ms, then points real TCP clients at it:
+//
+//   self-test  /latest, /history (?since), /events with Last-Event-ID
+//              resume, 404/405, and the 503s of the client and stream caps
+//   load       1..--max-clients concurrent clients, a quarter of them
+//              event streams and the rest polling /latest and /history,
+//              for --step-ms each
+//
+// Per load step it reports the device's http_loop() pass time (what the
+// server takes away from telemetry), requests served and refused, the peak
+// number of open connections and heap allocations made on the device
+// thread, which must stay at zero.
+//
+// Build: pio run -e native-http
+// Run:   .pio/build/native-http/program [--step-ms 2000] [--max-clients 32]
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "http_server.h"
+
+#include "../common/alloc_counter.h"
+
+namespace {
+
+const char* DEVICE_ID = "http-check";
+
+// ============ Options ============
+struct Options {
+  unsigned long sampleMs = 100;   // Faster than the firmware, so streams carry events
+  unsigned long stepMs = 2000;    // Duration of each load step
+  int maxClients = 32;
+  bool selfTestOnly = false;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --sample-ms N          sample interval of the device thread (100)\n"
+         "  --step-ms N            duration of each load step (2000)\n"
+         "  --max-clients N        largest load step; steps double from 1 (32)\n"
+         "  --self-test            functional checks only, no load steps\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"sample-ms", required_argument, nullptr, 's'},
+    {"step-ms", required_argument, nullptr, 'd'},
+    {"max-clients", required_argument, nullptr, 'c'},
+    {"self-test", no_argument, nullptr, 't'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 's': opt.sampleMs = strtoul(optarg, nullptr, 10); break;
+      case 'd': opt.stepMs = strtoul(optarg, nullptr, 10); break;
+      case 'c': opt.maxClients = atoi(optarg); break;
+      case 't': opt.selfTestOnly = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.sampleMs == 0 || opt.stepMs == 0 || opt.maxClients <= 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Results ============
+int failures = 0;
+
+void check(bool ok, const char* name, const std::string& detail = "") {
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+  if (!ok) failures++;
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+// ============ Device Thread ============
+// loop() reduced to what the server sees: a sample every sampleMs, and
+// http_loop() every pass, timed, with the open connections after it.
+class Device {
+ public:
+  explicit Device(const Options& opt) : opt_(opt) {}
+
+  void start() {
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+  }
+
+  void stop() {
+    running_ = false;
+    thread_.join();
+  }
+
+  // Stats and pass times may only be read while the thread is stopped
+  std::vector<double>& passes() { return passesUs_; }
+  uint8_t& peak_open() { return peakOpen_; }
+  uint32_t produced() const { return produced_; }
+  void produce(bool on) { produce_ = on; }
+
+ private:
+  void run() {
+    unsigned long lastSample = millis();
+    while (running_) {
+      unsigned long now = millis();
+      if (produce_ && now - lastSample >= opt_.sampleMs) {
+        lastSample = now;
+        uint32_t n = produced_ + 1;
+        HttpSample sample = {now, 21.0f + (n % 40) * 0.1f, 55.0f, 1800 + (int)(n % 100), {}, n % 10 == 0, false, true};
+        for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+          sample.moisturePercent[p] = 40 + (n + p) % 20;
+        }
+        {
+          host::CountAllocations counting;
+          http_sample(sample);
+        }
+        produced_ = n;
+      }
+      auto begin = std::chrono::steady_clock::now();
+      {
+        host::CountAllocations counting;
+        http_loop(now);
+      }
+      auto end = std::chrono::steady_clock::now();
+      passesUs_.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+      peakOpen_ = std::max(peakOpen_, http_stats().open);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  const Options& opt_;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<bool> produce_{false};
+  std::atomic<uint32_t> produced_{0};
+  std::vector<double> passesUs_;
+  uint8_t peakOpen_ = 0;
+};
+
+// ============ Clients ============
+int open_connection() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(HTTP_PORT);
+  if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool send_text(int fd, const std::string& text) {
+  return send(fd, text.data(), text.size(), MSG_NOSIGNAL) == (ssize_t)text.size();
+}
+
+// Appends what arrives within timeoutMs; false on close (or reset)
+bool receive(int fd, std::string& into, int timeoutMs) {
+  struct pollfd p = {fd, POLLIN, 0};
+  if (poll(&p, 1, timeoutMs) <= 0) return true;
+  char buffer[2048];
+  ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+  if (n <= 0) return false;
+  into.append(buffer, n);
+  return true;
+}
+
+struct Response {
+  int status = 0;                 // 0: no response
+  std::string head;
+  std::string body;
+};
+
+Response parse_response(const std::string& raw) {
+  Response r;
+  size_t split = raw.find("\r\n\r\n");
+  if (raw.compare(0, 9, "HTTP/1.1 ") != 0 || split == std::string::npos) return r;
+  r.status = atoi(raw.c_str() + 9);
+  r.head = raw.substr(0, split);
+  r.body = raw.substr(split + 4);
+  return r;
+}
+
+// One request; reads until the server closes
+Response request(const std::string& path, const char* method = "GET") {
+  int fd = open_connection();
+  if (fd < 0) return Response();
+  std::string raw;
+  send_text(fd, std::string(method) + " " + path + " HTTP/1.1\r\nHost: device\r\nUser-Agent: http-check\r\n\r\n");
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (std::chrono::steady_clock::now() < deadline && receive(fd, raw, 100)) {}
+  close(fd);
+  return parse_response(raw);
+}
+
+// An open event stream
+class Stream {
+ public:
+  explicit Stream(const char* lastEventId = nullptr) {
+    fd_ = open_connection();
+    std::string text = "GET /events HTTP/1.1\r\nHost: device\r\nAccept: text/event-stream\r\n";
+    if (lastEventId) text += std::string("Last-Event-ID: ") + lastEventId + "\r\n";
+    if (fd_ >= 0) send_text(fd_, text + "\r\n");
+  }
+  ~Stream() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  // Status of the response, once its head has arrived
+  int status(int timeoutMs = 2000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (raw_.find("\r\n\r\n") == std::string::npos && std::chrono::steady_clock::now() < deadline) {
+      if (!receive(fd_, raw_, 50)) break;
+    }
+    return parse_response(raw_).status;
+  }
+
+  // ID of the next "sample" event, 0 if none arrives in time
+  unsigned long next_event(int timeoutMs = 2000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+      size_t start = raw_.find("id: ", scanned_);
+      size_t end = start == std::string::npos ? start : raw_.find("\n\n", start);
+      if (end != std::string::npos) {
+        scanned_ = end + 2;
+        if (raw_.compare(raw_.find('\n', start) + 1, 13, "event: sample") == 0) {
+          return strtoul(raw_.c_str() + start + 4, nullptr, 10);
+        }
+        continue;
+      }
+      if (std::chrono::steady_clock::now() >= deadline || !receive(fd_, raw_, 50)) return 0;
+    }
+  }
+
+ private:
+  int fd_ = -1;
+  std::string raw_;
+  size_t scanned_ = 0;
+};
+
+size_t count(const std::string& text, const char* needle) {
+  size_t n = 0;
+  for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) n++;
+  return n;
+}
+
+unsigned long field(const std::string& json, const char* key) {
+  size_t at = json.find(std::string("\"") + key + "\":");
+  return at == std::string::npos ? 0 : strtoul(json.c_str() + at + strlen(key) + 3, nullptr, 10);
+}
+
+// ============ Self-Test ============
+void wait_for_samples(Device& device, uint32_t n) {
+  while (device.produced() < n) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+void self_test(Device& device) {
+  Response r = request("/latest");
+  check(r.status == 503, "/latest before the first sample", std::to_string(r.status));
+
+  device.produce(true);
+  wait_for_samples(device, 5);
+
+  r = request("/latest");
+  bool lengthOk = r.head.find("Content-Length: " + std::to_string(r.body.size())) != std::string::npos;
+  check(r.status == 200 && lengthOk && r.body.front() == '{' && r.body.back() == '}', "/latest",
+        r.body.substr(0, 60));
+  check(r.body.find("\"device_id\":\"http-check\"") != std::string::npos &&
+            r.body.find("\"soil_moisture_percent\":[") != std::string::npos &&
+            r.body.find("\"grow_light\":\"ON\"") != std::string::npos,
+        "/latest fields");
+  unsigned long latestId = field(r.body, "id");
+
+  r = request("/history");
+  size_t records = count(r.body, "{\"id\":");
+  check(r.status == 200 && r.body.front() == '[' && r.body.back() == ']' && records >= latestId &&
+            field(r.body, "id") == 1,
+        "/history", std::to_string(records) + " samples");
+
+  r = request("/history?since=" + std::to_string(latestId - 2));
+  check(r.status == 200 && field(r.body, "id") == latestId - 1, "/history?since",
+        "first id " + std::to_string(field(r.body, "id")));
+
+  wait_for_samples(device, HTTP_HISTORY_SAMPLES + 10);
+  r = request("/history");
+  records = count(r.body, "{\"id\":");
+  check(r.status == 200 && records == HTTP_HISTORY_SAMPLES, "/history after the buffer wrapped",
+        std::to_string(records) + " samples");
+
+  check(request("/nothing").status == 404, "unknown path: 404");
+  check(request("/latest", "POST").status == 405, "POST: 405");
+
+  unsigned long first;
+  {
+    Stream stream;
+    bool head = stream.status() == 200;
+    first = stream.next_event();
+    unsigned long second = stream.next_event();
+    check(head && first > 0 && second == first + 1, "/events live",
+          std::to_string(first) + ", " + std::to_string(second));
+  }
+  {
+    std::string resumeFrom = std::to_string(first - 5);
+    Stream stream(resumeFrom.c_str());
+    unsigned long resumed = stream.next_event();
+    check(stream.status() == 200 && resumed == first - 4, "/events resumes after Last-Event-ID",
+          std::to_string(resumed));
+  }
+  {
+    Stream streams[HTTP_MAX_STREAMS];
+    bool allOpen = true;
+    for (Stream& s : streams) allOpen = allOpen && s.status() == 200;
+    Stream extra;
+    check(allOpen && extra.status() == 503, "stream cap", std::to_string(HTTP_MAX_STREAMS) + " streams");
+  }
+  {
+    // Connections that never send a request hold their slots until the timeout
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));   // Streams above released
+    std::vector<int> idle;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) idle.push_back(open_connection());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    r = request("/latest");
+    check(r.status == 503 && r.head.find("Retry-After:") != std::string::npos, "client cap",
+          std::to_string(HTTP_MAX_CLIENTS) + " idle connections, then " + std::to_string(r.status));
+    for (int fd : idle) close(fd);
+  }
+}
+
+// ============ Load ============
+struct ClientTally {
+  uint64_t ok = 0;
+  uint64_t refused = 0;
+  uint64_t failed = 0;
+  uint64_t events = 0;
+  std::vector<double> latencyMs;
+};
+
+// Polls /latest (three in four) or /history until the end of the step
+void poller(int index, std::chrono::steady_clock::time_point until, ClientTally& tally) {
+  for (int n = 0; std::chrono::steady_clock::now() < until; n++) {
+    auto begin = std::chrono::steady_clock::now();
+    Response r = request((index + n) % 4 == 3 ? "/history" : "/latest");
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    if (r.status == 200) {
+      tally.ok++;
+      tally.latencyMs.push_back(ms);
+    } else if (r.status == 503) {
+      tally.refused++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    } else {
+      tally.failed++;
+    }
+  }
+}
+
+// Holds an event stream open (reconnecting when refused) until the end of the step
+void streamer(std::chrono::steady_clock::time_point until, ClientTally& tally) {
+  while (std::chrono::steady_clock::now() < until) {
+    Stream stream;
+    int status = stream.status();
+    if (status != 200) {
+      status == 503 ? tally.refused++ : tally.failed++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    tally.ok++;
+    while (std::chrono::steady_clock::now() < until && stream.next_event(200) != 0) tally.events++;
+  }
+}
+
+bool load_step(Device& device, const Options& opt, int clients) {
+  const HttpStats before = http_stats();
+  uint64_t allocationsBefore = host::allocations();
+  device.passes().clear();
+  device.peak_open() = 0;
+  device.start();
+
+  auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(opt.stepMs);
+  std::vector<ClientTally> tallies(clients);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < clients; i++) {
+    if (i % 4 == 3) {
+      threads.emplace_back(streamer, until, std::ref(tallies[i]));
+    } else {
+      threads.emplace_back(poller, i, until, std::ref(tallies[i]));
+    }
+  }
+  for (std::thread& t : threads) t.join();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  device.stop();
+
+  const HttpStats& after = http_stats();
+  ClientTally total;
+  for (ClientTally& t : tallies) {
+    total.ok += t.ok;
+    total.refused += t.refused;
+    total.failed += t.failed;
+    total.events += t.events;
+    total.latencyMs.insert(total.latencyMs.end(), t.latencyMs.begin(), t.latencyMs.end());
+  }
+  uint64_t allocations = host::allocations() - allocationsBefore;
+  double seconds = opt.stepMs / 1000.0;
+  const std::vector<double>& passes = device.passes();
+
+  printf("%7d %8.0f %8.1f %8.1f %8.0f %8.0f %7.1f %7.1f %6u %6u %6lu\n", clients, percentile(passes, 0.5),
+         percentile(passes, 0.99), *std::max_element(passes.begin(), passes.end()),
+         (after.latest + after.history - before.latest - before.history) / seconds,
+         (after.events - before.events) / seconds, percentile(total.latencyMs, 0.5),
+         percentile(total.latencyMs, 0.99), after.refused - before.refused, device.peak_open(),
+         (unsigned long)allocations);
+
+  bool ok = total.failed == 0 && device.peak_open() <= HTTP_MAX_CLIENTS && allocations == 0;
+  if (clients > HTTP_MAX_CLIENTS && after.refused == before.refused) ok = false;
+  if (total.failed) printf("        %lu requests failed\n", (unsigned long)total.failed);
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+  host::use_real_time();
+  host::board().serialEcho = false;
+
+  Device device(opt);
+  {
+    host::CountAllocations counting;
+    http_begin(DEVICE_ID);
+  }
+
+  printf("============ Self-Test ============\n");
+  device.start();
+  self_test(device);
+  device.stop();
+  check(host::allocations() == 0, "no allocations on the device thread", std::to_string(host::allocations()));
+
+  if (!opt.selfTestOnly) {
+    printf("\n============ Load (%lu ms per step, %d clients max, %d streams max) ============\n", opt.stepMs,
+           HTTP_MAX_CLIENTS, HTTP_MAX_STREAMS);
+    printf("clients  pass50us pass99us passmaxus  req/s  events/s  lat50ms lat99ms   503s   peak  alloc\n");
+    bool ok = true;
+    for (int clients = 1; clients <= opt.maxClients; clients *= 2) {
+      ok = load_step(device, opt, clients) && ok;
+    }
+    const HttpStats& stats = http_stats();
+    check(ok, "load steps", "peak " + std::to_string(stats.peakOpen) + " open, " + std::to_string(stats.refused) +
+                                " refused, " + std::to_string(stats.skipped) + " samples skipped");
+  }
+
+  if (failures == 0) {
+    printf("\nAll checks passed\n");
+    return 0;
+  }
+  printf("\n%d check(s) FAILED\n", failures);
+  return 1;
+}
@@ -0,0 +1,893 @@
+// ============ Fleet Load Generator ============
+// Runs thousands of virtual plant monitors in one Linux process, each with its
+// own MQTT connection, against a local broker. Every virtual device uses the
+// firmware's own filters (sensor_filter.h), payload serialization
+// (telemetry.h), topic table (topics.h) and packet framing (mqtt_codec.h), fed
+// by the simulated plant in host/common/plant_model.h.
+//
+// Build: pio run -e native-loadgen
+// Run:   .pio/build/native-loadgen/program --devices 2000 --duration 120
+//
+// Reports sustained publish rate, broker round-trip latency percentiles
+// (PUBACK at QoS 1, PINGRESP at QoS 0) and the broker's $SYS queue/drop
+// counters, which show whether the backend services keep up.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "mqtt_codec.h"
+#include "sensor_filter.h"
+#include "telemetry.h"
+#include "topics.h"
+#include "../common/plant_model.h"
+
+namespace {
+
+// ============ Options ============
+struct Options {
+  std::string host = "127.0.0.1";
+  int port = 1883;
+  int devices = 100;
+  int intervalMs = 2000;          // MQTT_INTERVAL in the firmware
+  int durationS = 60;
+  int rampPerSecond = 500;        // New connections per second
+  int reportS = 5;
+  int pingS = 5;                  // PINGREQ probe / keep-alive interval
+  int qos = 0;
+  int keepAliveS = 15;
+  bool flatTopics = true;         // TOPIC_COMPAT_FLAT
+  bool aggregatedOnly = false;    // Skip legacy per-sensor and status topics
+  bool subscribe = true;          // Subscribe to command topics like the firmware
+  bool reconnect = true;
+  bool sysStats = true;           // Monitor broker $SYS counters
+  bool json = false;
+  uint32_t seed = 1;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --host HOST            broker host (127.0.0.1)\n"
+         "  --port PORT            broker port (1883)\n"
+         "  --devices N            virtual devices, one connection each (100)\n"
+         "  --interval MS          publish interval per device (2000)\n"
+         "  --duration S           test duration after ramp-up (60)\n"
+         "  --ramp N               connections opened per second (500)\n"
+         "  --report S             progress report interval (5)\n"
+         "  --ping S               PINGREQ latency probe / keep-alive interval (5)\n"
+         "  --qos 0|1              telemetry QoS; 1 measures PUBACK round trip (0)\n"
+         "  --namespaced           plant-iot/<id>/... topics instead of flat topics\n"
+         "  --aggregated-only      publish only sensors/aggregated\n"
+         "  --no-subscribe         do not subscribe to command topics\n"
+         "  --no-reconnect         do not reconnect dropped devices\n"
+         "  --no-sys               do not monitor $SYS broker counters\n"
+         "  --seed N               simulation seed (1)\n"
+         "  --json                 print the final summary as one JSON line\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"host", required_argument, nullptr, 'h'},
+    {"port", required_argument, nullptr, 'p'},
+    {"devices", required_argument, nullptr, 'n'},
+    {"interval", required_argument, nullptr, 'i'},
+    {"duration", required_argument, nullptr, 'd'},
+    {"ramp", required_argument, nullptr, 'r'},
+    {"report", required_argument, nullptr, 'R'},
+    {"ping", required_argument, nullptr, 'P'},
+    {"qos", required_argument, nullptr, 'q'},
+    {"namespaced", no_argument, nullptr, 'N'},
+    {"aggregated-only", no_argument, nullptr, 'a'},
+    {"no-subscribe", no_argument, nullptr, 'S'},
+    {"no-reconnect", no_argument, nullptr, 'C'},
+    {"no-sys", no_argument, nullptr, 'Y'},
+    {"seed", required_argument, nullptr, 's'},
+    {"json", no_argument, nullptr, 'j'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'h': opt.host = optarg; break;
+      case 'p': opt.port = atoi(optarg); break;
+      case 'n': opt.devices = atoi(optarg); break;
+      case 'i': opt.intervalMs = atoi(optarg); break;
+      case 'd': opt.durationS = atoi(optarg); break;
+      case 'r': opt.rampPerSecond = atoi(optarg); break;
+      case 'R': opt.reportS = atoi(optarg); break;
+      case 'P': opt.pingS = atoi(optarg); break;
+      case 'q': opt.qos = atoi(optarg) ? 1 : 0; break;
+      case 'N': opt.flatTopics = false; break;
+      case 'a': opt.aggregatedOnly = true; break;
+      case 'S': opt.subscribe = false; break;
+      case 'C': opt.reconnect = false; break;
+      case 'Y': opt.sysStats = false; break;
+      case 's': opt.seed = strtoul(optarg, nullptr, 10); break;
+      case 'j': opt.json = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.devices < 1 || opt.intervalMs < 1 || opt.rampPerSecond < 1 || opt.reportS < 1) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+uint64_t now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+volatile sig_atomic_t stopRequested = 0;
+void on_signal(int) { stopRequested = 1; }
+
+// ============ Metrics ============
+struct LatencyRecorder {
+  std::vector<uint32_t> samples;   // Microseconds
+
+  void add(uint64_t us) { samples.push_back(us > UINT32_MAX ? UINT32_MAX : (uint32_t)us); }
+
+  // Sorts in place; call only when reporting
+  double percentile_ms(double p) {
+    if (samples.empty()) return 0;
+    size_t k = std::min(samples.size() - 1, (size_t)(p / 100.0 * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k] / 1000.0;
+  }
+
+  double max_ms() const {
+    return samples.empty() ? 0 : *std::max_element(samples.begin(), samples.end()) / 1000.0;
+  }
+};
+
+struct Counters {
+  uint64_t published = 0;
+  uint64_t publishedBytes = 0;
+  uint64_t suppressed = 0;         // Dedup skipped (hasSensorDataChanged)
+  uint64_t acked = 0;
+  uint64_t commands = 0;
+  uint64_t connectFailures = 0;
+  uint64_t disconnects = 0;
+  uint64_t txDropped = 0;          // Socket send buffer full: broker not draining
+};
+
+// ============ Virtual Device ============
+enum class ConnState { Idle, Connecting, AwaitConnack, Ready };
+
+struct PendingAck {
+  uint16_t packetId;
+  uint64_t sentUs;
+};
+
+static const size_t RX_CAPACITY = 4096;
+static const size_t TX_LIMIT = 64 * 1024;
+static const int PENDING_SLOTS = 32;
+
+struct Device {
+  int fd = -1;
+  ConnState state = ConnState::Idle;
+  bool monitor = false;            // $SYS monitor connection, not a plant
+  bool wantWrite = false;
+  char id[24];
+  char prefix[48];
+  char topics[TOPIC_COUNT][TOPIC_MAX_LEN];
+
+  uint8_t rx[RX_CAPACITY];
+  size_t rxLength = 0;
+  std::vector<uint8_t> tx;
+  size_t txOffset = 0;
+
+  host::PlantModel plant;
+  EnvironmentFilter env;
+  RollingAverage<SMOOTHING_SIZE> soil;
+  int lastT = 0, lastH = 0, lastM = -1, lastL = 0;
+  bool pump = false, fan = false, growLight = false;
+
+  uint16_t nextPacketId = 1;
+  PendingAck pending[PENDING_SLOTS];
+  int pendingHead = 0;
+  uint64_t pingSentUs = 0;
+  uint64_t bootUs = 0;
+  uint32_t boot = 0;               // Each connection counts as a boot, like uptime
+  uint32_t seq[TOPIC_FIRST_COMMAND] = {};
+
+  SequenceStamp next(TopicId id) { return {boot, ++seq[id]}; }
+};
+
+enum class TimerKind : uint8_t { Connect, Sample, Ping };
+
+struct Timer {
+  uint64_t dueUs;
+  uint32_t device;
+  TimerKind kind;
+  bool operator>(const Timer& o) const { return dueUs > o.dueUs; }
+};
+
+// ============ Load Generator ============
+class LoadGenerator {
+ public:
+  explicit LoadGenerator(const Options& options) : opt_(options) {}
+
+  bool run();
+
+ private:
+  bool resolve();
+  void start_connect(uint32_t index);
+  void close_device(uint32_t index, bool failed);
+  void on_writable(uint32_t index);
+  void on_readable(uint32_t index);
+  void handle_packet(uint32_t index, const mqtt::Packet& packet);
+  void handle_command(Device& dev, const mqtt::PublishView& view);
+  void send(uint32_t index, const uint8_t* data, size_t length);
+  bool publish(uint32_t index, const char* topic, const char* payload, size_t length, uint8_t qos);
+  void sample_and_publish(uint32_t index);
+  void send_ping(uint32_t index);
+  void update_interest(uint32_t index);
+  void schedule(uint64_t dueUs, uint32_t index, TimerKind kind) { timers_.push({dueUs, index, kind}); }
+  void report(uint64_t now, bool final);
+
+  Options opt_;
+  struct sockaddr_storage address_;
+  socklen_t addressLength_ = 0;
+  int epoll_ = -1;
+  std::vector<Device> devices_;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+
+  Counters total_, interval_;
+  LatencyRecorder ackLatency_, pingLatency_;
+  LatencyRecorder intervalAck_, intervalPing_;
+  int connected_ = 0;
+  uint64_t startUs_ = 0;
+  uint64_t steadyUs_ = 0;          // When ramp-up finished
+  Counters steadyBase_;
+
+  std::map<std::string, double> sys_;
+  double sysDroppedBase_ = -1;
+};
+
+bool LoadGenerator::resolve() {
+  struct addrinfo hints, *result = nullptr;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  char port[8];
+  snprintf(port, sizeof(port), "%d", opt_.port);
+  int rc = getaddrinfo(opt_.host.c_str(), port, &hints, &result);
+  if (rc != 0 || !result) {
+    fprintf(stderr, "Cannot resolve %s: %s\n", opt_.host.c_str(), gai_strerror(rc));
+    return false;
+  }
+  memcpy(&address_, result->ai_addr, result->ai_addrlen);
+  addressLength_ = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+void LoadGenerator::start_connect(uint32_t index) {
+  Device& dev = devices_[index];
+  int fd = socket(address_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    total_.connectFailures++;
+    interval_.connectFailures++;
+    if (opt_.reconnect) schedule(now_us() + 1000000, index, TimerKind::Connect);
+    return;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  int rc = connect(fd, (struct sockaddr*)&address_, addressLength_);
+  if (rc < 0 && errno != EINPROGRESS) {
+    close(fd);
+    total_.connectFailures++;
+    interval_.connectFailures++;
+    if (opt_.reconnect) schedule(now_us() + 1000000, index, TimerKind::Connect);
+    return;
+  }
+
+  dev.fd = fd;
+  dev.state = ConnState::Connecting;
+  dev.rxLength = 0;
+  dev.tx.clear();
+  dev.txOffset = 0;
+  dev.pingSentUs = 0;
+  dev.wantWrite = true;
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLOUT;
+  ev.data.u32 = index;
+  epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void LoadGenerator::close_device(uint32_t index, bool failed) {
+  Device& dev = devices_[index];
+  if (dev.fd < 0) return;
+  epoll_ctl(epoll_, EPOLL_CTL_DEL, dev.fd, nullptr);
+  close(dev.fd);
+  dev.fd = -1;
+
+  if (dev.state == ConnState::Ready) {
+    if (!dev.monitor) connected_--;
+    total_.disconnects++;
+    interval_.disconnects++;
+  } else if (failed) {
+    total_.connectFailures++;
+    interval_.connectFailures++;
+  }
+  dev.state = ConnState::Idle;
+
+  if (opt_.reconnect && !stopRequested) {
+    schedule(now_us() + 1000000, index, TimerKind::Connect);
+  }
+}
+
+void LoadGenerator::update_interest(uint32_t index) {
+  Device& dev = devices_[index];
+  bool want = dev.txOffset < dev.tx.size() || dev.state == ConnState::Connecting;
+  if (want == dev.wantWrite || dev.fd < 0) return;
+  struct epoll_event ev;
+  ev.events = EPOLLIN | (want ? (uint32_t)EPOLLOUT : 0u);
+  ev.data.u32 = index;
+  epoll_ctl(epoll_, EPOLL_CTL_MOD, dev.fd, &ev);
+  dev.wantWrite = want;
+}
+
+void LoadGenerator::send(uint32_t index, const uint8_t* data, size_t length) {
+  Device& dev = devices_[index];
+  if (dev.fd < 0) return;
+
+  // Fast path: nothing queued, write straight to the socket
+  if (dev.txOffset == dev.tx.size()) {
+    dev.tx.clear();
+    dev.txOffset = 0;
+    ssize_t n = ::send(dev.fd, data, length, MSG_NOSIGNAL);
+    if (n == (ssize_t)length) return;
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        close_device(index, false);
+        return;
+      }
+      n = 0;
+    }
+    data += n;
+    length -= n;
+  }
+
+  dev.tx.insert(dev.tx.end(), data, data + length);
+  update_interest(index);
+}
+
+bool LoadGenerator::publish(uint32_t index, const char* topic, const char* payload, size_t length, uint8_t qos) {
+  Device& dev = devices_[index];
+  if (dev.tx.size() - dev.txOffset > TX_LIMIT) {
+    total_.txDropped++;
+    interval_.txDropped++;
+    return false;
+  }
+
+  uint16_t packetId = 0;
+  if (qos > 0) {
+    packetId = dev.nextPacketId++;
+    if (dev.nextPacketId == 0) dev.nextPacketId = 1;
+    dev.pending[dev.pendingHead] = {packetId, now_us()};
+    dev.pendingHead = (dev.pendingHead + 1) % PENDING_SLOTS;
+  }
+
+  uint8_t packet[1024];
+  size_t size = mqtt::encode_publish(packet, sizeof(packet), topic, strlen(topic), (const uint8_t*)payload,
+                                     length, qos, false, packetId);
+  if (size == 0) return false;
+  send(index, packet, size);
+
+  total_.published++;
+  total_.publishedBytes += size;
+  interval_.published++;
+  interval_.publishedBytes += size;
+  return true;
+}
+
+// One MQTT_INTERVAL of the firmware loop: read_sensors(), publish_sensor_data()
+// and publish_status() against the simulated plant
+void LoadGenerator::sample_and_publish(uint32_t index) {
+  Device& dev = devices_[index];
+  if (dev.state != ConnState::Ready) return;
+
+  uint64_t now = now_us();
+  uint64_t nowMs = (now - startUs_) / 1000;
+  unsigned long uptime = (now - dev.bootUs) / 1000;
+
+  dev.plant.pumpOn = dev.pump;
+  dev.plant.step(nowMs, opt_.intervalMs);
+
+  float t = dev.plant.read_temperature(nowMs);
+  float h = dev.plant.read_humidity(nowMs);
+  int soilRaw = dev.soil.push(dev.plant.read_soil_raw());
+  dev.env.push(t, h, dev.plant.read_light_raw(nowMs));
+
+  SensorSample sample = {dev.env.temperature(), dev.env.humidity(), soilRaw,
+                         soil_percent(soilRaw, 1023, 0), dev.env.light()};
+
+  char payload[512];
+
+  // Same change test as hasSensorDataChanged(): integer T/H, raw moisture/light
+  int qt = (int)sample.temperature, qh = (int)sample.humidity;
+  if (qt != dev.lastT || qh != dev.lastH || sample.soilMoisture != dev.lastM || sample.lightIntensity != dev.lastL) {
+    dev.lastT = qt;
+    dev.lastH = qh;
+    dev.lastM = sample.soilMoisture;
+    dev.lastL = sample.lightIntensity;
+
+    size_t n = serialize_aggregated(sample, dev.id, nullptr, uptime, dev.next(TOPIC_SENSORS_AGGREGATED), payload,
+                                    sizeof(payload));
+    publish(index, dev.topics[TOPIC_SENSORS_AGGREGATED], payload, n, opt_.qos);
+
+    if (!opt_.aggregatedOnly) {
+      for (int i = TOPIC_SENSORS_TEMPERATURE; i <= TOPIC_SENSORS_LIGHT; i++) {
+        n = serialize_legacy_reading((TopicId)i, sample, uptime, dev.next((TopicId)i), payload, sizeof(payload));
+        publish(index, dev.topics[i], payload, n, opt_.qos);
+      }
+    }
+  } else {
+    total_.suppressed++;
+    interval_.suppressed++;
+  }
+
+  if (!opt_.aggregatedOnly) {
+    const bool states[3] = {dev.pump, dev.fan, dev.growLight};
+    for (int i = 0; i < 3; i++) {
+      TopicId id = (TopicId)(TOPIC_STATUS_PUMP + i);
+      size_t n = serialize_actuator_status(states[i], uptime, dev.next(id), payload, sizeof(payload));
+      publish(index, dev.topics[id], payload, n, opt_.qos);
+    }
+    size_t n = serialize_status_all(dev.pump, dev.fan, dev.growLight, -55, uptime, dev.next(TOPIC_STATUS_ALL), payload,
+                                    sizeof(payload));
+    publish(index, dev.topics[TOPIC_STATUS_ALL], payload, n, opt_.qos);
+  }
+}
+
+void LoadGenerator::send_ping(uint32_t index) {
+  Device& dev = devices_[index];
+  if (dev.state != ConnState::Ready || dev.pingSentUs != 0) return;
+  uint8_t packet[2];
+  mqtt::encode_empty(packet, sizeof(packet), mqtt::PINGREQ);
+  dev.pingSentUs = now_us();
+  send(index, packet, sizeof(packet));
+}
+
+void LoadGenerator::on_writable(uint32_t index) {
+  Device& dev = devices_[index];
+
+  if (dev.state == ConnState::Connecting) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(dev.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0) {
+      close_device(index, true);
+      return;
+    }
+
+    dev.state = ConnState::AwaitConnack;
+    mqtt::ConnectOptions options;
+    memset(&options, 0, sizeof(options));
+    options.clientId = dev.id;
+    options.keepAliveSeconds = opt_.keepAliveS;
+    options.cleanSession = true;
+
+    uint8_t packet[128];
+    size_t size = mqtt::encode_connect(packet, sizeof(packet), options);
+    send(index, packet, size);
+    if (devices_[index].fd >= 0) update_interest(index);
+    return;
+  }
+
+  while (dev.txOffset < dev.tx.size()) {
+    ssize_t n = ::send(dev.fd, dev.tx.data() + dev.txOffset, dev.tx.size() - dev.txOffset, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      close_device(index, false);
+      return;
+    }
+    dev.txOffset += n;
+  }
+  if (dev.txOffset == dev.tx.size()) {
+    dev.tx.clear();
+    dev.txOffset = 0;
+  }
+  update_interest(index);
+}
+
+void LoadGenerator::on_readable(uint32_t index) {
+  for (;;) {
+    Device& dev = devices_[index];
+    if (dev.fd < 0) return;
+
+    ssize_t n = recv(dev.fd, dev.rx + dev.rxLength, RX_CAPACITY - dev.rxLength, 0);
+    if (n == 0) {
+      close_device(index, false);
+      return;
+    }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+      close_device(index, false);
+      return;
+    }
+    dev.rxLength += n;
+
+    size_t offset = 0;
+    for (;;) {
+      mqtt::Packet packet;
+      long size = mqtt::decode_packet(dev.rx + offset, dev.rxLength - offset, packet);
+      if (size < 0) {
+        close_device(index, false);
+        return;
+      }
+      if (size == 0) break;
+      handle_packet(index, packet);
+      if (devices_[index].fd < 0) return;
+      offset += size;
+    }
+
+    if (offset == 0 && dev.rxLength == RX_CAPACITY) {
+      // A single packet larger than the receive buffer (e.g. a huge command)
+      close_device(index, false);
+      return;
+    }
+    memmove(dev.rx, dev.rx + offset, dev.rxLength - offset);
+    dev.rxLength -= offset;
+  }
+}
+
+void LoadGenerator::handle_packet(uint32_t index, const mqtt::Packet& packet) {
+  Device& dev = devices_[index];
+  uint64_t now = now_us();
+
+  switch (packet.type) {
+    case mqtt::CONNACK: {
+      if (mqtt::connack_code(packet) != 0) {
+        close_device(index, true);
+        return;
+      }
+      dev.state = ConnState::Ready;
+      dev.bootUs = now;
+      dev.boot++;
+      memset(dev.seq, 0, sizeof(dev.seq));
+      if (!dev.monitor) connected_++;
+
+      uint8_t buffer[128];
+      if (dev.monitor) {
+        static const char* const sysTopics[] = {
+          "$SYS/broker/load/messages/received/1min",
+          "$SYS/broker/load/messages/sent/1min",
+          "$SYS/broker/store/messages/count",
+          "$SYS/broker/publish/messages/dropped",
+          "$SYS/broker/clients/connected",
+        };
+        for (const char* t : sysTopics) {
+          send(index, buffer, mqtt::encode_subscribe(buffer, sizeof(buffer), dev.nextPacketId++, t, 0));
+        }
+        return;
+      }
+
+      if (opt_.subscribe) {
+        for (int t = TOPIC_FIRST_COMMAND; t < TOPIC_COUNT; t++) {
+          send(index, buffer, mqtt::encode_subscribe(buffer, sizeof(buffer), dev.nextPacketId++, dev.topics[t], 0));
+        }
+      }
+
+      // Spread the fleet evenly over one interval so load is not bursty.
+      // Pings double as keep-alives when dedup suppresses publishing.
+      uint64_t phase = (uint64_t)opt_.intervalMs * 1000 * index / devices_.size();
+      schedule(now + phase, index, TimerKind::Sample);
+      if (opt_.pingS > 0) {
+        schedule(now + phase + (uint64_t)opt_.pingS * 1000000, index, TimerKind::Ping);
+      }
+      return;
+    }
+
+    case mqtt::PUBACK: {
+      uint16_t id = mqtt::packet_id(packet);
+      for (int i = 0; i < PENDING_SLOTS; i++) {
+        if (dev.pending[i].packetId == id && dev.pending[i].sentUs != 0) {
+          uint64_t rtt = now - dev.pending[i].sentUs;
+          ackLatency_.add(rtt);
+          intervalAck_.add(rtt);
+          dev.pending[i].sentUs = 0;
+          total_.acked++;
+          interval_.acked++;
+          break;
+        }
+      }
+      return;
+    }
+
+    case mqtt::PINGRESP:
+      if (dev.pingSentUs != 0) {
+        uint64_t rtt = now - dev.pingSentUs;
+        pingLatency_.add(rtt);
+        intervalPing_.add(rtt);
+        dev.pingSentUs = 0;
+      }
+      return;
+
+    case mqtt::PUBLISH: {
+      mqtt::PublishView view;
+      if (!mqtt::parse_publish(packet, view)) return;
+      if (view.qos > 0) {
+        uint8_t ack[4];
+        send(index, ack, mqtt::encode_ack(ack, sizeof(ack), mqtt::PUBACK, view.packetId));
+      }
+      if (dev.monitor) {
+        std::string topic(view.topic, view.topicLength);
+        std::string value((const char*)view.payload, view.payloadLength);
+        sys_[topic] = atof(value.c_str());
+        return;
+      }
+      handle_command(dev, view);
+      return;
+    }
+
+    default:
+      return;
+  }
+}
+
+// Mirrors callback(): actuator commands flip the simulated outputs
+void LoadGenerator::handle_command(Device& dev, const mqtt::PublishView& view) {
+  total_.commands++;
+  interval_.commands++;
+
+  StaticJsonDocument<200> doc;
+  if (deserializeJson(doc, view.payload, view.payloadLength)) return;
+
+  for (int t = TOPIC_FIRST_COMMAND; t < TOPIC_COUNT; t++) {
+    size_t length = strlen(dev.topics[t]);
+    if (length != view.topicLength || memcmp(dev.topics[t], view.topic, length) != 0) continue;
+
+    bool on = doc["action"] == "ON";
+    bool off = doc["action"] == "OFF";
+    switch (t) {
+      case TOPIC_CMD_PUMP: if (on || off) dev.pump = on; break;
+      case TOPIC_CMD_FAN: if (on || off) dev.fan = on; break;
+      case TOPIC_CMD_GROW_LIGHT: if (on || off) dev.growLight = on; break;
+      case TOPIC_CMD_CONTROL_ALL: dev.pump = dev.fan = dev.growLight = doc["enable"].as<bool>(); break;
+      default: break;
+    }
+    return;
+  }
+}
+
+void LoadGenerator::report(uint64_t now, bool final) {
+  double elapsed = (now - startUs_) / 1e6;
+
+  if (!final) {
+    double seconds = opt_.reportS;
+    printf("[%7.1fs] conn %d/%d  pub %.0f msg/s (%.0f KB/s)  dedup %.0f/s",
+           elapsed, connected_, opt_.devices, interval_.published / seconds,
+           interval_.publishedBytes / seconds / 1024.0, interval_.suppressed / seconds);
+    LatencyRecorder& lat = opt_.qos > 0 ? intervalAck_ : intervalPing_;
+    printf("  %s p50 %.2f p99 %.2f max %.2f ms", opt_.qos > 0 ? "ack" : "ping",
+           lat.percentile_ms(50), lat.percentile_ms(99), lat.max_ms());
+    if (interval_.txDropped || interval_.connectFailures || interval_.disconnects) {
+      printf("  txdrop %" PRIu64 " connfail %" PRIu64 " disc %" PRIu64, interval_.txDropped,
+             interval_.connectFailures, interval_.disconnects);
+    }
+    if (!sys_.empty()) {
+      double dropped = sys_["$SYS/broker/publish/messages/dropped"];
+      if (sysDroppedBase_ < 0) sysDroppedBase_ = dropped;
+      printf("  | broker rx %.0f/min tx %.0f/min stored %.0f dropped +%.0f",
+             sys_["$SYS/broker/load/messages/received/1min"], sys_["$SYS/broker/load/messages/sent/1min"],
+             sys_["$SYS/broker/store/messages/count"], dropped - sysDroppedBase_);
+    }
+    printf("\n");
+    fflush(stdout);
+    interval_ = Counters();
+    intervalAck_.samples.clear();
+    intervalPing_.samples.clear();
+    return;
+  }
+
+  // Sustained rate is measured from the end of ramp-up
+  uint64_t steadyStart = steadyUs_ ? steadyUs_ : startUs_;
+  double steadySeconds = (now - steadyStart) / 1e6;
+  double rate = steadySeconds > 0 ? (total_.published - steadyBase_.published) / steadySeconds : 0;
+  double byteRate = steadySeconds > 0 ? (total_.publishedBytes - steadyBase_.publishedBytes) / steadySeconds : 0;
+  LatencyRecorder& lat = opt_.qos > 0 ? ackLatency_ : pingLatency_;
+  double dropped = sys_.count("$SYS/broker/publish/messages/dropped") && sysDroppedBase_ >= 0
+                       ? sys_["$SYS/broker/publish/messages/dropped"] - sysDroppedBase_ : 0;
+
+  if (opt_.json) {
+    printf("{\"devices\":%d,\"connected\":%d,\"interval_ms\":%d,\"qos\":%d,\"duration_s\":%.1f,"
+           "\"sustained_msgs_per_s\":%.1f,\"sustained_bytes_per_s\":%.0f,\"published\":%" PRIu64 ","
+           "\"suppressed\":%" PRIu64 ",\"acked\":%" PRIu64 ",\"commands\":%" PRIu64 ",\"tx_dropped\":%" PRIu64 ","
+           "\"connect_failures\":%" PRIu64 ",\"disconnects\":%" PRIu64 ",\"latency_kind\":\"%s\","
+           "\"latency_samples\":%zu,\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,"
+           "\"max_ms\":%.3f,\"broker_stored\":%.0f,\"broker_dropped\":%.0f}\n",
+           opt_.devices, connected_, opt_.intervalMs, opt_.qos, elapsed, rate, byteRate, total_.published,
+           total_.suppressed, total_.acked, total_.commands, total_.txDropped, total_.connectFailures,
+           total_.disconnects, opt_.qos > 0 ? "puback" : "pingresp", lat.samples.size(), lat.percentile_ms(50),
+           lat.percentile_ms(90), lat.percentile_ms(99), lat.percentile_ms(99.9), lat.max_ms(),
+           sys_["$SYS/broker/store/messages/count"], dropped);
+    return;
+  }
+
+  printf("\n============ Load Test Summary ============\n");
+  printf("Devices:            %d (%d connected at end)\n", opt_.devices, connected_);
+  printf("Duration:           %.1f s (steady state %.1f s)\n", elapsed, steadySeconds);
+  printf("Sustained publish:  %.1f msg/s, %.1f KB/s\n", rate, byteRate / 1024.0);
+  printf("Published:          %" PRIu64 " (dedup suppressed %" PRIu64 " samples)\n", total_.published, total_.suppressed);
+  printf("Commands received:  %" PRIu64 "\n", total_.commands);
+  printf("Send-buffer drops:  %" PRIu64 "\n", total_.txDropped);
+  printf("Connect failures:   %" PRIu64 ", disconnects %" PRIu64 "\n", total_.connectFailures, total_.disconnects);
+  printf("Broker RTT (%s, %zu samples): p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f ms\n",
+         opt_.qos > 0 ? "PUBACK" : "PINGRESP", lat.samples.size(), lat.percentile_ms(50), lat.percentile_ms(90),
+         lat.percentile_ms(99), lat.percentile_ms(99.9), lat.max_ms());
+  if (!sys_.empty()) {
+    printf("Service backlog:    %.0f messages stored in broker, %.0f dropped from subscriber queues\n",
+           sys_["$SYS/broker/store/messages/count"], dropped);
+  }
+}
+
+bool LoadGenerator::run() {
+  if (!resolve()) return false;
+
+  // Every virtual device needs a file descriptor
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)opt_.devices + 64) {
+    limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, opt_.devices + 64);
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  epoll_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_ < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+
+  uint32_t count = opt_.devices + (opt_.sysStats ? 1 : 0);
+  devices_.resize(count);
+  startUs_ = now_us();
+
+  for (uint32_t i = 0; i < count; i++) {
+    Device& dev = devices_[i];
+    dev.monitor = opt_.sysStats && i == (uint32_t)opt_.devices;
+    if (dev.monitor) {
+      snprintf(dev.id, sizeof(dev.id), "loadgen-sys-%u", opt_.seed);
+    } else {
+      snprintf(dev.id, sizeof(dev.id), "plant-lg%06u", i);
+    }
+    snprintf(dev.prefix, sizeof(dev.prefix), opt_.flatTopics ? TOPIC_ROOT "/" : TOPIC_ROOT "/%s/", dev.id);
+    for (int t = 0; t < TOPIC_COUNT; t++) {
+      topic_build(dev.topics[t], TOPIC_MAX_LEN, dev.prefix, (TopicId)t);
+    }
+
+    dev.plant = host::PlantModel(opt_.seed * 2654435761u + i);
+    dev.plant.phaseMs = dev.plant.rng.next() % 3600000;
+    dev.plant.moisturePercent = 40.0f + (dev.plant.rng.next() % 50);
+
+    uint64_t due = startUs_ + (uint64_t)i * 1000000 / opt_.rampPerSecond;
+    schedule(dev.monitor ? startUs_ : due, i, TimerKind::Connect);
+  }
+
+  uint64_t rampEndUs = startUs_ + (uint64_t)opt_.devices * 1000000 / opt_.rampPerSecond;
+  uint64_t endUs = rampEndUs + (uint64_t)opt_.durationS * 1000000;
+  uint64_t nextReport = startUs_ + (uint64_t)opt_.reportS * 1000000;
+
+  if (!opt_.json) {
+    printf("Load test: %d devices -> %s:%d, interval %d ms, QoS %d, %s topics\n", opt_.devices,
+           opt_.host.c_str(), opt_.port, opt_.intervalMs, opt_.qos, opt_.flatTopics ? "flat" : "namespaced");
+  }
+
+  std::vector<struct epoll_event> events(1024);
+  while (!stopRequested) {
+    uint64_t now = now_us();
+    if (now >= endUs) break;
+
+    if (!steadyUs_ && now >= rampEndUs && connected_ >= opt_.devices) {
+      steadyUs_ = now;
+      steadyBase_ = total_;
+    }
+
+    // Fire due timers
+    while (!timers_.empty() && timers_.top().dueUs <= now) {
+      Timer timer = timers_.top();
+      timers_.pop();
+      Device& dev = devices_[timer.device];
+      switch (timer.kind) {
+        case TimerKind::Connect:
+          if (dev.fd < 0) start_connect(timer.device);
+          break;
+        case TimerKind::Sample:
+          if (dev.state == ConnState::Ready) {
+            sample_and_publish(timer.device);
+            schedule(timer.dueUs + (uint64_t)opt_.intervalMs * 1000, timer.device, TimerKind::Sample);
+          }
+          break;
+        case TimerKind::Ping:
+          if (dev.state == ConnState::Ready) {
+            send_ping(timer.device);
+            schedule(timer.dueUs + (uint64_t)opt_.pingS * 1000000, timer.device, TimerKind::Ping);
+          }
+          break;
+      }
+    }
+
+    if (now >= nextReport) {
+      if (!opt_.json) report(now, false);
+      nextReport += (uint64_t)opt_.reportS * 1000000;
+    }
+
+    uint64_t wake = std::min(nextReport, endUs);
+    if (!timers_.empty()) wake = std::min(wake, timers_.top().dueUs);
+    now = now_us();
+    int timeoutMs = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+
+    int n = epoll_wait(epoll_, events.data(), events.size(), timeoutMs);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("epoll_wait");
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      uint32_t index = events[i].data.u32;
+      if (devices_[index].fd < 0) continue;
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        close_device(index, devices_[index].state != ConnState::Ready);
+        continue;
+      }
+      if (events[i].events & EPOLLOUT) on_writable(index);
+      if (devices_[index].fd >= 0 && (events[i].events & EPOLLIN)) on_readable(index);
+    }
+  }
+
+  report(now_us(), true);
+
+  opt_.reconnect = false;
+  for (uint32_t i = 0; i < devices_.size(); i++) {
+    if (devices_[i].fd >= 0) {
+      uint8_t packet[2];
+      mqtt::encode_empty(packet, sizeof(packet), mqtt::DISCONNECT);
+      ::send(devices_[i].fd, packet, sizeof(packet), MSG_NOSIGNAL);
+      close_device(i, false);
+    }
+  }
+  close(epoll_);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) return 2;
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  LoadGenerator generator(options);
+  return generator.run() ? 0 : 1;
+}
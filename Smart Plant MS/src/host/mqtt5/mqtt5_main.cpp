@@ -0,0 +1,601 @@
+// ============ MQTT 5.0 Client Checks ============
+// Exercises the firmware's MQTT 5.0 client (src/mqtt5_client.cpp) over real
+// TCP through the WiFiClient shim:
+//
+//   fallback    against in-process brokers that only speak 3.1.1: one that
+//               answers a 5.0 CONNECT with a 3.1.1 CONNACK 0x01 and one
+//               with a 5.0 CONNACK 0x84; the client must end up connected
+//               on 3.1.1 and stay on it for that broker. A broker that just
+//               closes the connection must not cause a fallback: the
+//               connect fails and the next one tries 5.0 again
+//   aliases     one report cycle's topics published repeatedly; bytes on
+//               the wire against the same messages as 3.1.1 PUBLISH packets
+//   properties  an observer sees the schema/encoding user properties and
+//               the message expiry on what the client publishes
+//   expiry      a retained message with a 2 s expiry is gone for an
+//               observer that subscribes 3 s later; one without is not
+//   response    a command with a response topic and correlation data is
+//               answered on that topic with the same correlation data
+//
+// The fallback checks need no broker; the others need Mosquitto 2.x
+// (docker compose up mosquitto).
+//
+// Build: pio run -e native-mqtt5
+// Run:   .pio/build/native-mqtt5/program --host 127.0.0.1
+//        .pio/build/native-mqtt5/program --no-broker     (fallback only)
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "mqtt5_client.h"
+#include "mqtt_codec.h"
+
+namespace {
+
+const char* TEST_PREFIX = "plant-iot/mqtt5-check";
+
+// ============ Options ============
+struct Options {
+  const char* host = "127.0.0.1";
+  uint16_t port = 1883;
+  int cycles = 50;                // Report cycles in the alias comparison
+  bool broker = true;             // Run the checks that need Mosquitto
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --host HOST            MQTT broker (127.0.0.1)\n"
+         "  --port N               broker port (1883)\n"
+         "  --cycles N             report cycles for the alias comparison (50)\n"
+         "  --no-broker            only the fallback checks (in-process brokers)\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"host", required_argument, nullptr, 'h'},
+    {"port", required_argument, nullptr, 'p'},
+    {"cycles", required_argument, nullptr, 'c'},
+    {"no-broker", no_argument, nullptr, 'n'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'h': opt.host = optarg; break;
+      case 'p': opt.port = (uint16_t)atoi(optarg); break;
+      case 'c': opt.cycles = atoi(optarg); break;
+      case 'n': opt.broker = false; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.cycles <= 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Results ============
+int failures = 0;
+
+void check(bool ok, const char* name, const std::string& detail = "") {
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+  if (!ok) failures++;
+}
+
+// ============ Socket Helpers ============
+int connect_tcp(const char* host, uint16_t port) {
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  std::string service = std::to_string(port);
+  if (getaddrinfo(host, service.c_str(), &hints, &addresses) != 0) return -1;
+  int fd = -1;
+  for (struct addrinfo* a = addresses; a && fd < 0; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd >= 0) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return fd;
+}
+
+bool send_all(int fd, const uint8_t* data, size_t length) {
+  size_t sent = 0;
+  while (length > 0 && sent < length) {
+    ssize_t n = send(fd, data + sent, length - sent, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return length > 0;
+}
+
+// ============ Observer ============
+// A raw 5.0 connection that records every PUBLISH with the properties the
+// client under test is supposed to send
+struct Received {
+  std::string topic;
+  std::string payload;
+  uint32_t messageExpiry = 0;
+  std::string responseTopic;
+  std::string correlation;
+  std::vector<std::pair<std::string, std::string>> userProperties;
+};
+
+class Observer {
+ public:
+  ~Observer() { close_connection(); }
+
+  bool open(const char* host, uint16_t port, const char* clientId) {
+    fd_ = connect_tcp(host, port);
+    if (fd_ < 0) return false;
+    uint8_t packet[256];
+    mqtt::ConnectOptions options = {};
+    options.protocolLevel = mqtt::PROTOCOL_V5;
+    options.clientId = clientId;
+    options.keepAliveSeconds = 60;
+    options.cleanSession = true;
+    if (!send_all(fd_, packet, mqtt::encode_connect(packet, sizeof(packet), options))) return false;
+    return wait_for(mqtt::CONNACK, 2000);
+  }
+
+  bool subscribe(const char* filter) {
+    uint8_t packet[256];
+    if (!send_all(fd_, packet, mqtt::encode_subscribe_v5(packet, sizeof(packet), nextPacketId_++, filter, 1))) {
+      return false;
+    }
+    return wait_for(mqtt::SUBACK, 2000);
+  }
+
+  bool publish(const char* topic, const mqtt::PublishProperties& properties, const std::string& payload,
+               bool retain = false) {
+    uint8_t packet[512];
+    size_t size = mqtt::encode_publish_v5(packet, sizeof(packet), topic, strlen(topic), properties,
+                                          (const uint8_t*)payload.data(), payload.size(), 0, retain);
+    return send_all(fd_, packet, size);
+  }
+
+  // Waits up to timeoutMs for the next PUBLISH
+  bool next(int timeoutMs, Received& out) {
+    uint64_t deadline = host::monotonic_us() + (uint64_t)timeoutMs * 1000;
+    while (received_.empty()) {
+      int64_t left = (int64_t)(deadline - host::monotonic_us()) / 1000;
+      if (left <= 0 || !read(left)) return false;
+    }
+    out = received_.front();
+    received_.erase(received_.begin());
+    return true;
+  }
+
+  void close_connection() {
+    if (fd_ >= 0) {
+      uint8_t packet[2];
+      send_all(fd_, packet, mqtt::encode_empty(packet, sizeof(packet), mqtt::DISCONNECT));
+      close(fd_);
+    }
+    fd_ = -1;
+  }
+
+ private:
+  bool wait_for(uint8_t type, int timeoutMs) {
+    uint64_t deadline = host::monotonic_us() + (uint64_t)timeoutMs * 1000;
+    while (!seen_[type]) {
+      int64_t left = (int64_t)(deadline - host::monotonic_us()) / 1000;
+      if (left <= 0 || !read(left)) return false;
+    }
+    seen_[type] = false;
+    return true;
+  }
+
+  bool read(int timeoutMs) {
+    struct pollfd p = {fd_, POLLIN, 0};
+    if (poll(&p, 1, timeoutMs) <= 0) return true;
+    uint8_t chunk[4096];
+    ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    rx_.insert(rx_.end(), chunk, chunk + n);
+
+    size_t pos = 0;
+    mqtt::Packet packet;
+    long size;
+    while ((size = mqtt::decode_packet(rx_.data() + pos, rx_.size() - pos, packet)) > 0) {
+      pos += size;
+      handle(packet);
+    }
+    if (size < 0) return false;
+    rx_.erase(rx_.begin(), rx_.begin() + pos);
+    return true;
+  }
+
+  void handle(const mqtt::Packet& packet) {
+    seen_[packet.type & 0x0F] = true;
+    mqtt::PublishView view;
+    mqtt::PublishPropertiesView props;
+    if (!mqtt::parse_publish_v5(packet, view, props)) return;
+    if (view.qos == 1) {
+      uint8_t ack[4];
+      send_all(fd_, ack, mqtt::encode_ack(ack, sizeof(ack), mqtt::PUBACK, view.packetId));
+    }
+
+    Received r;
+    r.topic.assign(view.topic, view.topicLength);
+    r.payload.assign((const char*)view.payload, view.payloadLength);
+    r.messageExpiry = props.messageExpiry;
+    if (props.responseTopic) r.responseTopic.assign(props.responseTopic, props.responseTopicLength);
+    if (props.correlationData) r.correlation.assign((const char*)props.correlationData, props.correlationLength);
+    mqtt::PropertyReader reader(props.properties, props.propertiesLength);
+    mqtt::Property p;
+    while (reader.next(p)) {
+      if (p.id == mqtt::PROP_USER_PROPERTY) {
+        r.userProperties.emplace_back(std::string((const char*)p.data, p.length),
+                                      std::string((const char*)p.data2, p.length2));
+      }
+    }
+    received_.push_back(r);
+  }
+
+  int fd_ = -1;
+  uint16_t nextPacketId_ = 1;
+  bool seen_[16] = {false};
+  std::vector<uint8_t> rx_;
+  std::vector<Received> received_;
+};
+
+// ============ Client Under Test ============
+WiFiClient transport;
+Mqtt5Client client(transport);
+std::vector<Received> delivered;
+
+void on_message(char* topic, uint8_t* payload, unsigned int length) {
+  Received r;
+  r.topic = topic;
+  r.payload.assign((const char*)payload, length);
+  if (client.responseTopic()) {
+    r.responseTopic = client.responseTopic();
+    std::string response = "{\"status\":\"ok\",\"echo\":" + r.payload + "}";
+    client.respond((const uint8_t*)response.data(), response.size());
+  }
+  delivered.push_back(r);
+}
+
+// Runs the client's loop while the observer waits for a message
+bool pump_until(Observer& observer, int timeoutMs, Received& out) {
+  uint64_t deadline = host::monotonic_us() + (uint64_t)timeoutMs * 1000;
+  while (host::monotonic_us() < deadline) {
+    client.loop();
+    if (observer.next(10, out)) return true;
+  }
+  return false;
+}
+
+// ============ Fallback (3.1.1-only broker) ============
+// Accepts connections on an ephemeral port. A 5.0 CONNECT is refused with a
+// 3.1.1 CONNACK 0x01, a 5.0 CONNACK 0x84 or by closing the socket; a 3.1.1
+// CONNECT is accepted.
+class LegacyBroker {
+ public:
+  enum Mode { REFUSE_WITH_CONNACK, REFUSE_WITH_REASON, CLOSE_CONNECTION };
+
+  bool start(Mode mode) {
+    mode_ = mode;
+    listen_ = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(listen_, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_, 4) != 0) return false;
+    getsockname(listen_, (struct sockaddr*)&address, &length);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread([this]() { run(); });
+    return true;
+  }
+
+  void stop() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    close(listen_);
+  }
+
+  uint16_t port() const { return port_; }
+  std::vector<int> levels;        // Protocol level of every CONNECT, in order
+
+ private:
+  void run() {
+    std::vector<int> open;
+    while (running_) {
+      struct pollfd p = {listen_, POLLIN, 0};
+      if (poll(&p, 1, 20) <= 0) continue;
+      int fd = accept(listen_, nullptr, nullptr);
+      if (fd < 0) continue;
+
+      // CONNECT: fixed header, then "MQTT" and the protocol level at body[6]
+      uint8_t packet[256];
+      size_t have = 0;
+      mqtt::Packet connect;
+      long size = 0;
+      while (size == 0 && have < sizeof(packet)) {
+        struct pollfd c = {fd, POLLIN, 0};
+        if (poll(&c, 1, 1000) <= 0) break;
+        ssize_t n = recv(fd, packet + have, sizeof(packet) - have, 0);
+        if (n <= 0) break;
+        have += n;
+        size = mqtt::decode_packet(packet, have, connect);
+      }
+      if (size <= 0 || connect.type != mqtt::CONNECT || connect.length < 7) {
+        close(fd);
+        continue;
+      }
+      int level = connect.body[6];
+      levels.push_back(level);
+
+      if (level == mqtt::PROTOCOL_V311) {
+        const uint8_t accepted[] = {0x20, 0x02, 0x00, 0x00};
+        send_all(fd, accepted, sizeof(accepted));
+        open.push_back(fd);
+      } else {
+        if (mode_ == REFUSE_WITH_CONNACK) {
+          const uint8_t refused[] = {0x20, 0x02, 0x00, mqtt::CONNACK_V311_BAD_PROTOCOL};
+          send_all(fd, refused, sizeof(refused));
+        } else if (mode_ == REFUSE_WITH_REASON) {
+          // Flags, reason code, no properties
+          const uint8_t refused[] = {0x20, 0x03, 0x00, mqtt::CONNACK_UNSUPPORTED_PROTOCOL, 0x00};
+          send_all(fd, refused, sizeof(refused));
+        }
+        close(fd);
+      }
+    }
+    for (int fd : open) close(fd);
+  }
+
+  Mode mode_ = REFUSE_WITH_CONNACK;
+  int listen_ = -1;
+  uint16_t port_ = 0;
+  std::atomic<bool> running_{true};
+  std::thread thread_;
+};
+
+void check_fallback(LegacyBroker::Mode mode, const char* name) {
+  LegacyBroker broker;
+  if (!broker.start(mode)) {
+    check(false, name, "cannot listen");
+    return;
+  }
+  WiFiClient socket;
+  Mqtt5Client legacy(socket);
+  legacy.setServer("127.0.0.1", broker.port());
+  bool connected = legacy.connect("mqtt5-check-fallback", "plant-iot/mqtt5-check/online", 1, true,
+                                  "{\"state\":\"offline\"}");
+  bool published = connected && legacy.publish("plant-iot/mqtt5-check/sensors", "{}");
+  legacy.disconnect();
+
+  // Reconnecting to the same broker goes straight to 3.1.1
+  legacy.setServer("127.0.0.1", broker.port());
+  bool reconnected = legacy.connect("mqtt5-check-fallback");
+  legacy.disconnect();
+  broker.stop();
+
+  std::string levels;
+  for (int level : broker.levels) levels += std::to_string(level) + " ";
+  check(connected && published && reconnected && broker.levels.size() == 3 &&
+            broker.levels[0] == mqtt::PROTOCOL_V5 && broker.levels[1] == mqtt::PROTOCOL_V311 &&
+            broker.levels[2] == mqtt::PROTOCOL_V311 && legacy.protocolLevel() == mqtt::PROTOCOL_V311,
+        name, "CONNECT levels " + levels + "then connected on " + std::to_string(legacy.protocolLevel()));
+
+  // Another broker may speak 5.0
+  legacy.setServer("127.0.0.1", broker.port() + 1);
+  check(legacy.protocolLevel() == mqtt::PROTOCOL_V5, "  5.0 again for another broker");
+}
+
+// A close before any CONNACK is a failed connect, not a version rejection
+void check_close_without_connack() {
+  LegacyBroker broker;
+  if (!broker.start(LegacyBroker::CLOSE_CONNECTION)) {
+    check(false, "no fallback after close", "cannot listen");
+    return;
+  }
+  WiFiClient socket;
+  Mqtt5Client mqtt(socket);
+  mqtt.setServer("127.0.0.1", broker.port());
+  bool first = mqtt.connect("mqtt5-check-close");
+  bool second = mqtt.connect("mqtt5-check-close");
+  broker.stop();
+
+  std::string levels;
+  for (int level : broker.levels) levels += std::to_string(level) + " ";
+  check(!first && !second && broker.levels.size() == 2 && broker.levels[0] == mqtt::PROTOCOL_V5 &&
+            broker.levels[1] == mqtt::PROTOCOL_V5 && mqtt.protocolLevel() == mqtt::PROTOCOL_V5,
+        "no fallback after close", "CONNECT levels " + levels + "state " + std::to_string(mqtt.state()));
+}
+
+// ============ Broker Checks ============
+// One report cycle of a four-plant board (topics.h / main.cpp layout)
+std::vector<std::string> cycle_topics() {
+  std::vector<std::string> topics;
+  for (int p = 0; p < 4; p++) {
+    topics.push_back(std::string(TEST_PREFIX) + "/plants/plant-" + std::to_string(p) + "/sensors/aggregated");
+  }
+  topics.push_back(std::string(TEST_PREFIX) + "/status/all");
+  topics.push_back(std::string(TEST_PREFIX) + "/status/pump");
+  return topics;
+}
+
+const char* SAMPLE_PAYLOAD =
+    "{\"temperature\":24.5,\"humidity\":61.2,\"soil_moisture\":2310,\"soil_moisture_percent\":43,"
+    "\"light_intensity\":1800,\"light_percent\":43,\"timestamp\":120000,\"boot\":7,\"seq\":1200}";
+
+void check_aliases(const Options& opt) {
+  std::vector<std::string> topics = cycle_topics();
+  uint32_t startBytes = client.bytesSent;
+  uint32_t startAliased = client.aliasedPublishes;
+  size_t legacyBytes = 0;
+  uint8_t packet[512];
+  size_t payloadLength = strlen(SAMPLE_PAYLOAD);
+  bool ok = true;
+
+  for (int cycle = 0; cycle < opt.cycles && ok; cycle++) {
+    for (const std::string& topic : topics) {
+      ok = ok && client.publish(topic.c_str(), SAMPLE_PAYLOAD);
+      legacyBytes += mqtt::encode_publish(packet, sizeof(packet), topic.c_str(), topic.size(),
+                                          (const uint8_t*)SAMPLE_PAYLOAD, payloadLength);
+    }
+    client.loop();
+  }
+  uint32_t v5Bytes = client.bytesSent - startBytes;
+  uint32_t aliased = client.aliasedPublishes - startAliased;
+
+  char detail[160];
+  snprintf(detail, sizeof(detail), "%u publishes, %u aliased; %u bytes vs %zu as 3.1.1 (%+.1f %%)",
+           (unsigned)(opt.cycles * topics.size()), aliased, v5Bytes, legacyBytes,
+           legacyBytes ? 100.0 * ((double)v5Bytes - legacyBytes) / legacyBytes : 0);
+  check(ok && aliased == (uint32_t)((opt.cycles - 1) * topics.size()), "topic aliases", detail);
+}
+
+void check_properties(const Options& opt) {
+  Observer observer;
+  std::string filter = std::string(TEST_PREFIX) + "/props";
+  if (!observer.open(opt.host, opt.port, "mqtt5-check-observer") || !observer.subscribe(filter.c_str())) {
+    check(false, "user properties and expiry", "observer could not subscribe");
+    return;
+  }
+  Received r;
+  bool got = client.publish(filter.c_str(), SAMPLE_PAYLOAD) && pump_until(observer, 2000, r);
+
+  std::string found;
+  for (const auto& p : r.userProperties) found += (found.empty() ? "" : ", ") + p.first + "=" + p.second;
+  bool schema = false, encoding = false;
+  for (const auto& p : r.userProperties) {
+    schema = schema || (p.first == "schema" && p.second == "1");
+    encoding = encoding || (p.first == "encoding" && p.second == "json");
+  }
+  // Mosquitto forwards the remaining lifetime, which is at most what was set
+  check(got && schema && encoding && r.messageExpiry > 0 && r.messageExpiry <= MQTT5_TELEMETRY_EXPIRY_S,
+        "user properties and expiry", found + ", expiry " + std::to_string(r.messageExpiry) + " s");
+}
+
+void check_expiry(const Options& opt) {
+  std::string expiring = std::string(TEST_PREFIX) + "/retained/expiring";
+  std::string lasting = std::string(TEST_PREFIX) + "/retained/lasting";
+  Observer writer;
+  if (!writer.open(opt.host, opt.port, "mqtt5-check-writer")) {
+    check(false, "message expiry", "cannot connect");
+    return;
+  }
+  mqtt::PublishProperties properties = {};
+  properties.messageExpiry = 2;
+  writer.publish(expiring.c_str(), properties, "{\"stale\":true}", true);
+  properties.messageExpiry = 0;
+  writer.publish(lasting.c_str(), properties, "{\"stale\":false}", true);
+  writer.close_connection();
+
+  host::advance_us(3000000);
+
+  Observer reader;
+  std::vector<std::string> topics;
+  if (reader.open(opt.host, opt.port, "mqtt5-check-reader")) {
+    std::string filter = std::string(TEST_PREFIX) + "/retained/+";
+    reader.subscribe(filter.c_str());
+    Received r;
+    while (reader.next(500, r)) topics.push_back(r.topic);
+  }
+
+  // Clear both retained messages again
+  Observer cleaner;
+  if (cleaner.open(opt.host, opt.port, "mqtt5-check-cleaner")) {
+    cleaner.publish(expiring.c_str(), properties, "", true);
+    cleaner.publish(lasting.c_str(), properties, "", true);
+  }
+
+  check(topics.size() == 1 && topics[0] == lasting, "message expiry",
+        std::to_string(topics.size()) + " of 2 retained messages left after 3 s");
+}
+
+void check_response(const Options& opt) {
+  std::string commands = std::string(TEST_PREFIX) + "/command";
+  std::string responses = std::string(TEST_PREFIX) + "/responses/backend-1";
+  Observer backend;
+  if (!backend.open(opt.host, opt.port, "mqtt5-check-backend") || !backend.subscribe(responses.c_str()) ||
+      !client.subscribe(commands.c_str())) {
+    check(false, "request/response", "cannot subscribe");
+    return;
+  }
+  // Let the SUBACK arrive before the request
+  for (int i = 0; i < 20; i++) {
+    client.loop();
+    delay(10);
+  }
+
+  const uint8_t correlation[] = {0x00, 0x17, 0xC0, 0xFF, 0xEE, 0x42};
+  mqtt::PublishProperties properties = {};
+  properties.responseTopic = responses.c_str();
+  properties.correlationData = correlation;
+  properties.correlationLength = sizeof(correlation);
+  uint64_t start = host::monotonic_us();
+  backend.publish(commands.c_str(), properties, "{\"action\":\"ON\"}");
+
+  Received r;
+  bool got = pump_until(backend, 2000, r);
+  double ms = (host::monotonic_us() - start) / 1000.0;
+  bool same = got && r.correlation == std::string((const char*)correlation, sizeof(correlation));
+  check(same && r.topic == responses && r.payload.find("\"status\":\"ok\"") != std::string::npos,
+        "request/response", got ? "round trip " + std::to_string(ms) + " ms" : "no response");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+  host::use_real_time();
+  host::board().serialEcho = false;
+
+  check_fallback(LegacyBroker::REFUSE_WITH_CONNACK, "fallback after CONNACK 0x01");
+  check_fallback(LegacyBroker::REFUSE_WITH_REASON, "fallback after CONNACK 0x84");
+  check_close_without_connack();
+
+  if (opt.broker) {
+    client.setServer(opt.host, opt.port);
+    client.setCallback(on_message);
+    client.setMessageExpiry(MQTT5_TELEMETRY_EXPIRY_S);
+    client.addUserProperty("schema", "1");
+    client.addUserProperty("encoding", "json");
+    if (!client.connect("mqtt5-check-device")) {
+      check(false, "connect", "state " + std::to_string(client.state()) + " (is Mosquitto running?)");
+    } else {
+      check(client.protocolLevel() == mqtt::PROTOCOL_V5, "connect", "MQTT 5.0");
+      check_aliases(opt);
+      check_properties(opt);
+      check_expiry(opt);
+      check_response(opt);
+      client.disconnect();
+    }
+  }
+
+  printf("%s\n", failures ? "FAILED" : "All checks passed");
+  return failures ? 1 : 0;
+}
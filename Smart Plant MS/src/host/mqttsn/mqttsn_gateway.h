@@ -0,0 +1,712 @@
+#ifndef HOST_MQTTSN_GATEWAY_H
+#define HOST_MQTTSN_GATEWAY_H
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "mqtt_codec.h"
+#include "mqttsn_client.h"
+#include "mqttsn_codec.h"
+#include "topics.h"
+
+// ============ MQTT-SN Gateway Stand-in ============
+// A transparent MQTT-SN gateway for testing: one UDP socket for all
+// clients and, per client, one MQTT 3.1.1 connection to the broker that
+// carries its will, subscriptions and publishes. Without a broker (local
+// mode) client publishes go to onPublish and inject() delivers to
+// subscribed clients, so the client can be tested with no broker at all.
+//
+// Predefined topic IDs follow mqttsn_client.h: ID = TopicId + 1, under
+// "plant-iot/" with TOPIC_COMPAT_FLAT and "plant-iot/<client id>/"
+// otherwise. Other topics are registered per session. Messages to a client
+// go at the QoS of its subscription; QoS 1 ones (and REGISTER) are re-sent
+// every retryMs up to MQTTSN_RETRIES times. Publishes are forwarded to the
+// broker at QoS 0 once acknowledged to the client.
+//
+// lossPercent drops that share of datagrams in each direction to exercise
+// the retransmission paths. Everything runs on one thread; onPublish is
+// called from it.
+
+namespace host {
+
+struct GatewayStats {
+  uint64_t datagramsIn = 0;
+  uint64_t datagramsOut = 0;
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+  uint64_t lost = 0;              // Datagrams dropped by lossPercent
+  uint64_t publishes = 0;         // Distinct client publishes forwarded
+  uint64_t duplicates = 0;        // Re-sent client publishes already forwarded
+  uint64_t deliveries = 0;        // Messages sent to clients
+  uint64_t retransmissions = 0;
+};
+
+class MqttSnGateway {
+ public:
+  struct Options {
+    uint16_t port = MQTTSN_GATEWAY_PORT;  // 0 = any free port
+    std::string brokerHost;               // Empty = local mode
+    uint16_t brokerPort = 1883;
+    int lossPercent = 0;
+    uint32_t seed = 1;
+    uint32_t retryMs = MQTTSN_RETRY_MS;
+  };
+
+  std::function<void(const std::string& clientId, const std::string& topic, const std::string& payload)> onPublish;
+
+  ~MqttSnGateway() { stop(); }
+
+  bool start(const Options& options) {
+    options_ = options;
+    random_.seed(options.seed);
+    fd_ = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (fd_ < 0) return false;
+    int off = 0;
+    setsockopt(fd_, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    struct sockaddr_in6 local = {};
+    local.sin6_family = AF_INET6;
+    local.sin6_addr = in6addr_any;
+    local.sin6_port = htons(options.port);
+    socklen_t length = sizeof(local);
+    if (bind(fd_, (struct sockaddr*)&local, sizeof(local)) != 0) return false;
+    getsockname(fd_, (struct sockaddr*)&local, &length);
+    port_ = ntohs(local.sin6_port);
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+    return true;
+  }
+
+  void stop() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    for (auto& s : sessions_) close_broker(s.second, false);
+    sessions_.clear();
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+  }
+
+  uint16_t port() const { return port_; }
+
+  // Delivers a message to every client subscribed to the topic (local mode)
+  void inject(const std::string& topic, const std::string& payload) {
+    std::lock_guard<std::mutex> guard(lock_);
+    injected_.emplace_back(topic, payload);
+  }
+
+  GatewayStats stats() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+  }
+
+  size_t session_count() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return sessions_.size();
+  }
+
+ private:
+  struct Pending {
+    uint8_t ackType;              // REGACK or PUBACK
+    uint16_t msgId;
+    uint16_t topicId;             // REGISTER: the ID whose held publishes it releases
+    std::vector<uint8_t> bytes;
+    uint64_t sentUs;
+    int attempts;
+  };
+
+  struct Session {
+    std::string address;          // sockaddr bytes, the session key
+    std::string clientId;
+    enum { WILL_TOPIC, WILL_MESSAGE, CONNECTED } stage = CONNECTED;
+    uint16_t keepAlive = 0;
+    uint64_t lastHeardUs = 0;
+    std::string willTopic;
+    std::string willMessage;
+    uint8_t willQos = 0;
+    bool willRetain = false;
+
+    int brokerFd = -1;
+    std::vector<uint8_t> brokerRx;
+
+    std::map<uint16_t, std::string> topics;   // Registered IDs, both directions
+    std::map<std::string, uint16_t> ids;
+    uint16_t nextTopicId = 0x100;             // Clear of the predefined range
+    std::vector<std::pair<std::string, uint8_t>> filters;
+    uint16_t nextMsgId = 1;
+    std::vector<Pending> pending;
+    std::map<uint16_t, std::vector<std::vector<uint8_t>>> held;  // Publishes waiting for a REGACK
+    uint16_t recent[64] = {0};                // Last client QoS 1 message IDs, for DUP
+    uint8_t recentPos = 0;
+  };
+
+  // ============ Event Loop ============
+  void run() {
+    while (running_) {
+      std::vector<struct pollfd> fds;
+      fds.push_back({fd_, POLLIN, 0});
+      std::vector<Session*> brokerSessions;
+      for (auto& s : sessions_) {
+        if (s.second.brokerFd >= 0) {
+          fds.push_back({s.second.brokerFd, POLLIN, 0});
+          brokerSessions.push_back(&s.second);
+        }
+      }
+      poll(fds.data(), fds.size(), 5);
+
+      if (fds[0].revents & POLLIN) receive_datagrams();
+      for (size_t i = 1; i < fds.size(); i++) {
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) read_broker(*brokerSessions[i - 1]);
+      }
+
+      std::vector<std::pair<std::string, std::string>> injected;
+      {
+        std::lock_guard<std::mutex> guard(lock_);
+        injected.swap(injected_);
+      }
+      for (const auto& m : injected) route(m.first, m.second, 1);
+
+      retransmit_and_expire();
+    }
+  }
+
+  void receive_datagrams() {
+    for (;;) {
+      uint8_t buffer[1500];
+      struct sockaddr_storage from;
+      socklen_t fromLength = sizeof(from);
+      ssize_t n = recvfrom(fd_, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr*)&from, &fromLength);
+      if (n <= 0) return;
+      {
+        std::lock_guard<std::mutex> guard(lock_);
+        stats_.datagramsIn++;
+        stats_.bytesIn += n;
+        if (lose()) {
+          stats_.lost++;
+          continue;
+        }
+      }
+      mqttsn::Message m;
+      if (!mqttsn::decode(buffer, n, m)) continue;
+      std::string address((const char*)&from, fromLength);
+      handle(address, m);
+    }
+  }
+
+  // ============ Client Messages ============
+  void handle(const std::string& address, const mqttsn::Message& m) {
+    if (m.type == mqttsn::CONNECT) {
+      handle_connect(address, m);
+      return;
+    }
+    auto it = sessions_.find(address);
+    if (it == sessions_.end()) {
+      uint8_t packet[2];
+      send_to(address, packet, mqttsn::encode_empty(packet, sizeof(packet), mqttsn::DISCONNECT));
+      return;
+    }
+    Session& s = it->second;
+    s.lastHeardUs = monotonic_us();
+
+    switch (m.type) {
+      case mqttsn::WILLTOPIC:
+        if (s.stage == Session::WILL_TOPIC && m.length >= 1) {
+          s.willQos = mqttsn::flags_qos(m.body[0]);
+          s.willRetain = m.body[0] & mqttsn::FLAG_RETAIN;
+          s.willTopic.assign((const char*)m.body + 1, m.length - 1);
+          s.stage = Session::WILL_MESSAGE;
+        }
+        if (s.stage == Session::WILL_MESSAGE) {
+          uint8_t packet[2];
+          send_to(address, packet, mqttsn::encode_empty(packet, sizeof(packet), mqttsn::WILLMSGREQ));
+        }
+        return;
+
+      case mqttsn::WILLMSG:
+        if (s.stage == Session::WILL_MESSAGE) {
+          s.willMessage.assign((const char*)m.body, m.length);
+          complete_connect(s);
+        }
+        return;
+
+      case mqttsn::REGISTER: {
+        mqttsn::RegisterView reg;
+        if (!mqttsn::parse_register(m, reg)) return;
+        uint16_t id = topic_id_for(s, std::string(reg.topic, reg.topicLength));
+        uint8_t packet[7];
+        send_to(address, packet, mqttsn::encode_ack(packet, sizeof(packet), mqttsn::REGACK, id, reg.msgId,
+                                                    mqttsn::ACCEPTED));
+        return;
+      }
+
+      case mqttsn::PUBLISH:
+        handle_publish(s, m);
+        return;
+
+      case mqttsn::SUBSCRIBE:
+        handle_subscribe(s, m);
+        return;
+
+      case mqttsn::REGACK:
+      case mqttsn::PUBACK: {
+        mqttsn::AckView ack;
+        if (!mqttsn::parse_ack(m, ack)) return;
+        for (size_t i = 0; i < s.pending.size(); i++) {
+          Pending& p = s.pending[i];
+          if (p.ackType != m.type || p.msgId != ack.msgId) continue;
+          uint16_t released = p.ackType == mqttsn::REGACK ? p.topicId : 0;
+          s.pending.erase(s.pending.begin() + i);
+          if (released) release_held(s, released);
+          break;
+        }
+        return;
+      }
+
+      case mqttsn::PINGREQ: {
+        uint8_t packet[2];
+        send_to(address, packet, mqttsn::encode_empty(packet, sizeof(packet), mqttsn::PINGRESP));
+        send_broker(s, packet, mqtt::encode_empty(packet, sizeof(packet), mqtt::PINGREQ));
+        return;
+      }
+
+      case mqttsn::DISCONNECT: {
+        uint8_t packet[2];
+        send_to(address, packet, mqttsn::encode_empty(packet, sizeof(packet), mqttsn::DISCONNECT));
+        close_broker(s, true);
+        std::lock_guard<std::mutex> guard(lock_);
+        sessions_.erase(it);
+        return;
+      }
+
+      default:
+        return;
+    }
+  }
+
+  void handle_connect(const std::string& address, const mqttsn::Message& m) {
+    mqttsn::ConnectView connect;
+    if (!mqttsn::parse_connect(m, connect)) return;
+    auto it = sessions_.find(address);
+    if (it != sessions_.end()) {
+      close_broker(it->second, false);
+      std::lock_guard<std::mutex> guard(lock_);
+      sessions_.erase(it);
+    }
+    Session s;
+    s.address = address;
+    s.clientId.assign(connect.clientId, connect.clientIdLength);
+    s.keepAlive = connect.keepAliveSeconds;
+    s.lastHeardUs = monotonic_us();
+    s.stage = connect.will ? Session::WILL_TOPIC : Session::CONNECTED;
+    Session* session;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      session = &(sessions_[address] = s);
+    }
+    if (connect.will) {
+      uint8_t packet[2];
+      send_to(address, packet, mqttsn::encode_empty(packet, sizeof(packet), mqttsn::WILLTOPICREQ));
+    } else {
+      complete_connect(*session);
+    }
+  }
+
+  void complete_connect(Session& s) {
+    s.stage = Session::CONNECTED;
+    uint8_t result = mqttsn::ACCEPTED;
+    if (!options_.brokerHost.empty() && !open_broker(s)) result = mqttsn::REJECTED_CONGESTION;
+    uint8_t packet[3];
+    send_to(s.address, packet, mqttsn::encode_connack(packet, sizeof(packet), result));
+  }
+
+  void handle_publish(Session& s, const mqttsn::Message& m) {
+    mqttsn::PublishView view;
+    if (!mqttsn::parse_publish(m, view)) return;
+    std::string topic = topic_name(s, view.topicIdType, view.topicId);
+    if (view.qos == 1) {
+      uint8_t packet[7];
+      send_to(s.address, packet, mqttsn::encode_ack(packet, sizeof(packet), mqttsn::PUBACK, view.topicId, view.msgId,
+                                                    topic.empty() ? mqttsn::REJECTED_INVALID_TOPIC
+                                                                  : mqttsn::ACCEPTED));
+    }
+    if (topic.empty()) return;
+
+    // A re-sent publish whose PUBACK was lost: acknowledged again, not forwarded
+    if (view.qos == 1) {
+      bool seen = false;
+      for (uint16_t id : s.recent) seen = seen || id == view.msgId;
+      if (seen && view.dup) {
+        std::lock_guard<std::mutex> guard(lock_);
+        stats_.duplicates++;
+        return;
+      }
+      s.recent[s.recentPos++ % 64] = view.msgId;
+    }
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stats_.publishes++;
+    }
+
+    std::string payload((const char*)view.data, view.length);
+    if (s.brokerFd >= 0) {
+      std::vector<uint8_t> packet(topic.size() + view.length + 16);
+      size_t size = mqtt::encode_publish(packet.data(), packet.size(), topic.c_str(), topic.size(), view.data,
+                                         view.length, 0, view.retain);
+      send_broker(s, packet.data(), size);
+    }
+    if (onPublish) onPublish(s.clientId, topic, payload);
+  }
+
+  void handle_subscribe(Session& s, const mqttsn::Message& m) {
+    mqttsn::SubscribeView sub;
+    if (!mqttsn::parse_subscribe(m, sub)) return;
+    uint8_t qos = sub.qos > 1 ? 1 : sub.qos;
+    std::string filter;
+    uint16_t topicId = 0;
+    if (sub.topicIdType == mqttsn::TOPIC_NORMAL) {
+      filter.assign(sub.filter, sub.filterLength);
+      if (filter.find_first_of("+#") == std::string::npos) topicId = topic_id_for(s, filter);
+    } else {
+      filter = topic_name(s, sub.topicIdType, sub.topicId);
+      topicId = sub.topicId;
+    }
+
+    uint8_t result = filter.empty() ? mqttsn::REJECTED_INVALID_TOPIC : mqttsn::ACCEPTED;
+    if (result == mqttsn::ACCEPTED) {
+      s.filters.emplace_back(filter, qos);
+      if (s.brokerFd >= 0) {
+        std::vector<uint8_t> packet(filter.size() + 16);
+        send_broker(s, packet.data(), mqtt::encode_subscribe(packet.data(), packet.size(), s.nextMsgId++,
+                                                              filter.c_str(), qos));
+      }
+    }
+    uint8_t packet[8];
+    send_to(s.address, packet, mqttsn::encode_suback(packet, sizeof(packet), qos, topicId, sub.msgId, result));
+  }
+
+  // ============ Topics ============
+  std::string predefined_name(const Session& s, uint16_t id) {
+    if (id == 0 || id > TOPIC_COUNT) return "";
+    std::string prefix = TOPIC_COMPAT_FLAT ? TOPIC_ROOT "/" : TOPIC_ROOT "/" + s.clientId + "/";
+    char name[MQTTSN_TOPIC_LEN];
+    return topic_build(name, sizeof(name), prefix.c_str(), (TopicId)(id - 1)) ? name : "";
+  }
+
+  uint16_t predefined_id(const Session& s, const std::string& topic) {
+    for (uint16_t id = 1; id <= TOPIC_COUNT; id++) {
+      if (predefined_name(s, id) == topic) return id;
+    }
+    return 0;
+  }
+
+  std::string topic_name(const Session& s, mqttsn::TopicIdType type, uint16_t id) {
+    if (type == mqttsn::TOPIC_PREDEFINED) return predefined_name(s, id);
+    if (type == mqttsn::TOPIC_SHORT) return std::string{(char)(id >> 8), (char)(id & 0xFF)};
+    auto it = s.topics.find(id);
+    return it == s.topics.end() ? "" : it->second;
+  }
+
+  uint16_t topic_id_for(Session& s, const std::string& topic) {
+    auto it = s.ids.find(topic);
+    if (it != s.ids.end()) return it->second;
+    uint16_t id = s.nextTopicId++;
+    s.ids[topic] = id;
+    s.topics[id] = topic;
+    return id;
+  }
+
+  static bool matches(const std::string& filter, const std::string& topic) {
+    size_t f = 0, t = 0;
+    while (f < filter.size()) {
+      if (filter[f] == '#') return true;
+      if (filter[f] == '+') {
+        while (t < topic.size() && topic[t] != '/') t++;
+        f++;
+        continue;
+      }
+      if (t >= topic.size() || filter[f] != topic[t]) return false;
+      f++;
+      t++;
+    }
+    return t == topic.size();
+  }
+
+  // ============ Delivery to Clients ============
+  void route(const std::string& topic, const std::string& payload, uint8_t qos) {
+    for (auto& entry : sessions_) {
+      Session& s = entry.second;
+      if (s.stage != Session::CONNECTED) continue;
+      int granted = -1;
+      for (const auto& f : s.filters) {
+        if (matches(f.first, topic) && f.second > granted) granted = f.second;
+      }
+      if (granted >= 0) deliver(s, topic, payload, granted < qos ? granted : qos);
+    }
+  }
+
+  void deliver(Session& s, const std::string& topic, const std::string& payload, uint8_t qos) {
+    mqttsn::TopicIdType type = mqttsn::TOPIC_PREDEFINED;
+    uint16_t id = predefined_id(s, topic);
+    bool announce = false;
+    if (!id) {
+      type = mqttsn::TOPIC_NORMAL;
+      announce = s.ids.find(topic) == s.ids.end();
+      id = topic_id_for(s, topic);
+    }
+
+    uint16_t msgId = qos ? s.nextMsgId++ : 0;
+    std::vector<uint8_t> bytes(payload.size() + 16);
+    bytes.resize(mqttsn::encode_publish(bytes.data(), bytes.size(), mqttsn::publish_flags(qos, false, type), id, msgId,
+                                        (const uint8_t*)payload.data(), payload.size()));
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stats_.deliveries++;
+    }
+
+    // A topic the client has not seen yet is announced with REGISTER; the
+    // publish waits for the REGACK
+    if (announce) {
+      std::vector<uint8_t> reg(topic.size() + 16);
+      uint16_t regId = s.nextMsgId++;
+      reg.resize(mqttsn::encode_register(reg.data(), reg.size(), id, regId, topic.c_str(), topic.size()));
+      reliable(s, mqttsn::REGACK, regId, id, reg);
+    }
+    auto held = s.held.find(id);
+    if (announce || held != s.held.end()) {
+      s.held[id].push_back(bytes);
+      return;
+    }
+    if (qos) {
+      reliable(s, mqttsn::PUBACK, msgId, 0, bytes);
+    } else {
+      send_to(s.address, bytes.data(), bytes.size());
+    }
+  }
+
+  void release_held(Session& s, uint16_t topicId) {
+    auto it = s.held.find(topicId);
+    if (it == s.held.end()) return;
+    std::vector<std::vector<uint8_t>> publishes;
+    publishes.swap(it->second);
+    s.held.erase(it);
+    for (auto& bytes : publishes) {
+      mqttsn::Message m;
+      mqttsn::PublishView view;
+      if (!mqttsn::decode(bytes.data(), bytes.size(), m) || !mqttsn::parse_publish(m, view)) continue;
+      if (view.qos) {
+        reliable(s, mqttsn::PUBACK, view.msgId, 0, bytes);
+      } else {
+        send_to(s.address, bytes.data(), bytes.size());
+      }
+    }
+  }
+
+  void reliable(Session& s, uint8_t ackType, uint16_t msgId, uint16_t topicId, const std::vector<uint8_t>& bytes) {
+    s.pending.push_back({ackType, msgId, topicId, bytes, monotonic_us(), 1});
+    send_to(s.address, bytes.data(), bytes.size());
+  }
+
+  void retransmit_and_expire() {
+    uint64_t now = monotonic_us();
+    std::vector<std::string> expired;
+    for (auto& entry : sessions_) {
+      Session& s = entry.second;
+      for (size_t i = 0; i < s.pending.size();) {
+        Pending& p = s.pending[i];
+        if (now - p.sentUs < options_.retryMs * 1000ULL) {
+          i++;
+          continue;
+        }
+        if (p.attempts >= MQTTSN_RETRIES) {
+          if (p.ackType == mqttsn::REGACK) s.held.erase(p.topicId);
+          s.pending.erase(s.pending.begin() + i);
+          continue;
+        }
+        if (p.bytes.size() > 2 && p.bytes[p.bytes[0] == 0x01 ? 3 : 1] == mqttsn::PUBLISH) {
+          p.bytes[p.bytes[0] == 0x01 ? 4 : 2] |= mqttsn::FLAG_DUP;
+        }
+        send_to(s.address, p.bytes.data(), p.bytes.size());
+        p.attempts++;
+        p.sentUs = now;
+        std::lock_guard<std::mutex> guard(lock_);
+        stats_.retransmissions++;
+        i++;
+      }
+      // 1.5 keep-alive intervals of silence: the client is gone
+      if (s.keepAlive && now - s.lastHeardUs > s.keepAlive * 1500000ULL) expired.push_back(entry.first);
+    }
+    for (const std::string& address : expired) {
+      Session& s = sessions_[address];
+      close_broker(s, false);     // The broker publishes the will
+      if (s.brokerFd < 0 && options_.brokerHost.empty() && onPublish && !s.willTopic.empty()) {
+        onPublish(s.clientId, s.willTopic, s.willMessage);
+      }
+      std::lock_guard<std::mutex> guard(lock_);
+      sessions_.erase(address);
+    }
+  }
+
+  // ============ Broker Link ============
+  bool open_broker(Session& s) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    std::string service = std::to_string(options_.brokerPort);
+    if (getaddrinfo(options_.brokerHost.c_str(), service.c_str(), &hints, &addresses) != 0) return false;
+    for (struct addrinfo* a = addresses; a && s.brokerFd < 0; a = a->ai_next) {
+      s.brokerFd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (s.brokerFd >= 0 && ::connect(s.brokerFd, a->ai_addr, a->ai_addrlen) != 0) {
+        close(s.brokerFd);
+        s.brokerFd = -1;
+      }
+    }
+    freeaddrinfo(addresses);
+    if (s.brokerFd < 0) return false;
+    int one = 1;
+    setsockopt(s.brokerFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    mqtt::ConnectOptions options = {};
+    options.clientId = s.clientId.c_str();
+    options.keepAliveSeconds = s.keepAlive;
+    options.cleanSession = true;
+    if (!s.willTopic.empty()) {
+      options.willTopic = s.willTopic.c_str();
+      options.willPayload = (const uint8_t*)s.willMessage.data();
+      options.willPayloadLength = s.willMessage.size();
+      options.willQos = s.willQos;
+      options.willRetain = s.willRetain;
+    }
+    std::vector<uint8_t> packet(s.clientId.size() + s.willTopic.size() + s.willMessage.size() + 32);
+    if (!send_broker(s, packet.data(), mqtt::encode_connect(packet.data(), packet.size(), options))) return false;
+
+    // Wait for the CONNACK before answering the client
+    uint64_t deadline = monotonic_us() + 2000000;
+    while (monotonic_us() < deadline) {
+      struct pollfd p = {s.brokerFd, POLLIN, 0};
+      if (poll(&p, 1, 50) <= 0) continue;
+      uint8_t chunk[64];
+      ssize_t n = recv(s.brokerFd, chunk, sizeof(chunk), 0);
+      if (n <= 0) break;
+      s.brokerRx.insert(s.brokerRx.end(), chunk, chunk + n);
+      mqtt::Packet connack;
+      long size = mqtt::decode_packet(s.brokerRx.data(), s.brokerRx.size(), connack);
+      if (size > 0) {
+        bool ok = mqtt::connack_code(connack) == 0;
+        s.brokerRx.erase(s.brokerRx.begin(), s.brokerRx.begin() + size);
+        if (ok) return true;
+        break;
+      }
+    }
+    close_broker(s, false);
+    return false;
+  }
+
+  void close_broker(Session& s, bool clean) {
+    if (s.brokerFd < 0) return;
+    if (clean) {
+      uint8_t packet[2];
+      send_broker(s, packet, mqtt::encode_empty(packet, sizeof(packet), mqtt::DISCONNECT));
+    }
+    close(s.brokerFd);
+    s.brokerFd = -1;
+  }
+
+  bool send_broker(Session& s, const uint8_t* data, size_t length) {
+    size_t sent = 0;
+    while (s.brokerFd >= 0 && length > 0 && sent < length) {
+      ssize_t n = send(s.brokerFd, data + sent, length - sent, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      sent += n;
+    }
+    return length > 0 && sent == length;
+  }
+
+  void read_broker(Session& s) {
+    uint8_t chunk[4096];
+    ssize_t n = recv(s.brokerFd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (n <= 0) {
+      // The broker dropped the client: tell it to reconnect
+      close_broker(s, false);
+      uint8_t packet[2];
+      send_to(s.address, packet, mqttsn::encode_empty(packet, sizeof(packet), mqttsn::DISCONNECT));
+      return;
+    }
+    s.brokerRx.insert(s.brokerRx.end(), chunk, chunk + n);
+
+    size_t pos = 0;
+    mqtt::Packet packet;
+    long size;
+    std::vector<std::pair<std::string, std::string>> messages;
+    while ((size = mqtt::decode_packet(s.brokerRx.data() + pos, s.brokerRx.size() - pos, packet)) > 0) {
+      pos += size;
+      mqtt::PublishView view;
+      if (!mqtt::parse_publish(packet, view)) continue;
+      if (view.qos == 1) {
+        uint8_t ack[4];
+        send_broker(s, ack, mqtt::encode_ack(ack, sizeof(ack), mqtt::PUBACK, view.packetId));
+      }
+      messages.emplace_back(std::string(view.topic, view.topicLength),
+                            std::string((const char*)view.payload, view.payloadLength));
+    }
+    s.brokerRx.erase(s.brokerRx.begin(), s.brokerRx.begin() + pos);
+
+    // The broker connection is this client's own: deliver only to it
+    for (const auto& m : messages) {
+      int granted = -1;
+      for (const auto& f : s.filters) {
+        if (matches(f.first, m.first) && f.second > granted) granted = f.second;
+      }
+      if (granted >= 0) deliver(s, m.first, m.second, granted);
+    }
+  }
+
+  // ============ UDP ============
+  bool lose() {
+    return options_.lossPercent > 0 && (int)(random_() % 100) < options_.lossPercent;
+  }
+
+  void send_to(const std::string& address, const uint8_t* data, size_t length) {
+    if (length == 0) return;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stats_.datagramsOut++;
+      stats_.bytesOut += length;
+      if (lose()) {
+        stats_.lost++;
+        return;
+      }
+    }
+    sendto(fd_, data, length, 0, (const struct sockaddr*)address.data(), address.size());
+  }
+
+  Options options_;
+  int fd_ = -1;
+  uint16_t port_ = 0;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+  std::mt19937 random_;
+  std::map<std::string, Session> sessions_;
+
+  std::mutex lock_;               // Guards stats_, injected_ and the session count
+  GatewayStats stats_;
+  std::vector<std::pair<std::string, std::string>> injected_;
+};
+
+}  // namespace host
+
+#endif
@@ -0,0 +1,505 @@
+// ============ MQTT-SN Transport Checks and Benchmark ============
+// Exercises the firmware's MQTT-SN client (src/mqttsn_client.cpp) over real
+// UDP through the WiFiUDP shim, against the gateway stand-in in
+// mqttsn_gateway.h:
+//
+//   self-test   no broker; the gateway runs in local mode and drops
+//               --loss-pct of the datagrams in each direction:
+//               - every QoS 1 sample (predefined and registered topics)
+//                 arrives, re-sent where a datagram was lost
+//               - commands on a predefined topic and on a topic matching a
+//                 wildcard subscription (announced with REGISTER) reach the
+//                 callback
+//               - the will is published once the client falls silent
+//   bench       needs Mosquitto (docker compose up mosquitto): --samples
+//               telemetry samples, one at a time, over plain MQTT 3.1.1/TCP
+//               and over MQTT-SN -> gateway -> broker. An observer
+//               subscribed on the broker timestamps each arrival.
+//
+// Bytes per sample are MQTT bytes on the device's socket, both directions.
+// "with headers" adds 28 bytes (IPv4 + UDP) per datagram, and 40 (IPv4 +
+// TCP, no options) per MQTT packet plus, at QoS 0, the broker's bare ACK;
+// it is an estimate, not a capture. Latency is publish() to arrival at the
+// observer, which includes the gateway's hop to the broker.
+//
+// Build: pio run -e native-mqttsn
+// Run:   .pio/build/native-mqttsn/program --self-test
+//        .pio/build/native-mqttsn/program --host 127.0.0.1 --samples 500
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "mqtt_codec.h"
+#include "mqttsn_client.h"
+#include "mqttsn_gateway.h"
+#include "topics.h"
+
+namespace {
+
+const char* DEVICE_ID = "mqttsn-check";
+
+// ============ Options ============
+struct Options {
+  const char* host = "127.0.0.1";
+  uint16_t port = 1883;
+  int samples = 200;
+  int qos = 1;
+  int lossPercent = 5;            // Self-test only
+  bool selfTest = false;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --self-test            client against the local gateway, no broker\n"
+         "  --loss-pct N           self-test datagram loss each way, percent (5)\n"
+         "  --host HOST            MQTT broker for the benchmark (127.0.0.1)\n"
+         "  --port N               broker port (1883)\n"
+         "  --samples N            samples per transport (200)\n"
+         "  --qos N                publish QoS, 0 or 1 (1)\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"self-test", no_argument, nullptr, 't'},
+    {"loss-pct", required_argument, nullptr, 'l'},
+    {"host", required_argument, nullptr, 'h'},
+    {"port", required_argument, nullptr, 'p'},
+    {"samples", required_argument, nullptr, 's'},
+    {"qos", required_argument, nullptr, 'q'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 't': opt.selfTest = true; break;
+      case 'l': opt.lossPercent = atoi(optarg); break;
+      case 'h': opt.host = optarg; break;
+      case 'p': opt.port = (uint16_t)atoi(optarg); break;
+      case 's': opt.samples = atoi(optarg); break;
+      case 'q': opt.qos = atoi(optarg); break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.samples <= 0 || opt.qos < 0 || opt.qos > 1 || opt.lossPercent < 0 || opt.lossPercent > 50) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Results ============
+int failures = 0;
+
+void check(bool ok, const char* name, const std::string& detail = "") {
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+  if (!ok) failures++;
+}
+
+// Shaped like serialize_sensor_data(); the sequence number identifies the sample
+std::string sample_payload(int seq) {
+  char payload[320];
+  snprintf(payload, sizeof(payload),
+           "{\"temperature\":23.4,\"humidity\":55.2,\"soil_moisture\":2210,\"soil_moisture_percent\":46.1,"
+           "\"light_intensity\":1830,\"light_percent\":44.7,\"timestamp\":%lu,\"device_id\":\"%s\","
+           "\"quality\":\"excellent\",\"boot\":3,\"seq\":%d}",
+           millis(), DEVICE_ID, seq);
+  return payload;
+}
+
+int sample_seq(const std::string& payload) {
+  size_t pos = payload.rfind("\"seq\":");
+  return pos == std::string::npos ? -1 : atoi(payload.c_str() + pos + 6);
+}
+
+// ============ Client Under Test ============
+WiFiUDP transport;
+MqttSnClient client(transport);
+std::vector<std::pair<std::string, std::string>> delivered;
+
+void on_message(char* topic, uint8_t* payload, unsigned int length) {
+  delivered.emplace_back(topic, std::string((const char*)payload, length));
+}
+
+void predefine_topics() {
+  topics_begin(DEVICE_ID);
+  for (int i = 0; i < TOPIC_COUNT; i++) client.predefine(mqttsn_predefined_id((TopicId)i), topic_name((TopicId)i));
+}
+
+// Runs the client's loop until done() or the timeout
+template <typename Done>
+bool pump_until(int timeoutMs, Done done) {
+  uint64_t deadline = host::monotonic_us() + (uint64_t)timeoutMs * 1000;
+  while (host::monotonic_us() < deadline) {
+    client.loop();
+    if (done()) return true;
+    delay(1);
+  }
+  return done();
+}
+
+// ============ Self-test ============
+void self_test(const Options& opt) {
+  host::MqttSnGateway gateway;
+  std::mutex lock;
+  std::vector<std::pair<std::string, std::string>> published;
+  gateway.onPublish = [&](const std::string&, const std::string& topic, const std::string& payload) {
+    std::lock_guard<std::mutex> guard(lock);
+    published.emplace_back(topic, payload);
+  };
+  host::MqttSnGateway::Options options;
+  options.port = 0;
+  options.lossPercent = opt.lossPercent;
+  if (!gateway.start(options)) {
+    check(false, "gateway", "cannot bind a UDP port");
+    return;
+  }
+  printf("gateway on udp/%u, %d%% loss each way\n", gateway.port(), opt.lossPercent);
+
+  predefine_topics();
+  client.setServer("127.0.0.1", gateway.port());
+  client.setCallback(on_message);
+  client.setKeepAlive(2);
+  client.setPublishQos(1);
+  const char* willTopic = topic_name(TOPIC_STATUS_ALL);
+  bool up = client.connect(DEVICE_ID, willTopic, 1, true, "{\"online\":false}");
+  check(up, "connect with will", "state " + std::to_string(client.state()));
+  if (!up) return;
+
+  // Samples: the aggregate on its predefined ID, every fifth also on a
+  // per-plant topic that has to be registered
+  std::string plantTopic = std::string(topic_device_prefix()) + "plants/1/sensors";
+  int expected = 0;
+  for (int seq = 0; seq < opt.samples; seq++) {
+    std::string payload = sample_payload(seq);
+    if (!client.publish(topic_name(TOPIC_SENSORS_AGGREGATED), payload.c_str())) break;
+    expected++;
+    if (seq % 5 == 0 && client.publish(plantTopic.c_str(), payload.c_str())) expected++;
+    client.loop();
+  }
+
+  std::vector<bool> seen(opt.samples * 2, false);
+  int distinct = 0;
+  int duplicates = 0;
+  pump_until(30000, [&]() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto& p : published) {
+      int seq = sample_seq(p.second);
+      if (seq < 0 || seq >= opt.samples) continue;
+      size_t slot = seq * 2 + (p.first == plantTopic ? 1 : 0);
+      if (seen[slot]) {
+        duplicates++;
+      } else {
+        seen[slot] = true;
+        distinct++;
+      }
+    }
+    published.clear();
+    return distinct >= expected;
+  });
+  host::GatewayStats stats = gateway.stats();
+  check(distinct == expected && expected == opt.samples + (opt.samples + 4) / 5, "qos 1 samples delivered",
+        std::to_string(distinct) + "/" + std::to_string(expected) + ", " + std::to_string(client.retransmissions) +
+            " client retransmissions, " + std::to_string(stats.duplicates) + " duplicates filtered, " +
+            std::to_string(duplicates) + " forwarded twice");
+  check(client.connected(), "gateway kept", "state " + std::to_string(client.state()));
+
+  // Commands: a predefined topic, and a wildcard match the gateway has to
+  // REGISTER before it can publish
+  std::string zoneFilter = std::string(topic_device_prefix()) + "zones/+/valve";
+  std::string zoneTopic = std::string(topic_device_prefix()) + "zones/2/valve";
+  bool subscribed = client.subscribe(topic_name(TOPIC_CMD_PUMP)) && client.subscribe(zoneFilter.c_str());
+  check(subscribed, "subscribe", "predefined and wildcard");
+  delivered.clear();
+  gateway.inject(topic_name(TOPIC_CMD_PUMP), "{\"state\":\"ON\"}");
+  gateway.inject(zoneTopic, "{\"state\":\"OPEN\"}");
+  auto got = [&](const std::string& topic) {
+    for (const auto& d : delivered) {
+      if (d.first == topic) return true;
+    }
+    return false;
+  };
+  pump_until(15000, [&]() { return got(topic_name(TOPIC_CMD_PUMP)) && got(zoneTopic); });
+  check(got(topic_name(TOPIC_CMD_PUMP)), "command on predefined topic");
+  check(got(zoneTopic), "command on registered topic", std::to_string(client.registrations) + " registrations");
+
+  // Silence for more than 1.5 keep-alive intervals: the gateway publishes the will
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    published.clear();
+  }
+  bool will = false;
+  uint64_t deadline = host::monotonic_us() + 6000000;
+  while (!will && host::monotonic_us() < deadline) {
+    delay(50);
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto& p : published) will = will || p.first == willTopic;
+  }
+  check(will, "will on silence", willTopic);
+
+  stats = gateway.stats();
+  printf("gateway: %llu datagrams in, %llu out, %llu lost, %llu retransmissions\n",
+         (unsigned long long)stats.datagramsIn, (unsigned long long)stats.datagramsOut,
+         (unsigned long long)stats.lost, (unsigned long long)stats.retransmissions);
+  client.disconnect();
+  gateway.stop();
+}
+
+// ============ Benchmark ============
+// A raw 3.1.1 connection to the broker; counts its own bytes and packets
+class RawMqtt {
+ public:
+  ~RawMqtt() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool open(const char* host, uint16_t port, const char* clientId) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host, service.c_str(), &hints, &addresses) != 0) return false;
+    for (struct addrinfo* a = addresses; a && fd_ < 0; a = a->ai_next) {
+      fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (fd_ >= 0 && ::connect(fd_, a->ai_addr, a->ai_addrlen) != 0) {
+        close(fd_);
+        fd_ = -1;
+      }
+    }
+    freeaddrinfo(addresses);
+    if (fd_ < 0) return false;
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    uint8_t packet[128];
+    mqtt::ConnectOptions options = {};
+    options.clientId = clientId;
+    options.keepAliveSeconds = 60;
+    options.cleanSession = true;
+    return write(packet, mqtt::encode_connect(packet, sizeof(packet), options)) && wait_for(mqtt::CONNACK, 2000);
+  }
+
+  bool subscribe(const char* filter) {
+    uint8_t packet[160];
+    return write(packet, mqtt::encode_subscribe(packet, sizeof(packet), nextPacketId_++, filter, 0)) &&
+           wait_for(mqtt::SUBACK, 2000);
+  }
+
+  bool publish(const char* topic, const std::string& payload, uint8_t qos) {
+    std::vector<uint8_t> packet(strlen(topic) + payload.size() + 16);
+    uint16_t packetId = qos ? nextPacketId_++ : 0;
+    size_t size = mqtt::encode_publish(packet.data(), packet.size(), topic, strlen(topic),
+                                       (const uint8_t*)payload.data(), payload.size(), qos, false, packetId);
+    return write(packet.data(), size) && (qos == 0 || wait_for(mqtt::PUBACK, 2000));
+  }
+
+  // Waits up to timeoutMs for the next PUBLISH; returns its payload
+  bool next(int timeoutMs, std::string& payload) {
+    uint64_t deadline = host::monotonic_us() + (uint64_t)timeoutMs * 1000;
+    while (messages_.empty()) {
+      int64_t left = (int64_t)(deadline - host::monotonic_us()) / 1000;
+      if (left <= 0 || !read(left)) return false;
+    }
+    payload = messages_.front();
+    messages_.erase(messages_.begin());
+    return true;
+  }
+
+  uint64_t bytes = 0;             // Both directions
+  uint64_t packets = 0;
+
+ private:
+  bool write(const uint8_t* data, size_t length) {
+    size_t sent = 0;
+    while (length > 0 && sent < length) {
+      ssize_t n = send(fd_, data + sent, length - sent, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      sent += n;
+    }
+    bytes += length;
+    packets++;
+    return length > 0;
+  }
+
+  bool wait_for(uint8_t type, int timeoutMs) {
+    uint64_t deadline = host::monotonic_us() + (uint64_t)timeoutMs * 1000;
+    while (!seen_[type]) {
+      int64_t left = (int64_t)(deadline - host::monotonic_us()) / 1000;
+      if (left <= 0 || !read(left)) return false;
+    }
+    seen_[type] = false;
+    return true;
+  }
+
+  bool read(int timeoutMs) {
+    struct pollfd p = {fd_, POLLIN, 0};
+    if (poll(&p, 1, timeoutMs) <= 0) return true;
+    uint8_t chunk[4096];
+    ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    rx_.insert(rx_.end(), chunk, chunk + n);
+
+    size_t pos = 0;
+    mqtt::Packet packet;
+    long size;
+    while ((size = mqtt::decode_packet(rx_.data() + pos, rx_.size() - pos, packet)) > 0) {
+      pos += size;
+      bytes += size;
+      packets++;
+      seen_[packet.type & 0x0F] = true;
+      mqtt::PublishView view;
+      if (mqtt::parse_publish(packet, view)) messages_.emplace_back((const char*)view.payload, view.payloadLength);
+    }
+    if (size < 0) return false;
+    rx_.erase(rx_.begin(), rx_.begin() + pos);
+    return true;
+  }
+
+  int fd_ = -1;
+  uint16_t nextPacketId_ = 1;
+  bool seen_[16] = {false};
+  std::vector<uint8_t> rx_;
+  std::vector<std::string> messages_;
+};
+
+struct Result {
+  const char* name;
+  uint64_t connectBytes = 0;
+  uint64_t bytes = 0;             // MQTT bytes, all samples
+  uint64_t headerBytes = 0;       // Estimated IP/UDP or IP/TCP headers
+  std::vector<double> latencyMs;
+  int lost = 0;
+};
+
+// Waits for sample seq at the observer, skipping stale arrivals
+bool await_sample(RawMqtt& observer, int seq, bool pumpClient) {
+  uint64_t deadline = host::monotonic_us() + 5000000;
+  while (host::monotonic_us() < deadline) {
+    if (pumpClient) client.loop();
+    std::string payload;
+    if (observer.next(pumpClient ? 1 : 50, payload) && sample_seq(payload) == seq) return true;
+  }
+  return false;
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[index];
+}
+
+void report(const Result& r, int samples) {
+  printf("%-18s %10.1f %14.1f %13llu %8.2f %8.2f %6d\n", r.name, (double)r.bytes / samples,
+         (double)(r.bytes + r.headerBytes) / samples, (unsigned long long)r.connectBytes,
+         percentile(r.latencyMs, 0.5), percentile(r.latencyMs, 0.99), r.lost);
+}
+
+void bench(const Options& opt) {
+  topics_begin(DEVICE_ID);
+  const char* topic = topic_name(TOPIC_SENSORS_AGGREGATED);
+  RawMqtt observer;
+  if (!observer.open(opt.host, opt.port, "mqttsn-bench-observer") || !observer.subscribe(topic)) {
+    check(false, "observer", std::string("cannot subscribe at ") + opt.host + " (is Mosquitto running?)");
+    return;
+  }
+
+  // ---- MQTT 3.1.1 over TCP ----
+  Result tcp;
+  tcp.name = "mqtt 3.1.1 / tcp";
+  {
+    RawMqtt device;
+    if (!device.open(opt.host, opt.port, "mqttsn-bench-tcp")) {
+      check(false, "tcp device", "cannot connect");
+      return;
+    }
+    tcp.connectBytes = device.bytes;
+    uint64_t bytes = device.bytes;
+    uint64_t packets = device.packets;
+    for (int seq = 0; seq < opt.samples; seq++) {
+      uint64_t start = host::monotonic_us();
+      if (!device.publish(topic, sample_payload(seq), opt.qos) || !await_sample(observer, seq, false)) {
+        tcp.lost++;
+        continue;
+      }
+      tcp.latencyMs.push_back((host::monotonic_us() - start) / 1000.0);
+    }
+    tcp.bytes = device.bytes - bytes;
+    tcp.headerBytes = 40 * (device.packets - packets + (opt.qos ? 0 : opt.samples));
+  }
+
+  // ---- MQTT-SN over UDP, through the gateway ----
+  Result sn;
+  sn.name = "mqtt-sn / udp";
+  host::MqttSnGateway gateway;
+  host::MqttSnGateway::Options options;
+  options.port = 0;
+  options.brokerHost = opt.host;
+  options.brokerPort = opt.port;
+  if (!gateway.start(options)) {
+    check(false, "gateway", "cannot bind a UDP port");
+    return;
+  }
+  predefine_topics();
+  client.setServer("127.0.0.1", gateway.port());
+  client.setPublishQos(opt.qos);
+  client.setKeepAlive(60);
+  if (!client.connect(DEVICE_ID)) {
+    check(false, "mqtt-sn connect", "state " + std::to_string(client.state()));
+    return;
+  }
+  sn.connectBytes = client.bytesSent + client.bytesReceived;
+  uint64_t bytes = sn.connectBytes;
+  uint64_t datagrams = gateway.stats().datagramsIn + gateway.stats().datagramsOut;
+  for (int seq = 0; seq < opt.samples; seq++) {
+    uint64_t start = host::monotonic_us();
+    if (!client.publish(topic, sample_payload(seq).c_str()) || !await_sample(observer, seq, true)) {
+      sn.lost++;
+      continue;
+    }
+    sn.latencyMs.push_back((host::monotonic_us() - start) / 1000.0);
+  }
+  pump_until(2000, []() { return false; });       // Last PUBACKs
+  host::GatewayStats stats = gateway.stats();
+  sn.bytes = client.bytesSent + client.bytesReceived - bytes;
+  sn.headerBytes = 28 * (stats.datagramsIn + stats.datagramsOut - datagrams);
+  client.disconnect();
+  gateway.stop();
+
+  printf("\n%d samples of %zu payload bytes, QoS %d\n", opt.samples, sample_payload(0).size(), opt.qos);
+  printf("%-18s %10s %14s %13s %8s %8s %6s\n", "transport", "bytes/smpl", "with headers", "connect bytes",
+         "p50 ms", "p99 ms", "lost");
+  report(tcp, opt.samples);
+  report(sn, opt.samples);
+  printf("(TCP connect bytes exclude the 3-way handshake; the gateway's own TCP hop is not counted)\n");
+  check(tcp.lost == 0 && sn.lost == 0, "all samples arrived");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+  host::use_real_time();
+  host::board().serialEcho = false;
+
+  if (opt.selfTest) {
+    self_test(opt);
+  } else {
+    bench(opt);
+  }
+
+  printf("%s\n", failures ? "FAILED" : "All checks passed");
+  return failures ? 1 : 0;
+}
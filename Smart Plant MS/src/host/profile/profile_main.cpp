@@ -0,0 +1,194 @@
+// ============ Firmware Profile Loop Timing ============
+// Measures what one pass of loop() costs in the firmware profile this binary
+// was built with (profile_presets.h): the unmodified firmware runs against
+// the host shim on the virtual clock, fed by the plant model, and every
+// loop() call is timed on the thread CPU clock. delay() only advances the
+// virtual clock, so the figure is pure firmware work. Together with the
+// flash and RAM sizes of the matching ESP32 build, report.sh turns this into
+// one comparison table per profile.
+//
+// Build: pio run -e native-profile-field
+// Run:   .pio/build/native-profile-field/program --loops 20000 --json
+
+#include <getopt.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "device_config.h"
+#include "firmware_profile.h"
+#include "../common/plant_model.h"
+#include "../common/soil_inputs.h"
+
+// Firmware entry points (src/main.cpp)
+void setup();
+void loop();
+
+namespace {
+
+// ============ Options ============
+struct Options {
+  long loops = 20000;             // Timed loop() passes
+  long warmup = 200;              // Untimed passes after setup()
+  uint32_t seed = 1;
+  bool json = false;              // One JSON object instead of the summary
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --loops N              timed loop() passes (20000)\n"
+         "  --warmup N             untimed passes after setup() (200)\n"
+         "  --seed N               plant model seed (1)\n"
+         "  --json                 print the result as one JSON object\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"loops", required_argument, nullptr, 'l'},
+    {"warmup", required_argument, nullptr, 'w'},
+    {"seed", required_argument, nullptr, 's'},
+    {"json", no_argument, nullptr, 'j'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'l': opt.loops = atol(optarg); break;
+      case 'w': opt.warmup = atol(optarg); break;
+      case 's': opt.seed = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case 'j': opt.json = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.loops < 100 || opt.warmup < 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Measurement ============
+uint64_t cpu_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+  size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+struct Traffic {
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+
+  // One plant model per soil probe; the first also drives air and light
+  std::vector<host::PlantModel> plants;
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    plants.emplace_back(opt.seed * 2654435761u + p);
+  }
+
+  Traffic traffic;
+  host::Board& b = host::board();
+  b.randomState = opt.seed ? opt.seed : 1;
+  b.serialEcho = false;
+  b.analogSource = [&](uint8_t pin) -> uint16_t {
+    if (pin == config().pins.light) return plants[0].read_light_raw(host::board().nowUs / 1000);
+    int channel = host::soil_channel_for_pin(pin);
+    return channel >= 0 ? plants[channel].read_soil_raw() : 0;
+  };
+  b.dhtTemperature = [&]() { return plants[0].read_temperature(host::board().nowUs / 1000); };
+  b.dhtHumidity = [&]() { return plants[0].read_humidity(host::board().nowUs / 1000); };
+  b.onAdvance = [&](uint64_t fromUs, uint64_t toUs) {
+    for (auto& plant : plants) plant.step(toUs / 1000, (uint32_t)((toUs - fromUs) / 1000));
+  };
+  b.onMqttPublish = [&](const char* topic, const uint8_t*, size_t length) {
+    traffic.messages++;
+    traffic.bytes += strlen(topic) + length;
+  };
+
+  setup();
+  for (long i = 0; i < opt.warmup; i++) loop();
+  traffic = Traffic();
+
+  std::vector<double> samples;
+  samples.reserve(opt.loops);
+  uint64_t virtualStartUs = b.nowUs;
+  for (long i = 0; i < opt.loops; i++) {
+    uint64_t start = cpu_ns();
+    loop();
+    samples.push_back((cpu_ns() - start) / 1000.0);
+  }
+  double virtualSeconds = (b.nowUs - virtualStartUs) / 1e6;
+
+  double total = 0;
+  for (double s : samples) total += s;
+  std::sort(samples.begin(), samples.end());
+  double mean = total / samples.size();
+  double p50 = percentile(samples, 50);
+  double p99 = percentile(samples, 99);
+  double max = samples.back();
+  double messagesPerMinute = virtualSeconds > 0 ? traffic.messages * 60.0 / virtualSeconds : 0;
+  double bytesPerMinute = virtualSeconds > 0 ? traffic.bytes * 60.0 / virtualSeconds : 0;
+
+  if (opt.json) {
+    printf("{\"profile\":\"%s\",\"plants\":%u,\"zones\":%u,\"legacy_topics\":%s,\"trace\":%s,"
+           "\"runtime_config\":%s,\"serial_log\":%s,\"device_shadow\":%s,"
+           "\"anomaly_events\":%s,\"watering_events\":%s,"
+           "\"dryness_eta\":%s,\"actuator_model\":%s,\"trend_model\":%s,\"mqtt5\":%s,\"mqttsn\":%s,\"mqtt_tls\":%s,\"mqtt_ws\":%s,"
+           "\"broker_failover\":%s,\"http_server\":%s,"
+           "\"loops\":%ld,\"loop_mean_us\":%.2f,"
+           "\"loop_p50_us\":%.2f,\"loop_p99_us\":%.2f,\"loop_max_us\":%.2f,"
+           "\"mqtt_messages_per_min\":%.1f,\"mqtt_bytes_per_min\":%.0f}\n",
+           PROFILE.name, PROFILE.plants, PROFILE.zones, PROFILE.legacyTopics ? "true" : "false",
+           PROFILE.trace ? "true" : "false", PROFILE.runtimeConfig ? "true" : "false",
+           PROFILE.serialLog ? "true" : "false", PROFILE.deviceShadow ? "true" : "false",
+           PROFILE.anomalyEvents ? "true" : "false", PROFILE.wateringEvents ? "true" : "false",
+           PROFILE.drynessEta ? "true" : "false", PROFILE.actuatorModel ? "true" : "false",
+           PROFILE.trendModel ? "true" : "false", PROFILE.mqtt5 ? "true" : "false",
+           PROFILE.mqttsn ? "true" : "false", PROFILE.mqttTls ? "true" : "false",
+           PROFILE.mqttWs ? "true" : "false", PROFILE.brokerFailover ? "true" : "false",
+           PROFILE.httpServer ? "true" : "false", opt.loops, mean, p50, p99, max,
+           messagesPerMinute, bytesPerMinute);
+    return 0;
+  }
+
+  printf("============ Profile Summary ============\n");
+  printf("Profile:            %s\n", PROFILE.name);
+  printf("Plants / zones:     %u / %u%s\n", PROFILE.plants, PROFILE.zones, PROFILE.soilMux ? " (multiplexer)" : "");
+  printf("Features:           legacy topics %s, trace %s, runtime config %s, serial log %s\n",
+         PROFILE.legacyTopics ? "on" : "off", PROFILE.trace ? "on" : "off", PROFILE.runtimeConfig ? "on" : "off",
+         PROFILE.serialLog ? "on" : "off");
+  printf("                    device shadow %s\n", PROFILE.deviceShadow ? "on" : "off");
+  printf("                    anomaly events %s, watering events %s, dryness ETA %s\n",
+         PROFILE.anomalyEvents ? "on" : "off", PROFILE.wateringEvents ? "on" : "off",
+         PROFILE.drynessEta ? "on" : "off");
+  printf("                    actuator model %s, trend model %s\n", PROFILE.actuatorModel ? "on" : "off",
+         PROFILE.trendModel ? "on" : "off");
+  printf("                    MQTT 5.0 %s, MQTT-SN %s, TLS %s, WebSocket %s\n", PROFILE.mqtt5 ? "on" : "off",
+         PROFILE.mqttsn ? "on" : "off", PROFILE.mqttTls ? "on" : "off", PROFILE.mqttWs ? "on" : "off");
+  printf("                    broker failover %s, http server %s\n", PROFILE.brokerFailover ? "on" : "off",
+         PROFILE.httpServer ? "on" : "off");
+  printf("Loop passes:        %ld (%.0f s virtual)\n", opt.loops, virtualSeconds);
+  printf("Loop CPU time:      mean %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us\n", mean, p50, p99, max);
+  printf("MQTT traffic:       %.1f messages/min, %.0f bytes/min\n", messagesPerMinute, bytesPerMinute);
+  return 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/bash
+# Firmware profile report: builds every deployment profile for the ESP32 and
+# for the host, and prints one markdown table with flash size, static RAM,
+# loop CPU time and MQTT traffic per profile.
+# Extra arguments are passed to the loop-time harness (e.g. --loops 50000).
+set -e
+
+FIRMWARE_DIR="$(cd "$(dirname "$0")/../../.." && pwd)"
+PROFILES="bench field gateway"
+
+cd "$FIRMWARE_DIR"
+
+# "RAM:   [=         ]  13.9% (used 45468 bytes from 327680 bytes)"
+used_bytes() {
+  grep "^$1:" | sed -E 's/.*\(used ([0-9]+) bytes.*/\1/' | tail -1
+}
+
+json_field() {
+  sed -E "s/.*\"$1\":\"?([^,\"}]*).*/\1/"
+}
+
+echo "| Profile | Plants | Features | Flash (bytes) | Static RAM (bytes) | Loop p50 (us) | Loop p99 (us) | MQTT msgs/min | MQTT bytes/min |"
+echo "|---|---|---|---|---|---|---|---|---|"
+
+for profile in $PROFILES; do
+  build="$(pio run -e "profile-$profile" 2>&1)" || { echo "$build" >&2; exit 1; }
+  flash="$(echo "$build" | used_bytes Flash)"
+  ram="$(echo "$build" | used_bytes RAM)"
+
+  pio run -e "native-profile-$profile" > /dev/null
+  result="$(".pio/build/native-profile-$profile/program" --json "$@")"
+
+  features=""
+  for f in legacy_topics trace runtime_config serial_log device_shadow anomaly_events watering_events dryness_eta actuator_model trend_model mqtt5 mqttsn mqtt_tls mqtt_ws broker_failover http_server; do
+    if [ "$(echo "$result" | json_field $f)" = "true" ]; then features="$features $f"; fi
+  done
+
+  echo "| $profile | $(echo "$result" | json_field plants) |${features:- -} | $flash | $ram" \
+       "| $(echo "$result" | json_field loop_p50_us) | $(echo "$result" | json_field loop_p99_us)" \
+       "| $(echo "$result" | json_field mqtt_messages_per_min) | $(echo "$result" | json_field mqtt_bytes_per_min) |"
+done
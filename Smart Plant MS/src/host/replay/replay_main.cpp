@@ -0,0 +1,394 @@
+// ============ Trace Replay ============
+// Feeds a device trace (trace_format.h) through the unmodified firmware on
+// the host: recorded sensor reads are served to the DHT, LDR and soil probe
+// inputs in order, recorded commands are delivered over the loopback broker
+// at their recorded offsets, and everything the firmware publishes is hashed.
+// Runs in virtual time, so the same trace and firmware always give the same
+// output digest and actuator sequence - usable as a regression check or with
+// `git bisect run`.
+//
+// Build: pio run -e native-replay
+// Run:   .pio/build/native-replay/program trace.bin [--out published.txt]
+//
+// Capture a trace from a device:
+//   mosquitto_sub -h localhost -t "plant-iot/<device>/trace" -N > trace.bin
+//   mosquitto_pub -h localhost -t "plant-iot/<device>/trace/command" -m '{"action":"start"}'
+//
+// Exit status: 0 if the replayed actuator sequence matches the recorded one
+// (and the digest matches --expect), 2 on divergence, 1 on errors.
+
+#include <getopt.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "loopback_broker.h"
+#include "sample_snapshot.h"
+#include "soil_probes.h"
+#include "trace_format.h"
+#include "../common/soil_inputs.h"
+
+// Firmware entry points and state (src/main.cpp)
+void setup();
+void loop();
+extern char traceTopic[];
+
+namespace {
+
+const uint8_t LIGHT_PIN = 35;
+const uint64_t NEW_SAMPLE_GAP_US = 100000;   // Reads closer than this belong to one read_sensors() pass
+const uint64_t TAIL_US = 10000000;           // Keep running after the last record
+
+// ============ Options ============
+struct Options {
+  const char* trace = nullptr;
+  const char* out = nullptr;      // Every publish, one per line
+  const char* expect = nullptr;   // Expected output digest
+  int session = 1;                // Which TRACE_START session to replay
+  bool verbose = false;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s TRACE [options]\n"
+         "  --session N            replay the Nth recording session in the file (1)\n"
+         "  --out FILE             write every published message to FILE\n"
+         "  --expect HEX           fail unless the output digest matches\n"
+         "  --verbose              echo the firmware's Serial output\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"session", required_argument, nullptr, 's'},
+    {"out", required_argument, nullptr, 'o'},
+    {"expect", required_argument, nullptr, 'e'},
+    {"verbose", no_argument, nullptr, 'v'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 's': opt.session = atoi(optarg); break;
+      case 'o': opt.out = optarg; break;
+      case 'e': opt.expect = optarg; break;
+      case 'v': opt.verbose = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (optind != argc - 1 || opt.session < 1) {
+    usage(argv[0]);
+    return false;
+  }
+  opt.trace = argv[optind];
+  return true;
+}
+
+// ============ Trace Loading ============
+// Decoded records with owned strings (chunk buffers are not kept)
+struct Event {
+  trace::RecordType type;
+  uint32_t timeMs;
+  float temperature;
+  float humidity;
+  int light;
+  int soil[trace::MAX_PLANTS];
+  std::string text;               // Device ID or command topic
+  std::string payload;
+  uint8_t actuators;
+};
+
+struct Trace {
+  std::string deviceId;
+  uint8_t plantCount = 0;
+  std::vector<Event> events;
+  uint32_t chunks = 0;
+  uint32_t missingChunks = 0;
+  uint32_t sessions = 0;
+};
+
+bool load_trace(const char* path, int session, Trace& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.insert(data.end(), buffer, buffer + n);
+  fclose(f);
+
+  size_t pos = 0;
+  bool inSession = false;
+  uint32_t expectedSequence = 0;
+  while (pos < data.size()) {
+    trace::ChunkInfo info;
+    long size = trace::decode_chunk(data.data() + pos, data.size() - pos, info);
+    if (size <= 0) {
+      fprintf(stderr, "%s: %s chunk at offset %zu\n", path, size < 0 ? "malformed" : "truncated", pos);
+      break;
+    }
+    pos += size;
+    out.chunks++;
+
+    trace::ChunkReader reader(info);
+    trace::Record r;
+    bool first = true;
+    while (reader.next(r)) {
+      if (r.type == trace::TRACE_START) {
+        out.sessions++;
+        inSession = (int)out.sessions == session;
+        if (inSession) {
+          out.deviceId.assign(r.deviceId, r.deviceIdLength);
+          out.plantCount = info.plantCount;
+          expectedSequence = info.sequence;
+        }
+      }
+      if (first && inSession) {
+        if (info.sequence != expectedSequence) out.missingChunks += info.sequence - expectedSequence;
+        expectedSequence = info.sequence + 1;
+        first = false;
+      }
+      if (!inSession || r.type == trace::TRACE_START) continue;
+
+      Event e = Event();
+      e.type = r.type;
+      e.timeMs = r.timeMs;
+      switch (r.type) {
+        case trace::TRACE_SAMPLE:
+          e.temperature = r.temperature;
+          e.humidity = r.humidity;
+          e.light = r.light;
+          memcpy(e.soil, r.soil, sizeof(e.soil));
+          break;
+        case trace::TRACE_COMMAND:
+          e.text.assign(r.topic, r.topicLength);
+          e.payload.assign((const char*)r.payload, r.payloadLength);
+          break;
+        case trace::TRACE_ACTUATORS:
+          e.actuators = r.actuators;
+          break;
+        default:
+          break;
+      }
+      out.events.push_back(e);
+    }
+    if (!reader.ok()) fprintf(stderr, "%s: malformed record in chunk %u\n", path, (unsigned)info.sequence);
+  }
+
+  if ((int)out.sessions < session) {
+    fprintf(stderr, "%s: session %d not found (%u in file)\n", path, session, (unsigned)out.sessions);
+    return false;
+  }
+  return true;
+}
+
+// ============ Replay ============
+class Replayer {
+ public:
+  explicit Replayer(const Trace& t) : trace_(t) {}
+
+  // Serves the current sample; a read after a gap starts the next one
+  const Event* sample() {
+    uint64_t now = host::board().nowUs;
+    if (!current_ || now - servedAtUs_ >= NEW_SAMPLE_GAP_US) {
+      advance_to_sample();
+      servedAtUs_ = now;
+    }
+    return current_;
+  }
+
+  // Delivers commands whose offset from the previous sample has elapsed
+  void poll() {
+    uint64_t now = host::board().nowUs;
+    while (next_ < trace_.events.size()) {
+      const Event& e = trace_.events[next_];
+      if (e.type == trace::TRACE_SAMPLE) break;
+      if (e.type == trace::TRACE_COMMAND) {
+        if (anchorSet_ && now < anchorUs_ + (uint64_t)(e.timeMs - anchorMs_) * 1000) break;
+        host::loopback().publish(e.text, e.payload);
+        commands++;
+      } else if (e.type == trace::TRACE_ACTUATORS) {
+        expected.push_back(e.actuators);
+      }
+      next_++;
+    }
+  }
+
+  bool finished() const { return next_ >= trace_.events.size(); }
+
+  uint32_t samples = 0;
+  uint32_t commands = 0;
+  uint32_t lateCommands = 0;      // Delivered after the next sample was already needed
+  std::vector<uint8_t> expected;  // Recorded actuator masks
+
+ private:
+  void advance_to_sample() {
+    while (next_ < trace_.events.size()) {
+      const Event& e = trace_.events[next_++];
+      if (e.type == trace::TRACE_SAMPLE) {
+        current_ = &e;
+        anchorSet_ = true;
+        anchorUs_ = host::board().nowUs;
+        anchorMs_ = e.timeMs;
+        samples++;
+        return;
+      }
+      // The firmware wants the next sample before these were due
+      if (e.type == trace::TRACE_COMMAND) {
+        host::loopback().publish(e.text, e.payload);
+        commands++;
+        lateCommands++;
+      } else if (e.type == trace::TRACE_ACTUATORS) {
+        expected.push_back(e.actuators);
+      }
+    }
+    // Out of samples: keep serving the last one
+  }
+
+  const Trace& trace_;
+  size_t next_ = 0;
+  const Event* current_ = nullptr;
+  uint64_t servedAtUs_ = 0;
+  bool anchorSet_ = false;
+  uint64_t anchorUs_ = 0;
+  uint32_t anchorMs_ = 0;
+};
+
+// FNV-1a over every published topic and payload
+struct Digest {
+  uint64_t hash = 1469598103934665603ULL;
+
+  void add(const std::string& data) {
+    for (unsigned char c : data) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    hash ^= 0xFF;
+    hash *= 1099511628211ULL;
+  }
+};
+
+uint8_t actuator_mask() {
+  ActuatorState actuators = snapshot_actuators();
+  return (actuators.pump ? trace::TRACE_PUMP : 0) | (actuators.fan ? trace::TRACE_FAN : 0) |
+         (actuators.growLight ? trace::TRACE_GROW_LIGHT : 0);
+}
+
+std::string mask_name(uint8_t mask) {
+  std::string s;
+  s += (mask & trace::TRACE_PUMP) ? "pump " : "";
+  s += (mask & trace::TRACE_FAN) ? "fan " : "";
+  s += (mask & trace::TRACE_GROW_LIGHT) ? "light " : "";
+  return s.empty() ? "off" : s.substr(0, s.size() - 1);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 1;
+
+  Trace t;
+  if (!load_trace(opt.trace, opt.session, t)) return 1;
+  if (t.plantCount != PLANT_COUNT) {
+    fprintf(stderr, "Trace has %u plants but this build has PLANT_COUNT=%d\n", t.plantCount, PLANT_COUNT);
+    return 1;
+  }
+
+  FILE* out = nullptr;
+  if (opt.out) {
+    out = fopen(opt.out, "w");
+    if (!out) {
+      perror(opt.out);
+      return 1;
+    }
+  }
+
+  // Same device ID as the recording, so namespaced command topics match
+  host::nvs()["identity"]["device_id"] = t.deviceId;
+
+  Replayer replay(t);
+  host::Board& b = host::board();
+  b.serialEcho = opt.verbose;
+  b.dhtHumidity = [&]() { return replay.sample() ? replay.sample()->humidity : NAN; };
+  b.dhtTemperature = [&]() { return replay.sample() ? replay.sample()->temperature : NAN; };
+  b.analogSource = [&](uint8_t pin) -> uint16_t {
+    const Event* s = replay.sample();
+    if (!s) return 0;
+    if (pin == LIGHT_PIN) return s->light;
+    int plant = host::soil_channel_for_pin(pin);
+    return plant >= 0 ? s->soil[plant] : 0;
+  };
+
+  setup();
+
+  // Observe everything the firmware publishes (except its own trace output)
+  Digest digest;
+  uint64_t published = 0;
+  int observer = host::loopback().attach([&](const std::string& topic, const std::string& payload) {
+    if (topic == traceTopic) return;
+    digest.add(topic);
+    digest.add(payload);
+    published++;
+    if (out) fprintf(out, "%s %s\n", topic.c_str(), payload.c_str());
+  });
+  host::loopback().subscribe(observer, "#");
+
+  std::vector<uint8_t> replayed;
+  replayed.push_back(actuator_mask());
+  uint64_t tailUntil = 0;
+
+  for (;;) {
+    replay.poll();
+    loop();
+    host::loopback().deliver(b.nowUs);
+
+    uint8_t mask = actuator_mask();
+    if (mask != replayed.back()) replayed.push_back(mask);
+
+    if (replay.finished()) {
+      if (!tailUntil) tailUntil = b.nowUs + TAIL_US;
+      if (b.nowUs >= tailUntil) break;
+    }
+  }
+  if (out) fclose(out);
+
+  // The recorder logs the state at start, so both sequences begin with it
+  std::vector<uint8_t> expected;
+  for (uint8_t m : replay.expected) {
+    if (expected.empty() || expected.back() != m) expected.push_back(m);
+  }
+  size_t match = 0;
+  while (match < expected.size() && match < replayed.size() && expected[match] == replayed[match]) match++;
+  bool actuatorsMatch = match == expected.size() && match == replayed.size();
+
+  char digestHex[17];
+  snprintf(digestHex, sizeof(digestHex), "%016" PRIx64, digest.hash);
+  bool digestMatch = !opt.expect || strcmp(opt.expect, digestHex) == 0;
+
+  printf("\n============ Replay Summary ============\n");
+  printf("Trace:              %s, device %s, session %d of %u\n", opt.trace, t.deviceId.c_str(), opt.session,
+         (unsigned)t.sessions);
+  printf("Chunks:             %u (%u missing)\n", (unsigned)t.chunks, (unsigned)t.missingChunks);
+  printf("Samples:            %u served\n", (unsigned)replay.samples);
+  printf("Commands:           %u delivered (%u late)\n", (unsigned)replay.commands, (unsigned)replay.lateCommands);
+  printf("Virtual time:       %.1f min\n", b.nowUs / 60e6);
+  printf("Published:          %" PRIu64 " messages, digest %s%s\n", published, digestHex,
+         opt.expect ? (digestMatch ? " (matches)" : " (MISMATCH)") : "");
+  printf("Actuator changes:   %zu recorded, %zu replayed - %s\n", expected.size(), replayed.size(),
+         actuatorsMatch ? "match" : "DIVERGED");
+  if (!actuatorsMatch) {
+    printf("  first difference at change %zu: recorded %s, replayed %s\n", match,
+           match < expected.size() ? mask_name(expected[match]).c_str() : "(end)",
+           match < replayed.size() ? mask_name(replayed[match]).c_str() : "(end)");
+  }
+  return actuatorsMatch && digestMatch ? 0 : 2;
+}
@@ -0,0 +1,184 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ============ Arduino API Shim (native builds) ============
+// Just enough of the Arduino-ESP32 core for src/main.cpp and its modules to
+// compile and run on a Linux host. Time is virtual: delay() advances the
+// clock instantly, so hours of firmware behaviour run in seconds. Pins,
+// sensors and the network are backed by host::Board (host_board.h).
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <algorithm>
+#include <string>
+
+using std::isnan;
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define DEC 10
+#define HEX 16
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define F(string_literal) (string_literal)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+template <class T, class L, class H>
+T constrain(T x, L low, H high) {
+  return x < low ? low : (x > high ? high : x);
+}
+
+// ============ String ============
+class String {
+ public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  explicit String(char c) : s_(1, c) {}
+  String(int value, unsigned char base = 10) { format((long)value, base); }
+  String(unsigned int value, unsigned char base = 10) { format((unsigned long)value, base); }
+  String(long value, unsigned char base = 10) { format(value, base); }
+  String(unsigned long value, unsigned char base = 10) { format(value, base); }
+  String(float value, unsigned int decimals = 2) { formatFloat(value, decimals); }
+  String(double value, unsigned int decimals = 2) { formatFloat(value, decimals); }
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  void reserve(unsigned int size) { s_.reserve(size); }
+  char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t pos = s_.find(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  int indexOf(const String& str, unsigned int from = 0) const {
+    size_t pos = s_.find(str.s_, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < s_.size() && to > from ? String(s_.substr(from, to - from)) : String();
+  }
+  bool startsWith(const String& prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+  long toInt() const { return atol(s_.c_str()); }
+  float toFloat() const { return atof(s_.c_str()); }
+  void toUpperCase() { for (char& c : s_) c = toupper((unsigned char)c); }
+  void toLowerCase() { for (char& c : s_) c = tolower((unsigned char)c); }
+  void trim() {
+    size_t b = s_.find_first_not_of(" \t\r\n");
+    size_t e = s_.find_last_not_of(" \t\r\n");
+    s_ = b == std::string::npos ? std::string() : s_.substr(b, e - b + 1);
+  }
+
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  bool operator==(const char* o) const { return s_ == (o ? o : ""); }
+  bool operator!=(const char* o) const { return !(*this == o); }
+  bool operator<(const String& o) const { return s_ < o.s_; }
+
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o ? o : ""; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  String& operator+=(int v) { return *this += String(v); }
+  String& operator+=(unsigned int v) { return *this += String(v); }
+  String& operator+=(long v) { return *this += String(v); }
+  String& operator+=(unsigned long v) { return *this += String(v); }
+  String& operator+=(float v) { return *this += String(v); }
+  String& operator+=(double v) { return *this += String(v); }
+
+  friend String operator+(String a, const String& b) { a += b; return a; }
+  friend String operator+(String a, const char* b) { a += b; return a; }
+
+ private:
+  void format(unsigned long value, unsigned char base) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%lu", value);
+    s_ = buf;
+  }
+  void format(long value, unsigned char base) {
+    if (base == 16) { format((unsigned long)value, base); return; }
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%ld", value);
+    s_ = buf;
+  }
+  void formatFloat(double value, unsigned int decimals) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+    s_ = buf;
+  }
+
+  std::string s_;
+};
+
+// ============ Serial ============
+class IPAddress {
+ public:
+  IPAddress(uint8_t a = 127, uint8_t b = 0, uint8_t c = 0, uint8_t d = 1) : a_(a), b_(b), c_(c), d_(d) {}
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", a_, b_, c_, d_);
+    return String(buf);
+  }
+ private:
+  uint8_t a_, b_, c_, d_;
+};
+
+class HardwareSerial {
+ public:
+  void begin(unsigned long) {}
+  size_t write(const char* s);
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(const char* s) { return write(s); }
+  size_t print(char c) { char s[2] = {c, 0}; return write(s); }
+  size_t print(const IPAddress& ip) { return print(ip.toString()); }
+  template <class T>
+  size_t print(T value) { return print(String(value)); }
+  size_t print(long value, int base) { return print(String(value, (unsigned char)base)); }
+  size_t println() { return write("\n"); }
+  template <class T>
+  size_t println(const T& value) { size_t n = print(value); return n + println(); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() {}
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef HOST_DHT_H
+#define HOST_DHT_H
+
+#include "Arduino.h"
+#include "host_board.h"
+
+// ============ DHT Shim ============
+// Readings come from host::Board::dhtTemperature / dhtHumidity (NaN if unset,
+// which the firmware treats as a failed read).
+
+#define DHT11 11
+#define DHT22 22
+
+class DHT {
+ public:
+  DHT(uint8_t, uint8_t) {}
+  void begin() {}
+  float readTemperature() {
+    host::Board& b = host::board();
+    return b.dhtTemperature ? b.dhtTemperature() : NAN;
+  }
+  float readHumidity() {
+    host::Board& b = host::board();
+    return b.dhtHumidity ? b.dhtHumidity() : NAN;
+  }
+};
+
+#endif
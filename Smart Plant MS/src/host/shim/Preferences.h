@@ -0,0 +1,73 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include "Arduino.h"
+#include "host_board.h"
+
+// ============ NVS Preferences Shim ============
+// Backed by host::nvs(), which survives simulated reboots.
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false) {
+    ns_ = name;
+    readOnly_ = readOnly;
+    open_ = true;
+    return true;
+  }
+  void end() { open_ = false; }
+
+  bool isKey(const char* key) { return open_ && store().count(key) > 0; }
+  bool remove(const char* key) { return !readOnly_ && store().erase(key) > 0; }
+  bool clear() { if (readOnly_) return false; store().clear(); return true; }
+
+  size_t putBytes(const char* key, const void* value, size_t length) {
+    if (!open_ || readOnly_) return 0;
+    store()[key] = std::string((const char*)value, length);
+    return length;
+  }
+  size_t getBytesLength(const char* key) { return isKey(key) ? store()[key].size() : 0; }
+  size_t getBytes(const char* key, void* buffer, size_t maxLength) {
+    if (!isKey(key)) return 0;
+    const std::string& v = store()[key];
+    if (v.size() > maxLength) return 0;
+    memcpy(buffer, v.data(), v.size());
+    return v.size();
+  }
+
+  size_t putString(const char* key, const char* value) { return putBytes(key, value, strlen(value)); }
+  size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+  size_t getString(const char* key, char* value, size_t maxLength) {
+    if (!isKey(key) || maxLength == 0) return 0;
+    const std::string& v = store()[key];
+    if (v.size() + 1 > maxLength) return 0;
+    memcpy(value, v.c_str(), v.size() + 1);
+    return v.size() + 1;
+  }
+  String getString(const char* key, const String& defaultValue = String()) {
+    return isKey(key) ? String(store()[key]) : defaultValue;
+  }
+
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+  size_t putULong(const char* key, uint32_t value) { return putUInt(key, value); }
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return getUInt(key, defaultValue); }
+  size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+  size_t putBool(const char* key, bool value) { return putUChar(key, value); }
+  bool getBool(const char* key, bool defaultValue = false) { return getUChar(key, defaultValue); }
+
+ private:
+  template <class T>
+  T get(const char* key, T defaultValue) {
+    T value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+  }
+  std::map<std::string, std::string>& store() { return host::nvs()[ns_]; }
+
+  std::string ns_;
+  bool readOnly_ = false;
+  bool open_ = false;
+};
+
+#endif
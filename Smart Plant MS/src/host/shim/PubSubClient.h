@@ -0,0 +1,101 @@
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "loopback_broker.h"
+
+// ============ PubSubClient Shim ============
+// Same API as knolleary/PubSubClient, connected to host::loopback(), or to a
+// real broker over TCP when host::board().mqttHost is set. The packet size
+// limit is enforced like the real library so oversized publishes fail on the
+// host exactly as they would on the device.
+
+#define MQTT_MAX_PACKET_SIZE 256
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+ public:
+  PubSubClient() {}
+  explicit PubSubClient(Client&) {}
+
+  PubSubClient& setServer(const char* domain, uint16_t port) { domain_ = domain; port_ = port; return *this; }
+  PubSubClient& setServer(IPAddress, uint16_t port) { port_ = port; return *this; }
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { callback_ = callback; return *this; }
+  PubSubClient& setClient(Client&) { return *this; }
+  PubSubClient& setKeepAlive(uint16_t seconds) { keepAlive_ = seconds; return *this; }
+  PubSubClient& setSocketTimeout(uint16_t) { return *this; }
+  bool setBufferSize(uint16_t size) { bufferSize_ = size; return size > 0; }
+  uint16_t getBufferSize() { return bufferSize_; }
+
+  bool connect(const char* id) { return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr, true); }
+  bool connect(const char* id, const char* user, const char* pass) {
+    return connect(id, user, pass, nullptr, 0, false, nullptr, true);
+  }
+  bool connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage) {
+    return connect(id, nullptr, nullptr, willTopic, willQos, willRetain, willMessage, true);
+  }
+  bool connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+               bool willRetain, const char* willMessage, bool cleanSession = true);
+
+  void disconnect();
+  bool connected();
+  int state() { connected(); return state_; }
+
+  bool publish(const char* topic, const char* payload) { return publish(topic, payload, false); }
+  bool publish(const char* topic, const char* payload, bool retained) {
+    return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, retained);
+  }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length) {
+    return publish(topic, payload, length, false);
+  }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained);
+
+  bool subscribe(const char* topic) { return subscribe(topic, 0); }
+  bool subscribe(const char* topic, uint8_t qos);
+  bool unsubscribe(const char* topic);
+
+  bool loop();
+
+  // Host-side statistics
+  uint64_t published = 0;
+  uint64_t publishFailures = 0;
+  uint64_t received = 0;
+
+ private:
+  std::string domain_;
+  uint16_t port_ = 1883;
+  std::function<void(char*, uint8_t*, unsigned int)> callback_;
+  uint16_t bufferSize_ = MQTT_MAX_PACKET_SIZE;
+  uint16_t keepAlive_ = 15;
+  int session_ = 0;
+  int state_ = MQTT_DISCONNECTED;
+  std::deque<std::pair<std::string, std::string>> inbox_;
+
+  // TCP transport
+  bool tcp_connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+                   bool willRetain, const char* willMessage, bool cleanSession);
+  bool tcp_send(const uint8_t* data, size_t length);
+  bool tcp_poll(int timeoutMs);
+  void tcp_close(int state);
+  int fd_ = -1;
+  uint16_t nextPacketId_ = 1;
+  uint64_t lastSendUs_ = 0;
+  bool pingOutstanding_ = false;
+  std::vector<uint8_t> rx_;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+#include "host_board.h"
+
+// ============ WiFi Shim ============
+// Association state and RSSI come from host::Board. PubSubClient.h brings
+// its own transport; WiFiClient is a real TCP socket and WiFiUDP a real UDP
+// socket for code that frames MQTT itself (mqtt5_client.h, mqttsn_client.h).
+// Both go to host::board().mqttHost when set. WiFiServer listens on all
+// interfaces; the clients it accepts move rather than copy.
+
+#define WL_IDLE_STATUS 0
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+#define WIFI_STA 1
+
+class Client {
+ public:
+  virtual ~Client() {}
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t* buffer, size_t size) = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+};
+
+class WiFiClient : public Client {
+ public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd) : fd_(fd) {}   // An accepted connection (WiFiServer)
+  WiFiClient(WiFiClient&& other) : fd_(other.fd_) { other.fd_ = -1; }
+  WiFiClient& operator=(WiFiClient&& other) {
+    if (this != &other) {
+      stop();
+      fd_ = other.fd_;
+      other.fd_ = -1;
+    }
+    return *this;
+  }
+  ~WiFiClient() override { stop(); }
+  int connect(const char* host, uint16_t port) override;
+  int connect(const char* host, uint16_t port, int32_t timeoutMs);   // -1 waits indefinitely
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  void setNoDelay(bool) {}
+  operator bool() { return connected(); }
+
+ private:
+  int fd_ = -1;
+};
+
+class WiFiServer {
+ public:
+  explicit WiFiServer(uint16_t port) : port_(port) {}
+  ~WiFiServer() { end(); }
+  void begin();
+  void end();
+  WiFiClient accept();              // Not connected() when nothing is pending
+  WiFiClient available() { return accept(); }
+  void setNoDelay(bool) {}
+  operator bool() const { return fd_ >= 0; }
+
+ private:
+  uint16_t port_;
+  int fd_ = -1;
+};
+
+class UDP {
+ public:
+  virtual ~UDP() {}
+  virtual uint8_t begin(uint16_t port) = 0;
+  virtual void stop() = 0;
+  virtual int beginPacket(const char* host, uint16_t port) = 0;
+  virtual int endPacket() = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+  virtual int parsePacket() = 0;
+  virtual int available() = 0;
+  virtual int read(uint8_t* buffer, size_t size) = 0;
+};
+
+class WiFiUDP : public UDP {
+ public:
+  ~WiFiUDP() override { stop(); }
+  uint8_t begin(uint16_t port) override;
+  void stop() override;
+  int beginPacket(const char* host, uint16_t port) override;
+  int endPacket() override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int parsePacket() override;
+  int available() override { return rxLength_ - rxPos_; }
+  int read(uint8_t* buffer, size_t size) override;
+
+ private:
+  int fd_ = -1;
+  uint8_t destination_[128];            // sockaddr_storage of the current packet
+  unsigned destinationLength_ = 0;
+  uint8_t tx_[1472];                    // One UDP payload on a 1500-byte MTU
+  size_t txLength_ = 0;
+  uint8_t rx_[1472];
+  size_t rxLength_ = 0;
+  size_t rxPos_ = 0;
+};
+
+class WiFiClass {
+ public:
+  void mode(int) {}
+  void begin(const char*, const char*) {}
+  void disconnect() {}
+  void setSleep(bool) {}
+  int status() { return host::board().wifiConnected ? WL_CONNECTED : WL_DISCONNECTED; }
+  IPAddress localIP() { return IPAddress(192, 168, 240, 2); }
+  long RSSI() { return host::board().rssi; }
+  void macAddress(uint8_t* mac) { memcpy(mac, host::board().mac, 6); }
+  String macAddress() {
+    const uint8_t* m = host::board().mac;
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", m[0], m[1], m[2], m[3], m[4], m[5]);
+    return String(buf);
+  }
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,135 @@
+#include "Arduino.h"
+#include "host_board.h"
+
+#include <time.h>
+
+// ============ Arduino API on the Simulated Board ============
+HardwareSerial Serial;
+
+namespace host {
+
+Board& board() {
+  static Board instance;
+  return instance;
+}
+
+uint64_t monotonic_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Brings nowUs up to date in real-time mode
+static void sync_clock() {
+  Board& b = board();
+  if (b.realTime) b.nowUs = monotonic_us() - b.realTimeOriginUs;
+}
+
+void advance_us(uint64_t us) {
+  Board& b = board();
+  uint64_t from = b.nowUs;
+  if (b.realTime) {
+    struct timespec ts = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+    nanosleep(&ts, nullptr);
+    sync_clock();
+  } else {
+    b.nowUs += us;
+  }
+  if (b.onAdvance) b.onAdvance(from, b.nowUs);
+}
+
+void use_real_time() {
+  Board& b = board();
+  b.realTime = true;
+  b.realTimeOriginUs = monotonic_us() - b.nowUs;
+}
+
+void reset_board() {
+  board() = Board();
+}
+
+std::map<std::string, std::map<std::string, std::string>>& nvs() {
+  static std::map<std::string, std::map<std::string, std::string>> store;
+  return store;
+}
+
+}  // namespace host
+
+unsigned long millis() {
+  host::sync_clock();
+  return (unsigned long)(host::board().nowUs / 1000);
+}
+
+unsigned long micros() {
+  host::sync_clock();
+  return (unsigned long)host::board().nowUs;
+}
+
+void delay(unsigned long ms) {
+  host::advance_us((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  host::advance_us(us);
+}
+
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < host::PIN_COUNT) host::board().pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  host::Board& b = host::board();
+  if (pin >= host::PIN_COUNT) return;
+  b.pinLevels[pin] = level ? HIGH : LOW;
+  if (b.onDigitalWrite) b.onDigitalWrite(pin, b.pinLevels[pin]);
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < host::PIN_COUNT ? host::board().pinLevels[pin] : LOW;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  host::Board& b = host::board();
+  return b.analogSource ? b.analogSource(pin) : 0;
+}
+
+void analogReadResolution(uint8_t) {}
+
+// xorshift32 so simulations are reproducible across platforms
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  uint32_t& s = host::board().randomState;
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  host::board().randomState = seed ? seed : 1;
+}
+
+size_t HardwareSerial::write(const char* s) {
+  host::Board& b = host::board();
+  if (b.serialSink) b.serialSink(s);
+  if (b.serialEcho) fputs(s, stdout);
+  return strlen(s);
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  host::Board& b = host::board();
+  if (!b.serialEcho && !b.serialSink) return 0;
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  write(buffer);
+  return n < 0 ? 0 : n;
+}
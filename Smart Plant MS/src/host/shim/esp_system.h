@@ -0,0 +1,53 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include "host_board.h"
+
+// ============ ESP-IDF System Shim ============
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO
+} esp_reset_reason_t;
+
+inline esp_reset_reason_t esp_reset_reason() {
+  return (esp_reset_reason_t)host::board().resetReason;
+}
+
+inline esp_err_t esp_efuse_mac_get_default(uint8_t* mac) {
+  memcpy(mac, host::board().mac, 6);
+  return ESP_OK;
+}
+
+// Hardware RNG on the device
+inline uint32_t esp_random() {
+  static std::mt19937 rng{std::random_device{}()};
+  return rng();
+}
+
+inline uint32_t esp_get_free_heap_size() {
+  return host::board().freeHeap;
+}
+
+// The host cannot reboot the process; the harness observes the flag and
+// re-runs setup() as a simulated reset.
+inline void esp_restart() {
+  host::board().restartRequested = true;
+  host::board().resetReason = ESP_RST_SW;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HOST_BOARD_H
+#define HOST_BOARD_H
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <string>
+
+// ============ Simulated Board ============
+// Backing state for the Arduino shim. Host programs (simulation, replay,
+// benchmarks) configure these hooks before calling setup() and loop().
+
+namespace host {
+
+static const int PIN_COUNT = 40;
+
+struct Board {
+  uint64_t nowUs = 0;                    // Virtual clock (or real time, see use_real_time())
+  bool realTime = false;
+  uint64_t realTimeOriginUs = 0;
+
+  uint8_t pinModes[PIN_COUNT] = {0};
+  uint8_t pinLevels[PIN_COUNT] = {0};
+
+  // Sensor sources; called whenever the firmware samples the hardware
+  std::function<uint16_t(uint8_t pin)> analogSource;
+  std::function<float()> dhtTemperature;
+  std::function<float()> dhtHumidity;
+
+  // Called on every digitalWrite (after pinLevels is updated)
+  std::function<void(uint8_t pin, uint8_t level)> onDigitalWrite;
+
+  // Called when the firmware delays; lets the host advance models in step
+  std::function<void(uint64_t fromUs, uint64_t toUs)> onAdvance;
+
+  bool serialEcho = true;                // Mirror Serial output to stdout
+  std::function<void(const char* text)> serialSink;
+
+  // MQTT transport: empty host = in-process loopback broker, otherwise a real
+  // broker over TCP (overrides the firmware's setServer())
+  std::string mqttHost;
+  uint16_t mqttPort = 1883;
+
+  // Observation hooks for everything the firmware publishes and receives
+  std::function<void(const char* topic, const uint8_t* payload, size_t length)> onMqttPublish;
+  std::function<void(const char* topic, const uint8_t* payload, size_t length)> onMqttMessage;
+
+  bool wifiConnected = true;
+  long rssi = -55;
+  uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56};
+  int resetReason = 1;                   // ESP_RST_POWERON
+  bool restartRequested = false;         // Set by esp_restart()
+  uint32_t freeHeap = 200000;
+  uint32_t randomState = 1;
+};
+
+Board& board();
+
+// Advances the virtual clock, invoking onAdvance (sleeps in real-time mode)
+void advance_us(uint64_t us);
+
+// Switches to wall-clock time: millis()/micros() follow CLOCK_MONOTONIC from
+// now on and delay() really sleeps. Used against real brokers and services.
+void use_real_time();
+
+// Monotonic wall clock in microseconds
+uint64_t monotonic_us();
+
+// Resets pins, clock and hooks to power-on defaults (NVS contents survive)
+void reset_board();
+
+// In-memory NVS: namespace -> key -> raw bytes. Survives reset_board() so
+// reboot scenarios see persisted values.
+std::map<std::string, std::map<std::string, std::string>>& nvs();
+
+}  // namespace host
+
+#endif
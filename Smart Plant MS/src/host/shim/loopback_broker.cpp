@@ -0,0 +1,140 @@
+#include "loopback_broker.h"
+#include "host_board.h"
+
+#include <string.h>
+
+namespace host {
+
+bool topic_matches(const char* filter, const char* topic) {
+  // Topics starting with '$' are not matched by wildcards at the first level
+  if (topic[0] == '$' && (filter[0] == '+' || filter[0] == '#')) return false;
+
+  while (*filter) {
+    if (*filter == '#') return true;
+    if (*filter == '+') {
+      while (*topic && *topic != '/') topic++;
+      filter++;
+    } else {
+      while (*filter && *filter != '/') {
+        if (*filter++ != *topic++) return false;
+      }
+      if (*topic && *topic != '/' ) return false;
+    }
+    if (*filter == '/') {
+      if (*topic != '/') {
+        // "a/#" also matches "a"
+        return !*topic && filter[1] == '#' && !filter[2];
+      }
+      filter++;
+      topic++;
+    } else if (*topic) {
+      return false;
+    }
+  }
+  return !*topic;
+}
+
+LoopbackBroker& loopback() {
+  static LoopbackBroker instance;
+  return instance;
+}
+
+int LoopbackBroker::attach(const Handler& handler) {
+  if (!online_) return 0;
+  Session session;
+  session.handler = handler;
+  session.active = true;
+  sessions_.push_back(session);
+  return (int)sessions_.size();
+}
+
+void LoopbackBroker::detach(int session) {
+  if (!alive(session)) return;
+  sessions_[session - 1] = Session();
+}
+
+bool LoopbackBroker::alive(int session) const {
+  return session > 0 && (size_t)session <= sessions_.size() && sessions_[session - 1].active;
+}
+
+void LoopbackBroker::set_will(int session, const std::string& topic, const std::string& payload, bool retain) {
+  if (!alive(session)) return;
+  Session& s = sessions_[session - 1];
+  s.hasWill = true;
+  s.willTopic = topic;
+  s.willPayload = payload;
+  s.willRetain = retain;
+}
+
+void LoopbackBroker::subscribe(int session, const std::string& filter) {
+  if (!alive(session)) return;
+  sessions_[session - 1].filters.push_back(filter);
+
+  for (const auto& r : retained_) {
+    if (topic_matches(filter.c_str(), r.first.c_str())) {
+      queue_.push_back({board().nowUs + latencyUs, r.first, r.second});
+    }
+  }
+}
+
+void LoopbackBroker::unsubscribe(int session, const std::string& filter) {
+  if (!alive(session)) return;
+  std::vector<std::string>& filters = sessions_[session - 1].filters;
+  for (size_t i = 0; i < filters.size(); i++) {
+    if (filters[i] == filter) {
+      filters.erase(filters.begin() + i);
+      return;
+    }
+  }
+}
+
+void LoopbackBroker::publish(const std::string& topic, const uint8_t* payload, size_t length, bool retain) {
+  if (!online_) return;
+  std::string body((const char*)payload, length);
+
+  TopicStats& s = stats[topic];
+  s.messages++;
+  s.bytes += length;
+  totalMessages++;
+  totalBytes += length;
+
+  if (retain) {
+    if (length == 0) retained_.erase(topic);
+    else retained_[topic] = body;
+  }
+  queue_.push_back({board().nowUs + latencyUs, topic, body});
+}
+
+void LoopbackBroker::deliver(uint64_t nowUs) {
+  while (!queue_.empty() && queue_.front().dueUs <= nowUs) {
+    Pending message = queue_.front();
+    queue_.pop_front();
+    for (size_t i = 0; i < sessions_.size(); i++) {
+      // Copy: handlers may attach new sessions and reallocate the vector
+      if (!sessions_[i].active) continue;
+      std::vector<std::string> filters = sessions_[i].filters;
+      for (const std::string& f : filters) {
+        if (topic_matches(f.c_str(), message.topic.c_str())) {
+          Handler handler = sessions_[i].handler;
+          handler(message.topic, message.payload);
+          break;
+        }
+      }
+    }
+  }
+}
+
+void LoopbackBroker::set_online(bool online) {
+  if (online_ && !online) {
+    // Broker going down: drops clients without firing wills (nobody to send them)
+    for (Session& s : sessions_) s = Session();
+    queue_.clear();
+  }
+  online_ = online;
+}
+
+void LoopbackBroker::reset() {
+  *this = LoopbackBroker();
+}
+
+}  // namespace host
@@ -0,0 +1,89 @@
+#ifndef HOST_LOOPBACK_BROKER_H
+#define HOST_LOOPBACK_BROKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// ============ Loopback MQTT Broker ============
+// In-process stand-in for mosquitto used by native builds. Messages are
+// routed by MQTT topic filters (+ and # wildcards) and delivered on the
+// virtual clock after an optional latency, so the firmware and host-side
+// "services" exchange messages exactly as they would through a broker.
+
+namespace host {
+
+bool topic_matches(const char* filter, const char* topic);
+
+class LoopbackBroker {
+ public:
+  typedef std::function<void(const std::string& topic, const std::string& payload)> Handler;
+
+  struct TopicStats {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+  };
+
+  // Sessions: one per connected client. Returns a session ID (> 0) or 0 if
+  // the broker is offline.
+  int attach(const Handler& handler);
+  void detach(int session);
+  bool alive(int session) const;
+
+  // Last Will, published if the session is dropped without detach()
+  void set_will(int session, const std::string& topic, const std::string& payload, bool retain);
+
+  void subscribe(int session, const std::string& filter);
+  void unsubscribe(int session, const std::string& filter);
+  void publish(const std::string& topic, const uint8_t* payload, size_t length, bool retain = false);
+  void publish(const std::string& topic, const std::string& payload, bool retain = false) {
+    publish(topic, (const uint8_t*)payload.data(), payload.size(), retain);
+  }
+
+  // Dispatches every message due at or before nowUs (including messages
+  // published by handlers during dispatch)
+  void deliver(uint64_t nowUs);
+
+  // Broker availability: going offline drops every session (firing wills)
+  void set_online(bool online);
+  bool online() const { return online_; }
+
+  void reset();
+
+  uint64_t latencyUs = 0;
+  std::map<std::string, TopicStats> stats;
+  uint64_t totalMessages = 0;
+  uint64_t totalBytes = 0;
+
+ private:
+  struct Session {
+    Handler handler;
+    std::vector<std::string> filters;
+    bool active = false;
+    bool hasWill = false;
+    std::string willTopic;
+    std::string willPayload;
+    bool willRetain = false;
+  };
+
+  struct Pending {
+    uint64_t dueUs;
+    std::string topic;
+    std::string payload;
+  };
+
+  std::vector<Session> sessions_;
+  std::deque<Pending> queue_;
+  std::map<std::string, std::string> retained_;
+  bool online_ = true;
+};
+
+LoopbackBroker& loopback();
+
+}  // namespace host
+
+#endif
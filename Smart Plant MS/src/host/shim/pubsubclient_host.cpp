@@ -0,0 +1,303 @@
+#include "PubSubClient.h"
+#include "host_board.h"
+#include "mqtt_codec.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+static const int TCP_CONNECT_TIMEOUT_MS = 5000;
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass, const char* willTopic,
+                           uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession) {
+  disconnect();
+  if (!id || !host::board().wifiConnected) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  if (!host::board().mqttHost.empty()) {
+    return tcp_connect(id, user, pass, willTopic, willQos, willRetain, willMessage, cleanSession);
+  }
+
+  session_ = host::loopback().attach([this](const std::string& topic, const std::string& payload) {
+    inbox_.push_back(std::make_pair(topic, payload));
+  });
+  if (session_ == 0) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  if (willTopic && willMessage) {
+    host::loopback().set_will(session_, willTopic, willMessage, willRetain);
+  }
+  state_ = MQTT_CONNECTED;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  if (fd_ >= 0) {
+    uint8_t packet[2];
+    tcp_send(packet, mqtt::encode_empty(packet, sizeof(packet), mqtt::DISCONNECT));
+    tcp_close(MQTT_DISCONNECTED);
+  }
+  if (host::loopback().alive(session_)) {
+    host::loopback().detach(session_);
+  }
+  session_ = 0;
+  inbox_.clear();
+  state_ = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() {
+  if (fd_ >= 0) {
+    if (!host::board().wifiConnected) tcp_close(MQTT_CONNECTION_LOST);
+    return fd_ >= 0;
+  }
+  if (session_ != 0 && (!host::loopback().alive(session_) || !host::board().wifiConnected)) {
+    if (host::loopback().alive(session_)) host::loopback().detach(session_);
+    session_ = 0;
+    inbox_.clear();
+    state_ = MQTT_CONNECTION_LOST;
+  }
+  return session_ != 0;
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  if (!connected()) return false;
+
+  // PubSubClient builds the whole packet in its buffer: fixed header (up to
+  // 5 bytes), topic length prefix, topic and payload
+  if (5 + 2 + strlen(topic) + length > bufferSize_) {
+    publishFailures++;
+    return false;
+  }
+  if (fd_ >= 0) {
+    std::vector<uint8_t> packet(bufferSize_);
+    size_t size = mqtt::encode_publish(packet.data(), packet.size(), topic, strlen(topic), payload, length,
+                                       0, retained);
+    if (!tcp_send(packet.data(), size)) return false;
+  } else {
+    host::loopback().publish(topic, payload, length, retained);
+  }
+  published++;
+  if (host::board().onMqttPublish) host::board().onMqttPublish(topic, payload, length);
+  return true;
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  if (!connected()) return false;
+  if (9 + strlen(topic) > bufferSize_) return false;
+  if (fd_ >= 0) {
+    std::vector<uint8_t> packet(bufferSize_);
+    return tcp_send(packet.data(), mqtt::encode_subscribe(packet.data(), packet.size(), nextPacketId_++, topic, qos));
+  }
+  host::loopback().subscribe(session_, topic);
+  return true;
+}
+
+bool PubSubClient::unsubscribe(const char* topic) {
+  if (!connected()) return false;
+  if (fd_ >= 0) {
+    std::vector<uint8_t> packet(bufferSize_);
+    size_t topicLength = strlen(topic);
+    mqtt::Writer w(packet.data(), packet.size());
+    w.byte((mqtt::UNSUBSCRIBE << 4) | 0x02);
+    w.varint(2 + 2 + topicLength);
+    w.u16(nextPacketId_++);
+    w.string(topic, topicLength);
+    return tcp_send(packet.data(), w.size());
+  }
+  host::loopback().unsubscribe(session_, topic);
+  return true;
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) return false;
+  if (fd_ >= 0) {
+    if (!tcp_poll(0)) return false;
+
+    // Keepalive: ping after a quiet period, drop the link if the last ping
+    // went unanswered (the real library does the same)
+    uint64_t now = host::monotonic_us();
+    if (keepAlive_ > 0 && now - lastSendUs_ > (uint64_t)keepAlive_ * 1000000) {
+      if (pingOutstanding_) {
+        tcp_close(MQTT_CONNECTION_TIMEOUT);
+        return false;
+      }
+      uint8_t packet[2];
+      if (!tcp_send(packet, mqtt::encode_empty(packet, sizeof(packet), mqtt::PINGREQ))) return false;
+      pingOutstanding_ = true;
+    }
+  } else {
+    host::loopback().deliver(host::board().nowUs);
+  }
+
+  while (!inbox_.empty() && connected()) {
+    std::pair<std::string, std::string> message = inbox_.front();
+    inbox_.pop_front();
+    if (5 + 2 + message.first.size() + message.second.size() > bufferSize_) continue;
+    received++;
+    if (host::board().onMqttMessage) {
+      host::board().onMqttMessage(message.first.c_str(), (const uint8_t*)message.second.data(),
+                                  message.second.size());
+    }
+    if (callback_) {
+      std::vector<char> topic(message.first.begin(), message.first.end());
+      topic.push_back('\0');
+      std::vector<uint8_t> payload(message.second.begin(), message.second.end());
+      payload.push_back(0);
+      callback_(topic.data(), payload.data(), message.second.size());
+    }
+  }
+  return true;
+}
+
+// ============ TCP Transport ============
+bool PubSubClient::tcp_connect(const char* id, const char* user, const char* pass, const char* willTopic,
+                               uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession) {
+  const host::Board& b = host::board();
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  std::string port = std::to_string(b.mqttPort);
+  if (getaddrinfo(b.mqttHost.c_str(), port.c_str(), &hints, &addresses) != 0) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  for (struct addrinfo* a = addresses; a && fd_ < 0; a = a->ai_next) {
+    fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd_ < 0) continue;
+    if (::connect(fd_, a->ai_addr, a->ai_addrlen) != 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd_ < 0) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+
+  mqtt::ConnectOptions options = {};
+  options.clientId = id;
+  options.keepAliveSeconds = keepAlive_;
+  options.cleanSession = cleanSession;
+  options.username = user;
+  options.password = user ? pass : nullptr;
+  if (willTopic && willMessage) {
+    options.willTopic = willTopic;
+    options.willPayload = (const uint8_t*)willMessage;
+    options.willPayloadLength = strlen(willMessage);
+    options.willQos = willQos;
+    options.willRetain = willRetain;
+  }
+  std::vector<uint8_t> packet(bufferSize_);
+  if (!tcp_send(packet.data(), mqtt::encode_connect(packet.data(), packet.size(), options))) {
+    tcp_close(MQTT_CONNECT_FAILED);
+    return false;
+  }
+
+  // The broker's first packet must be the CONNACK
+  uint64_t deadline = host::monotonic_us() + (uint64_t)TCP_CONNECT_TIMEOUT_MS * 1000;
+  state_ = MQTT_DISCONNECTED;
+  while (state_ != MQTT_CONNECTED) {
+    if (host::monotonic_us() > deadline) {
+      tcp_close(MQTT_CONNECTION_TIMEOUT);
+      return false;
+    }
+    if (!tcp_poll(50)) return false;
+  }
+  return true;
+}
+
+bool PubSubClient::tcp_send(const uint8_t* data, size_t length) {
+  if (fd_ < 0 || length == 0) return false;
+  size_t sent = 0;
+  while (sent < length) {
+    ssize_t n = send(fd_, data + sent, length - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd p = {fd_, POLLOUT, 0};
+      poll(&p, 1, 100);
+    } else {
+      tcp_close(MQTT_CONNECTION_LOST);
+      return false;
+    }
+  }
+  lastSendUs_ = host::monotonic_us();
+  return true;
+}
+
+// Reads whatever the broker sent and queues PUBLISH payloads for loop().
+// Returns false if the connection is gone.
+bool PubSubClient::tcp_poll(int timeoutMs) {
+  struct pollfd p = {fd_, POLLIN, 0};
+  if (poll(&p, 1, timeoutMs) > 0) {
+    uint8_t chunk[4096];
+    for (;;) {
+      ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+      if (n > 0) {
+        rx_.insert(rx_.end(), chunk, chunk + n);
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      tcp_close(MQTT_CONNECTION_LOST);
+      return false;
+    }
+  }
+
+  size_t pos = 0;
+  mqtt::Packet packet;
+  long size;
+  while ((size = mqtt::decode_packet(rx_.data() + pos, rx_.size() - pos, packet)) > 0) {
+    pos += size;
+    if (state_ != MQTT_CONNECTED) {
+      int code = mqtt::connack_code(packet);
+      if (code != 0) {
+        tcp_close(code > 0 ? code : MQTT_CONNECT_FAILED);
+        return false;
+      }
+      state_ = MQTT_CONNECTED;
+      pingOutstanding_ = false;
+      continue;
+    }
+    if (packet.type == mqtt::PINGRESP) {
+      pingOutstanding_ = false;
+    } else if (packet.type == mqtt::PUBLISH) {
+      mqtt::PublishView view;
+      if (!mqtt::parse_publish(packet, view)) continue;
+      inbox_.push_back(std::make_pair(std::string(view.topic, view.topicLength),
+                                      std::string((const char*)view.payload, view.payloadLength)));
+      if (view.qos == 1) {
+        uint8_t ack[4];
+        tcp_send(ack, mqtt::encode_ack(ack, sizeof(ack), mqtt::PUBACK, view.packetId));
+      }
+    }
+  }
+  if (size < 0) {
+    tcp_close(MQTT_CONNECTION_LOST);
+    return false;
+  }
+  rx_.erase(rx_.begin(), rx_.begin() + pos);
+  return fd_ >= 0;
+}
+
+void PubSubClient::tcp_close(int state) {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+  rx_.clear();
+  inbox_.clear();
+  pingOutstanding_ = false;
+  state_ = state;
+}
@@ -0,0 +1,150 @@
+#include "WiFi.h"
+#include "host_board.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+// ============ WiFiClient (TCP) ============
+// Blocking connect (bounded with the timeout overload), non-blocking reads
+// like the ESP32 WiFiClient: available() and read() never wait. host::board().mqttHost/mqttPort override the
+// address the firmware asks for, as they do for PubSubClient.
+int WiFiClient::connect(const char* host, uint16_t port) {
+  return connect(host, port, -1);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+  stop();
+  const host::Board& b = host::board();
+  if (!b.wifiConnected) return 0;
+  std::string name = b.mqttHost.empty() ? host : b.mqttHost;
+  std::string service = std::to_string(b.mqttHost.empty() ? port : b.mqttPort);
+
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  if (getaddrinfo(name.c_str(), service.c_str(), &hints, &addresses) != 0) return 0;
+  for (struct addrinfo* a = addresses; a && fd_ < 0; a = a->ai_next) {
+    fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd_ < 0) continue;
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+    bool ok = ::connect(fd_, a->ai_addr, a->ai_addrlen) == 0;
+    if (!ok && errno == EINPROGRESS) {
+      struct pollfd p = {fd_, POLLOUT, 0};
+      int error = 0;
+      socklen_t length = sizeof(error);
+      ok = poll(&p, 1, timeoutMs) > 0 && getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+    }
+    if (!ok) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd_ < 0) return 0;
+
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+  size_t sent = 0;
+  while (fd_ >= 0 && sent < size) {
+    ssize_t n = send(fd_, buffer + sent, size - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd p = {fd_, POLLOUT, 0};
+      poll(&p, 1, 100);
+    } else {
+      stop();
+    }
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  if (fd_ < 0) return 0;
+  int pending = 0;
+  if (ioctl(fd_, FIONREAD, &pending) < 0) return 0;
+  if (pending == 0) {
+    // A readable socket with nothing to read has been closed by the peer
+    struct pollfd p = {fd_, POLLIN, 0};
+    if (poll(&p, 1, 0) > 0 && (p.revents & (POLLIN | POLLHUP | POLLERR))) {
+      char probe;
+      if (recv(fd_, &probe, 1, MSG_PEEK) == 0) stop();
+    }
+  }
+  return pending;
+}
+
+int WiFiClient::read() {
+  uint8_t value;
+  return read(&value, 1) == 1 ? value : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+  if (fd_ < 0) return -1;
+  ssize_t n = recv(fd_, buffer, size, 0);
+  if (n > 0) return n;
+  if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) stop();
+  return -1;
+}
+
+void WiFiClient::stop() {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+}
+
+uint8_t WiFiClient::connected() {
+  if (fd_ >= 0 && !host::board().wifiConnected) stop();
+  if (fd_ >= 0) available();  // Notices a peer close
+  return fd_ >= 0;
+}
+
+// ============ WiFiServer (TCP) ============
+// Non-blocking accept like the ESP32 WiFiServer; accepted connections get
+// the same non-blocking reads as outgoing ones.
+void WiFiServer::begin() {
+  end();
+  fd_ = socket(AF_INET6, SOCK_STREAM, 0);
+  if (fd_ < 0) return;
+  int one = 1;
+  int zero = 0;
+  setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(fd_, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+  struct sockaddr_in6 address = {};
+  address.sin6_family = AF_INET6;
+  address.sin6_addr = in6addr_any;
+  address.sin6_port = htons(port_);
+  if (bind(fd_, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd_, 16) != 0) {
+    end();
+    return;
+  }
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+}
+
+void WiFiServer::end() {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+}
+
+WiFiClient WiFiServer::accept() {
+  if (fd_ < 0) return WiFiClient();
+  int fd = ::accept(fd_, nullptr, nullptr);
+  if (fd < 0) return WiFiClient();
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  return WiFiClient(fd);
+}
@@ -0,0 +1,95 @@
+#include "WiFi.h"
+#include "host_board.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+// ============ WiFiUDP ============
+// Non-blocking like the ESP32 WiFiUDP: parsePacket() returns 0 when no
+// datagram is waiting. host::board().mqttHost overrides the destination
+// host (not the port), as it does for WiFiClient.
+uint8_t WiFiUDP::begin(uint16_t port) {
+  stop();
+  fd_ = socket(AF_INET6, SOCK_DGRAM, 0);
+  if (fd_ < 0) return 0;
+  int off = 0;
+  setsockopt(fd_, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+  struct sockaddr_in6 local = {};
+  local.sin6_family = AF_INET6;
+  local.sin6_addr = in6addr_any;
+  local.sin6_port = htons(port);
+  if (bind(fd_, (struct sockaddr*)&local, sizeof(local)) != 0) {
+    stop();
+    return 0;
+  }
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+  rxLength_ = rxPos_ = 0;
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+  if (fd_ < 0 && !begin(0)) return 0;
+  const host::Board& b = host::board();
+  if (!b.wifiConnected) return 0;
+  std::string name = b.mqttHost.empty() ? host : b.mqttHost;
+  std::string service = std::to_string(port);
+
+  // The socket is dual-stack: resolve IPv4 addresses as v4-mapped
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET6;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = AI_V4MAPPED;
+  struct addrinfo* addresses = nullptr;
+  if (getaddrinfo(name.c_str(), service.c_str(), &hints, &addresses) != 0) return 0;
+  bool ok = addresses && addresses->ai_addrlen <= sizeof(destination_);
+  if (ok) {
+    memcpy(destination_, addresses->ai_addr, addresses->ai_addrlen);
+    destinationLength_ = addresses->ai_addrlen;
+  }
+  freeaddrinfo(addresses);
+  txLength_ = 0;
+  return ok;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+  if (txLength_ + size > sizeof(tx_)) size = sizeof(tx_) - txLength_;
+  memcpy(tx_ + txLength_, buffer, size);
+  txLength_ += size;
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  if (fd_ < 0 || !destinationLength_ || !host::board().wifiConnected) return 0;
+  ssize_t n = sendto(fd_, tx_, txLength_, 0, (struct sockaddr*)destination_, destinationLength_);
+  txLength_ = 0;
+  return n >= 0;
+}
+
+int WiFiUDP::parsePacket() {
+  rxLength_ = rxPos_ = 0;
+  if (fd_ < 0 || !host::board().wifiConnected) return 0;
+  ssize_t n = recv(fd_, rx_, sizeof(rx_), 0);
+  if (n <= 0) return 0;
+  rxLength_ = n;
+  return n;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t size) {
+  size_t left = rxLength_ - rxPos_;
+  if (left == 0) return -1;
+  if (size > left) size = left;
+  memcpy(buffer, rx_ + rxPos_, size);
+  rxPos_ += size;
+  return size;
+}
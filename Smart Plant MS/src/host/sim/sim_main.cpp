@@ -0,0 +1,414 @@
+// ============ Virtual-Time Simulation ============
+// Runs the unmodified firmware (src/*.cpp) on the host against the Arduino
+// shim in host/shim: delay() advances a virtual clock, sensors are fed by the
+// plant model in host/common/plant_model.h, actuator pins feed back into it,
+// and MQTT goes through an in-process loopback broker. A port of the
+// actuator-control service's auto-control rules closes the loop, so a day of
+// greenhouse behaviour runs in a few seconds and is bit-for-bit reproducible
+// for a given seed.
+//
+// Build: pio run -e native-sim
+// Run:   .pio/build/native-sim/program --hours 24 --seed 7
+
+#include <getopt.h>
+#include <time.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ArduinoJson.h>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "loopback_broker.h"
+#include "irrigation_zones.h"
+#include "soil_probes.h"
+#include "topics.h"
+#include "../common/plant_model.h"
+#include "../common/sequence_tracker.h"
+#include "../common/soil_inputs.h"
+
+// Firmware entry points and pins (src/main.cpp)
+void setup();
+void loop();
+
+namespace {
+
+const uint8_t PUMP_PIN = 5;
+const uint8_t FAN_PIN = 18;
+const uint8_t GROW_LIGHT_PIN = 19;
+const uint8_t LIGHT_PIN = 35;
+
+// ============ Options ============
+struct Options {
+  double hours = 24;
+  uint32_t seed = 1;
+  uint32_t latencyMs = 0;         // Broker delivery latency
+  double dropPercent = 0;         // Telemetry lost on the way to the backend
+  bool backend = true;            // Run the auto-control rules
+  bool verbose = false;           // Echo firmware Serial output
+  const char* csv = nullptr;      // Per-minute trace
+  const char* trace = nullptr;    // Record a device trace (trace_format.h)
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --hours H              virtual time to simulate (24)\n"
+         "  --seed N               plant model / noise seed (1)\n"
+         "  --latency-ms MS        loopback broker delivery latency (0)\n"
+         "  --drop-pct P           drop P %% of the telemetry the backend receives (0)\n"
+         "  --no-backend           do not run the auto-control rules\n"
+         "  --csv FILE             write a per-minute trace of the plant and actuators\n"
+         "  --trace FILE           record a device trace for host/replay\n"
+         "  --verbose              echo the firmware's Serial output\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"hours", required_argument, nullptr, 'H'},
+    {"seed", required_argument, nullptr, 's'},
+    {"latency-ms", required_argument, nullptr, 'l'},
+    {"drop-pct", required_argument, nullptr, 'D'},
+    {"no-backend", no_argument, nullptr, 'B'},
+    {"csv", required_argument, nullptr, 'c'},
+    {"trace", required_argument, nullptr, 't'},
+    {"verbose", no_argument, nullptr, 'v'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'H': opt.hours = atof(optarg); break;
+      case 's': opt.seed = strtoul(optarg, nullptr, 10); break;
+      case 'l': opt.latencyMs = strtoul(optarg, nullptr, 10); break;
+      case 'D': opt.dropPercent = atof(optarg); break;
+      case 'B': opt.backend = false; break;
+      case 'c': opt.csv = optarg; break;
+      case 't': opt.trace = optarg; break;
+      case 'v': opt.verbose = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.hours <= 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Greenhouse ============
+// One PlantModel per soil probe. Pots share the air (temperature, humidity,
+// light) of plant 0; on zone boards each pot is watered by valve p % ZONE_COUNT.
+struct Greenhouse {
+  std::vector<host::PlantModel> plants;
+
+  explicit Greenhouse(uint32_t seed) {
+    for (int p = 0; p < PLANT_COUNT; p++) {
+      host::PlantModel plant(seed * 2654435761u + p);
+      plant.baseTemperature = 26.0f;   // Warm enough that the fan has work to do
+      plant.moisturePercent = 55.0f + (plant.rng.next() % 20);
+      plants.push_back(plant);
+    }
+  }
+
+  host::PlantModel& air() { return plants[0]; }
+
+  bool watering(int plant) const {
+    const host::Board& b = host::board();
+    if (!b.pinLevels[PUMP_PIN]) return false;
+    if (ZONE_COUNT == 1) return true;
+    static const uint8_t valves[] = ZONE_VALVE_PINS;
+    return b.pinLevels[valves[plant % ZONE_COUNT]];
+  }
+
+  void step(uint64_t fromUs, uint64_t toUs) {
+    const host::Board& b = host::board();
+    uint32_t dtMs = (uint32_t)((toUs - fromUs) / 1000);
+    for (size_t p = 0; p < plants.size(); p++) {
+      plants[p].pumpOn = watering(p);
+      plants[p].fanOn = b.pinLevels[FAN_PIN];
+      plants[p].growLightOn = b.pinLevels[GROW_LIGHT_PIN];
+      plants[p].step(toUs / 1000, dtMs);
+    }
+  }
+
+  uint16_t analog_read(uint8_t pin) {
+    uint64_t nowMs = host::board().nowUs / 1000;
+    if (pin == LIGHT_PIN) return air().read_light_raw(nowMs);
+    int plant = host::soil_channel_for_pin(pin);
+    return plant >= 0 ? plants[plant].read_soil_raw() : 0;
+  }
+};
+
+// ============ Backend ============
+// Port of perform_auto_control() in services/actuator-control/main.py, fed by
+// the aggregated sensor topic and answering with command topics. Thresholds
+// are applied to the percent fields; per-plant topics on zone boards get zone
+// commands instead of the shared pump. Every message goes through the
+// sequence tracker, after an optional random drop that it should detect.
+class Backend {
+ public:
+  static const uint32_t PUMP_MAX_MS = 300000;   // activate_pump(duration=300)
+
+  explicit Backend(uint32_t seed, double dropPercent) : rng_(seed ^ 0x5eed), dropPercent_(dropPercent) {}
+
+  void begin() {
+    session_ = host::loopback().attach([this](const std::string& topic, const std::string& payload) {
+      on_message(topic, payload);
+    });
+    host::loopback().subscribe(session_, topic_name(TOPIC_SENSORS_AGGREGATED));
+    if (PLANT_COUNT > 1) {
+      host::loopback().subscribe(session_, std::string(topic_device_prefix()) + "+/sensors/aggregated");
+    }
+  }
+
+  // Enforces the pump duration limit between messages
+  void poll(uint64_t nowMs) {
+    if (pumpOn_ && nowMs - pumpStartMs_ >= PUMP_MAX_MS) {
+      command(TOPIC_CMD_PUMP, false);
+      pumpOn_ = false;
+    }
+  }
+
+  uint64_t commands = 0;
+  uint64_t dropped = 0;
+  host::SequenceTracker sequences;
+
+ private:
+  void command(TopicId id, bool on) {
+    host::loopback().publish(topic_name(id), on ? "{\"action\":\"ON\"}" : "{\"action\":\"OFF\"}");
+    commands++;
+  }
+
+  void on_message(const std::string& topic, const std::string& payload) {
+    if (dropPercent_ > 0 && (rng_.next() % 10000) < dropPercent_ * 100) {
+      dropped++;
+      return;
+    }
+    StaticJsonDocument<384> doc;
+    if (deserializeJson(doc, payload)) return;
+    uint64_t nowMs = host::board().nowUs / 1000;
+
+    // Each pot on a multi-plant board is its own logical device
+    std::string device = doc["device_id"] | "";
+    if (doc["plant_id"]) device = device + "/" + doc["plant_id"].as<const char*>();
+    sequences.observe(device, topic, {doc["boot"] | 0u, doc["seq"] | 0u});
+
+    int moisture = doc["soil_moisture_percent"] | 50;
+    float temp = doc["temperature"] | 25.0f;
+    int light = doc["light_percent"] | 50;
+
+    const char* plantId = doc["plant_id"];
+    if (plantId) {
+      water_plant(plantId, moisture);
+    } else if (moisture < 30 && !pumpOn_) {
+      command(TOPIC_CMD_PUMP, true);
+      pumpOn_ = true;
+      pumpStartMs_ = nowMs;
+    } else if (moisture > 70 && pumpOn_) {
+      command(TOPIC_CMD_PUMP, false);
+      pumpOn_ = false;
+    }
+
+    if (temp > 30 && !fanOn_) {
+      command(TOPIC_CMD_FAN, true);
+      fanOn_ = true;
+    } else if (temp < 25 && fanOn_) {
+      command(TOPIC_CMD_FAN, false);
+      fanOn_ = false;
+    }
+
+    if (light < 20 && !lightOn_) {
+      command(TOPIC_CMD_GROW_LIGHT, true);
+      lightOn_ = true;
+    } else if (light > 60 && lightOn_) {
+      command(TOPIC_CMD_GROW_LIGHT, false);
+      lightOn_ = false;
+    }
+  }
+
+  void water_plant(const char* plantId, int moisture) {
+    int plant = atoi(plantId + strlen("plant-")) - 1;
+    if (plant < 0 || moisture >= 30 || ZONE_COUNT == 1) return;
+
+    char topic[TOPIC_MAX_LEN + 32];
+    snprintf(topic, sizeof(topic), "%szones/%s/command", topic_device_prefix(), zone_id(plant % ZONE_COUNT));
+    host::loopback().publish(topic, "{\"action\":\"ON\",\"duration\":60}");
+    commands++;
+  }
+
+  int session_ = 0;
+  host::Rng rng_;
+  double dropPercent_;
+  bool pumpOn_ = false;
+  bool fanOn_ = false;
+  bool lightOn_ = false;
+  uint64_t pumpStartMs_ = 0;
+};
+
+// ============ Statistics ============
+struct ActuatorStats {
+  uint64_t onUs = 0;
+  uint32_t switches = 0;
+};
+
+struct Stats {
+  std::map<uint8_t, ActuatorStats> actuators;
+  uint64_t inRangeUs = 0;         // Plant 0 moisture within 30-70 %
+  uint64_t hotUs = 0;             // Air above 30 °C
+  float minMoisture = 100;
+  float maxMoisture = 0;
+  float maxTemperature = -100;
+
+  void advance(Greenhouse& house, uint64_t fromUs, uint64_t toUs) {
+    const host::Board& b = host::board();
+    uint64_t dt = toUs - fromUs;
+    for (uint8_t pin : {PUMP_PIN, FAN_PIN, GROW_LIGHT_PIN}) {
+      if (b.pinLevels[pin]) actuators[pin].onUs += dt;
+    }
+
+    float moisture = house.plants[0].moisturePercent;
+    float temp = house.air().air_temperature(toUs / 1000);
+    if (moisture >= 30 && moisture <= 70) inRangeUs += dt;
+    if (temp > 30) hotUs += dt;
+    minMoisture = std::min(minMoisture, moisture);
+    maxMoisture = std::max(maxMoisture, moisture);
+    maxTemperature = std::max(maxTemperature, temp);
+  }
+};
+
+double wall_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 1;
+
+  FILE* csv = nullptr;
+  if (opt.csv) {
+    csv = fopen(opt.csv, "w");
+    if (!csv) {
+      perror(opt.csv);
+      return 1;
+    }
+    fprintf(csv, "minute,moisture,temperature,light_raw,pump,fan,grow_light\n");
+  }
+
+  Greenhouse house(opt.seed);
+  Stats stats;
+  uint8_t lastLevel[host::PIN_COUNT] = {0};
+
+  host::Board& b = host::board();
+  b.randomState = opt.seed ? opt.seed : 1;
+  b.serialEcho = opt.verbose;
+  b.analogSource = [&](uint8_t pin) { return house.analog_read(pin); };
+  b.dhtTemperature = [&]() { return house.air().read_temperature(host::board().nowUs / 1000); };
+  b.dhtHumidity = [&]() { return house.air().read_humidity(host::board().nowUs / 1000); };
+  b.onDigitalWrite = [&](uint8_t pin, uint8_t level) {
+    if (level != lastLevel[pin]) {
+      lastLevel[pin] = level;
+      if (pin == PUMP_PIN || pin == FAN_PIN || pin == GROW_LIGHT_PIN) stats.actuators[pin].switches++;
+    }
+  };
+  b.onAdvance = [&](uint64_t fromUs, uint64_t toUs) {
+    // Step in at most one-second slices so long delays stay accurate
+    for (uint64_t t = fromUs; t < toUs;) {
+      uint64_t next = std::min(toUs, t + 1000000);
+      house.step(t, next);
+      stats.advance(house, t, next);
+      if (csv && next / 60000000 != t / 60000000) {
+        fprintf(csv, "%" PRIu64 ",%.2f,%.2f,%d,%d,%d,%d\n", next / 60000000, house.plants[0].moisturePercent,
+                house.air().air_temperature(next / 1000), house.air().read_light_raw(next / 1000),
+                b.pinLevels[PUMP_PIN], b.pinLevels[FAN_PIN], b.pinLevels[GROW_LIGHT_PIN]);
+      }
+      t = next;
+    }
+  };
+  host::loopback().latencyUs = (uint64_t)opt.latencyMs * 1000;
+
+  double wallStart = wall_seconds();
+  setup();
+
+  Backend backend(opt.seed, opt.dropPercent);
+  if (opt.backend) backend.begin();
+
+  // Start the firmware's trace recorder over MQTT, as an operator would
+  FILE* traceFile = nullptr;
+  std::string traceTopic = std::string(topic_device_prefix()) + "trace";
+  if (opt.trace) {
+    traceFile = fopen(opt.trace, "wb");
+    if (!traceFile) {
+      perror(opt.trace);
+      return 1;
+    }
+    int session = host::loopback().attach([&](const std::string&, const std::string& payload) {
+      fwrite(payload.data(), 1, payload.size(), traceFile);
+    });
+    host::loopback().subscribe(session, traceTopic);
+    host::loopback().publish(traceTopic + "/command", "{\"action\":\"start\",\"sink\":\"mqtt\"}");
+  }
+
+  uint64_t endUs = (uint64_t)(opt.hours * 3600e6);
+  uint64_t loops = 0;
+  while (b.nowUs < endUs) {
+    loop();
+    host::loopback().deliver(b.nowUs);
+    if (opt.backend) backend.poll(b.nowUs / 1000);
+    loops++;
+  }
+  if (traceFile) {
+    host::loopback().publish(traceTopic + "/command", "{\"action\":\"stop\"}");
+    loop();
+    host::loopback().deliver(b.nowUs);
+    fclose(traceFile);
+  }
+  double wall = wall_seconds() - wallStart;
+  if (csv) fclose(csv);
+
+  double simSeconds = b.nowUs / 1e6;
+  static const struct { uint8_t pin; const char* name; } actuators[] = {
+    {PUMP_PIN, "Pump"}, {FAN_PIN, "Fan"}, {GROW_LIGHT_PIN, "Grow light"},
+  };
+
+  printf("\n============ Simulation Summary ============\n");
+  printf("Simulated:          %.2f h (%" PRIu64 " loop iterations), seed %u\n", simSeconds / 3600, loops, opt.seed);
+  printf("Wall time:          %.2f s (%.0fx real time)\n", wall, wall > 0 ? simSeconds / wall : 0);
+  printf("Plants / zones:     %d / %d\n", PLANT_COUNT, ZONE_COUNT);
+  for (const auto& a : actuators) {
+    const ActuatorStats& s = stats.actuators[a.pin];
+    printf("%-12s        duty %5.1f %%, %u switches\n", a.name, 100.0 * s.onUs / b.nowUs, s.switches);
+  }
+  printf("Moisture:           %.1f %% of time in 30-70 %%, min %.1f %%, max %.1f %%\n",
+         100.0 * stats.inRangeUs / b.nowUs, stats.minMoisture, stats.maxMoisture);
+  printf("Temperature:        max %.1f C, %.1f min above 30 C\n", stats.maxTemperature, stats.hotUs / 60e6);
+  printf("Backend commands:   %" PRIu64 "\n", backend.commands);
+  if (opt.backend) {
+    host::LossCounters loss = backend.sequences.total();
+    printf("Telemetry loss:     %" PRIu64 " dropped, %" PRIu64 " detected lost of %" PRIu64 " (%.2f %%), "
+           "%" PRIu64 " duplicates\n",
+           backend.dropped, loss.lost, loss.received + loss.lost, 100 * loss.loss_rate(), loss.duplicates);
+    if (loss.lost) {
+      backend.sequences.for_each([](const std::string& device, const host::LossCounters& c) {
+        printf("  %-52s %8" PRIu64 " lost %6.2f %%\n", device.c_str(), c.lost, 100 * c.loss_rate());
+      });
+    }
+  }
+  printf("MQTT messages:      %" PRIu64 " (%.1f KB)\n", host::loopback().totalMessages,
+         host::loopback().totalBytes / 1024.0);
+  for (const auto& t : host::loopback().stats) {
+    printf("  %-52s %8" PRIu64 " msgs %8.1f KB\n", t.first.c_str(), t.second.messages, t.second.bytes / 1024.0);
+  }
+  return 0;
+}
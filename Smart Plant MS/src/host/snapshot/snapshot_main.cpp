@@ -0,0 +1,321 @@
+// ============ Sample Snapshot Stress Test ============
+// Hammers the firmware's sample snapshot (src/sample_snapshot.cpp on
+// include/seqlock.h) from several threads at once, the way it is shared
+// once reading, publishing and command handling run in separate tasks:
+//
+//   sensor writer    stores readings back to back; every field of reading n
+//                    is derived from n
+//   actuator writer  switches pump, fan and grow light together
+//   readers          copy the snapshot and check that it is one reading
+//                    (all fields agree), that readings never go backwards
+//                    and that the three actuators agree
+//
+// Then the same load runs against SeqLock<SampleSnapshot> directly, to
+// count reader retries, and against a mutex-protected copy for comparison.
+// Built with ThreadSanitizer in [env:native-snapshot], so a data race in
+// the seqlock fails the run even when no torn value happens to be caught.
+//
+// Build: pio run -e native-snapshot
+// Run:   .pio/build/native-snapshot/program [--seconds 2] [--readers 3]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sample_snapshot.h"
+#include "seqlock.h"
+
+namespace {
+
+// ============ Options ============
+struct Options {
+  double seconds = 2;             // Per phase
+  int readers = 3;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --seconds N            duration of each phase (2)\n"
+         "  --readers N            reader threads (3)\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"seconds", required_argument, nullptr, 's'},
+    {"readers", required_argument, nullptr, 'r'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 's': opt.seconds = atof(optarg); break;
+      case 'r': opt.readers = atoi(optarg); break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.seconds <= 0 || opt.readers <= 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Results ============
+int failures = 0;
+
+void check(bool ok, const char* name, const std::string& detail = "") {
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+  if (!ok) failures++;
+}
+
+// ============ Readings ============
+// Reading n: every field is a function of n, so a mix of two readings shows
+SensorReading make_reading(uint32_t n) {
+  SensorReading r = {};
+  r.timestamp = n;
+  r.temperature = (float)(n & 0xFFFFF);   // Exact in a float
+  r.humidity = (float)((n * 7) & 0xFFFFF);
+  r.lightIntensity = (int)(n & 0xFFF);
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    r.soilMoisture[p] = (int)((n + p) & 0xFFF);
+    r.soilMoisturePercent[p] = (uint8_t)((n + p) % 101);
+  }
+  return r;
+}
+
+bool coherent(const SampleSnapshot& s) {
+  if (s.readings == 0) return true;       // Nothing stored yet
+  if (s.readings != s.sensors.timestamp) return false;
+  SensorReading expected = make_reading(s.readings);
+  if (s.sensors.temperature != expected.temperature || s.sensors.humidity != expected.humidity ||
+      s.sensors.lightIntensity != expected.lightIntensity) {
+    return false;
+  }
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    if (s.sensors.soilMoisture[p] != expected.soilMoisture[p] ||
+        s.sensors.soilMoisturePercent[p] != expected.soilMoisturePercent[p]) {
+      return false;
+    }
+  }
+  return s.actuators.pump == s.actuators.fan && s.actuators.fan == s.actuators.growLight;
+}
+
+// ============ Shared Value Under Test ============
+// The three ways the phases share the snapshot
+struct Shared {
+  virtual ~Shared() {}
+  virtual void store_reading(uint32_t n) = 0;
+  virtual void set_actuators(bool on) = 0;
+  virtual uint32_t read(SampleSnapshot& out) = 0;   // Returns the retries
+};
+
+struct ModuleShared : Shared {
+  uint32_t base = 0;                      // Readings stored by the functional checks
+  void store_reading(uint32_t n) override { snapshot_store_reading(make_reading(base + n)); }
+  void set_actuators(bool on) override { snapshot_set_actuators({on, on, on}); }
+  uint32_t read(SampleSnapshot& out) override {
+    out = snapshot_read();
+    return 0;                             // snapshot_read() does not report retries
+  }
+};
+
+struct SeqLockShared : Shared {
+  SeqLock<SampleSnapshot> lock;
+  void store_reading(uint32_t n) override {
+    lock.update([n](SampleSnapshot& s) {
+      s.readings = n;
+      s.sensors = make_reading(n);
+    });
+  }
+  void set_actuators(bool on) override {
+    lock.update([on](SampleSnapshot& s) { s.actuators = {on, on, on}; });
+  }
+  uint32_t read(SampleSnapshot& out) override { return lock.read(out); }
+};
+
+struct MutexShared : Shared {
+  std::mutex mutex;
+  SampleSnapshot value = {};
+  void store_reading(uint32_t n) override {
+    std::lock_guard<std::mutex> guard(mutex);
+    value.readings = n;
+    value.sensors = make_reading(n);
+  }
+  void set_actuators(bool on) override {
+    std::lock_guard<std::mutex> guard(mutex);
+    value.actuators = {on, on, on};
+  }
+  uint32_t read(SampleSnapshot& out) override {
+    std::lock_guard<std::mutex> guard(mutex);
+    out = value;
+    return 0;
+  }
+};
+
+// ============ Phase ============
+struct ReaderTally {
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  uint64_t backwards = 0;
+  uint64_t retries = 0;
+  uint32_t maxRetries = 0;
+  std::vector<double> latencyNs;          // Every 64th read
+};
+
+struct PhaseResult {
+  uint64_t readings = 0;
+  uint64_t actuatorWrites = 0;
+  ReaderTally total;
+};
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+PhaseResult run_phase(const Options& opt, Shared& shared) {
+  std::atomic<bool> running{true};
+  PhaseResult result;
+
+  std::thread sensor([&]() {
+    uint32_t n = 0;
+    while (running.load(std::memory_order_relaxed)) shared.store_reading(++n);
+    result.readings = n;
+  });
+  std::thread actuator([&]() {
+    uint64_t k = 0;
+    while (running.load(std::memory_order_relaxed)) {
+      shared.set_actuators(++k & 1);
+      std::this_thread::yield();          // Commands are rarer than readings
+    }
+    result.actuatorWrites = k;
+  });
+
+  std::vector<ReaderTally> tallies(opt.readers);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < opt.readers; i++) {
+    readers.emplace_back([&, i]() {
+      ReaderTally& t = tallies[i];
+      uint32_t last = 0;
+      SampleSnapshot s;
+      while (running.load(std::memory_order_relaxed)) {
+        bool timed = (t.reads & 63) == 0;
+        auto begin = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        uint32_t retries = shared.read(s);
+        if (timed) {
+          t.latencyNs.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin)
+                                    .count());
+        }
+        t.reads++;
+        t.retries += retries;
+        t.maxRetries = std::max(t.maxRetries, retries);
+        if (!coherent(s)) t.torn++;
+        if (s.readings < last) t.backwards++;
+        last = s.readings;
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+  running = false;
+  sensor.join();
+  actuator.join();
+  for (std::thread& t : readers) t.join();
+
+  for (ReaderTally& t : tallies) {
+    result.total.reads += t.reads;
+    result.total.torn += t.torn;
+    result.total.backwards += t.backwards;
+    result.total.retries += t.retries;
+    result.total.maxRetries = std::max(result.total.maxRetries, t.maxRetries);
+    result.total.latencyNs.insert(result.total.latencyNs.end(), t.latencyNs.begin(), t.latencyNs.end());
+  }
+  return result;
+}
+
+void report(const char* name, const Options& opt, const PhaseResult& r) {
+  printf("%-9s %10.0f %10.0f %10.0f %8.0f %9.0f %8lu %8u %6lu\n", name, r.readings / opt.seconds,
+         r.actuatorWrites / opt.seconds, r.total.reads / opt.seconds, percentile(r.total.latencyNs, 0.5),
+         percentile(r.total.latencyNs, 0.999), (unsigned long)r.total.retries, r.total.maxRetries,
+         (unsigned long)r.total.torn);
+}
+
+// ============ Single-Threaded Checks ============
+void functional_checks() {
+  SampleSnapshot s = snapshot_read();
+  check(s.readings == 0 && !s.actuators.pump && !s.actuators.fan && !s.actuators.growLight, "empty at boot");
+
+  snapshot_set_fan(true);
+  snapshot_store_reading(make_reading(1));
+  s = snapshot_read();
+  check(s.readings == 1 && s.sensors.temperature == 1.0f && s.actuators.fan && !s.actuators.pump,
+        "a reading keeps the actuator states");
+
+  snapshot_set_pump(true);
+  snapshot_set_grow_light(true);
+  snapshot_set_fan(false);
+  s = snapshot_read();
+  check(s.readings == 1 && s.sensors.timestamp == 1 && s.actuators.pump && !s.actuators.fan && s.actuators.growLight,
+        "an actuator change keeps the reading and the other actuators");
+
+  snapshot_set_actuators({false, false, false});
+  check(!snapshot_actuators().pump && !snapshot_actuators().growLight, "snapshot_actuators()");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+
+  printf("============ Functional ============\n");
+  functional_checks();
+
+  printf("\n============ Stress (%.1f s per phase, 1 sensor writer, 1 actuator writer, %d readers, %u plants) "
+         "============\n",
+         opt.seconds, opt.readers, (unsigned)PLANT_COUNT);
+  printf("%-9s %10s %10s %10s %8s %9s %8s %8s %6s\n", "phase", "readings/s", "actuator/s", "reads/s", "read50ns",
+         "read999ns", "retries", "maxretry", "torn");
+
+  ModuleShared module;
+  module.base = snapshot_read().readings;
+  PhaseResult moduleResult = run_phase(opt, module);
+  report("module", opt, moduleResult);
+
+  SeqLockShared seqlock;
+  PhaseResult seqlockResult = run_phase(opt, seqlock);
+  report("seqlock", opt, seqlockResult);
+
+  MutexShared mutex;
+  PhaseResult mutexResult = run_phase(opt, mutex);
+  report("mutex", opt, mutexResult);
+  printf("\n");
+
+  for (const PhaseResult* r : {&moduleResult, &seqlockResult}) {
+    const char* name = r == &moduleResult ? "snapshot_read()" : "SeqLock::read()";
+    check(r->total.reads > 0 && r->readings > 0 && r->actuatorWrites > 0, name,
+          std::to_string(r->total.reads) + " reads against " + std::to_string(r->readings) + " readings");
+    check(r->total.torn == 0, "  no torn snapshots", std::to_string(r->total.torn));
+    check(r->total.backwards == 0, "  readings never go backwards", std::to_string(r->total.backwards));
+  }
+  check(mutexResult.total.torn == 0, "mutex reference", std::to_string(mutexResult.total.torn) + " torn");
+
+  if (failures == 0) {
+    printf("\nAll checks passed\n");
+    return 0;
+  }
+  printf("\n%d check(s) FAILED\n", failures);
+  return 1;
+}
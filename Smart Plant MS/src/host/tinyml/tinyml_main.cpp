@@ -0,0 +1,264 @@
+// ============ Int8 Trend Model Accuracy and Latency ============
+// Loads a weights blob from machine-learning/trend_tinyml.py exactly as the
+// firmware maps it from flash, runs the int8 kernel on the exporter's
+// evaluation windows and reports:
+//   - agreement with the Python int8 reference (the kernel must match it)
+//   - accuracy of the int8 and float models against the actual readings
+//   - time per inference and the memory the model takes
+//
+// Build: pio run -e native-tinyml
+// Run:   python machine-learning/trend_tinyml.py --out trend_model.bin --eval trend_eval.csv
+//        .pio/build/native-tinyml/program trend_model.bin trend_eval.csv
+//
+// Exit status is 1 if the kernel disagrees with the reference or the int8
+// error exceeds the float model's by more than the allowed margin.
+
+#include <getopt.h>
+#include <time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "trend_model.h"
+
+namespace {
+
+const char* const METRICS[TREND_CHANNELS] = {"temperature", "humidity", "soil_moisture", "light_intensity"};
+
+// ============ Options ============
+struct Options {
+  const char* blob = nullptr;
+  const char* eval = nullptr;
+  double minTimeMs = 200;         // Minimum duration of the timing run
+  double maxDegradation = 0.10;   // Allowed int8 MAE increase over float, relative
+  double slack = 0.05;            // ... plus this much in the metric's own units
+  bool json = false;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s BLOB EVAL.csv [options]\n"
+         "  --min-time MS          minimum duration of the timing run (200)\n"
+         "  --max-degradation F    allowed relative int8 MAE increase over float (0.10)\n"
+         "  --json                 print the result as one JSON object\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"min-time", required_argument, nullptr, 'm'},
+    {"max-degradation", required_argument, nullptr, 'd'},
+    {"json", no_argument, nullptr, 'j'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'm': opt.minTimeMs = atof(optarg); break;
+      case 'd': opt.maxDegradation = atof(optarg); break;
+      case 'j': opt.json = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (optind != argc - 2 || opt.minTimeMs <= 0 || opt.maxDegradation < 0) {
+    usage(argv[0]);
+    return false;
+  }
+  opt.blob = argv[optind];
+  opt.eval = argv[optind + 1];
+  return true;
+}
+
+// ============ Inputs ============
+// Word-aligned like the flash mapping, which the loader requires
+bool read_blob(const char* path, std::vector<uint32_t>& out, size_t& size) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  out.assign((length + 3) / 4, 0);
+  size = fread(out.data(), 1, length, f);
+  fclose(f);
+  return size == (size_t)length;
+}
+
+struct EvalWindow {
+  TrendReading window[TREND_WINDOW];
+  float actual[TREND_CHANNELS];
+  float floatPrediction[TREND_CHANNELS];
+  float int8Prediction[TREND_CHANNELS];     // Python reference
+};
+
+bool read_eval(const char* path, std::vector<EvalWindow>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  const int columns = TREND_WINDOW * TREND_CHANNELS + 3 * TREND_CHANNELS;
+  char* line = nullptr;
+  size_t capacity = 0;
+  bool header = true;
+  while (getline(&line, &capacity, f) > 0) {
+    if (header) {
+      header = false;
+      continue;
+    }
+    float v[columns];
+    int n = 0;
+    char* p = line;
+    while (n < columns) {
+      char* end;
+      v[n] = strtof(p, &end);
+      if (end == p) break;
+      n++;
+      p = *end == ',' ? end + 1 : end;
+    }
+    if (n != columns) continue;
+
+    EvalWindow w;
+    for (int t = 0; t < TREND_WINDOW; t++) {
+      for (int c = 0; c < TREND_CHANNELS; c++) w.window[t].value[c] = v[t * TREND_CHANNELS + c];
+    }
+    const float* tail = v + TREND_WINDOW * TREND_CHANNELS;
+    for (int c = 0; c < TREND_CHANNELS; c++) {
+      w.actual[c] = tail[c];
+      w.floatPrediction[c] = tail[TREND_CHANNELS + c];
+      w.int8Prediction[c] = tail[2 * TREND_CHANNELS + c];
+    }
+    out.push_back(w);
+  }
+  free(line);
+  fclose(f);
+  return true;
+}
+
+// ============ Measurement ============
+template <typename T>
+inline void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct ChannelReport {
+  double floatMae = 0;
+  double int8Mae = 0;
+  double int8VsFloatMae = 0;
+  double maxReferenceError = 0;   // Kernel vs Python int8 reference
+  bool degraded = false;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+
+  std::vector<uint32_t> blob;
+  size_t blobSize = 0;
+  if (!read_blob(opt.blob, blob, blobSize)) return 2;
+  if (!trend_model_load((const uint8_t*)blob.data(), blobSize)) {
+    fprintf(stderr, "%s: not a valid trend model blob for this build\n", opt.blob);
+    return 2;
+  }
+
+  std::vector<EvalWindow> windows;
+  if (!read_eval(opt.eval, windows)) return 2;
+  if (windows.empty()) {
+    fprintf(stderr, "%s: no evaluation windows\n", opt.eval);
+    return 2;
+  }
+
+  // The kernel must reproduce the Python reference up to float formatting
+  const double referenceTolerance = 1e-4;
+
+  ChannelReport channels[TREND_CHANNELS];
+  long referenceMismatches = 0;
+  for (const EvalWindow& w : windows) {
+    TrendReading predicted;
+    trend_model_infer(w.window, predicted);
+    bool mismatch = false;
+    for (int c = 0; c < TREND_CHANNELS; c++) {
+      ChannelReport& r = channels[c];
+      double error = fabs(predicted.value[c] - w.int8Prediction[c]);
+      if (error > r.maxReferenceError) r.maxReferenceError = error;
+      if (error > referenceTolerance * (1 + fabs(w.int8Prediction[c]))) mismatch = true;
+      r.floatMae += fabs(w.floatPrediction[c] - w.actual[c]);
+      r.int8Mae += fabs(predicted.value[c] - w.actual[c]);
+      r.int8VsFloatMae += fabs(predicted.value[c] - w.floatPrediction[c]);
+    }
+    if (mismatch) referenceMismatches++;
+  }
+
+  bool degraded = false;
+  for (ChannelReport& r : channels) {
+    r.floatMae /= windows.size();
+    r.int8Mae /= windows.size();
+    r.int8VsFloatMae /= windows.size();
+    r.degraded = r.int8Mae > r.floatMae * (1 + opt.maxDegradation) + opt.slack;
+    degraded |= r.degraded;
+  }
+
+  // Latency over the evaluation windows, round-robin
+  uint64_t inferences = 0;
+  uint64_t start = now_ns();
+  uint64_t elapsed = 0;
+  do {
+    for (const EvalWindow& w : windows) {
+      TrendReading predicted;
+      trend_model_infer(w.window, predicted);
+      keep(predicted);
+    }
+    inferences += windows.size();
+    elapsed = now_ns() - start;
+  } while (elapsed < opt.minTimeMs * 1e6);
+  double nsPerInference = (double)elapsed / inferences;
+
+  bool failed = referenceMismatches > 0 || degraded;
+
+  if (opt.json) {
+    printf("{\"model\":\"%s\",\"windows\":%zu,\"horizon_minutes\":%u,\"blob_bytes\":%zu,\"arena_bytes\":%zu,"
+           "\"ns_per_inference\":%.1f,\"reference_mismatches\":%ld,",
+           trend_model_id(), windows.size(), trend_model_horizon(), trend_model_blob_bytes(),
+           trend_model_arena_bytes(), nsPerInference, referenceMismatches);
+    for (int c = 0; c < TREND_CHANNELS; c++) {
+      const ChannelReport& r = channels[c];
+      printf("\"%s\":{\"float_mae\":%.4f,\"int8_mae\":%.4f,\"int8_vs_float_mae\":%.4f,\"max_reference_error\":%.3g,"
+             "\"degraded\":%s},",
+             METRICS[c], r.floatMae, r.int8Mae, r.int8VsFloatMae, r.maxReferenceError, r.degraded ? "true" : "false");
+    }
+    printf("\"ok\":%s}\n", failed ? "false" : "true");
+    return failed ? 1 : 0;
+  }
+
+  printf("============ Int8 Trend Model ============\n");
+  printf("Model:              %s, %u-minute horizon, %zu evaluation windows\n", trend_model_id(),
+         trend_model_horizon(), windows.size());
+  printf("Memory:             %zu-byte weights blob (flash), %zu-byte arena, no heap\n", trend_model_blob_bytes(),
+         trend_model_arena_bytes());
+  printf("Latency:            %.0f ns per inference\n", nsPerInference);
+  printf("Reference:          %ld window%s differ from the Python int8 model\n", referenceMismatches,
+         referenceMismatches == 1 ? "" : "s");
+  printf("%-16s %10s %10s %14s\n", "metric", "float MAE", "int8 MAE", "int8 vs float");
+  for (int c = 0; c < TREND_CHANNELS; c++) {
+    const ChannelReport& r = channels[c];
+    printf("%-16s %10.3f %10.3f %14.3f%s\n", METRICS[c], r.floatMae, r.int8Mae, r.int8VsFloatMae,
+           r.degraded ? "  DEGRADED" : "");
+  }
+  printf("Result:             %s\n", failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+// ============ TLS Handshake Measurements ============
+// Connects the firmware's TLS transport (src/tls_client.cpp) to a TLS
+// broker through the WiFiClient shim and compares:
+//
+//   full      a fresh handshake every time (saved session dropped first)
+//   resumed   reconnects that offer the session saved by the previous one,
+//             each through a new TlsClient like after a reboot
+//
+// For each mode: connect time (TCP + TLS handshake), TLS bytes on the wire
+// and memory. Memory is the static pool's peak when mbedTLS routes its
+// allocations there (ESP-IDF); host mbedTLS builds without
+// MBEDTLS_PLATFORM_MEMORY use the heap, and then the heap held by an open
+// connection is reported instead. Every connection also sends an MQTT
+// CONNECT and expects a CONNACK.
+//
+// Needs the TLS broker (docker compose --profile tls up mosquitto-tls) and
+// the CA from mqtt-broker/tls/generate-certs.sh. Crypto on the host is
+// software; the timings show what resumption saves, not ESP32 numbers.
+//
+// Build: pio run -e native-tls
+// Run:   .pio/build/native-tls/program --ca ../mqtt-broker/tls/certs/ca.crt
+
+#include <getopt.h>
+#include <malloc.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "mqtt_codec.h"
+#include "tls_client.h"
+
+namespace {
+
+// ============ Options ============
+struct Options {
+  const char* host = "127.0.0.1";
+  uint16_t port = MQTT_TLS_PORT;
+  const char* ca = "../mqtt-broker/tls/certs/ca.crt";
+  int runs = 20;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --host HOST            TLS broker (127.0.0.1)\n"
+         "  --port N               TLS port (%d)\n"
+         "  --ca FILE              CA certificate, PEM (../mqtt-broker/tls/certs/ca.crt)\n"
+         "  --runs N               connections per mode (20)\n",
+         argv0, MQTT_TLS_PORT);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"host", required_argument, nullptr, 'h'},
+    {"port", required_argument, nullptr, 'p'},
+    {"ca", required_argument, nullptr, 'c'},
+    {"runs", required_argument, nullptr, 'r'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'h': opt.host = optarg; break;
+      case 'p': opt.port = (uint16_t)atoi(optarg); break;
+      case 'c': opt.ca = optarg; break;
+      case 'r': opt.runs = atoi(optarg); break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.runs <= 0) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Results ============
+int failures = 0;
+
+void check(bool ok, const char* name, const std::string& detail = "") {
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+  if (!ok) failures++;
+}
+
+// ============ Counting Transport ============
+// The TCP connection under TlsClient; counts the TLS bytes in both directions
+class CountingClient : public Client {
+ public:
+  int connect(const char* host, uint16_t port) override { return tcp_.connect(host, port); }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    size_t n = tcp_.write(buffer, size);
+    bytes += n;
+    return n;
+  }
+  int available() override { return tcp_.available(); }
+  int read() override {
+    uint8_t byte;
+    return read(&byte, 1) == 1 ? byte : -1;
+  }
+  int read(uint8_t* buffer, size_t size) override {
+    int n = tcp_.read(buffer, size);
+    if (n > 0) bytes += n;
+    return n;
+  }
+  void flush() override {}
+  void stop() override { tcp_.stop(); }
+  uint8_t connected() override { return tcp_.connected(); }
+
+  uint64_t bytes = 0;
+
+ private:
+  WiFiClient tcp_;
+};
+
+size_t heap_in_use() {
+  return mallinfo2().uordblks;
+}
+
+// MQTT CONNECT over the TLS connection; true on CONNACK 0
+bool mqtt_connect(TlsClient& tls) {
+  uint8_t packet[64];
+  mqtt::ConnectOptions options = {};
+  options.clientId = "tls-check";
+  options.keepAliveSeconds = 30;
+  options.cleanSession = true;
+  size_t size = mqtt::encode_connect(packet, sizeof(packet), options);
+  if (tls.write(packet, size) != size) return false;
+
+  std::vector<uint8_t> rx;
+  uint64_t deadline = host::monotonic_us() + 3000000;
+  while (host::monotonic_us() < deadline && tls.connected()) {
+    uint8_t chunk[64];
+    int n = tls.read(chunk, sizeof(chunk));
+    if (n <= 0) {
+      delay(1);
+      continue;
+    }
+    rx.insert(rx.end(), chunk, chunk + n);
+    mqtt::Packet reply;
+    if (mqtt::decode_packet(rx.data(), rx.size(), reply) > 0) return mqtt::connack_code(reply) == 0;
+  }
+  return false;
+}
+
+struct Mode {
+  const char* name;
+  std::vector<double> connectMs;
+  std::vector<double> bytes;
+  size_t memory = 0;
+  int resumed = 0;
+  int mqttOk = 0;
+  int failed = 0;
+};
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+void run(const Options& opt, const std::string& ca, bool resume, Mode& mode) {
+  for (int i = 0; i < opt.runs; i++) {
+    if (!resume) TlsClient::forgetSession();
+    CountingClient tcp;
+    TlsClient tls(tcp);             // New instance each time, as after a reboot
+    tls.setCACert(ca.c_str());
+
+    tls_pool_reset_peak();
+    size_t heapBefore = heap_in_use();
+    uint64_t start = host::monotonic_us();
+    if (!tls.connect(opt.host, opt.port)) {
+      mode.failed++;
+      continue;
+    }
+    mode.connectMs.push_back((host::monotonic_us() - start) / 1000.0);
+    mode.bytes.push_back((double)tcp.bytes);
+    TlsPoolStats pool = tls_pool_stats();
+    size_t memory = pool.installed ? pool.peak : heap_in_use() - std::min(heap_in_use(), heapBefore);
+    mode.memory = std::max(mode.memory, memory);
+    if (tls.lastHandshake().resumed) mode.resumed++;
+    if (mqtt_connect(tls)) mode.mqttOk++;
+    tls.stop();
+  }
+}
+
+void report(const Mode& m) {
+  printf("%-9s %6zu %10.2f %10.2f %12.0f %12zu %8d\n", m.name, m.connectMs.size(), percentile(m.connectMs, 0.5),
+         percentile(m.connectMs, 0.99), percentile(m.bytes, 0.5), m.memory, m.resumed);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+  host::use_real_time();
+  host::board().serialEcho = false;
+
+  std::ifstream file(opt.ca);
+  std::stringstream pem;
+  pem << file.rdbuf();
+  if (!file || pem.str().empty()) {
+    check(false, "CA certificate", std::string("cannot read ") + opt.ca + " (run mqtt-broker/tls/generate-certs.sh)");
+    return 1;
+  }
+  std::string ca = pem.str();
+
+  Mode full;
+  full.name = "full";
+  run(opt, ca, false, full);
+
+  // Seed the cache with one full handshake, then reconnect on it
+  Mode resumed;
+  resumed.name = "resumed";
+  TlsClient::forgetSession();
+  {
+    CountingClient tcp;
+    TlsClient tls(tcp);
+    tls.setCACert(ca.c_str());
+    if (tls.connect(opt.host, opt.port)) tls.stop();
+  }
+  run(opt, ca, true, resumed);
+
+  TlsPoolStats pool = tls_pool_stats();
+  printf("\n%s:%u, %s, ", opt.host, opt.port, TlsClient::hardwareCrypto() ? "hardware crypto" : "software crypto");
+  printf(pool.installed ? "static pool of %zu bytes (%u heap fallbacks)\n" : "heap (no MBEDTLS_PLATFORM_MEMORY)\n",
+         pool.size, pool.fallbacks);
+  printf("%-9s %6s %10s %10s %12s %12s %8s\n", "mode", "conns", "p50 ms", "p99 ms", "tls bytes",
+         pool.installed ? "pool peak" : "heap held", "resumed");
+  report(full);
+  report(resumed);
+  printf("\n");
+
+  check(full.failed == 0 && resumed.failed == 0, "handshakes",
+        std::to_string(full.failed + resumed.failed) + " failed (is the TLS broker running?)");
+  check(full.resumed == 0, "full handshakes are full");
+  check(resumed.resumed == (int)resumed.connectMs.size() && resumed.resumed > 0, "session resumed",
+        std::to_string(resumed.resumed) + "/" + std::to_string(resumed.connectMs.size()));
+  check(full.mqttOk + resumed.mqttOk == (int)(full.connectMs.size() + resumed.connectMs.size()), "MQTT CONNACK over TLS");
+
+  printf("%s\n", failures ? "FAILED" : "All checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,560 @@
+// ============ MQTT over WebSocket Checks ============
+// Exercises the firmware's WebSocket transport (src/ws_client.cpp) over
+// real TCP through the WiFiClient shim:
+//
+//   --self-test   against an in-process WebSocket server, no broker: the
+//                 accept key against RFC 6455's example, the upgrade, a
+//                 rejected Sec-WebSocket-Accept, a CONNACK split
+//                 over a fragmented message with a ping in between, two MQTT
+//                 packets in one frame, 16-bit frame lengths, writes larger
+//                 than WS_FRAME_BUFFER_SIZE split over frames, and the close
+//                 handshake
+//   (default)     raw TCP (1883) against WebSocket (9001) on the broker.
+//                 Per transport: latency of single publishes to an observer
+//                 (p50/p99), throughput of back-to-back publishes, bytes on
+//                 the wire per message and heap allocations per message
+//
+// Both transports carry the same MQTT 3.1.1 packets (mqtt_codec.h, as
+// PubSubClient frames them) at QoS 0; the observer is a raw TCP connection.
+//
+// Build: pio run -e native-ws
+// Run:   .pio/build/native-ws/program --self-test
+//        .pio/build/native-ws/program --host 127.0.0.1 --messages 20000 --payload 200
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "host_board.h"
+#include "mqtt_codec.h"
+#include "ws_client.h"
+
+#include "../common/alloc_counter.h"
+
+namespace {
+
+const char* TEST_PREFIX = "plant-iot/ws-check";
+
+// ============ Options ============
+struct Options {
+  const char* host = "127.0.0.1";
+  uint16_t port = 1883;
+  uint16_t wsPort = 9001;
+  int messages = 20000;           // Back-to-back publishes per transport
+  int samples = 1000;             // Single publishes timed for latency
+  int payload = 200;              // Bytes per message
+  bool selfTest = false;
+};
+
+void usage(const char* argv0) {
+  printf("Usage: %s [options]\n"
+         "  --host HOST            MQTT broker (127.0.0.1)\n"
+         "  --port N               raw MQTT port (1883)\n"
+         "  --ws-port N            WebSocket port (9001)\n"
+         "  --messages N           back-to-back publishes per transport (20000)\n"
+         "  --samples N            publishes timed one at a time (1000)\n"
+         "  --payload N            bytes per message (200)\n"
+         "  --self-test            in-process WebSocket server, no broker\n",
+         argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& opt) {
+  static const struct option longOptions[] = {
+    {"host", required_argument, nullptr, 'h'},
+    {"port", required_argument, nullptr, 'p'},
+    {"ws-port", required_argument, nullptr, 'w'},
+    {"messages", required_argument, nullptr, 'm'},
+    {"samples", required_argument, nullptr, 's'},
+    {"payload", required_argument, nullptr, 'l'},
+    {"self-test", no_argument, nullptr, 't'},
+    {"help", no_argument, nullptr, '?'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (c) {
+      case 'h': opt.host = optarg; break;
+      case 'p': opt.port = (uint16_t)atoi(optarg); break;
+      case 'w': opt.wsPort = (uint16_t)atoi(optarg); break;
+      case 'm': opt.messages = atoi(optarg); break;
+      case 's': opt.samples = atoi(optarg); break;
+      case 'l': opt.payload = atoi(optarg); break;
+      case 't': opt.selfTest = true; break;
+      default: usage(argv[0]); return false;
+    }
+  }
+  if (opt.messages <= 0 || opt.samples <= 0 || opt.payload <= 0 || opt.payload > 1024) {
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// ============ Results ============
+int failures = 0;
+
+void check(bool ok, const char* name, const std::string& detail = "") {
+  printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", name, detail.empty() ? "" : ": ", detail.c_str());
+  if (!ok) failures++;
+}
+
+// ============ Counting Transport ============
+// The TCP connection under the MQTT session; counts bytes sent
+class CountingClient : public Client {
+ public:
+  int connect(const char* host, uint16_t port) override { return tcp_.connect(host, port); }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    size_t n = tcp_.write(buffer, size);
+    sent += n;
+    return n;
+  }
+  int available() override { return tcp_.available(); }
+  int read() override { return tcp_.read(); }
+  int read(uint8_t* buffer, size_t size) override { return tcp_.read(buffer, size); }
+  void flush() override {}
+  void stop() override { tcp_.stop(); }
+  uint8_t connected() override { return tcp_.connected(); }
+
+  uint64_t sent = 0;
+
+ private:
+  WiFiClient tcp_;
+};
+
+// ============ MQTT Session ============
+// MQTT 3.1.1 over any Client with fixed buffers, like PubSubClient: one
+// write() per packet, reads polled without waiting
+class Session {
+ public:
+  explicit Session(Client& client) : client_(client) {}
+
+  bool open(const char* host, uint16_t port, const char* clientId) {
+    if (!client_.connect(host, port)) return false;
+    mqtt::ConnectOptions options = {};
+    options.clientId = clientId;
+    options.keepAliveSeconds = 60;
+    options.cleanSession = true;
+    if (!send(mqtt::encode_connect(tx_, sizeof(tx_), options))) return false;
+    mqtt::Packet reply;
+    return next(reply, 3000) && mqtt::connack_code(reply) == 0;
+  }
+
+  bool subscribe(const char* filter) {
+    if (!send(mqtt::encode_subscribe(tx_, sizeof(tx_), 1, filter, 0))) return false;
+    mqtt::Packet reply;
+    return next(reply, 3000) && reply.type == mqtt::SUBACK;
+  }
+
+  bool publish(const char* topic, const uint8_t* payload, size_t length) {
+    return send(mqtt::encode_publish(tx_, sizeof(tx_), topic, strlen(topic), payload, length));
+  }
+
+  void close_session() {
+    send(mqtt::encode_empty(tx_, sizeof(tx_), mqtt::DISCONNECT));
+    client_.stop();
+  }
+
+  // Next packet; spins up to timeoutMs (0: only what has arrived). The
+  // packet points into rx_ until the next call.
+  bool next(mqtt::Packet& packet, int timeoutMs) {
+    memmove(rx_, rx_ + consumed_, have_ - consumed_);
+    have_ -= consumed_;
+    consumed_ = 0;
+    uint64_t deadline = host::monotonic_us() + (uint64_t)timeoutMs * 1000;
+    while (true) {
+      long size = mqtt::decode_packet(rx_, have_, packet);
+      if (size < 0) return false;
+      if (size > 0) {
+        consumed_ = size;
+        return true;
+      }
+      int n = have_ < sizeof(rx_) ? client_.read(rx_ + have_, sizeof(rx_) - have_) : -1;
+      if (n > 0) {
+        have_ += n;
+        continue;
+      }
+      if (!client_.connected() || host::monotonic_us() >= deadline) return false;
+    }
+  }
+
+ private:
+  bool send(size_t size) { return size > 0 && client_.write(tx_, size) == size; }
+
+  Client& client_;
+  uint8_t tx_[2048];
+  uint8_t rx_[65536];
+  size_t have_ = 0;
+  size_t consumed_ = 0;
+};
+
+// ============ Socket Helpers ============
+bool send_all(int fd, const uint8_t* data, size_t length) {
+  size_t sent = 0;
+  while (sent < length) {
+    ssize_t n = send(fd, data + sent, length - sent, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+bool recv_all(int fd, uint8_t* data, size_t length, int timeoutMs = 2000) {
+  size_t have = 0;
+  while (have < length) {
+    struct pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, timeoutMs) <= 0) return false;
+    ssize_t n = recv(fd, data + have, length - have, 0);
+    if (n <= 0) return false;
+    have += n;
+  }
+  return true;
+}
+
+// ============ WebSocket Stand-in ============
+// Serves one connection at a time on an ephemeral port. ACCEPT runs the
+// script in run_session(); WRONG_ACCEPT answers the upgrade with a bad
+// Sec-WebSocket-Accept.
+class WsServer {
+ public:
+  enum Mode { ACCEPT, WRONG_ACCEPT };
+
+  bool start(Mode mode) {
+    mode_ = mode;
+    listen_ = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(listen_, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_, 4) != 0) return false;
+    getsockname(listen_, (struct sockaddr*)&address, &length);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread([this]() { run(); });
+    return true;
+  }
+
+  void stop() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    close(listen_);
+  }
+
+  uint16_t port() const { return port_; }
+
+  // What the server saw, read after stop()
+  bool subprotocol = false;       // Upgrade asked for "mqtt"
+  bool allMasked = true;
+  int framesReceived = 0;
+  int publishes = 0;
+  bool pongMatched = false;
+  int closeCode = -1;
+
+ private:
+  void run() {
+    while (running_) {
+      struct pollfd p = {listen_, POLLIN, 0};
+      if (poll(&p, 1, 20) <= 0) continue;
+      int fd = accept(listen_, nullptr, nullptr);
+      if (fd < 0) continue;
+      if (upgrade(fd) && mode_ == ACCEPT) run_session(fd);
+      close(fd);
+    }
+  }
+
+  bool upgrade(int fd) {
+    std::string request;
+    uint8_t c;
+    while (request.size() < 4 || request.compare(request.size() - 4, 4, "\r\n\r\n") != 0) {
+      if (!recv_all(fd, &c, 1)) return false;
+      request.push_back((char)c);
+    }
+    subprotocol = request.find("Sec-WebSocket-Protocol: mqtt\r\n") != std::string::npos;
+    size_t at = request.find("Sec-WebSocket-Key: ");
+    if (at == std::string::npos) return false;
+    std::string key = request.substr(at + 19, request.find("\r\n", at) - at - 19);
+    char accept[29];
+    ws_accept_key(key.c_str(), accept);
+    if (mode_ == WRONG_ACCEPT) accept[0] = accept[0] == 'A' ? 'B' : 'A';
+    std::string response = std::string("HTTP/1.1 101 Switching Protocols\r\n"
+                                       "Upgrade: websocket\r\n"
+                                       "Connection: Upgrade\r\n"
+                                       "Sec-WebSocket-Protocol: mqtt\r\n"
+                                       "Sec-WebSocket-Accept: ") + accept + "\r\n\r\n";
+    return send_all(fd, (const uint8_t*)response.data(), response.size());
+  }
+
+  // Unmasked server frame; 16-bit length from 126 bytes
+  static bool send_frame(int fd, uint8_t first, const uint8_t* payload, size_t length) {
+    std::vector<uint8_t> frame = {first};
+    if (length < 126) {
+      frame.push_back((uint8_t)length);
+    } else {
+      frame.push_back(126);
+      frame.push_back((uint8_t)(length >> 8));
+      frame.push_back((uint8_t)length);
+    }
+    frame.insert(frame.end(), payload, payload + length);
+    return send_all(fd, frame.data(), frame.size());
+  }
+
+  // Next client frame, unmasked
+  bool read_frame(int fd, uint8_t& opcode, std::vector<uint8_t>& payload) {
+    uint8_t header[2];
+    if (!recv_all(fd, header, 2)) return false;
+    opcode = header[0] & 0x0F;
+    uint64_t length = header[1] & 0x7F;
+    if (length == 126) {
+      uint8_t extended[2];
+      if (!recv_all(fd, extended, 2)) return false;
+      length = extended[0] << 8 | extended[1];
+    } else if (length == 127) {
+      return false;                 // Never needed for MQTT packets this size
+    }
+    uint8_t key[4] = {0, 0, 0, 0};
+    if (header[1] & 0x80) {
+      if (!recv_all(fd, key, 4)) return false;
+    } else {
+      allMasked = false;
+    }
+    payload.resize(length);
+    if (length > 0 && !recv_all(fd, payload.data(), length)) return false;
+    for (size_t i = 0; i < length; i++) payload[i] ^= key[i & 3];
+    framesReceived++;
+    return true;
+  }
+
+  // CONNACK in two fragments with a ping between them; each PUBLISH echoed
+  // in one frame, the first one twice in the same frame; ends on close
+  void run_session(int fd) {
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> payload;
+    uint8_t opcode;
+    while (read_frame(fd, opcode, payload)) {
+      if (opcode == 0x8) {
+        if (payload.size() >= 2) closeCode = payload[0] << 8 | payload[1];
+        send_frame(fd, 0x88, payload.data(), std::min<size_t>(payload.size(), 2));
+        return;
+      }
+      if (opcode == 0xA) {
+        pongMatched = payload == std::vector<uint8_t>{'h', 'b'};
+        continue;
+      }
+      stream.insert(stream.end(), payload.begin(), payload.end());
+
+      mqtt::Packet packet;
+      long size;
+      while ((size = mqtt::decode_packet(stream.data(), stream.size(), packet)) > 0) {
+        if (packet.type == mqtt::CONNECT) {
+          const uint8_t head[] = {0x20, 0x02}, ping[] = {'h', 'b'}, tail[] = {0x00, 0x00};
+          send_frame(fd, 0x02, head, sizeof(head));           // Binary, not final
+          send_frame(fd, 0x89, ping, sizeof(ping));           // Ping inside the message
+          send_frame(fd, 0x80, tail, sizeof(tail));           // Continuation, final
+        } else if (packet.type == mqtt::PUBLISH) {
+          std::vector<uint8_t> echo(stream.begin(), stream.begin() + size);
+          if (publishes++ == 0) echo.insert(echo.end(), stream.begin(), stream.begin() + size);
+          send_frame(fd, 0x82, echo.data(), echo.size());
+        }
+        stream.erase(stream.begin(), stream.begin() + size);
+      }
+    }
+  }
+
+  Mode mode_ = ACCEPT;
+  int listen_ = -1;
+  uint16_t port_ = 0;
+  std::atomic<bool> running_{true};
+  std::thread thread_;
+};
+
+// Publishes a payload of the given size and expects `copies` echoes of it
+bool echo(Session& session, size_t length, int copies) {
+  std::string topic = std::string(TEST_PREFIX) + "/echo";
+  std::vector<uint8_t> payload(length);
+  for (size_t i = 0; i < length; i++) payload[i] = (uint8_t)(i * 7 + length);
+  if (!session.publish(topic.c_str(), payload.data(), length)) return false;
+  for (int i = 0; i < copies; i++) {
+    mqtt::Packet packet;
+    mqtt::PublishView view;
+    if (!session.next(packet, 2000) || !mqtt::parse_publish(packet, view)) return false;
+    if (view.payloadLength != length || memcmp(view.payload, payload.data(), length) != 0) return false;
+  }
+  return true;
+}
+
+void self_test() {
+  // The stand-in computes the accept key with the same function, so check
+  // it against the example in RFC 6455 1.3 first
+  char accept[29];
+  ws_accept_key("dGhlIHNhbXBsZSBub25jZQ==", accept);
+  check(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0, "Sec-WebSocket-Accept (RFC 6455 example)", accept);
+
+  WsServer server;
+  if (!server.start(WsServer::ACCEPT)) {
+    check(false, "stand-in", "cannot listen");
+    return;
+  }
+  WiFiClient tcp;
+  WsClient ws(tcp);
+  Session session(ws);
+  bool connected = session.open("127.0.0.1", server.port(), "ws-check");
+  check(connected, "upgrade, CONNACK over a fragmented message with a ping inside");
+  if (connected) {
+    check(echo(session, 10, 2), "two MQTT packets in one frame");
+    check(echo(session, 300, 1), "16-bit frame lengths");
+    uint32_t framesBefore = ws.stats().framesSent;
+    bool echoed = echo(session, 1200, 1);
+    check(echoed && ws.stats().framesSent - framesBefore == 3, "write split over frames",
+          "1200-byte payload in " + std::to_string(ws.stats().framesSent - framesBefore) + " frames");
+    check(ws.stats().pings == 1, "ping answered", std::to_string(ws.stats().pings) + " pings");
+    session.close_session();
+  }
+  server.stop();
+  check(server.subprotocol, "subprotocol mqtt requested");
+  check(server.allMasked && server.framesReceived > 0, "client frames masked",
+        std::to_string(server.framesReceived) + " frames");
+  check(server.pongMatched, "pong echoes the ping payload");
+  check(server.closeCode == 1000, "close handshake", "status " + std::to_string(server.closeCode));
+
+  WsServer bogus;
+  if (bogus.start(WsServer::WRONG_ACCEPT)) {
+    WiFiClient tcp2;
+    WsClient rejected(tcp2);
+    check(!rejected.connect("127.0.0.1", bogus.port()), "wrong Sec-WebSocket-Accept rejected");
+    bogus.stop();
+  }
+}
+
+// ============ Broker Benchmark ============
+struct Result {
+  const char* name;
+  bool ok = false;
+  int delivered = 0;
+  double seconds = 0;
+  std::vector<double> latencyUs;
+  double wireBytesPerMessage = 0;
+  double allocationsPerMessage = 0;
+};
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+// Drains everything the observer has; counts PUBLISH packets
+int drain(Session& observer, int timeoutMs) {
+  int count = 0;
+  mqtt::Packet packet;
+  while (observer.next(packet, timeoutMs)) {
+    if (packet.type == mqtt::PUBLISH) count++;
+    timeoutMs = 0;
+  }
+  return count;
+}
+
+void benchmark(const Options& opt, bool websocket, Result& r) {
+  std::string topic = std::string(TEST_PREFIX) + (websocket ? "/ws" : "/tcp");
+  WiFiClient observerTcp;
+  Session observer(observerTcp);
+  if (!observer.open(opt.host, opt.port, websocket ? "ws-check-observer-ws" : "ws-check-observer-tcp") ||
+      !observer.subscribe(topic.c_str())) {
+    return;
+  }
+
+  CountingClient tcp;
+  WsClient ws(tcp);
+  Client& transport = websocket ? (Client&)ws : (Client&)tcp;
+  Session publisher(transport);
+  if (!publisher.open(opt.host, websocket ? opt.wsPort : opt.port, websocket ? "ws-check-ws" : "ws-check-tcp")) {
+    return;
+  }
+  std::vector<uint8_t> payload(opt.payload, 'x');
+
+  // Latency: one message in flight
+  for (int i = 0; i < opt.samples; i++) {
+    uint64_t start = host::monotonic_us();
+    if (!publisher.publish(topic.c_str(), payload.data(), payload.size())) return;
+    mqtt::Packet packet;
+    if (!observer.next(packet, 2000)) return;
+    r.latencyUs.push_back((double)(host::monotonic_us() - start));
+  }
+
+  // Throughput: back to back, the observer drained in between
+  uint64_t sentBefore = tcp.sent;
+  uint64_t allocationsBefore = host::allocations();
+  uint64_t start = host::monotonic_us();
+  for (int i = 0; i < opt.messages; i++) {
+    bool published;
+    {
+      host::CountAllocations counting;
+      published = publisher.publish(topic.c_str(), payload.data(), payload.size());
+    }
+    if (!published) return;
+    r.delivered += drain(observer, 0);
+  }
+  uint64_t allocationsAfter = host::allocations();
+  uint64_t sentAfter = tcp.sent;
+  uint64_t deadline = host::monotonic_us() + 10000000;
+  while (r.delivered < opt.messages && host::monotonic_us() < deadline) r.delivered += drain(observer, 100);
+  r.seconds = (host::monotonic_us() - start) / 1e6;
+
+  r.wireBytesPerMessage = (double)(sentAfter - sentBefore) / opt.messages;
+  r.allocationsPerMessage = (double)(allocationsAfter - allocationsBefore) / opt.messages;
+  r.ok = true;
+  publisher.close_session();
+  observer.close_session();
+}
+
+void report(const Result& r, int payload) {
+  double rate = r.seconds > 0 ? r.delivered / r.seconds : 0;
+  printf("%-10s %10.0f %8.2f %9.1f %9.1f %10.1f %10.2f\n", r.name, rate, rate * payload / 1e6,
+         percentile(r.latencyUs, 0.5), percentile(r.latencyUs, 0.99), r.wireBytesPerMessage,
+         r.allocationsPerMessage);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_options(argc, argv, opt)) return 2;
+  host::use_real_time();
+  host::board().serialEcho = false;
+
+  if (opt.selfTest) {
+    self_test();
+  } else {
+    Result tcp, ws;
+    tcp.name = "tcp";
+    ws.name = "websocket";
+    benchmark(opt, false, tcp);
+    benchmark(opt, true, ws);
+
+    printf("\n%s, %d-byte payloads, QoS 0: %d timed one at a time, %d back to back\n", opt.host, opt.payload,
+           opt.samples, opt.messages);
+    printf("%-10s %10s %8s %9s %9s %10s %10s\n", "transport", "msgs/s", "MB/s", "p50 us", "p99 us", "wire B/msg",
+           "allocs/msg");
+    report(tcp, opt.payload);
+    report(ws, opt.payload);
+    printf("\n");
+
+    check(tcp.ok && ws.ok, "both transports connected", "broker on 1883 and its WebSocket listener on 9001?");
+    check(tcp.delivered == opt.messages && ws.delivered == opt.messages, "every message delivered",
+          std::to_string(tcp.delivered) + " / " + std::to_string(ws.delivered));
+    check(ws.ok && ws.allocationsPerMessage == 0, "no allocations per WebSocket message");
+  }
+
+  printf("%s\n", failures ? "FAILED" : "All checks passed");
+  return failures ? 1 : 0;
+}
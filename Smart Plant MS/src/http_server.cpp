@@ -0,0 +1,396 @@
+#include "http_server.h"
+
+#if FEATURE_HTTP_SERVER
+#include <WiFi.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <utility>
+#include "firmware_profile.h"
+
+// ============ Sample Buffer ============
+// Sample n (from 1) lives in samples[n % HTTP_HISTORY_SAMPLES]
+static HttpSample samples[HTTP_HISTORY_SAMPLES];
+static uint32_t newestId = 0;
+static const char* httpDeviceId = "";
+
+static uint32_t oldest_id() {
+  return newestId > HTTP_HISTORY_SAMPLES ? newestId - HTTP_HISTORY_SAMPLES + 1 : 1;
+}
+
+// ============ Connections ============
+enum class Phase : uint8_t { Free, Request, Respond, Stream };
+enum class Route : uint8_t { Latest, History, Events, NotFound, BadMethod };
+
+struct Connection {
+  WiFiClient client;
+  Phase phase;
+  unsigned long since;                // Accepted; on a stream, last write
+  char line[HTTP_LINE_MAX];
+  uint8_t lineLength;
+  bool requestLine;                   // Request line parsed, reading headers
+  Route route;
+  uint32_t cursor;                    // Next sample to send (/history, /events)
+  uint32_t end;                       // Last sample of a /history response
+  bool listed;                        // /history: an element has been sent
+  char tx[HTTP_TX_BUFFER_SIZE];
+  size_t txLength;
+  size_t txSent;
+  bool closeWhenSent;
+};
+
+static WiFiServer server(HTTP_PORT);
+static Connection connections[HTTP_MAX_CLIENTS];
+static HttpStats stats = {};
+
+static const char BUSY[] =
+    "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 2\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// ============ Formatting ============
+struct Out {
+  char* buffer;
+  size_t size;
+  size_t length;
+};
+
+static void put(Out& out, const char* format, ...) {
+  if (out.length >= out.size) return;
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(out.buffer + out.length, out.size - out.length, format, args);
+  va_end(args);
+  out.length = n < 0 ? out.size : out.length + n;
+}
+
+static void put_float(Out& out, const char* key, float value) {
+  if (isnan(value)) {
+    put(out, ",\"%s\":null", key);
+  } else {
+    put(out, ",\"%s\":%.1f", key, value);
+  }
+}
+
+static void put_sample(Out& out, uint32_t id) {
+  const HttpSample& s = samples[id % HTTP_HISTORY_SAMPLES];
+  put(out, "{\"id\":%lu,\"timestamp\":%lu,\"device_id\":\"%s\"", (unsigned long)id, (unsigned long)s.timestamp,
+      httpDeviceId);
+  put_float(out, "temperature", s.temperature);
+  put_float(out, "humidity", s.humidity);
+  // light_percent() of telemetry.h, which needs ArduinoJson
+  put(out, ",\"light_intensity\":%d,\"light_percent\":%ld,\"soil_moisture_percent\":[", s.lightIntensity,
+      (long)s.lightIntensity * 100 / 4095);
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    put(out, p ? ",%u" : "%u", s.moisturePercent[p]);
+  }
+  put(out, "],\"pump\":\"%s\",\"fan\":\"%s\",\"grow_light\":\"%s\"}", s.pump ? "ON" : "OFF", s.fan ? "ON" : "OFF",
+      s.growLight ? "ON" : "OFF");
+}
+
+// Status line and headers of a response without a body of known length
+static void put_head(Out& out, const char* contentType) {
+  put(out,
+      "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nCache-Control: no-cache\r\n"
+      "Access-Control-Allow-Origin: *\r\nConnection: %s\r\n\r\n",
+      contentType, strcmp(contentType, "text/event-stream") == 0 ? "keep-alive" : "close");
+}
+
+// A complete response with Content-Length: the body is formatted first, so
+// its length is known, then copied in behind the head
+static void respond_complete(Connection& c, int status, const char* reason, uint32_t sampleId) {
+  static char body[HTTP_TX_BUFFER_SIZE - 160];
+  Out b = {body, sizeof(body), 0};
+  if (sampleId) {
+    put_sample(b, sampleId);
+  } else {
+    put(b, "{\"error\":\"%s\"}", reason);
+  }
+  if (b.length >= b.size) b.length = 0;
+
+  Out out = {c.tx, sizeof(c.tx), 0};
+  put(out,
+      "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\nCache-Control: no-cache\r\n"
+      "Access-Control-Allow-Origin: *\r\n%sConnection: close\r\n\r\n",
+      status, reason, (unsigned)b.length, status == 503 ? "Retry-After: 2\r\n" : "");
+  if (out.length + b.length > out.size) out.length = out.size - b.length;
+  memcpy(c.tx + out.length, body, b.length);
+  c.txLength = out.length + b.length;
+  c.txSent = 0;
+  c.closeWhenSent = true;
+  c.phase = Phase::Respond;
+}
+
+// ============ Requests ============
+static void request_line(Connection& c) {
+  char* method = c.line;
+  char* path = strchr(method, ' ');
+  if (!path) {
+    c.route = Route::NotFound;
+    return;
+  }
+  *path++ = '\0';
+  char* version = strchr(path, ' ');
+  if (version) *version = '\0';
+  char* query = strchr(path, '?');
+  if (query) *query++ = '\0';
+
+  if (strcmp(method, "GET") != 0) {
+    c.route = Route::BadMethod;
+  } else if (strcmp(path, "/latest") == 0) {
+    c.route = Route::Latest;
+  } else if (strcmp(path, "/history") == 0) {
+    c.route = Route::History;
+    const char* since = query ? strstr(query, "since=") : nullptr;
+    c.cursor = since ? strtoul(since + 6, nullptr, 10) + 1 : 1;
+  } else if (strcmp(path, "/events") == 0) {
+    c.route = Route::Events;
+    c.cursor = 0;                     // Live samples only, unless Last-Event-ID says otherwise
+  } else {
+    c.route = Route::NotFound;
+  }
+}
+
+static void header_line(Connection& c) {
+  static const char LAST_EVENT_ID[] = "Last-Event-ID:";
+  if (c.route == Route::Events && strncasecmp(c.line, LAST_EVENT_ID, sizeof(LAST_EVENT_ID) - 1) == 0) {
+    c.cursor = strtoul(c.line + sizeof(LAST_EVENT_ID) - 1, nullptr, 10) + 1;
+  }
+}
+
+static uint8_t open_streams() {
+  uint8_t n = 0;
+  for (const Connection& c : connections) {
+    if (c.phase == Phase::Stream) n++;
+  }
+  return n;
+}
+
+static void start_response(Connection& c, unsigned long now) {
+  Out out = {c.tx, sizeof(c.tx), 0};
+  switch (c.route) {
+    case Route::Latest:
+      stats.latest++;
+      if (newestId == 0) {
+        respond_complete(c, 503, "no sample yet", 0);
+      } else {
+        respond_complete(c, 200, "OK", newestId);
+      }
+      return;
+
+    case Route::History:
+      stats.history++;
+      put_head(out, "application/json");
+      put(out, "[");
+      if (c.cursor < oldest_id()) c.cursor = oldest_id();
+      c.end = newestId;
+      c.phase = Phase::Respond;
+      c.closeWhenSent = false;
+      break;
+
+    case Route::Events:
+      if (open_streams() >= HTTP_MAX_STREAMS) {
+        stats.refused++;
+        respond_complete(c, 503, "too many streams", 0);
+        return;
+      }
+      stats.streams++;
+      put_head(out, "text/event-stream");
+      put(out, "retry: 3000\n\n");
+      if (c.cursor == 0 || c.cursor > newestId + 1) c.cursor = newestId + 1;
+      c.phase = Phase::Stream;
+      c.closeWhenSent = false;
+      c.since = now;
+      break;
+
+    case Route::NotFound:
+      stats.notFound++;
+      respond_complete(c, 404, "not found", 0);
+      return;
+
+    case Route::BadMethod:
+      stats.notFound++;
+      respond_complete(c, 405, "method not allowed", 0);
+      return;
+  }
+  c.txLength = out.length;
+  c.txSent = 0;
+}
+
+// Reads what has arrived, one line at a time; only the request line and
+// Last-Event-ID matter, so long headers are simply cut at HTTP_LINE_MAX
+static void read_request(Connection& c, unsigned long now) {
+  uint8_t chunk[128];
+  int n;
+  while (c.phase == Phase::Request && (n = c.client.read(chunk, sizeof(chunk))) > 0) {
+    for (int i = 0; i < n && c.phase == Phase::Request; i++) {
+      char ch = (char)chunk[i];
+      if (ch == '\r') continue;
+      if (ch != '\n') {
+        if (c.lineLength < HTTP_LINE_MAX - 1) c.line[c.lineLength++] = ch;
+        continue;
+      }
+      c.line[c.lineLength] = '\0';
+      if (!c.requestLine) {
+        request_line(c);
+        c.requestLine = true;
+      } else if (c.lineLength == 0) {
+        start_response(c, now);
+      } else {
+        header_line(c);
+      }
+      c.lineLength = 0;
+    }
+  }
+}
+
+// ============ Responses ============
+// Refills the buffer once the previous contents have gone out, with as many
+// whole samples as fit
+static void refill(Connection& c, unsigned long now) {
+  Out out = {c.tx, sizeof(c.tx), 0};
+  if (c.cursor < oldest_id()) {
+    stats.skipped += oldest_id() - c.cursor;
+    c.cursor = oldest_id();
+  }
+
+  if (c.phase == Phase::Respond) {
+    // The "[" went out with the head; room is kept for the "]"
+    while (c.cursor <= c.end) {
+      size_t mark = out.length;
+      put(out, c.listed ? "," : "");
+      put_sample(out, c.cursor);
+      if (out.length >= out.size - 1) {
+        out.length = mark;
+        break;
+      }
+      c.listed = true;
+      c.cursor++;
+    }
+    if (c.cursor > c.end) {
+      put(out, "]");
+      c.closeWhenSent = true;
+    }
+  } else {
+    while (c.cursor <= newestId) {
+      size_t mark = out.length;
+      put(out, "id: %lu\nevent: sample\ndata: ", (unsigned long)c.cursor);
+      put_sample(out, c.cursor);
+      put(out, "\n\n");
+      if (out.length >= out.size) {
+        out.length = mark;
+        break;
+      }
+      stats.events++;
+      c.cursor++;
+      c.since = now;
+    }
+    if (out.length == 0 && now - c.since >= HTTP_KEEPALIVE_MS) {
+      put(out, ": keep-alive\n\n");
+      c.since = now;
+    }
+  }
+  c.txLength = out.length;
+  c.txSent = 0;
+}
+
+static void write_response(Connection& c, unsigned long now) {
+  size_t budget = HTTP_WRITE_PER_LOOP;
+  while (budget > 0) {
+    if (c.txSent == c.txLength) {
+      if (c.closeWhenSent) {
+        c.client.stop();
+        return;
+      }
+      refill(c, now);
+      if (c.txLength == 0) return;
+    }
+    size_t length = c.txLength - c.txSent < budget ? c.txLength - c.txSent : budget;
+    size_t n = c.client.write((const uint8_t*)c.tx + c.txSent, length);
+    if (n == 0) return;
+    c.txSent += n;
+    budget -= n;
+  }
+}
+
+// ============ Server ============
+static void release(Connection& c) {
+  c.client.stop();
+  c.phase = Phase::Free;
+  stats.open--;
+}
+
+static void accept_pending(unsigned long now) {
+  for (uint8_t i = 0; i < HTTP_ACCEPT_PER_LOOP; i++) {
+    WiFiClient client = server.accept();
+    if (!client) return;
+    stats.accepted++;
+
+    Connection* slot = nullptr;
+    for (Connection& c : connections) {
+      if (c.phase == Phase::Free) {
+        slot = &c;
+        break;
+      }
+    }
+    if (!slot) {
+      // Whatever of the request has arrived is dropped first, so the close
+      // that follows does not turn into a reset that swallows the 503
+      uint8_t discard[128];
+      while (client.read(discard, sizeof(discard)) > 0) {}
+      client.write((const uint8_t*)BUSY, sizeof(BUSY) - 1);
+      client.stop();
+      stats.refused++;
+      continue;
+    }
+
+    slot->client = std::move(client);
+    slot->phase = Phase::Request;
+    slot->since = now;
+    slot->lineLength = 0;
+    slot->requestLine = false;
+    slot->route = Route::NotFound;
+    slot->listed = false;
+    slot->txLength = 0;
+    slot->txSent = 0;
+    slot->closeWhenSent = false;
+    stats.open++;
+    if (stats.open > stats.peakOpen) stats.peakOpen = stats.open;
+  }
+}
+
+void http_begin(const char* deviceId) {
+  httpDeviceId = deviceId;
+  server.begin();
+  server.setNoDelay(true);
+  Log::printf("[HTTP] Serving /latest, /history and /events on port %d (%d clients, %d streams)\n", HTTP_PORT,
+              HTTP_MAX_CLIENTS, HTTP_MAX_STREAMS);
+}
+
+void http_sample(const HttpSample& sample) {
+  newestId++;
+  samples[newestId % HTTP_HISTORY_SAMPLES] = sample;
+}
+
+void http_loop(unsigned long now) {
+  accept_pending(now);
+  for (Connection& c : connections) {
+    if (c.phase == Phase::Free) continue;
+    if (c.phase == Phase::Request) {
+      read_request(c, now);
+      if (c.phase == Phase::Request && now - c.since >= HTTP_REQUEST_TIMEOUT_MS) {
+        release(c);
+        continue;
+      }
+    }
+    if (c.phase != Phase::Request) write_response(c, now);
+    if (!c.client.connected()) release(c);
+  }
+}
+
+const HttpStats& http_stats() {
+  return stats;
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include "irrigation_zones.h"
+#include "firmware_profile.h"
+
+// ============ Zone State ============
+struct Zone {
+  ZoneState state;
+  unsigned long startedAt;
+  unsigned long durationMs;
+  unsigned long lastWateredAt;
+  char id[8];
+};
+
+static const uint8_t valvePins[] = ZONE_VALVE_PINS;
+static_assert(sizeof(valvePins) >= ZONE_COUNT, "ZONE_VALVE_PINS has fewer pins than ZONE_COUNT");
+
+static Zone zones[ZONE_COUNT];
+static uint8_t pumpPin = 0;
+static bool pumpOn = false;
+static uint8_t activeCount = 0;
+static unsigned long lastValveStart = 0;
+static uint16_t changedMask = 0;
+
+// FIFO of queued zones; each zone appears at most once so ZONE_COUNT slots suffice
+static uint8_t queue[ZONE_COUNT];
+static uint8_t queueHead = 0;
+static uint8_t queueLength = 0;
+
+// ============ Internal Helpers ============
+static void set_state(uint8_t zone, ZoneState state) {
+  if (zones[zone].state != state) {
+    zones[zone].state = state;
+    changedMask |= (1 << zone);
+  }
+}
+
+static void set_pump(bool on) {
+  if (pumpOn != on) {
+    pumpOn = on;
+    digitalWrite(pumpPin, on ? HIGH : LOW);
+    Log::printf("[Zones] Pump %s\n", on ? "ON" : "OFF");
+  }
+}
+
+static void remove_from_queue(uint8_t zone) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < queueLength; i++) {
+    uint8_t z = queue[(queueHead + i) % ZONE_COUNT];
+    if (z != zone) {
+      queue[(queueHead + kept) % ZONE_COUNT] = z;
+      kept++;
+    }
+  }
+  queueLength = kept;
+}
+
+static void close_valve(uint8_t zone) {
+  if (zones[zone].state == ZONE_WATERING) {
+    activeCount--;
+    // Stop the pump before the last valve closes to avoid a pressure spike
+    if (activeCount == 0) {
+      set_pump(false);
+    }
+    digitalWrite(valvePins[zone], LOW);
+    Log::printf("[Zones] %s valve closed\n", zones[zone].id);
+  }
+  set_state(zone, ZONE_IDLE);
+}
+
+// ============ Irrigation Zone API ============
+void zones_begin(uint8_t pump) {
+  pumpPin = pump;
+  pumpOn = false;
+  activeCount = 0;
+  queueHead = 0;
+  queueLength = 0;
+  changedMask = 0;
+
+  for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+    pinMode(valvePins[z], OUTPUT);
+    digitalWrite(valvePins[z], LOW);
+    zones[z].state = ZONE_IDLE;
+    zones[z].startedAt = 0;
+    zones[z].durationMs = 0;
+    zones[z].lastWateredAt = 0;
+    snprintf(zones[z].id, sizeof(zones[z].id), "zone-%02d", z + 1);
+  }
+}
+
+void zones_set_pump_pin(uint8_t pump) {
+  if (pump == pumpPin) return;
+  digitalWrite(pumpPin, LOW);
+  pinMode(pump, OUTPUT);
+  digitalWrite(pump, pumpOn ? HIGH : LOW);
+  pumpPin = pump;
+}
+
+void zones_loop(unsigned long now) {
+  // Finish zones whose watering time has elapsed
+  for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+    if (zones[z].state == ZONE_WATERING && now - zones[z].startedAt >= zones[z].durationMs) {
+      close_valve(z);
+    }
+  }
+
+  // Start at most one queued zone per pass, staggered to spread inrush current
+  if (queueLength > 0 && activeCount < ZONE_MAX_ACTIVE &&
+      (activeCount == 0 || now - lastValveStart >= ZONE_START_STAGGER_MS)) {
+    uint8_t z = queue[queueHead];
+    queueHead = (queueHead + 1) % ZONE_COUNT;
+    queueLength--;
+
+    digitalWrite(valvePins[z], HIGH);
+    zones[z].startedAt = now;
+    zones[z].lastWateredAt = now;
+    lastValveStart = now;
+    activeCount++;
+    set_state(z, ZONE_WATERING);
+    Log::printf("[Zones] %s valve open for %lu ms\n", zones[z].id, zones[z].durationMs);
+  }
+
+  // Pump follows the valves, with a short lead so it never runs dead-headed
+  if (activeCount > 0 && !pumpOn && now - lastValveStart >= ZONE_PUMP_LEAD_MS) {
+    set_pump(true);
+  }
+}
+
+ZoneRequestResult zones_request(uint8_t zone, unsigned long durationMs, unsigned long now) {
+  if (zone >= ZONE_COUNT || durationMs == 0) {
+    return ZONE_REJECTED_INVALID;
+  }
+  if (zones[zone].state != ZONE_IDLE) {
+    return ZONE_ALREADY_PENDING;
+  }
+  if (zones[zone].lastWateredAt != 0 && now - zones[zone].lastWateredAt < ZONE_MIN_INTERVAL_MS) {
+    return ZONE_REJECTED_INTERVAL;
+  }
+
+  zones[zone].durationMs = min(durationMs, ZONE_MAX_DURATION_MS);
+  queue[(queueHead + queueLength) % ZONE_COUNT] = zone;
+  queueLength++;
+  set_state(zone, ZONE_QUEUED);
+  return ZONE_ACCEPTED;
+}
+
+void zones_stop(uint8_t zone) {
+  if (zone >= ZONE_COUNT) return;
+  if (zones[zone].state == ZONE_QUEUED) {
+    remove_from_queue(zone);
+  }
+  close_valve(zone);
+}
+
+void zones_stop_all() {
+  queueLength = 0;
+  for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+    close_valve(z);
+  }
+  set_pump(false);
+}
+
+bool zones_pump_on() {
+  return pumpOn;
+}
+
+uint8_t zones_active_count() {
+  return activeCount;
+}
+
+uint8_t zones_queued_count() {
+  return queueLength;
+}
+
+ZoneState zone_state(uint8_t zone) {
+  if (zone >= ZONE_COUNT) return ZONE_IDLE;
+  return zones[zone].state;
+}
+
+const char* zone_state_name(ZoneState state) {
+  switch (state) {
+    case ZONE_QUEUED: return "QUEUED";
+    case ZONE_WATERING: return "WATERING";
+    default: return "IDLE";
+  }
+}
+
+const char* zone_request_result_name(ZoneRequestResult result) {
+  switch (result) {
+    case ZONE_ACCEPTED: return "accepted";
+    case ZONE_ALREADY_PENDING: return "already_pending";
+    case ZONE_REJECTED_INTERVAL: return "min_interval";
+    default: return "invalid";
+  }
+}
+
+const char* zone_id(uint8_t zone) {
+  if (zone >= ZONE_COUNT) return "";
+  return zones[zone].id;
+}
+
+int zone_index(const char* id) {
+  for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+    if (strcmp(id, zones[z].id) == 0) return z;
+  }
+  return -1;
+}
+
+unsigned long zone_remaining_ms(uint8_t zone, unsigned long now) {
+  if (zone >= ZONE_COUNT || zones[zone].state != ZONE_WATERING) return 0;
+  unsigned long elapsed = now - zones[zone].startedAt;
+  return elapsed >= zones[zone].durationMs ? 0 : zones[zone].durationMs - elapsed;
+}
+
+unsigned long zone_last_watered(uint8_t zone) {
+  if (zone >= ZONE_COUNT) return 0;
+  return zones[zone].lastWateredAt;
+}
+
+uint16_t zones_take_changed() {
+  uint16_t changed = changedMask;
+  changedMask = 0;
+  return changed;
+}
@@ -2,7 +2,40 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <DHT.h>
+#include <esp_system.h>
 #include <ArduinoJson.h>
+#include "soil_probes.h"
+#include "irrigation_zones.h"
+#include "device_identity.h"
+#include "device_config.h"
+#include "topics.h"
+#include "sensor_filter.h"
+#include "telemetry.h"
+#include "trace_recorder.h"
+#include "anomaly_detector.h"
+#include "watering_monitor.h"
+#include "dryness_predictor.h"
+#include "actuator_forest.h"
+#include "trend_model.h"
+#include "device_shadow.h"
+#include "stream_sequence.h"
+#include "presence.h"
+#include "mqtt5_client.h"
+#include "mqttsn_client.h"
+#include "tls_client.h"
+#include "ws_client.h"
+#include "broker_failover.h"
+#include "offline_backlog.h"
+#include "http_server.h"
+#include "sample_snapshot.h"
+#include "firmware_profile.h"
+#include <type_traits>
+
+#if FEATURE_MQTT_TLS
+// Generated by mqtt-broker/tls/generate-certs.sh; defines MQTT_CA_CERT, the
+// CA that signed the broker's certificate
+#include "mqtt_ca_cert.h"
+#endif
 
 // ============ WiFi Configuration ============
 const char* ssid = "Wokwi-GUEST";
@@ -13,117 +46,220 @@ const char* password = "";
 const char* mqtt_server = "192.168.240.1";  // Wokwi gateway (correct for simulation)
 const int mqtt_port = 1883;
 
+// FEATURE_BROKER_FAILOVER: tried in this order, the primary first. The
+// standby is the mosquitto-standby service (docker compose --profile failover),
+// which only publishes a plain MQTT listener.
+const BrokerEndpoint mqtt_brokers[] = {
+  {mqtt_server, PROFILE.mqttWs ? MQTT_WS_PORT : PROFILE.mqttTls ? MQTT_TLS_PORT : mqtt_port},
+  {mqtt_server, 1884},
+};
+
 // ============ Pin Definitions ============
-#define DHTPIN 4
 #define DHTTYPE DHT22
-#define SOIL_MOISTURE_PIN 34
-#define LIGHT_PIN 35
-#define PUMP_PIN 5
-#define FAN_PIN 18
-#define GROW_LIGHT_PIN 19
+// DHTPIN and the runtime-configurable light/actuator pins are in device_config.h
+// Soil probe pins and multiplexer wiring are configured in soil_probes.h
+// Zone valve pins (sharing the pump on PUMP_PIN) are configured in irrigation_zones.h
+
+// ============ Device Identity ============
+// Derived from NVS or the eFuse MAC at boot (see device_identity.h)
+const char* device_id = "";
+char zoneTopicPrefix[64];  // "plant-iot/<device>/zones/"
+char traceTopic[TOPIC_MAX_LEN];         // "plant-iot/<device>/trace"
+char traceCommandTopic[TOPIC_MAX_LEN];  // "plant-iot/<device>/trace/command"
+char configSetTopic[TOPIC_MAX_LEN];     // "plant-iot/<device>/config/set"
+char configGetTopic[TOPIC_MAX_LEN];     // "plant-iot/<device>/config/get"
+char configStateTopic[TOPIC_MAX_LEN];   // "plant-iot/<device>/config/state"
+char identitySetTopic[TOPIC_MAX_LEN];   // "plant-iot/<device>/identity/set"
+char identityStateTopic[TOPIC_MAX_LEN]; // "plant-iot/<device>/identity/state"
+char shadowDesiredTopic[TOPIC_MAX_LEN]; // "plant-iot/<device>/shadow/desired"
+char shadowGetTopic[TOPIC_MAX_LEN];     // "plant-iot/<device>/shadow/get"
+char shadowReportedTopic[TOPIC_MAX_LEN];// "plant-iot/<device>/shadow/reported"
+char onlineTopic[TOPIC_MAX_LEN];        // "plant-iot/<device>/online"
+char willPayload[96];                   // Offline message registered as the Last Will
 
 // ============ Global Objects ============
+// FEATURE_MQTTSN swaps the TCP connection to the broker for UDP datagrams to
+// an MQTT-SN gateway on the same host (MQTTSN_GATEWAY_PORT). FEATURE_MQTT_TLS
+// runs the TCP connection through TLS (MQTT_TLS_PORT). FEATURE_MQTT_WS
+// carries MQTT in WebSocket frames (MQTT_WS_PORT), over TLS if both are set.
 DHT dht(DHTPIN, DHTTYPE);
-WiFiClient espClient;
-PubSubClient client(espClient);
+std::conditional_t<PROFILE.mqttsn, WiFiUDP, WiFiClient> espClient;
+std::conditional_t<PROFILE.mqttTls, TlsClient, decltype(espClient)&> tlsTransport(espClient);
+std::conditional_t<PROFILE.mqttWs, WsClient, decltype(tlsTransport)&> mqttTransport(tlsTransport);
+std::conditional_t<PROFILE.mqttsn, MqttSnClient, std::conditional_t<PROFILE.mqtt5, Mqtt5Client, PubSubClient>>
+    client(mqttTransport);
 
 // ============ Global Variables ============
 unsigned long lastSensorRead = 0;
 unsigned long lastMqttPublish = 0;
-const unsigned long SENSOR_INTERVAL = 2000;  // 2 seconds
-const unsigned long MQTT_INTERVAL = 2000;    // 2 seconds
+// Sensor and publish intervals are runtime configurable (config().sensorIntervalMs, ...)
 
-// Sensor smoothing - 5-sample rolling average
-#define SMOOTHING_SIZE 5
-float tempBuffer[SMOOTHING_SIZE] = {0.0};
-float humidityBuffer[SMOOTHING_SIZE] = {0.0};
-int moistureBuffer[SMOOTHING_SIZE] = {0};
-int lightBuffer[SMOOTHING_SIZE] = {0};
-int bufferIndex = 0;
+// Sensor smoothing - rolling average, window set by config().smoothingSize (see sensor_filter.h)
+EnvironmentFilter envFilter;
 
-// Deduplication - store combined sensor string to prevent duplicate publishes
-String lastPublishedSensorString = "";
+// Deduplication - store combined sensor string per plant to prevent duplicate publishes
+String lastPublishedSensorString[PLANT_COUNT];
 
-float temperature = 0.0;
-float humidity = 0.0;
-int soilMoisture = 0;
-int lightIntensity = 0;
+// The latest reading and the actuator states live in one snapshot, read
+// whole with snapshot_read() (see sample_snapshot.h)
 
-bool pumpStatus = false;
-bool fanStatus = false;
-bool growLightStatus = false;
+uint32_t mqttConnects = 0;  // Successful connects since boot, reported in the birth message
 
 // ============ Function Prototypes ============
 void setup_wifi();
 void setup_mqtt();
+template <typename Mqtt> void setup_mqtt5(Mqtt& mqtt);
+void setup_mqtt5(Mqtt5Client& mqtt);
+template <typename Mqtt> void setup_mqttsn(Mqtt& mqtt);
+void setup_mqttsn(MqttSnClient& mqtt);
+template <typename Transport> void setup_tls(Transport& transport);
+void setup_tls(TlsClient& tls);
+template <typename Mqtt> void respond_command(Mqtt& mqtt, const char* status, uint16_t rejectedZones = 0);
+void respond_command(Mqtt5Client& mqtt, const char* status, uint16_t rejectedZones = 0);
+template <typename Mqtt> void limit_connect_wait(Mqtt& mqtt);
+void limit_connect_wait(MqttSnClient& mqtt);
 void reconnect_mqtt();
 void callback(char* topic, byte* payload, unsigned int length);
 void read_sensors();
+bool publish_telemetry(uint16_t stream, const char* topic, const char* payload);
+bool publish_sequenced(uint16_t stream, const char* topic, const char* payload);
+bool publish_backlogged(const char* topic, const char* payload);
 void publish_sensor_data();
+void publish_plant_data(const SensorReading& reading, uint8_t plant);
 void publish_status();
+void publish_zone_status(uint8_t zone, const char* rejected = nullptr);
+void publish_birth();
+void publish_anomaly_event(const AnomalyEvent& event);
+void publish_watering_event(const WateringEvent& event);
+void publish_dryness_estimate(const DrynessEstimate& estimate);
+void publish_trend_prediction(const TrendPrediction& prediction);
+const char* handle_zone_command(uint8_t zone, JsonDocument& doc);
+uint16_t set_pump_command(bool on);
+void set_fan(bool on);
+void set_grow_light(bool on);
+void handle_trace_command(JsonDocument& doc);
+bool publish_trace_chunk(const uint8_t* data, size_t length);
+void apply_config(const DeviceConfig& next, const DeviceConfig& previous);
+void apply_soil_calibration(const DeviceConfig& c);
+void handle_config_set(const byte* payload, unsigned int length);
+void publish_config_state(const char* status, const char* error);
+void handle_identity_set(const byte* payload, unsigned int length);
+void apply_shadow_desired(const ShadowDesired& desired);
+void publish_shadow(bool full);
 void control_actuators();
 
-// ============ Sensor Smoothing Helper Functions ============
-float getSmoothedFloat(float* buffer, int size) {
-  float sum = 0.0;
-  for (int i = 0; i < size; i++) {
-    sum += buffer[i];
-  }
-  return sum / size;
-}
-
-int getSmoothedInt(int* buffer, int size) {
-  long sum = 0;
-  for (int i = 0; i < size; i++) {
-    sum += buffer[i];
-  }
-  return sum / size;
-}
-
 // ============ Deduplication Helper Function ============
-// Creates a combined string of all sensor values for deduplication
-String createSensorString() {
+// Creates a combined string of all sensor values for deduplication.
+// Shared environment readings are combined with the given plant's moisture.
+String createSensorString(const SensorReading& reading, uint8_t plant) {
   String sensorString = "";
   sensorString += "T:";
-  sensorString += (int)temperature;  // Use integer part to avoid float precision issues
+  sensorString += (int)reading.temperature;  // Use integer part to avoid float precision issues
   sensorString += "H:";
-  sensorString += (int)humidity;
+  sensorString += (int)reading.humidity;
   sensorString += "M:";
-  sensorString += soilMoisture;
+  sensorString += reading.soilMoisture[plant];
   sensorString += "L:";
-  sensorString += lightIntensity;
+  sensorString += reading.lightIntensity;
   return sensorString;
 }
 
-// Check if sensor data has changed since last published reading
-boolean hasSensorDataChanged() {
-  String currentSensorString = createSensorString();
+// Check if sensor data has changed since last published reading for a plant
+boolean hasSensorDataChanged(const SensorReading& reading, uint8_t plant = 0) {
+  String currentSensorString = createSensorString(reading, plant);
   
-  if (currentSensorString != lastPublishedSensorString) {
-    lastPublishedSensorString = currentSensorString;
-    Serial.printf("[Dedup] Sensor data changed: %s - will publish\n", currentSensorString.c_str());
+  if (currentSensorString != lastPublishedSensorString[plant]) {
+    lastPublishedSensorString[plant] = currentSensorString;
+    Log::printf("[Dedup] Sensor data changed: %s - will publish\n", currentSensorString.c_str());
     return true;
   }
   
-  Serial.println("[Dedup] No change - skipping publish");
+  Log::printf("[Dedup] No change for %s - skipping publish\n", soil_probe_id(plant));
   return false;
 }
 
 // ============ Setup ============
 void setup() {
-  Serial.begin(115200);
-  delay(2000);
-  Serial.println("\n\nStarting Smart Plant IoT System...");
+  // The UART and the pause for a serial monitor to attach are only worth
+  // their boot time when something is logged
+  if constexpr (PROFILE.serialLog) {
+    Serial.begin(115200);
+    delay(2000);
+  }
+  Log::println("\n\nStarting Smart Plant IoT System...");
+  
+  // Load the runtime configuration; applying it sets up the actuator pins (all OFF)
+  config_begin(apply_config);
+  
+  // Derive device identity and build the MQTT topic table once
+  device_id = device_identity_begin();
+  topics_begin(device_id);
+  
+  // Count this boot; every telemetry stream restarts at seq 1
+  sequence_begin();
+  
+  // Presence topic and the Last Will the broker publishes if we vanish
+  snprintf(onlineTopic, sizeof(onlineTopic), "%s" PRESENCE_TOPIC_SUFFIX, topic_device_prefix());
+  serialize_offline(device_id, sequence_boot(), willPayload, sizeof(willPayload));
+  
+  // Trace recorder (idle until started over MQTT)
+  if constexpr (PROFILE.trace) {
+    snprintf(traceTopic, sizeof(traceTopic), "%strace", topic_device_prefix());
+    snprintf(traceCommandTopic, sizeof(traceCommandTopic), "%strace/command", topic_device_prefix());
+    trace_begin(device_id, publish_trace_chunk);
+  }
+  
+  // Streaming anomaly detection (publishes events only)
+  if constexpr (PROFILE.anomalyEvents) {
+    anomaly_begin(publish_anomaly_event);
+  }
+  
+  // Watering response and moisture drop detection (publishes events only)
+  if constexpr (PROFILE.wateringEvents) {
+    watering_begin(publish_watering_event);
+  }
+  
+  // Per-pot drying-rate model and dryness ETA
+  if constexpr (PROFILE.drynessEta) {
+    dryness_begin(publish_dryness_estimate);
+  }
+  
+  // Int8 trend model, mapped from the "trendmodel" flash partition
+  if constexpr (PROFILE.trendModel) {
+    if (trend_model_begin(publish_trend_prediction)) {
+      Log::printf("Trend model %s loaded (%u-minute horizon)\n", trend_model_id(), trend_model_horizon());
+    } else {
+      Log::println("No valid trend model in the trendmodel partition");
+    }
+  }
+  
+  // Runtime configuration topics
+  if constexpr (PROFILE.runtimeConfig) {
+    snprintf(configSetTopic, sizeof(configSetTopic), "%sconfig/set", topic_device_prefix());
+    snprintf(configGetTopic, sizeof(configGetTopic), "%sconfig/get", topic_device_prefix());
+    snprintf(configStateTopic, sizeof(configStateTopic), "%sconfig/state", topic_device_prefix());
+    snprintf(identitySetTopic, sizeof(identitySetTopic), "%sidentity/set", topic_device_prefix());
+    snprintf(identityStateTopic, sizeof(identityStateTopic), "%sidentity/state", topic_device_prefix());
+  }
+  
+  // Device shadow topics; desired state arrives with the subscription
+  if constexpr (PROFILE.deviceShadow) {
+    snprintf(shadowDesiredTopic, sizeof(shadowDesiredTopic), "%sshadow/desired", topic_device_prefix());
+    snprintf(shadowGetTopic, sizeof(shadowGetTopic), "%sshadow/get", topic_device_prefix());
+    snprintf(shadowReportedTopic, sizeof(shadowReportedTopic), "%sshadow/reported", topic_device_prefix());
+    shadow_begin(apply_shadow_desired);
+  }
   
-  // Initialize pins
-  pinMode(PUMP_PIN, OUTPUT);
-  pinMode(FAN_PIN, OUTPUT);
-  pinMode(GROW_LIGHT_PIN, OUTPUT);
+  // Initialize irrigation zones (one valve per zone, shared pump)
+  snprintf(zoneTopicPrefix, sizeof(zoneTopicPrefix), "%szones/", topic_device_prefix());
+  if (ZONE_COUNT > 1) {
+    zones_begin(config().pins.pump);
+  }
   
-  // Initialize all actuators as OFF
-  digitalWrite(PUMP_PIN, LOW);
-  digitalWrite(FAN_PIN, LOW);
-  digitalWrite(GROW_LIGHT_PIN, LOW);
+  // Initialize soil probe channels (multiplexer select lines, filters)
+  soil_probes_begin();
+  soil_probes_set_smoothing(config().soilSmoothingSize);
+  apply_soil_calibration(config());
   
   // Initialize DHT sensor
   dht.begin();
@@ -133,90 +269,258 @@ void setup() {
   setup_wifi();
   setup_mqtt();
   
-  Serial.println("Setup Complete!");
+  // LAN dashboards read the device directly (/latest, /history, /events)
+  if constexpr (PROFILE.httpServer) {
+    http_begin(device_id);
+  }
+  
+  Log::println("Setup Complete!");
 }
 
 // ============ Main Loop ============
 void loop() {
+  // Probe the other brokers; go back to the primary once it has been healthy for a while
+  if constexpr (PROFILE.brokerFailover) {
+    if (failover_loop(millis(), client.connected())) {
+      client.publish(onlineTopic, willPayload, true);  // A clean disconnect skips the Last Will
+      client.disconnect();
+    }
+  }
+  
   // Maintain MQTT connection
   if (!client.connected()) {
     reconnect_mqtt();
   }
   client.loop();
   
+  // Telemetry held back while no broker was connected, oldest first
+  if constexpr (PROFILE.brokerFailover) {
+    if (client.connected()) {
+      backlog_replay(publish_backlogged, BACKLOG_REPLAY_PER_LOOP);
+    }
+  }
+  
+  // Serve LAN dashboards; bounded work per pass, whatever the number of clients
+  if constexpr (PROFILE.httpServer) {
+    http_loop(millis());
+  }
+  
+  // Sequence irrigation zones and report state changes immediately
+  if (ZONE_COUNT > 1) {
+    zones_loop(millis());
+    snapshot_set_pump(zones_pump_on());
+    uint16_t changed = zones_take_changed();
+    for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+      if (changed & (1 << z)) {
+        publish_zone_status(z);
+        // Zone n's valve waters every plant p with p % ZONE_COUNT == n
+        if constexpr (PROFILE.wateringEvents) {
+          for (uint8_t p = z; p < PLANT_COUNT; p += ZONE_COUNT) {
+            watering_pump(p, zone_state(z) == ZONE_WATERING, millis());
+          }
+        }
+      }
+    }
+  }
+  
   // Read sensors at interval
   unsigned long currentTime = millis();
-  if (currentTime - lastSensorRead >= SENSOR_INTERVAL) {
+  if (currentTime - lastSensorRead >= config().sensorIntervalMs) {
     read_sensors();
     lastSensorRead = currentTime;
   }
   
   // Publish data at interval
-  if (currentTime - lastMqttPublish >= MQTT_INTERVAL) {
+  if (currentTime - lastMqttPublish >= config().publishIntervalMs) {
     publish_sensor_data();
     publish_status();
     control_actuators();
     lastMqttPublish = currentTime;
   }
   
+  // Commit or roll back a configuration change once its trial is over
+  if constexpr (PROFILE.runtimeConfig) {
+    ConfigEvent configEvent = config_loop(millis());
+    if (configEvent == CONFIG_EVENT_COMMITTED) {
+      publish_config_state("committed", config_last_error());
+    } else if (configEvent == CONFIG_EVENT_ROLLED_BACK) {
+      publish_config_state("rolled_back", config_last_error());
+    }
+    if (configEvent != CONFIG_EVENT_NONE) {
+      publish_birth();  // Keep the retained config_hash current
+    }
+  }
+  
+  // Report actuator and configuration changes as shadow deltas
+  if constexpr (PROFILE.deviceShadow) {
+    publish_shadow(false);
+  }
+  
+  // Record actuator changes and flush the trace recorder
+  if constexpr (PROFILE.trace) {
+    ActuatorState actuators = snapshot_actuators();
+    trace_actuators(millis(), actuators.pump, actuators.fan, actuators.growLight);
+    trace_loop(millis());
+  }
+  
   delay(100);  // Small delay to prevent blocking
 }
 
 // ============ WiFi Setup ============
 void setup_wifi() {
   delay(10);
-  Serial.print("Connecting to WiFi: ");
-  Serial.println(ssid);
+  Log::print("Connecting to WiFi: ");
+  Log::println(ssid);
   
   WiFi.begin(ssid, password);
   
   int attempts = 0;
   while (WiFi.status() != WL_CONNECTED && attempts < 20) {
     delay(500);
-    Serial.print(".");
+    Log::print(".");
     attempts++;
   }
   
-  Serial.println();
+  Log::println();
   if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("WiFi connected");
-    Serial.print("IP address: ");
-    Serial.println(WiFi.localIP());
+    Log::println("WiFi connected");
+    Log::print("IP address: ");
+    Log::println(WiFi.localIP());
   } else {
-    Serial.println("Failed to connect WiFi (continuing with MQTT simulation)");
+    Log::println("Failed to connect WiFi (continuing with MQTT simulation)");
   }
 }
 
 // ============ MQTT Setup ============
 void setup_mqtt() {
-  client.setServer(mqtt_server, mqtt_port);
+  client.setServer(mqtt_server, PROFILE.mqttsn    ? MQTTSN_GATEWAY_PORT
+                                : PROFILE.mqttWs  ? MQTT_WS_PORT
+                                : PROFILE.mqttTls ? MQTT_TLS_PORT
+                                                  : mqtt_port);
   client.setCallback(callback);
+  // Default 256-byte packet buffer is too small for per-plant aggregated payloads
+  // and a multi-plant board's config/state (MQTT5_BUFFER_SIZE and
+  // MQTTSN_BUFFER_SIZE cap it on those transports)
+  client.setBufferSize(max(512, CONFIG_STATE_SIZE + 64));
+  setup_mqtt5(client);
+  setup_mqttsn(client);
+  setup_tls(tlsTransport);
+  
+  // Probes check CONNACK on plain MQTT, only the TCP port behind TLS or WebSocket
+  if constexpr (PROFILE.brokerFailover) {
+    failover_begin(mqtt_brokers, sizeof(mqtt_brokers) / sizeof(mqtt_brokers[0]), device_id,
+                   !PROFILE.mqttTls && !PROFILE.mqttWs);
+    limit_connect_wait(client);
+  }
+}
+
+template <typename Mqtt>
+void setup_mqtt5(Mqtt&) {}
+
+// Non-retained messages older than MQTT5_TELEMETRY_EXPIRY_S are dropped by
+// the broker instead of being delivered to a consumer that reconnects
+void setup_mqtt5(Mqtt5Client& mqtt) {
+  mqtt.setMessageExpiry(MQTT5_TELEMETRY_EXPIRY_S);
+  mqtt.addUserProperty("schema", TELEMETRY_SCHEMA_VERSION);
+  mqtt.addUserProperty("encoding", "json");
+}
+
+template <typename Mqtt>
+void setup_mqttsn(Mqtt&) {}
+
+// The topics.h table goes out as predefined topic IDs, which the gateway
+// derives from the client ID: telemetry and commands never need a REGISTER
+void setup_mqttsn(MqttSnClient& mqtt) {
+  for (int t = 0; t < TOPIC_COUNT; t++) {
+    mqtt.predefine(mqttsn_predefined_id((TopicId)t), topic_name((TopicId)t));
+  }
 }
 
+template <typename Transport>
+void setup_tls(Transport&) {}
+
+#if FEATURE_MQTT_TLS
+// The broker must present a certificate for mqtt_server signed by this CA.
+// Reconnects resume the saved TLS session (see tls_client.h).
+void setup_tls(TlsClient& tls) {
+  tls.setCACert(MQTT_CA_CERT);
+  Log::printf("[TLS] Hardware AES/SHA/RSA: %s\n", TlsClient::hardwareCrypto() ? "yes" : "no");
+}
+#endif
+
+// A broker that accepts the TCP connection but never answers CONNECT would
+// otherwise hold the device for the client's CONNACK wait (15 s for
+// PubSubClient, 5 s for Mqtt5Client), past BROKER_FAILOVER_AFTER_MS
+template <typename Mqtt>
+void limit_connect_wait(Mqtt& mqtt) {
+  mqtt.setSocketTimeout(BROKER_CONNECT_TIMEOUT_S);
+}
+
+// MQTT-SN has no broker list (firmware_profile.h)
+void limit_connect_wait(MqttSnClient&) {}
+
 // ============ MQTT Reconnect ============
 void reconnect_mqtt() {
   int attempts = 0;
   while (!client.connected() && attempts < 3) {
-    Serial.print("Attempting MQTT connection...");
-    
-    // Create unique client ID
-    String clientId = "ESP32-";
-    clientId += String(random(0xffff), HEX);
+    // The failover module picks the broker and moves on when one stays down
+    if constexpr (PROFILE.brokerFailover) {
+      const BrokerEndpoint& broker = failover_target(millis());
+      client.setServer(broker.host, broker.port);
+    }
+    Log::print("Attempting MQTT connection...");
     
-    if (client.connect(clientId.c_str())) {
-      Serial.println("connected");
+    // Client ID is the device ID: unique per board and stable across reconnects.
+    // The retained Last Will marks the device offline if the connection drops.
+    if (client.connect(device_id, onlineTopic, PRESENCE_WILL_QOS, true, willPayload)) {
+      Log::println("connected");
+      mqttConnects++;
+      if constexpr (PROFILE.brokerFailover) {
+        failover_connected(millis());
+      }
       
       // Subscribe to command topics
-      client.subscribe("plant-iot/actuators/pump");
-      client.subscribe("plant-iot/actuators/fan");
-      client.subscribe("plant-iot/actuators/grow-light");
-      client.subscribe("plant-iot/control/all");
+      for (int t = TOPIC_FIRST_COMMAND; t < TOPIC_COUNT; t++) {
+        client.subscribe(topic_name((TopicId)t));
+      }
+      
+      if (ZONE_COUNT > 1) {
+        char zoneFilter[80];
+        snprintf(zoneFilter, sizeof(zoneFilter), "%s+/command", zoneTopicPrefix);
+        client.subscribe(zoneFilter);
+      }
+      
+      if constexpr (PROFILE.trace) {
+        client.subscribe(traceCommandTopic);
+      }
+      if constexpr (PROFILE.runtimeConfig) {
+        client.subscribe(configSetTopic);
+        client.subscribe(configGetTopic);
+        client.subscribe(identitySetTopic);
+      }
+      
+      // Subscribing fetches the retained desired document; the full reported
+      // document lets the backend reconcile whatever it missed
+      if constexpr (PROFILE.deviceShadow) {
+        client.subscribe(shadowDesiredTopic);
+        client.subscribe(shadowGetTopic);
+        publish_shadow(true);
+      }
+      
+      // Birth last, once the device is ready to take commands
+      publish_birth();
       
     } else {
-      Serial.print("failed, rc=");
-      Serial.print(client.state());
-      Serial.println(" try again in 5 seconds");
-      delay(5000);
+      Log::print("failed, rc=");
+      Log::print(client.state());
+      if constexpr (PROFILE.brokerFailover) {
+        failover_connect_failed(millis());
+        Log::println(" retrying");
+        delay(BROKER_RETRY_MS);
+      } else {
+        Log::println(" try again in 5 seconds");
+        delay(5000);
+      }
     }
     attempts++;
   }
@@ -224,165 +528,567 @@ void reconnect_mqtt() {
 
 // ============ MQTT Callback ============
 void callback(char* topic, byte* payload, unsigned int length) {
-  Serial.print("Message arrived on topic: ");
-  Serial.println(topic);
+  Log::print("Message arrived on topic: ");
+  Log::println(topic);
+  
+  // Record every command as received (including malformed ones) for replay
+  bool traceControl = false;
+  if constexpr (PROFILE.trace) {
+    traceControl = strcmp(topic, traceCommandTopic) == 0;
+    if (!traceControl) {
+      trace_command(millis(), topic, payload, length);
+    }
+  }
+  
+  // Configuration documents are larger than commands and parsed by device_config
+  if constexpr (PROFILE.runtimeConfig) {
+    if (strcmp(topic, configSetTopic) == 0) {
+      handle_config_set(payload, length);
+      return;
+    }
+    if (strcmp(topic, configGetTopic) == 0) {
+      publish_config_state(config_on_trial() ? "trial" : "active", nullptr);
+      return;
+    }
+    if (strcmp(topic, identitySetTopic) == 0) {
+      handle_identity_set(payload, length);
+      return;
+    }
+  }
+  
+  // Desired documents carry a config section and are parsed by device_shadow
+  if constexpr (PROFILE.deviceShadow) {
+    if (strcmp(topic, shadowDesiredTopic) == 0) {
+      ShadowResult result = shadow_set_desired(payload, length);
+      Log::printf("[Shadow] desired: %s (version %lu)\n", shadow_result_name(result),
+                    (unsigned long)shadow_desired_version());
+      return;
+    }
+    if (strcmp(topic, shadowGetTopic) == 0) {
+      publish_shadow(true);
+      return;
+    }
+  }
   
   // Parse JSON payload
   StaticJsonDocument<200> doc;
   DeserializationError error = deserializeJson(doc, payload, length);
   
   if (error) {
-    Serial.print("JSON parse error: ");
-    Serial.println(error.f_str());
+    Log::print("JSON parse error: ");
+    Log::println(error.f_str());
+    respond_command(client, "invalid_json");
     return;
   }
   
+  int command = topic_lookup(topic);
+  const char* status = "ok";
+  uint16_t rejectedZones = 0;
+  
+  // Handle trace recorder control (always false when the profile has no trace)
+  if (traceControl) {
+    handle_trace_command(doc);
+    return;
+  }
+  
+  // Handle irrigation zone commands: plant-iot/<device>/zones/<zone>/command
+  size_t prefixLength = strlen(zoneTopicPrefix);
+  if (ZONE_COUNT > 1 && strncmp(topic, zoneTopicPrefix, prefixLength) == 0) {
+    char zoneName[8];
+    const char* rest = topic + prefixLength;
+    const char* slash = strchr(rest, '/');
+    if (slash && strcmp(slash, "/command") == 0 && (size_t)(slash - rest) < sizeof(zoneName)) {
+      memcpy(zoneName, rest, slash - rest);
+      zoneName[slash - rest] = '\0';
+      int zone = zone_index(zoneName);
+      if (zone >= 0) {
+        status = handle_zone_command(zone, doc);
+      }
+    }
+  }
+  
   // Handle pump commands
-  if (strcmp(topic, "plant-iot/actuators/pump") == 0) {
+  else if (command == TOPIC_CMD_PUMP) {
     if (doc["action"] == "ON") {
-      pumpStatus = true;
-      digitalWrite(PUMP_PIN, HIGH);
-      Serial.println("Pump turned ON");
+      rejectedZones = set_pump_command(true);
     } else if (doc["action"] == "OFF") {
-      pumpStatus = false;
-      digitalWrite(PUMP_PIN, LOW);
-      Serial.println("Pump turned OFF");
+      set_pump_command(false);
     }
   }
   
   // Handle fan commands
-  else if (strcmp(topic, "plant-iot/actuators/fan") == 0) {
+  else if (command == TOPIC_CMD_FAN) {
     if (doc["action"] == "ON") {
-      fanStatus = true;
-      digitalWrite(FAN_PIN, HIGH);
-      Serial.println("Fan turned ON");
+      set_fan(true);
     } else if (doc["action"] == "OFF") {
-      fanStatus = false;
-      digitalWrite(FAN_PIN, LOW);
-      Serial.println("Fan turned OFF");
+      set_fan(false);
     }
   }
   
   // Handle grow light commands
-  else if (strcmp(topic, "plant-iot/actuators/grow-light") == 0) {
+  else if (command == TOPIC_CMD_GROW_LIGHT) {
     if (doc["action"] == "ON") {
-      growLightStatus = true;
-      digitalWrite(GROW_LIGHT_PIN, HIGH);
-      Serial.println("Grow Light turned ON");
+      set_grow_light(true);
     } else if (doc["action"] == "OFF") {
-      growLightStatus = false;
-      digitalWrite(GROW_LIGHT_PIN, LOW);
-      Serial.println("Grow Light turned OFF");
+      set_grow_light(false);
     }
   }
   
   // Handle global control
-  else if (strcmp(topic, "plant-iot/control/all") == 0) {
+  else if (command == TOPIC_CMD_CONTROL_ALL) {
     bool enable = doc["enable"];
-    digitalWrite(PUMP_PIN, enable ? HIGH : LOW);
-    digitalWrite(FAN_PIN, enable ? HIGH : LOW);
-    digitalWrite(GROW_LIGHT_PIN, enable ? HIGH : LOW);
-    pumpStatus = fanStatus = growLightStatus = enable;
-    Serial.printf("All actuators turned %s\n", enable ? "ON" : "OFF");
+    rejectedZones = set_pump_command(enable);
+    set_fan(enable);
+    set_grow_light(enable);
+    Log::printf("All actuators turned %s\n", enable ? "ON" : "OFF");
+  }
+  
+  if (rejectedZones) status = "zones_rejected";
+  respond_command(client, status, rejectedZones);
+}
+
+// ============ Command Responses ============
+// MQTT 5.0 request/response: a command that carries a response topic gets
+// the resulting actuator states back with its correlation data
+template <typename Mqtt>
+void respond_command(Mqtt&, const char*, uint16_t) {}
+
+void respond_command(Mqtt5Client& mqtt, const char* status, uint16_t rejectedZones) {
+  static_assert(ZONE_COUNT <= COMMAND_RESPONSE_MAX_ZONES, "command responses cannot list every zone");
+  if (!mqtt.responseTopic()) return;
+  const char* rejectedIds[ZONE_COUNT];
+  uint8_t rejectedCount = 0;
+  for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+    if (rejectedZones & (1 << z)) rejectedIds[rejectedCount++] = zone_id(z);
+  }
+  char buffer[160 + ZONE_COUNT * 12];
+  ActuatorState actuators = snapshot_actuators();
+  size_t length = serialize_command_response(status, rejectedIds, rejectedCount, actuators.pump, actuators.fan,
+                                             actuators.growLight, millis(), buffer, sizeof(buffer));
+  if (length > 0) {
+    mqtt.respond((const uint8_t*)buffer, length);
+  }
+}
+
+// ============ Pump Command ============
+// Legacy pump commands drive PUMP_PIN directly on single-zone boards. With
+// zones, ON queues every zone (sequenced by the zone manager) and OFF stops
+// all. Returns the zones ON could not queue (bit n = zone n); each also
+// reports why on its status topic.
+uint16_t set_pump_command(bool on) {
+  if (ZONE_COUNT > 1) {
+    uint16_t rejected = 0;
+    if (on) {
+      for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+        ZoneRequestResult result = zones_request(z, ZONE_DEFAULT_DURATION_MS, millis());
+        if (result == ZONE_REJECTED_INTERVAL || result == ZONE_REJECTED_INVALID) {
+          Log::printf("[Zones] %s request: %s\n", zone_id(z), zone_request_result_name(result));
+          publish_zone_status(z, zone_request_result_name(result));
+          rejected |= 1 << z;
+        }
+      }
+    } else {
+      zones_stop_all();
+    }
+    snapshot_set_pump(zones_pump_on());
+    return rejected;
+  }
+  
+  snapshot_set_pump(on);
+  digitalWrite(config().pins.pump, on ? HIGH : LOW);
+  Log::printf("Pump turned %s\n", on ? "ON" : "OFF");
+  
+  // Without valves the pump waters every pot
+  if constexpr (PROFILE.wateringEvents) {
+    for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+      watering_pump(p, on, millis());
+    }
+  }
+  return 0;
+}
+
+// ============ Fan and Grow Light ============
+void set_fan(bool on) {
+  snapshot_set_fan(on);
+  digitalWrite(config().pins.fan, on ? HIGH : LOW);
+  Log::printf("Fan turned %s\n", on ? "ON" : "OFF");
+}
+
+void set_grow_light(bool on) {
+  snapshot_set_grow_light(on);
+  digitalWrite(config().pins.growLight, on ? HIGH : LOW);
+  Log::printf("Grow Light turned %s\n", on ? "ON" : "OFF");
+}
+
+// ============ Device Shadow ============
+// Applies the sections of a newer desired document; actuators already in the
+// desired state are left alone (a pump request would restart zone queues)
+void apply_shadow_desired(const ShadowDesired& desired) {
+  ActuatorState actuators = snapshot_actuators();
+  if (desired.hasPump && desired.pump != actuators.pump) set_pump_command(desired.pump);
+  if (desired.hasFan && desired.fan != actuators.fan) set_fan(desired.fan);
+  if (desired.hasGrowLight && desired.growLight != actuators.growLight) set_grow_light(desired.growLight);
+  if (PROFILE.runtimeConfig && desired.config) {
+    handle_config_set((const byte*)desired.config, desired.configLength);
+  }
+}
+
+// Topic: plant-iot/<device>/shadow/reported (deltas unless full)
+void publish_shadow(bool full) {
+  if (!client.connected()) return;
+  ActuatorState actuators = snapshot_actuators();
+  ShadowState state = {actuators.pump, actuators.fan, actuators.growLight, config().revision, config_on_trial()};
+  char buffer[256];
+  size_t length = shadow_report(state, full, buffer, sizeof(buffer));
+  if (length > 0 && client.publish(shadowReportedTopic, buffer)) {
+    shadow_reported(state);
+  }
+}
+
+// ============ Runtime Configuration ============
+void move_output(uint8_t from, uint8_t to, bool on) {
+  if (from == to) return;
+  digitalWrite(from, LOW);
+  pinMode(to, OUTPUT);
+  digitalWrite(to, on ? HIGH : LOW);
+}
+
+// The soil probes are set up after the configuration is loaded, so setup()
+// hands them their calibration separately
+void apply_soil_calibration(const DeviceConfig& c) {
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    soil_probe_set_calibration(p, c.soilCalibration[p].dryRaw, c.soilCalibration[p].wetRaw);
+  }
+}
+
+// Applies a configuration to the running firmware. Called once at boot
+// (next and previous are the same object) and for every change or rollback.
+void apply_config(const DeviceConfig& next, const DeviceConfig& previous) {
+  bool boot = &next == &previous;
+  
+  // Actuator pins: all OFF at boot; on a change the old pin is driven LOW and
+  // the new one takes over the actuator's state
+  if (boot) {
+    const uint8_t pins[] = {next.pins.pump, next.pins.fan, next.pins.growLight};
+    for (uint8_t pin : pins) {
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+    }
+  } else {
+    ActuatorState actuators = snapshot_actuators();
+    if (ZONE_COUNT > 1) {
+      zones_set_pump_pin(next.pins.pump);  // The zone manager owns the shared pump
+    } else {
+      move_output(previous.pins.pump, next.pins.pump, actuators.pump);
+    }
+    move_output(previous.pins.fan, next.pins.fan, actuators.fan);
+    move_output(previous.pins.growLight, next.pins.growLight, actuators.growLight);
+  }
+  
+  // Filter windows are resized in place, keeping the current averages
+  if (boot || next.smoothingSize != previous.smoothingSize) {
+    envFilter.resize(next.smoothingSize);
+  }
+  if (!boot && next.soilSmoothingSize != previous.soilSmoothingSize) {
+    soil_probes_set_smoothing(next.soilSmoothingSize);
+  }
+  if (!boot) {
+    apply_soil_calibration(next);  // Takes effect on the next percentage computed
+  }
+  
+  // Intervals take effect on the next loop() pass: loop() compares elapsed
+  // time against config(), so a shorter interval fires immediately
+  if (!boot) {
+    Log::printf("[Config] sensor %lu ms, publish %lu ms, smoothing %u/%u\n",
+                  (unsigned long)next.sensorIntervalMs, (unsigned long)next.publishIntervalMs,
+                  next.smoothingSize, next.soilSmoothingSize);
+  }
+}
+
+// Payload: see device_config.h; the outcome is reported on config/state
+void handle_config_set(const byte* payload, unsigned int length) {
+  char error[48];
+  ConfigResult result = config_set(payload, length, millis(), error, sizeof(error));
+  Log::printf("[Config] set: %s %s\n", config_result_name(result), error);
+  publish_config_state(config_result_name(result), error);
+}
+
+void publish_config_state(const char* status, const char* error) {
+  if (!client.connected()) return;
+  char buffer[CONFIG_STATE_SIZE];
+  config_serialize(status, error, buffer, sizeof(buffer));
+  client.publish(configStateTopic, buffer);
+}
+
+// ============ Identity Provisioning ============
+// Payload: see device_identity.h; the outcome is reported on identity/state
+void handle_identity_set(const byte* payload, unsigned int length) {
+  StaticJsonDocument<128> doc;
+  const char* status;
+  bool stored = false;
+  if (deserializeJson(doc, payload, length) || !doc["device_id"].is<const char*>()) {
+    status = "rejected_parse";
+  } else {
+    const char* id = doc["device_id"];
+    if (id[0] && !device_identity_valid(id)) {
+      status = "rejected_invalid";
+    } else if (!device_identity_provision(id)) {
+      status = "nvs_failed";
+    } else {
+      status = id[0] ? "provisioned" : "cleared";
+      stored = true;
+    }
+  }
+  Log::printf("[Identity] set: %s\n", status);
+  
+  if (client.connected()) {
+    char buffer[128];
+    serialize_identity_state(status, device_id, device_identity_is_provisioned(), millis(), buffer, sizeof(buffer));
+    client.publish(identityStateTopic, buffer);
+  }
+  
+  // Topics, client ID and Last Will all derive from the ID, so it is only
+  // picked up at boot; this identity goes offline first
+  if (stored && (doc["restart"] | false)) {
+    client.publish(onlineTopic, willPayload, true);
+    client.disconnect();
+    delay(100);
+    esp_restart();
   }
 }
 
+// ============ Zone Command ============
+// Payload: {"action": "ON", "duration": 30} (seconds, optional) or {"action": "OFF"}
+// Returns the command status: "ok" or why the request was rejected
+const char* handle_zone_command(uint8_t zone, JsonDocument& doc) {
+  if (doc["action"] == "ON") {
+    // Seconds are checked before scaling, so no duration can wrap around
+    // into an arbitrary valve-open time
+    JsonVariant duration = doc["duration"];
+    long seconds = ZONE_DEFAULT_DURATION_MS / 1000;
+    if (!duration.isNull()) {
+      seconds = duration.is<long>() ? duration.as<long>() : 0;
+    }
+    if (seconds <= 0) {
+      Log::printf("[Zones] %s request: invalid duration\n", zone_id(zone));
+      publish_zone_status(zone, "invalid_duration");
+      return "invalid_duration";
+    }
+    unsigned long durationMs = min((unsigned long)seconds, ZONE_MAX_DURATION_S) * 1000;
+    ZoneRequestResult result = zones_request(zone, durationMs, millis());
+    Log::printf("[Zones] %s request: %s\n", zone_id(zone), zone_request_result_name(result));
+    if (result != ZONE_ACCEPTED) {
+      publish_zone_status(zone, zone_request_result_name(result));
+      return zone_request_result_name(result);
+    }
+  } else if (doc["action"] == "OFF") {
+    zones_stop(zone);
+  }
+  return "ok";
+}
+
+// ============ Trace Recorder ============
+// Payload: {"action": "start", "sink": "mqtt" | "flash"}, {"action": "stop"},
+// {"action": "dump"} or {"action": "erase"}
+void handle_trace_command(JsonDocument& doc) {
+  const char* action = doc["action"] | "";
+  bool ok = false;
+  
+  if (strcmp(action, "start") == 0) {
+    const char* sink = doc["sink"] | "mqtt";
+    ok = trace_start(strcmp(sink, "flash") == 0 ? TRACE_SINK_FLASH : TRACE_SINK_MQTT, millis());
+  } else if (strcmp(action, "stop") == 0) {
+    trace_stop();
+    ok = true;
+  } else if (strcmp(action, "dump") == 0) {
+    ok = trace_dump();
+  } else if (strcmp(action, "erase") == 0) {
+    ok = trace_erase();
+  }
+  
+  Log::printf("[Trace] %s: %s\n", action, ok ? "ok" : "failed");
+}
+
+bool publish_trace_chunk(const uint8_t* data, size_t length) {
+  return client.connected() && client.publish(traceTopic, data, length);
+}
+
 // ============ Read Sensors ============
 void read_sensors() {
   // Read DHT22 (Temperature & Humidity)
   float h = dht.readHumidity();
   float t = dht.readTemperature();
   
-  // Store in buffers for smoothing
-  if (!isnan(h)) {
-    humidityBuffer[bufferIndex] = h;
+  // Scan all soil probe channels (each has its own filter and calibration)
+  soil_probes_scan();
+  
+  // Store in buffers for smoothing (failed DHT reads keep the previous slot)
+  int lightRaw = analogRead(config().pins.light);
+  envFilter.push(t, h, lightRaw);
+  config_note_sensor_read(!isnan(t) && !isnan(h));
+  
+  // Record the unfiltered inputs so the trace can be replayed through the filters
+  if (PROFILE.trace && trace_active()) {
+    int soilRaw[PLANT_COUNT];
+    for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+      soilRaw[p] = soil_probe_sample(p);
+    }
+    trace_sample(millis(), t, h, lightRaw, soilRaw);
   }
-  if (!isnan(t)) {
-    tempBuffer[bufferIndex] = t;
+  
+  // Get smoothed (averaged) values and store them as one reading; the first
+  // plant doubles as the legacy single-pot reading
+  SensorReading reading = {millis(), envFilter.temperature(), envFilter.humidity(), envFilter.light(), {}, {}};
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    reading.soilMoisture[p] = soil_probe_raw(p);
+    reading.soilMoisturePercent[p] = soil_probe_percent(p);
   }
+  snapshot_store_reading(reading);
+  float temperature = reading.temperature;
+  float humidity = reading.humidity;
+  int lightIntensity = reading.lightIntensity;
   
-  // Read ADC sensors
-  moistureBuffer[bufferIndex] = analogRead(SOIL_MOISTURE_PIN);
-  lightBuffer[bufferIndex] = analogRead(LIGHT_PIN);
+  // Compare the smoothed readings with their recent statistics; transitions
+  // are published as events from publish_anomaly_event()
+  if constexpr (PROFILE.anomalyEvents) {
+    anomaly_check_environment(temperature, humidity, light_percent(lightIntensity));
+    for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+      anomaly_check_soil(p, soil_probe_percent(p));
+    }
+  }
   
-  // Move to next buffer position
-  bufferIndex = (bufferIndex + 1) % SMOOTHING_SIZE;
+  // Check that watering raises each pot and that nothing else drains it;
+  // transitions are published as events from publish_watering_event()
+  if constexpr (PROFILE.wateringEvents) {
+    for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+      watering_observe(p, soil_probe_moisture(p), millis());
+    }
+  }
   
-  // Get smoothed (averaged) values
-  temperature = getSmoothedFloat(tempBuffer, SMOOTHING_SIZE);
-  humidity = getSmoothedFloat(humidityBuffer, SMOOTHING_SIZE);
-  soilMoisture = getSmoothedInt(moistureBuffer, SMOOTHING_SIZE);
-  lightIntensity = getSmoothedInt(lightBuffer, SMOOTHING_SIZE);
+  // Learn each pot's drying rate. Any watering (the pump is shared by all
+  // zones) voids the current observation interval.
+  if constexpr (PROFILE.drynessEta) {
+    for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+      dryness_observe(p, soil_probe_moisture(p), temperature, humidity, snapshot_actuators().pump,
+                      config().pumpOnBelowPercent, millis());
+    }
+  }
   
-  Serial.printf("Sensors [Smoothed] - Temp: %.1f°C, Humidity: %.1f%%, Moisture: %d, Light: %d\n",
-                temperature, humidity, soilMoisture, lightIntensity);
+  // One-minute history for the trend model (the first plant's pot)
+  if constexpr (PROFILE.trendModel) {
+    trend_observe(temperature, humidity, soil_probe_percent(0), light_percent(lightIntensity), millis());
+  }
+  
+  Log::printf("Sensors [Smoothed] - Temp: %.1f°C, Humidity: %.1f%%, Moisture: %d, Light: %d\n",
+                temperature, humidity, reading.soilMoisture[0], lightIntensity);
+  
+  if (PLANT_COUNT > 1) {
+    for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+      Log::printf("  %s - Moisture: %d (%d%%)\n", soil_probe_id(p), soil_probe_raw(p), soil_probe_percent(p));
+    }
+  }
+  
+  // The new /latest, appended to /history and pushed to event streams
+  if constexpr (PROFILE.httpServer) {
+    SampleSnapshot latest = snapshot_read();
+    HttpSample sample = {latest.sensors.timestamp, latest.sensors.temperature, latest.sensors.humidity,
+                         latest.sensors.lightIntensity, {}, latest.actuators.pump, latest.actuators.fan,
+                         latest.actuators.growLight};
+    memcpy(sample.moisturePercent, latest.sensors.soilMoisturePercent, sizeof(sample.moisturePercent));
+    http_sample(sample);
+  }
+}
+
+// ============ Publish Telemetry ============
+// Sensor readings, events and predictions, stamped with sequence_peek(stream).
+// With FEATURE_BROKER_FAILOVER they go to the offline backlog while no broker
+// is connected, and behind it until the replay has caught up, so every
+// stream stays in seq order. The seq is taken whether or not the message got
+// out, so every drop on the device is a gap (see stream_sequence.h).
+static_assert(BACKLOG_PAYLOAD_MAX >= TELEMETRY_PAYLOAD_MAX, "the offline backlog must hold every telemetry payload");
+
+bool publish_telemetry(uint16_t stream, const char* topic, const char* payload) {
+  bool accepted;
+  if constexpr (PROFILE.brokerFailover) {
+    accepted = (client.connected() && backlog_empty() && client.publish(topic, payload)) ||
+               backlog_push(topic, payload);
+  } else {
+    accepted = client.publish(topic, payload);
+  }
+  sequence_commit(stream);
+  return accepted;
+}
+
+// Status messages are current state, not worth backlogging
+bool publish_sequenced(uint16_t stream, const char* topic, const char* payload) {
+  bool published = client.publish(topic, payload);
+  sequence_commit(stream);
+  return published;
+}
+
+bool publish_backlogged(const char* topic, const char* payload) {
+  return client.publish(topic, payload);
 }
 
 // ============ Publish Sensor Data ============
 void publish_sensor_data() {
-  if (!client.connected()) return;
+  if (!client.connected() && !PROFILE.brokerFailover) return;
+  
+  // Every message of this publish describes the same reading
+  const SensorReading reading = snapshot_read().sensors;
+  
+  // Multi-plant boards publish each pot as its own logical device
+  if (PLANT_COUNT > 1) {
+    for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+      publish_plant_data(reading, p);
+    }
+    return;
+  }
   
   // Check if sensor data has changed using the deduplication function
-  if (!hasSensorDataChanged()) {
+  if (!hasSensorDataChanged(reading)) {
     return;  // Data hasn't changed, skip publishing
   }
   
-  char buffer[512];
+  char buffer[TELEMETRY_PAYLOAD_MAX];
   
   // Create AGGREGATED sensor data JSON (main format for backend)
-  StaticJsonDocument<256> aggregatedDoc;
-  aggregatedDoc["temperature"] = temperature;
-  aggregatedDoc["humidity"] = humidity;
-  aggregatedDoc["soil_moisture"] = soilMoisture;
-  aggregatedDoc["soil_moisture_percent"] = map(soilMoisture, 1023, 0, 0, 100);
-  aggregatedDoc["light_intensity"] = lightIntensity;
-  aggregatedDoc["light_percent"] = map(lightIntensity, 0, 4095, 0, 100);
-  aggregatedDoc["timestamp"] = millis();
-  aggregatedDoc["device_id"] = "ESP32-Plant-01";
-  aggregatedDoc["quality"] = "excellent";
+  SensorSample sample = {reading.temperature, reading.humidity, reading.soilMoisture[0],
+                         reading.soilMoisturePercent[0], reading.lightIntensity};
+  serialize_aggregated(sample, device_id, nullptr, millis(), sequence_peek(TOPIC_SENSORS_AGGREGATED), buffer,
+                       sizeof(buffer));
   
   // Publish aggregated data (this is what backend expects)
-  serializeJson(aggregatedDoc, buffer);
-  client.publish("plant-iot/sensors/aggregated", buffer);
-  Serial.printf("[MQTT] Published aggregated sensor data\n");
+  publish_telemetry(TOPIC_SENSORS_AGGREGATED, topic_name(TOPIC_SENSORS_AGGREGATED), buffer);
+  Log::printf("[MQTT] Published aggregated sensor data\n");
   
   // Also publish individual sensor topics (for backward compatibility)
-  StaticJsonDocument<100> tempDoc;
-  tempDoc["temperature"] = temperature;
-  tempDoc["unit"] = "celsius";
-  tempDoc["timestamp"] = millis();
-  
-  StaticJsonDocument<100> humidityDoc;
-  humidityDoc["humidity"] = humidity;
-  humidityDoc["unit"] = "percent";
-  humidityDoc["timestamp"] = millis();
-  
-  StaticJsonDocument<100> moistureDoc;
-  moistureDoc["moisture"] = soilMoisture;
-  moistureDoc["unit"] = "adc_0-4095";
-  moistureDoc["moisture_percent"] = map(soilMoisture, 1023, 0, 0, 100);
-  moistureDoc["timestamp"] = millis();
-  
-  StaticJsonDocument<100> lightDoc;
-  lightDoc["light"] = lightIntensity;
-  lightDoc["unit"] = "adc_0-4095";
-  lightDoc["light_percent"] = map(lightIntensity, 0, 4095, 0, 100);
-  lightDoc["timestamp"] = millis();
-  
-  // Publish to MQTT
-  char buffer[256];
-  
-  serializeJson(tempDoc, buffer);
-  client.publish("plant-iot/sensors/temperature", buffer);
+  if constexpr (PROFILE.legacyTopics) {
+    for (int t = TOPIC_SENSORS_TEMPERATURE; t <= TOPIC_SENSORS_LIGHT; t++) {
+      serialize_legacy_reading((TopicId)t, sample, millis(), sequence_peek(t), buffer, sizeof(buffer));
+      publish_telemetry(t, topic_name((TopicId)t), buffer);
+    }
+  }
+}
+
+// ============ Publish Per-Plant Data ============
+// Topic: plant-iot/<device>/<plant>/sensors/aggregated
+void publish_plant_data(const SensorReading& reading, uint8_t plant) {
+  if (!hasSensorDataChanged(reading, plant)) {
+    return;
+  }
   
-  serializeJson(humidityDoc, buffer);
-  client.publish("plant-iot/sensors/humidity", buffer);
+  char topic[96];
+  snprintf(topic, sizeof(topic), "%s%s/sensors/aggregated", topic_device_prefix(), soil_probe_id(plant));
   
-  serializeJson(moistureDoc, buffer);
-  client.publish("plant-iot/sensors/soil-moisture", buffer);
+  SensorSample sample = {reading.temperature, reading.humidity, reading.soilMoisture[plant],
+                         reading.soilMoisturePercent[plant], reading.lightIntensity};
   
-  serializeJson(lightDoc, buffer);
-  client.publish("plant-iot/sensors/light", buffer);
+  char buffer[384];
+  serialize_aggregated(sample, device_id, soil_probe_id(plant), millis(), sequence_peek(SEQUENCE_PLANT_STREAM(plant)),
+                       buffer, sizeof(buffer));
+  publish_telemetry(SEQUENCE_PLANT_STREAM(plant), topic, buffer);
+  Log::printf("[MQTT] Published %s sensor data\n", soil_probe_id(plant));
 }
 
 // ============ Publish Status ============
@@ -390,54 +1096,185 @@ void publish_status() {
   if (!client.connected()) return;
   
   char buffer[256];
+  ActuatorState actuators = snapshot_actuators();  // All four messages agree
   
   // Publish pump status
-  StaticJsonDocument<100> pumpStatusDoc;
-  pumpStatusDoc["status"] = pumpStatus ? "ON" : "OFF";
-  pumpStatusDoc["timestamp"] = millis();
-  serializeJson(pumpStatusDoc, buffer);
-  client.publish("plant-iot/status/pump", buffer);
+  serialize_actuator_status(actuators.pump, millis(), sequence_peek(TOPIC_STATUS_PUMP), buffer, sizeof(buffer));
+  publish_sequenced(TOPIC_STATUS_PUMP, topic_name(TOPIC_STATUS_PUMP), buffer);
   
   // Publish fan status
-  StaticJsonDocument<100> fanStatusDoc;
-  fanStatusDoc["status"] = fanStatus ? "ON" : "OFF";
-  fanStatusDoc["timestamp"] = millis();
-  serializeJson(fanStatusDoc, buffer);
-  client.publish("plant-iot/status/fan", buffer);
+  serialize_actuator_status(actuators.fan, millis(), sequence_peek(TOPIC_STATUS_FAN), buffer, sizeof(buffer));
+  publish_sequenced(TOPIC_STATUS_FAN, topic_name(TOPIC_STATUS_FAN), buffer);
   
   // Publish grow light status
-  StaticJsonDocument<100> lightStatusDoc;
-  lightStatusDoc["status"] = growLightStatus ? "ON" : "OFF";
-  lightStatusDoc["timestamp"] = millis();
-  serializeJson(lightStatusDoc, buffer);
-  client.publish("plant-iot/status/grow-light", buffer);
+  serialize_actuator_status(actuators.growLight, millis(), sequence_peek(TOPIC_STATUS_GROW_LIGHT), buffer,
+                            sizeof(buffer));
+  publish_sequenced(TOPIC_STATUS_GROW_LIGHT, topic_name(TOPIC_STATUS_GROW_LIGHT), buffer);
   
   // Also publish aggregated status
-  StaticJsonDocument<200> statusDoc;
-  statusDoc["pump"] = pumpStatus ? "ON" : "OFF";
-  statusDoc["fan"] = fanStatus ? "ON" : "OFF";
-  statusDoc["grow_light"] = growLightStatus ? "ON" : "OFF";
-  statusDoc["rssi"] = WiFi.RSSI();
-  statusDoc["uptime"] = millis();
-  serializeJson(statusDoc, buffer);
-  client.publish("plant-iot/status/all", buffer);
+  serialize_status_all(actuators.pump, actuators.fan, actuators.growLight, WiFi.RSSI(), millis(),
+                       sequence_peek(TOPIC_STATUS_ALL), buffer, sizeof(buffer));
+  config_note_publish(publish_sequenced(TOPIC_STATUS_ALL, topic_name(TOPIC_STATUS_ALL), buffer));
+  
+  if (ZONE_COUNT > 1) {
+    for (uint8_t z = 0; z < ZONE_COUNT; z++) {
+      publish_zone_status(z);
+    }
+  }
+}
+
+// ============ Publish Zone Status ============
+// Topic: plant-iot/<device>/zones/<zone>/status
+// rejected: why a request for this zone was just turned down, if it was
+void publish_zone_status(uint8_t zone, const char* rejected) {
+  if (!client.connected()) return;
+  
+  char topic[96];
+  snprintf(topic, sizeof(topic), "%s%s/status", zoneTopicPrefix, zone_id(zone));
+  
+  unsigned long now = millis();
+  StaticJsonDocument<256> zoneDoc;
+  zoneDoc["zone"] = zone_id(zone);
+  zoneDoc["state"] = zone_state_name(zone_state(zone));
+  if (rejected) zoneDoc["rejected"] = rejected;
+  zoneDoc["remaining_ms"] = zone_remaining_ms(zone, now);
+  zoneDoc["last_watered"] = zone_last_watered(zone);
+  zoneDoc["pump"] = zones_pump_on() ? "ON" : "OFF";
+  zoneDoc["queued"] = zones_queued_count();
+  zoneDoc["timestamp"] = now;
+  add_sequence(zoneDoc, sequence_peek(SEQUENCE_ZONE_STREAM(zone)));
+  
+  char buffer[256];
+  serializeJson(zoneDoc, buffer);
+  publish_sequenced(SEQUENCE_ZONE_STREAM(zone), topic, buffer);
+}
+
+// ============ Publish Birth ============
+// Topic: plant-iot/<device>/online (retained, replaced by the Last Will
+// when the connection is lost)
+void publish_birth() {
+  if (!client.connected()) return;
+  
+  BirthInfo birth = {FIRMWARE_VERSION, PROFILE.name, sequence_boot(), presence_boot_reason(), mqttConnects,
+                     config().revision, config_hash(), nullptr, nullptr};
+  if constexpr (PROFILE.brokerFailover) {
+    birth.failover = &failover_stats();
+    birth.backlog = &backlog_stats();
+  }
+  char buffer[512];
+  serialize_birth(birth, device_id, millis(), buffer, sizeof(buffer));
+  client.publish(onlineTopic, buffer, true);
+  Log::printf("[Presence] Online (boot %u, connect %u)\n", (unsigned)birth.boot, (unsigned)birth.connects);
+}
+
+// ============ Publish Anomaly Event ============
+// Topic: plant-iot/<device>/events/anomaly
+void publish_anomaly_event(const AnomalyEvent& event) {
+  Log::printf("[Anomaly] %s %s: %.1f (expected %.1f, z %.1f)\n", anomaly_field_name(event.field),
+                event.raised ? "raised" : "cleared", event.value, event.expected, event.zScore);
+  if (!client.connected() && !PROFILE.brokerFailover) return;
+  
+  uint8_t plant = event.plant < 0 ? 0 : event.plant;
+  const char* plantId = PLANT_COUNT > 1 && event.plant >= 0 ? soil_probe_id(plant) : nullptr;
+  const SampleSnapshot latest = snapshot_read();
+  SensorSample context = {latest.sensors.temperature, latest.sensors.humidity, latest.sensors.soilMoisture[plant],
+                          latest.sensors.soilMoisturePercent[plant], latest.sensors.lightIntensity};
+  
+  char buffer[TELEMETRY_PAYLOAD_MAX];
+  serialize_anomaly_event(event, context, latest.actuators.pump, latest.actuators.fan, latest.actuators.growLight,
+                          device_id, plantId, millis(), sequence_peek(TOPIC_EVENTS_ANOMALY), buffer, sizeof(buffer));
+  publish_telemetry(TOPIC_EVENTS_ANOMALY, topic_name(TOPIC_EVENTS_ANOMALY), buffer);
+}
+
+// ============ Publish Watering Event ============
+// Topic: plant-iot/<device>/events/watering
+void publish_watering_event(const WateringEvent& event) {
+  Log::printf("[Watering] %s %s %s: %.1f%% (from %.1f%%)\n", soil_probe_id(event.plant),
+                watering_event_name(event.type), event.raised ? "raised" : "cleared", event.moisture, event.baseline);
+  if (!client.connected() && !PROFILE.brokerFailover) return;
+  
+  const char* plantId = PLANT_COUNT > 1 ? soil_probe_id(event.plant) : nullptr;
+  char buffer[384];
+  serialize_watering_event(event, snapshot_actuators().pump, device_id, plantId, millis(),
+                           sequence_peek(TOPIC_EVENTS_WATERING), buffer, sizeof(buffer));
+  publish_telemetry(TOPIC_EVENTS_WATERING, topic_name(TOPIC_EVENTS_WATERING), buffer);
+}
+
+// ============ Publish Dryness Estimate ============
+// Topic: plant-iot/<device>/predictions/soil-dryness
+void publish_dryness_estimate(const DrynessEstimate& estimate) {
+  Log::printf("[Dryness] %s: %.1f%% drying %.2f%%/h, ETA %.1f h (confidence %.2f)\n", soil_probe_id(estimate.plant),
+                estimate.moisture, estimate.rate, estimate.etaHours, estimate.confidence);
+  
+  const char* plantId = PLANT_COUNT > 1 ? soil_probe_id(estimate.plant) : nullptr;
+  char buffer[448];
+  serialize_dryness_estimate(estimate, device_id, plantId, millis(), sequence_peek(TOPIC_PREDICTIONS_SOIL_DRYNESS),
+                             buffer, sizeof(buffer));
+  publish_telemetry(TOPIC_PREDICTIONS_SOIL_DRYNESS, topic_name(TOPIC_PREDICTIONS_SOIL_DRYNESS), buffer);
+}
+
+// ============ Publish Trend Prediction ============
+// Topic: plant-iot/<device>/predictions/trend
+void publish_trend_prediction(const TrendPrediction& prediction) {
+  Log::printf("[Trend] +%u min: %.1f°C, %.1f%%, soil %.1f%%, light %.1f%%\n", prediction.horizonMinutes,
+                prediction.predicted.value[0], prediction.predicted.value[1], prediction.predicted.value[2],
+                prediction.predicted.value[3]);
+  
+  char buffer[TELEMETRY_PAYLOAD_MAX];
+  serialize_trend_prediction(prediction, trend_model_id(), device_id, millis(), sequence_peek(TOPIC_PREDICTIONS_TREND),
+                             buffer, sizeof(buffer));
+  publish_telemetry(TOPIC_PREDICTIONS_TREND, topic_name(TOPIC_PREDICTIONS_TREND), buffer);
 }
 
 // ============ Control Actuators (Local Logic) ============
 void control_actuators() {
   // Auto-control based on sensor readings
   // This is optional; main control comes from MQTT commands
+  const SampleSnapshot latest = snapshot_read();
+  const SensorReading& reading = latest.sensors;
+  const ActuatorState& actuators = latest.actuators;
   
-  // Example: Auto fan if temperature > 30°C
-  if (temperature > 30 && !fanStatus) {
-    Serial.println("Auto: Turning on fan (High temp)");
+  // Example: Auto fan above the configured temperature threshold
+  if (reading.temperature > config().fanOnAboveC && !actuators.fan) {
+    Log::println("Auto: Turning on fan (High temp)");
     // Could publish to self or just control directly
   }
   
-  // Example: Auto pump if soil moisture < 30%
-  int moisturePercent = map(soilMoisture, 1023, 0, 0, 100);
-  if (moisturePercent < 30 && !pumpStatus) {
-    Serial.println("Auto: Turning on pump (Low moisture)");
+  // Example: Auto pump below the configured soil moisture threshold
+  int moisturePercent = reading.soilMoisturePercent[0];
+  if (moisturePercent < config().pumpOnBelowPercent && !actuators.pump) {
+    Log::println("Auto: Turning on pump (Low moisture)");
     // Could publish to self or just control directly
   }
+  
+  // Example: Hold off on watering a pot that did not take the last watering
+  if constexpr (PROFILE.wateringEvents) {
+    if (moisturePercent < config().pumpOnBelowPercent && watering_active(WATERING_INEFFECTIVE, 0)) {
+      Log::println("Auto: Last watering did not reach the soil - check the reservoir and line");
+    }
+  }
+  
+  // Example: Plan watering ahead from the learned dryness ETA
+  if constexpr (PROFILE.drynessEta) {
+    const DrynessEstimate& dryness = dryness_estimate(0);
+    if (dryness.etaHours > 0 && dryness.etaHours < DRYNESS_PLAN_AHEAD_HOURS &&
+        dryness.confidence >= DRYNESS_PLAN_MIN_CONFIDENCE && !actuators.pump) {
+      Log::printf("Auto: Soil reaches %d%% in %.1f h - schedule watering\n", config().pumpOnBelowPercent,
+                    dryness.etaHours);
+    }
+  }
+  
+  // Example: Ask the exported actuator model (the cloud ActuatorController's forests)
+  if constexpr (PROFILE.actuatorModel) {
+    ForestInputs inputs = forest_quantize(reading.temperature, reading.humidity, moisturePercent,
+                                          light_percent(reading.lightIntensity));
+    const bool states[MODEL_ACTUATOR_COUNT] = {actuators.fan, actuators.pump, actuators.growLight};
+    for (uint8_t a = 0; a < MODEL_ACTUATOR_COUNT; a++) {
+      ActuatorDecision decision = actuator_model_predict((ModelActuator)a, inputs);
+      if (decision.on != states[a]) {
+        Log::printf("Auto (model): %s should be %s (confidence %.2f)\n", model_actuator_name((ModelActuator)a),
+                      decision.on ? "ON" : "OFF", decision.confidence);
+      }
+    }
+  }
 }
\ No newline at end of file
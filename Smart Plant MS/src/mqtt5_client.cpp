@@ -0,0 +1,397 @@
+#include "mqtt5_client.h"
+#include <string.h>
+#include "firmware_profile.h"
+
+Mqtt5Client::Mqtt5Client(Client& client) : client_(client) {
+  responseTopic_[0] = '\0';
+}
+
+// ============ Configuration ============
+Mqtt5Client& Mqtt5Client::setServer(const char* domain, uint16_t port) {
+  // A fallback to 3.1.1 holds for the broker that asked for it
+  if (!domain_ || !domain || strcmp(domain, domain_) != 0 || port != port_) {
+    protocol_ = mqtt::PROTOCOL_V5;
+  }
+  domain_ = domain;
+  port_ = port;
+  return *this;
+}
+
+Mqtt5Client& Mqtt5Client::setCallback(Mqtt5Callback callback) {
+  callback_ = callback;
+  return *this;
+}
+
+Mqtt5Client& Mqtt5Client::setKeepAlive(uint16_t seconds) {
+  keepAlive_ = seconds;
+  return *this;
+}
+
+Mqtt5Client& Mqtt5Client::setSocketTimeout(uint16_t seconds) {
+  connectTimeoutMs_ = seconds * 1000UL;
+  return *this;
+}
+
+bool Mqtt5Client::setBufferSize(uint16_t size) {
+  if (size < 16 || size > MQTT5_BUFFER_SIZE) return false;
+  bufferSize_ = size;
+  return true;
+}
+
+void Mqtt5Client::setMessageExpiry(uint32_t seconds) {
+  messageExpiry_ = seconds;
+}
+
+bool Mqtt5Client::addUserProperty(const char* key, const char* value) {
+  if (userPropertyCount_ >= MQTT5_USER_PROPERTIES) return false;
+  userProperties_[userPropertyCount_].key = key;
+  userProperties_[userPropertyCount_].value = value;
+  userPropertyCount_++;
+  return true;
+}
+
+// ============ Connection ============
+bool Mqtt5Client::connect(const char* id) {
+  return connect(id, nullptr, 0, false, nullptr);
+}
+
+bool Mqtt5Client::connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain,
+                          const char* willMessage) {
+  mqtt::ConnectOptions options;
+  memset(&options, 0, sizeof(options));
+  options.clientId = id;
+  options.keepAliveSeconds = keepAlive_;
+  options.cleanSession = true;
+  if (willTopic && willMessage) {
+    options.willTopic = willTopic;
+    options.willPayload = (const uint8_t*)willMessage;
+    options.willPayloadLength = strlen(willMessage);
+    options.willQos = willQos;
+    options.willRetain = willRetain;
+  }
+
+  bool versionRejected = false;
+  options.protocolLevel = protocol_;
+  if (open(options, versionRejected)) return true;
+  if (protocol_ != mqtt::PROTOCOL_V5 || !versionRejected) return false;
+
+  // The broker does not speak 5.0: stay on 3.1.1 with it
+  Log::println("[MQTT] Broker rejected MQTT 5.0, falling back to 3.1.1");
+  protocol_ = mqtt::PROTOCOL_V311;
+  options.protocolLevel = protocol_;
+  return open(options, versionRejected);
+}
+
+// Sends CONNECT and waits for the CONNACK. versionRejected tells a broker
+// that does not know the protocol level from any other failure.
+bool Mqtt5Client::open(const mqtt::ConnectOptions& options, bool& versionRejected) {
+  versionRejected = false;
+  client_.stop();
+  rxLength_ = 0;
+  rxPending_ = 0;
+  rxSkip_ = 0;
+  aliasCount_ = 0;
+  aliasMaximum_ = 0;
+  pingOutstanding_ = false;
+  state_ = MQTT5_DISCONNECTED;
+
+  if (!domain_ || !client_.connect(domain_, port_)) {
+    state_ = MQTT5_CONNECT_FAILED;
+    return false;
+  }
+  size_t size = mqtt::encode_connect(tx_, bufferSize_, options);
+  if (!send(tx_, size)) {
+    drop(MQTT5_CONNECT_FAILED);
+    return false;
+  }
+
+  bool v5 = options.protocolLevel == mqtt::PROTOCOL_V5;
+  unsigned long start = millis();
+  while (millis() - start < connectTimeoutMs_) {
+    mqtt::Packet packet;
+    if (read_packet(packet)) {
+      if (packet.type != mqtt::CONNACK) {
+        drop(MQTT5_CONNECT_FAILED);
+        return false;
+      }
+      int code;
+      mqtt::ConnackView view;
+      if (!v5) {
+        code = mqtt::connack_code(packet);
+      } else if (!mqtt::parse_connack_v5(packet, view)) {
+        // A two-byte (3.1.1) CONNACK to a 5.0 CONNECT
+        versionRejected = mqtt::connack_code(packet) == mqtt::CONNACK_V311_BAD_PROTOCOL;
+        code = mqtt::connack_code(packet) > 0 ? mqtt::connack_code(packet) : MQTT5_CONNECT_FAILED;
+      } else {
+        code = view.reasonCode;
+        versionRejected = code == mqtt::CONNACK_UNSUPPORTED_PROTOCOL;
+        aliasMaximum_ = view.topicAliasMaximum < MQTT5_TOPIC_ALIASES ? view.topicAliasMaximum : MQTT5_TOPIC_ALIASES;
+      }
+      if (code != 0) {
+        drop(code);
+        return false;
+      }
+      state_ = MQTT5_CONNECTED;
+      lastSend_ = millis();
+      return true;
+    }
+    if (state_ != MQTT5_DISCONNECTED || !client_.connected()) {
+      // Closed without a CONNACK. Some 3.1.1 brokers answer a 5.0 CONNECT
+      // this way, but so does a broker that is restarting, so it is not
+      // taken as a version rejection
+      drop(MQTT5_CONNECTION_LOST);
+      return false;
+    }
+    delay(1);
+  }
+  drop(MQTT5_CONNECTION_TIMEOUT);
+  return false;
+}
+
+void Mqtt5Client::disconnect() {
+  if (state_ == MQTT5_CONNECTED && client_.connected()) {
+    uint8_t packet[2];
+    send(packet, mqtt::encode_empty(packet, sizeof(packet), mqtt::DISCONNECT));
+  }
+  drop(MQTT5_DISCONNECTED);
+}
+
+bool Mqtt5Client::connected() {
+  if (state_ == MQTT5_CONNECTED && !client_.connected()) drop(MQTT5_CONNECTION_LOST);
+  return state_ == MQTT5_CONNECTED;
+}
+
+int Mqtt5Client::state() {
+  connected();
+  return state_;
+}
+
+void Mqtt5Client::drop(int state) {
+  client_.stop();
+  rxLength_ = 0;
+  rxPending_ = 0;
+  rxSkip_ = 0;
+  state_ = state;
+}
+
+bool Mqtt5Client::send(const uint8_t* data, size_t length) {
+  if (length == 0) return false;
+  if (client_.write(data, length) != length) {
+    drop(MQTT5_CONNECTION_LOST);
+    return false;
+  }
+  bytesSent += length;
+  lastSend_ = millis();
+  return true;
+}
+
+// ============ Publish / Subscribe ============
+bool Mqtt5Client::publish(const char* topic, const char* payload) {
+  return publish(topic, payload, false);
+}
+
+bool Mqtt5Client::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, retained);
+}
+
+bool Mqtt5Client::publish(const char* topic, const uint8_t* payload, unsigned int length) {
+  return publish(topic, payload, length, false);
+}
+
+bool Mqtt5Client::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  if (!connected()) return false;
+  size_t topicLength = strlen(topic);
+
+  size_t size;
+  bool established = false;
+  uint16_t alias = 0;
+  if (protocol_ == mqtt::PROTOCOL_V5) {
+    mqtt::PublishProperties properties;
+    memset(&properties, 0, sizeof(properties));
+    alias = alias_for(topic, topicLength, established);
+    properties.topicAlias = alias;
+    properties.messageExpiry = retained ? 0 : messageExpiry_;
+    properties.userProperties = userProperties_;
+    properties.userPropertyCount = userPropertyCount_;
+    size = mqtt::encode_publish_v5(tx_, bufferSize_, topic, established ? 0 : topicLength, properties, payload,
+                                   length, 0, retained);
+  } else {
+    size = mqtt::encode_publish(tx_, bufferSize_, topic, topicLength, payload, length, 0, retained);
+  }
+  if (!send(tx_, size)) return false;
+
+  // The alias only exists once the broker has seen it with the topic
+  if (alias && !established) {
+    memcpy(aliasTopics_[alias - 1], topic, topicLength + 1);
+    aliasCount_++;
+  }
+  publishes++;
+  if (established) aliasedPublishes++;
+  return true;
+}
+
+// Returns the alias for a topic (established = already known to the broker),
+// the next free alias, or 0 if the topic goes without one
+uint16_t Mqtt5Client::alias_for(const char* topic, size_t length, bool& established) {
+  established = false;
+  if (length >= MQTT5_ALIAS_TOPIC_LEN) return 0;
+  for (uint16_t i = 0; i < aliasCount_; i++) {
+    if (strcmp(aliasTopics_[i], topic) == 0) {
+      established = true;
+      return i + 1;
+    }
+  }
+  return aliasCount_ < aliasMaximum_ ? aliasCount_ + 1 : 0;
+}
+
+bool Mqtt5Client::subscribe(const char* topic, uint8_t qos) {
+  if (!connected()) return false;
+  uint16_t packetId = nextPacketId_++;
+  if (nextPacketId_ == 0) nextPacketId_ = 1;
+  size_t size = protocol_ == mqtt::PROTOCOL_V5 ? mqtt::encode_subscribe_v5(tx_, bufferSize_, packetId, topic, qos)
+                                                : mqtt::encode_subscribe(tx_, bufferSize_, packetId, topic, qos);
+  return send(tx_, size);
+}
+
+// ============ Request / Response ============
+const char* Mqtt5Client::responseTopic() const {
+  return responseTopic_[0] ? responseTopic_ : nullptr;
+}
+
+bool Mqtt5Client::respond(const uint8_t* payload, size_t length) {
+  if (!responseTopic_[0] || !connected()) return false;
+  mqtt::PublishProperties properties;
+  memset(&properties, 0, sizeof(properties));
+  properties.correlationData = correlationLength_ ? correlation_ : nullptr;
+  properties.correlationLength = correlationLength_;
+  properties.userProperties = userProperties_;
+  properties.userPropertyCount = userPropertyCount_;
+  size_t size = mqtt::encode_publish_v5(tx_, bufferSize_, responseTopic_, strlen(responseTopic_), properties,
+                                        payload, length);
+  if (!send(tx_, size)) return false;
+  publishes++;
+  return true;
+}
+
+// ============ Receive Path ============
+bool Mqtt5Client::loop() {
+  if (!connected()) return false;
+
+  mqtt::Packet packet;
+  while (read_packet(packet)) {
+    handle(packet);
+    if (!connected()) return false;
+  }
+  if (!connected()) return false;
+
+  // Keep-alive: ping after a quiet period, give up if the last ping went
+  // unanswered for a whole interval
+  if (keepAlive_ > 0 && millis() - lastSend_ > keepAlive_ * 1000UL) {
+    if (pingOutstanding_) {
+      drop(MQTT5_CONNECTION_TIMEOUT);
+      return false;
+    }
+    uint8_t ping[2];
+    if (!send(ping, mqtt::encode_empty(ping, sizeof(ping), mqtt::PINGREQ))) return false;
+    pingOutstanding_ = true;
+  }
+  return true;
+}
+
+// Frames the next packet from the client without blocking. The packet
+// points into rx_ and stays valid until the next call.
+bool Mqtt5Client::read_packet(mqtt::Packet& packet) {
+  if (rxPending_) {
+    rxLength_ -= rxPending_;
+    memmove(rx_, rx_ + rxPending_, rxLength_);
+    rxPending_ = 0;
+  }
+
+  // Discard the rest of a packet too large for the buffer
+  while (rxSkip_ > 0 && client_.available() > 0) {
+    uint8_t scratch[64];
+    int n = client_.read(scratch, rxSkip_ < sizeof(scratch) ? rxSkip_ : sizeof(scratch));
+    if (n <= 0) break;
+    rxSkip_ -= n;
+  }
+  if (rxSkip_ > 0) return false;
+
+  int available = client_.available();
+  if (available > 0 && rxLength_ < bufferSize_) {
+    size_t room = bufferSize_ - rxLength_;
+    int n = client_.read(rx_ + rxLength_, (size_t)available < room ? available : room);
+    if (n > 0) rxLength_ += n;
+  }
+
+  long size = mqtt::decode_packet(rx_, rxLength_, packet);
+  if (size < 0) {
+    drop(MQTT5_CONNECTION_LOST);
+    return false;
+  }
+  if (size > 0) {
+    rxPending_ = size;
+    return true;
+  }
+
+  // A full buffer that still holds no whole packet: skip that packet
+  if (rxLength_ == bufferSize_) {
+    uint32_t length = 0, multiplier = 1;
+    size_t pos = 1;
+    while (pos < 5 && (rx_[pos] & 0x80)) {
+      length += (rx_[pos++] & 0x7F) * multiplier;
+      multiplier *= 128;
+    }
+    length += (rx_[pos++] & 0x7F) * multiplier;
+    rxSkip_ = pos + length - rxLength_;
+    rxLength_ = 0;
+    Log::printf("[MQTT] Dropped a %lu-byte packet (buffer %u)\n", (unsigned long)(pos + length), bufferSize_);
+  }
+  return false;
+}
+
+void Mqtt5Client::handle(const mqtt::Packet& packet) {
+  if (packet.type == mqtt::PINGRESP) {
+    pingOutstanding_ = false;
+    return;
+  }
+  if (packet.type == mqtt::DISCONNECT) {
+    drop(MQTT5_CONNECTION_LOST);  // 5.0 brokers say why; the reason code is not used
+    return;
+  }
+  if (packet.type != mqtt::PUBLISH) return;
+
+  mqtt::PublishView view;
+  mqtt::PublishPropertiesView properties;
+  memset(&properties, 0, sizeof(properties));
+  bool ok = protocol_ == mqtt::PROTOCOL_V5 ? mqtt::parse_publish_v5(packet, view, properties)
+                                           : mqtt::parse_publish(packet, view);
+  // We never offer the broker topic aliases, so every message names its topic
+  if (!ok || view.topicLength == 0) return;
+
+  if (view.qos == 1) {
+    uint8_t ack[4];
+    uint16_t packetId = view.packetId;
+    if (!send(ack, mqtt::encode_ack(ack, sizeof(ack), mqtt::PUBACK, packetId))) return;
+  }
+
+  // Copy what respond() needs before the topic is terminated in place
+  responseTopic_[0] = '\0';
+  correlationLength_ = 0;
+  if (properties.responseTopic && properties.responseTopicLength < sizeof(responseTopic_) &&
+      properties.correlationLength <= sizeof(correlation_)) {
+    memcpy(responseTopic_, properties.responseTopic, properties.responseTopicLength);
+    responseTopic_[properties.responseTopicLength] = '\0';
+    memcpy(correlation_, properties.correlationData, properties.correlationLength);
+    correlationLength_ = properties.correlationLength;
+  }
+
+  // Shift the topic over its length prefix to make room for a terminator,
+  // as PubSubClient does
+  char* topic = (char*)packet.body + 1;
+  memmove(topic, view.topic, view.topicLength);
+  topic[view.topicLength] = '\0';
+
+  if (callback_) callback_(topic, (uint8_t*)view.payload, view.payloadLength);
+  responseTopic_[0] = '\0';
+  correlationLength_ = 0;
+}
@@ -0,0 +1,420 @@
+#include "mqttsn_client.h"
+#include "firmware_profile.h"
+
+MqttSnClient::MqttSnClient(UDP& udp) : udp_(udp) {
+  memset(inflight_, 0, sizeof(inflight_));
+}
+
+// ============ Configuration ============
+MqttSnClient& MqttSnClient::setServer(const char* domain, uint16_t port) {
+  domain_ = domain;
+  port_ = port;
+  return *this;
+}
+
+MqttSnClient& MqttSnClient::setCallback(MqttSnCallback callback) {
+  callback_ = callback;
+  return *this;
+}
+
+MqttSnClient& MqttSnClient::setKeepAlive(uint16_t seconds) {
+  keepAlive_ = seconds;
+  return *this;
+}
+
+bool MqttSnClient::setBufferSize(uint16_t size) {
+  if (size < 16 || size > MQTTSN_BUFFER_SIZE) return false;
+  bufferSize_ = size;
+  return true;
+}
+
+bool MqttSnClient::predefine(uint16_t topicId, const char* topic) {
+  if (topicId == 0 || topicId > MQTTSN_PREDEFINED) return false;
+  predefined_[topicId] = topic;
+  return true;
+}
+
+void MqttSnClient::setPublishQos(uint8_t qos) {
+  publishQos_ = qos > 0 ? 1 : 0;
+}
+
+// ============ Connection ============
+bool MqttSnClient::connect(const char* id) {
+  return connect(id, nullptr, 0, false, nullptr);
+}
+
+bool MqttSnClient::connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain,
+                           const char* willMessage) {
+  drop(MQTTSN_DISCONNECTED);
+  // Any local port: the gateway answers to wherever the datagrams come from
+  if (!domain_ || !udp_.begin(0)) {
+    state_ = MQTTSN_CONNECT_FAILED;
+    return false;
+  }
+  bool will = willTopic && willMessage;
+  willTopic_ = willTopic;
+  willMessage_ = willMessage;
+  willQos_ = willQos;
+  willRetain_ = willRetain;
+
+  // CONNECT, then answer WILLTOPICREQ / WILLMSGREQ until CONNACK. Each
+  // answer counts as progress and restarts the retry timer.
+  uint8_t connect[64 + MQTTSN_TOPIC_LEN];
+  size_t size = mqttsn::encode_connect(connect, sizeof(connect), id, keepAlive_, true, will);
+  for (uint8_t attempt = 0; attempt < MQTTSN_RETRIES; attempt++) {
+    if (!send(connect, size)) break;
+    unsigned long start = millis();
+    while (millis() - start < MQTTSN_RETRY_MS) {
+      mqttsn::Message m;
+      if (!receive(m)) {
+        delay(1);
+        continue;
+      }
+      if (m.type == mqttsn::WILLTOPICREQ && will) {
+        send(tx_, mqttsn::encode_willtopic(tx_, bufferSize_, willQos_, willRetain_, willTopic_));
+        start = millis();
+      } else if (m.type == mqttsn::WILLMSGREQ && will) {
+        send(tx_, mqttsn::encode_willmsg(tx_, bufferSize_, (const uint8_t*)willMessage_, strlen(willMessage_)));
+        start = millis();
+      } else if (m.type == mqttsn::CONNACK && m.length >= 1) {
+        if (m.body[0] != mqttsn::ACCEPTED) {
+          drop(MQTTSN_CONNECT_FAILED);
+          return false;
+        }
+        state_ = MQTTSN_CONNECTED;
+        lastSend_ = millis();
+        return true;
+      }
+    }
+  }
+  drop(MQTTSN_CONNECTION_TIMEOUT);
+  return false;
+}
+
+void MqttSnClient::disconnect() {
+  if (state_ == MQTTSN_CONNECTED) {
+    uint8_t packet[2];
+    send(packet, mqttsn::encode_empty(packet, sizeof(packet), mqttsn::DISCONNECT));
+  }
+  drop(MQTTSN_DISCONNECTED);
+}
+
+// UDP has no connection to lose: the state only changes when the gateway
+// stops answering or sends DISCONNECT
+bool MqttSnClient::connected() {
+  return state_ == MQTTSN_CONNECTED;
+}
+
+int MqttSnClient::state() {
+  return state_;
+}
+
+void MqttSnClient::drop(int state) {
+  state_ = state;
+  topicCount_ = 0;
+  pingAttempts_ = 0;
+  for (uint8_t i = 0; i < MQTTSN_INFLIGHT; i++) inflight_[i].used = false;
+}
+
+bool MqttSnClient::send(const uint8_t* data, size_t length) {
+  if (length == 0) return false;
+  if (!udp_.beginPacket(domain_, port_) || udp_.write(data, length) != length || !udp_.endPacket()) {
+    if (state_ == MQTTSN_CONNECTED) drop(MQTTSN_CONNECTION_LOST);
+    return false;
+  }
+  bytesSent += length;
+  lastSend_ = millis();
+  return true;
+}
+
+uint16_t MqttSnClient::next_msg_id() {
+  uint16_t id = nextMsgId_++;
+  if (nextMsgId_ == 0) nextMsgId_ = 1;
+  return id;
+}
+
+// Sends a request and waits for the reply with the same message ID,
+// re-sending it every MQTTSN_RETRY_MS. The reply is left in reply_.
+bool MqttSnClient::exchange(const uint8_t* data, size_t length, uint8_t replyType, uint16_t msgId) {
+  for (uint8_t attempt = 0; attempt < MQTTSN_RETRIES; attempt++) {
+    if (attempt > 0) retransmissions++;
+    if (!send(data, length)) return false;
+    unsigned long start = millis();
+    while (millis() - start < MQTTSN_RETRY_MS) {
+      mqttsn::Message m;
+      if (!receive(m)) {
+        delay(1);
+        continue;
+      }
+      // REGACK: TopicId MsgId; SUBACK: Flags TopicId MsgId
+      size_t idOffset = replyType == mqttsn::SUBACK ? 3 : 2;
+      if (m.type == replyType && m.length >= idOffset + 2 && mqttsn::get_u16(m.body + idOffset) == msgId) {
+        reply_ = m;
+        return true;
+      }
+      handle(m, false);
+      if (state_ != MQTTSN_CONNECTED) return false;
+    }
+  }
+  drop(MQTTSN_CONNECTION_TIMEOUT);
+  return false;
+}
+
+bool MqttSnClient::receive(mqttsn::Message& message) {
+  int size = udp_.parsePacket();
+  if (size <= 0) return false;
+  bytesReceived += size;
+  if (size > bufferSize_) return false;   // Too large for the buffer: dropped
+  int n = udp_.read(rx_, size);
+  return n > 0 && mqttsn::decode(rx_, n, message);
+}
+
+// ============ Topic IDs ============
+uint16_t MqttSnClient::topic_id(const char* topic, mqttsn::TopicIdType& type) {
+  for (uint16_t id = 1; id <= MQTTSN_PREDEFINED; id++) {
+    if (predefined_[id] && strcmp(predefined_[id], topic) == 0) {
+      type = mqttsn::TOPIC_PREDEFINED;
+      return id;
+    }
+  }
+  type = mqttsn::TOPIC_NORMAL;
+  for (uint8_t i = 0; i < topicCount_; i++) {
+    if (strcmp(topics_[i].name, topic) == 0) return topics_[i].id;
+  }
+  return 0;
+}
+
+const char* MqttSnClient::topic_name(uint16_t id, mqttsn::TopicIdType type) {
+  if (type == mqttsn::TOPIC_PREDEFINED) return id <= MQTTSN_PREDEFINED ? predefined_[id] : nullptr;
+  for (uint8_t i = 0; i < topicCount_; i++) {
+    if (topics_[i].id == id) return topics_[i].name;
+  }
+  return nullptr;
+}
+
+bool MqttSnClient::remember(uint16_t id, const char* name, size_t length) {
+  if (length >= MQTTSN_TOPIC_LEN) return false;
+  uint8_t slot = 0;
+  while (slot < topicCount_ && topics_[slot].id != id) slot++;
+  if (slot == topicCount_) {
+    if (topicCount_ == MQTTSN_TOPICS) return false;
+    topicCount_++;
+  }
+  topics_[slot].id = id;
+  memcpy(topics_[slot].name, name, length);
+  topics_[slot].name[length] = '\0';
+  return true;
+}
+
+// ============ Publish / Subscribe ============
+bool MqttSnClient::publish(const char* topic, const char* payload) {
+  return publish(topic, payload, false);
+}
+
+bool MqttSnClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, retained);
+}
+
+bool MqttSnClient::publish(const char* topic, const uint8_t* payload, unsigned int length) {
+  return publish(topic, payload, length, false);
+}
+
+bool MqttSnClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  if (!connected()) return false;
+
+  Inflight* slot = nullptr;
+  if (publishQos_ == 1) {
+    slot = free_slot();
+    if (!slot) return false;
+  }
+
+  mqttsn::TopicIdType type;
+  uint16_t id = topic_id(topic, type);
+  if (id == 0) {
+    // First publish on this topic in this connection: register it
+    size_t topicLength = strlen(topic);
+    uint16_t msgId = next_msg_id();
+    size_t size = mqttsn::encode_register(tx_, bufferSize_, 0, msgId, topic, topicLength);
+    if (!exchange(tx_, size, mqttsn::REGACK, msgId)) return false;
+    mqttsn::AckView ack;
+    if (!mqttsn::parse_ack(reply_, ack) || ack.returnCode != mqttsn::ACCEPTED) {
+      Log::printf("[MQTT-SN] REGISTER %s rejected\n", topic);
+      return false;
+    }
+    remember(ack.topicId, topic, topicLength);   // A full table re-registers next time
+    registrations++;
+    id = ack.topicId;
+  }
+
+  uint8_t* out = slot ? slot->packet : tx_;
+  uint16_t msgId = slot ? next_msg_id() : 0;
+  size_t size = mqttsn::encode_publish(out, bufferSize_, mqttsn::publish_flags(publishQos_, retained, type), id, msgId,
+                                       payload, length);
+  if (!send(out, size)) return false;
+  if (slot) {
+    slot->used = true;
+    slot->msgId = msgId;
+    slot->attempts = 1;
+    slot->sentAt = millis();
+    slot->length = size;
+  }
+  publishes++;
+  return true;
+}
+
+// A burst of publishes (one report cycle) outruns the PUBACKs: wait for one
+// to come back, re-sending as loop() would. Bounded by the retry budget: the
+// oldest slot either frees up or the gateway is declared lost.
+MqttSnClient::Inflight* MqttSnClient::free_slot() {
+  for (;;) {
+    for (uint8_t i = 0; i < MQTTSN_INFLIGHT; i++) {
+      if (!inflight_[i].used) return &inflight_[i];
+    }
+    if (!retransmit()) return nullptr;
+    mqttsn::Message m;
+    if (receive(m)) {
+      handle(m, false);
+    } else {
+      delay(1);
+    }
+  }
+}
+
+bool MqttSnClient::subscribe(const char* topic, uint8_t qos) {
+  if (!connected()) return false;
+  mqttsn::TopicIdType type;
+  uint16_t id = topic_id(topic, type);
+  uint16_t msgId = next_msg_id();
+  size_t size = type == mqttsn::TOPIC_PREDEFINED ? mqttsn::encode_subscribe_id(tx_, bufferSize_, qos, msgId, id)
+                                                 : mqttsn::encode_subscribe(tx_, bufferSize_, qos, msgId, topic);
+  if (!exchange(tx_, size, mqttsn::SUBACK, msgId)) return false;
+  mqttsn::SubackView suback;
+  if (!mqttsn::parse_suback(reply_, suback) || suback.returnCode != mqttsn::ACCEPTED) return false;
+
+  // Without wildcards the gateway publishes under the ID from the SUBACK;
+  // matches of a wildcard filter are announced with REGISTER first
+  if (type == mqttsn::TOPIC_NORMAL && suback.topicId && !strpbrk(topic, "+#")) {
+    remember(suback.topicId, topic, strlen(topic));
+  }
+  return true;
+}
+
+// ============ Receive Path ============
+bool MqttSnClient::loop() {
+  if (!connected()) return false;
+
+  mqttsn::Message m;
+  while (state_ == MQTTSN_CONNECTED && receive(m)) {
+    handle(m, true);
+  }
+  if (!connected()) return false;
+
+  if (!retransmit()) return false;
+
+  // Keep-alive, re-sent like any other request
+  unsigned long now = millis();
+  bool pingDue = pingAttempts_ ? now - pingSentAt_ >= MQTTSN_RETRY_MS
+                               : keepAlive_ > 0 && now - lastSend_ >= keepAlive_ * 1000UL;
+  if (pingDue) {
+    if (pingAttempts_ >= MQTTSN_RETRIES) {
+      drop(MQTTSN_CONNECTION_TIMEOUT);
+      return false;
+    }
+    uint8_t ping[2];
+    if (!send(ping, mqttsn::encode_empty(ping, sizeof(ping), mqttsn::PINGREQ))) return false;
+    pingAttempts_++;
+    pingSentAt_ = now;
+  }
+  return true;
+}
+
+// QoS 1 retransmission; false once the gateway is lost after MQTTSN_RETRIES
+// attempts
+bool MqttSnClient::retransmit() {
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < MQTTSN_INFLIGHT; i++) {
+    Inflight& slot = inflight_[i];
+    if (!slot.used || now - slot.sentAt < MQTTSN_RETRY_MS) continue;
+    if (slot.attempts >= MQTTSN_RETRIES) {
+      Log::printf("[MQTT-SN] No PUBACK for message %u, gateway lost\n", slot.msgId);
+      drop(MQTTSN_CONNECTION_TIMEOUT);
+      return false;
+    }
+    slot.packet[slot.packet[0] == 0x01 ? 4 : 2] |= mqttsn::FLAG_DUP;
+    if (!send(slot.packet, slot.length)) return false;
+    slot.attempts++;
+    slot.sentAt = now;
+    retransmissions++;
+  }
+  return state_ == MQTTSN_CONNECTED;
+}
+
+// deliver is false while exchange() waits: incoming PUBLISH is then left
+// unacknowledged for the gateway to send again
+void MqttSnClient::handle(const mqttsn::Message& m, bool deliver) {
+  switch (m.type) {
+    case mqttsn::PUBACK: {
+      mqttsn::AckView ack;
+      if (!mqttsn::parse_ack(m, ack)) return;
+      for (uint8_t i = 0; i < MQTTSN_INFLIGHT; i++) {
+        if (inflight_[i].used && inflight_[i].msgId == ack.msgId) inflight_[i].used = false;
+      }
+      if (ack.returnCode == mqttsn::REJECTED_INVALID_TOPIC) {
+        // The gateway lost the registration: register again on the next publish
+        for (uint8_t i = 0; i < topicCount_; i++) {
+          if (topics_[i].id == ack.topicId) topics_[i] = topics_[--topicCount_];
+        }
+      }
+      return;
+    }
+
+    case mqttsn::PINGRESP:
+      pingAttempts_ = 0;
+      return;
+
+    case mqttsn::DISCONNECT:
+      drop(MQTTSN_CONNECTION_LOST);
+      return;
+
+    case mqttsn::REGISTER: {
+      // The gateway names a topic matching a wildcard subscription
+      mqttsn::RegisterView reg;
+      if (!mqttsn::parse_register(m, reg)) return;
+      bool ok = remember(reg.topicId, reg.topic, reg.topicLength);
+      uint8_t ack[7];
+      send(ack, mqttsn::encode_ack(ack, sizeof(ack), mqttsn::REGACK, reg.topicId, reg.msgId,
+                                   ok ? mqttsn::ACCEPTED : mqttsn::REJECTED_CONGESTION));
+      return;
+    }
+
+    case mqttsn::PUBLISH: {
+      mqttsn::PublishView view;
+      if (!deliver || !mqttsn::parse_publish(m, view)) return;
+      const char* name = nullptr;
+      if (view.topicIdType == mqttsn::TOPIC_SHORT) {
+        topicBuffer_[0] = view.topicId >> 8;
+        topicBuffer_[1] = view.topicId & 0xFF;
+        topicBuffer_[2] = '\0';
+        name = topicBuffer_;
+      } else {
+        name = topic_name(view.topicId, view.topicIdType);
+      }
+      if (view.qos == 1) {
+        uint8_t ack[7];
+        send(ack, mqttsn::encode_ack(ack, sizeof(ack), mqttsn::PUBACK, view.topicId, view.msgId,
+                                     name ? mqttsn::ACCEPTED : mqttsn::REJECTED_INVALID_TOPIC));
+      }
+      if (!name || !callback_) return;
+
+      // The callback may publish, and a REGISTER exchange reuses rx_: hand
+      // it copies of the topic and payload
+      if (name != topicBuffer_) strcpy(topicBuffer_, name);
+      memcpy(message_, view.data, view.length);
+      callback_(topicBuffer_, message_, view.length);
+      return;
+    }
+
+    default:
+      return;
+  }
+}
@@ -0,0 +1,63 @@
+#include "offline_backlog.h"
+
+#if FEATURE_BROKER_FAILOVER
+#include <string.h>
+
+// ============ Backlog Slots ============
+struct BacklogSlot {
+  char topic[TOPIC_MAX_LEN];
+  char payload[BACKLOG_PAYLOAD_MAX];
+};
+
+static BacklogSlot slots[BACKLOG_SLOTS];
+static uint8_t head = 0;        // Oldest message
+static uint8_t count = 0;
+static BacklogStats stats = {};
+
+bool backlog_push(const char* topic, const char* payload) {
+  size_t topicLength = strlen(topic);
+  size_t payloadLength = strlen(payload);
+  if (topicLength >= TOPIC_MAX_LEN || payloadLength >= BACKLOG_PAYLOAD_MAX) {
+    stats.dropped++;
+    return false;
+  }
+
+  if (count == BACKLOG_SLOTS) {
+    head = (head + 1) % BACKLOG_SLOTS;
+    count--;
+    stats.dropped++;
+  }
+  BacklogSlot& slot = slots[(head + count) % BACKLOG_SLOTS];
+  memcpy(slot.topic, topic, topicLength + 1);
+  memcpy(slot.payload, payload, payloadLength + 1);
+  count++;
+  stats.queued++;
+  return true;
+}
+
+uint8_t backlog_replay(BacklogPublisher publish, uint8_t max) {
+  uint8_t sent = 0;
+  while (count > 0 && sent < max) {
+    const BacklogSlot& slot = slots[head];
+    if (!publish(slot.topic, slot.payload)) break;
+    head = (head + 1) % BACKLOG_SLOTS;
+    count--;
+    sent++;
+  }
+  stats.replayed += sent;
+  return sent;
+}
+
+bool backlog_empty() {
+  return count == 0;
+}
+
+uint8_t backlog_count() {
+  return count;
+}
+
+const BacklogStats& backlog_stats() {
+  return stats;
+}
+
+#endif
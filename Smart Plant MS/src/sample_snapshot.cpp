@@ -0,0 +1,38 @@
+#include "sample_snapshot.h"
+#include "seqlock.h"
+
+// ============ Snapshot State ============
+static SeqLock<SampleSnapshot> snapshot;
+
+// ============ Writers ============
+void snapshot_store_reading(const SensorReading& reading) {
+  snapshot.update([&reading](SampleSnapshot& s) {
+    s.readings++;
+    s.sensors = reading;
+  });
+}
+
+void snapshot_set_pump(bool on) {
+  snapshot.update([on](SampleSnapshot& s) { s.actuators.pump = on; });
+}
+
+void snapshot_set_fan(bool on) {
+  snapshot.update([on](SampleSnapshot& s) { s.actuators.fan = on; });
+}
+
+void snapshot_set_grow_light(bool on) {
+  snapshot.update([on](SampleSnapshot& s) { s.actuators.growLight = on; });
+}
+
+void snapshot_set_actuators(const ActuatorState& state) {
+  snapshot.update([&state](SampleSnapshot& s) { s.actuators = state; });
+}
+
+// ============ Readers ============
+SampleSnapshot snapshot_read() {
+  return snapshot.load();
+}
+
+ActuatorState snapshot_actuators() {
+  return snapshot.load().actuators;
+}
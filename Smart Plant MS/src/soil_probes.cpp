@@ -0,0 +1,142 @@
+#include "soil_probes.h"
+#include "sensor_filter.h"
+
+// ============ Per-Channel State ============
+// Each probe has its own rolling window and calibration so a noisy or
+// disconnected pot never bleeds into its neighbours.
+struct SoilChannel {
+  RollingAverage<SMOOTHING_MAX_SIZE> filter;
+  int sample;
+  int smoothed;
+  SoilCalibration cal;
+  char id[10];
+};
+
+static SoilChannel channels[PLANT_COUNT];
+
+// Channels are visited in Gray-code order so consecutive scans toggle as few
+// mux select lines as possible, shortening the settle time needed per channel.
+static uint8_t scanOrder[PLANT_COUNT];
+
+#if SOIL_MUX_ENABLED
+static const uint8_t muxSelectPins[4] = {SOIL_MUX_S0_PIN, SOIL_MUX_S1_PIN, SOIL_MUX_S2_PIN, SOIL_MUX_S3_PIN};
+static uint8_t currentMuxChannel = 0;
+
+static void select_mux_channel(uint8_t channel) {
+  uint8_t changed = channel ^ currentMuxChannel;
+  for (int bit = 0; bit < 4; bit++) {
+    if (changed & (1 << bit)) {
+      digitalWrite(muxSelectPins[bit], (channel >> bit) & 1 ? HIGH : LOW);
+    }
+  }
+  currentMuxChannel = channel;
+}
+#else
+static const uint8_t probePins[] = SOIL_PROBE_PINS;
+static_assert(sizeof(probePins) >= PLANT_COUNT, "SOIL_PROBE_PINS has fewer pins than PLANT_COUNT");
+#endif
+
+// ============ Channel Acquisition ============
+static int read_channel(uint8_t plant) {
+#if SOIL_MUX_ENABLED
+  select_mux_channel(plant);
+  delayMicroseconds(SOIL_MUX_SETTLE_US);
+  const uint8_t pin = SOIL_MUX_SIG_PIN;
+#else
+  const uint8_t pin = probePins[plant];
+#endif
+
+  // The ESP32 SAR ADC shares one sample capacitor across inputs; the first
+  // conversion after a channel change still carries charge from the previous
+  // channel, so it is discarded.
+  if (PLANT_COUNT > 1) {
+    analogRead(pin);
+  }
+
+  long sum = 0;
+  for (int i = 0; i < SOIL_OVERSAMPLE; i++) {
+    sum += analogRead(pin);
+  }
+  return sum / SOIL_OVERSAMPLE;
+}
+
+// ============ Soil Probe API ============
+void soil_probes_begin() {
+#if SOIL_MUX_ENABLED
+  for (int bit = 0; bit < 4; bit++) {
+    pinMode(muxSelectPins[bit], OUTPUT);
+    digitalWrite(muxSelectPins[bit], LOW);
+  }
+  currentMuxChannel = 0;
+#endif
+
+  int n = 0;
+  for (int i = 0; i < 16 && n < PLANT_COUNT; i++) {
+    uint8_t gray = i ^ (i >> 1);
+    if (gray < PLANT_COUNT) {
+      scanOrder[n++] = gray;
+    }
+  }
+
+  for (int p = 0; p < PLANT_COUNT; p++) {
+    SoilChannel& ch = channels[p];
+    ch.filter.reset();
+    ch.filter.size = SOIL_SMOOTHING_SIZE;
+    ch.sample = 0;
+    ch.smoothed = 0;
+    ch.cal.dryRaw = SOIL_DEFAULT_DRY_RAW;
+    ch.cal.wetRaw = SOIL_DEFAULT_WET_RAW;
+    snprintf(ch.id, sizeof(ch.id), "plant-%02d", p + 1);
+  }
+}
+
+void soil_probes_scan() {
+  for (int i = 0; i < PLANT_COUNT; i++) {
+    SoilChannel& ch = channels[scanOrder[i]];
+    ch.sample = read_channel(scanOrder[i]);
+    ch.smoothed = ch.filter.push(ch.sample);
+  }
+}
+
+int soil_probe_raw(uint8_t plant) {
+  if (plant >= PLANT_COUNT) return 0;
+  return channels[plant].smoothed;
+}
+
+int soil_probe_sample(uint8_t plant) {
+  if (plant >= PLANT_COUNT) return 0;
+  return channels[plant].sample;
+}
+
+int soil_probe_percent(uint8_t plant) {
+  if (plant >= PLANT_COUNT) return 0;
+  const SoilChannel& ch = channels[plant];
+  return soil_percent(ch.smoothed, ch.cal.dryRaw, ch.cal.wetRaw);
+}
+
+float soil_probe_moisture(uint8_t plant) {
+  if (plant >= PLANT_COUNT) return 0;
+  const SoilChannel& ch = channels[plant];
+  if (ch.cal.dryRaw == ch.cal.wetRaw) return 0;
+  float percent = (float)(ch.smoothed - ch.cal.dryRaw) * 100.0f / (ch.cal.wetRaw - ch.cal.dryRaw);
+  return percent < 0 ? 0 : percent > 100 ? 100 : percent;
+}
+
+const char* soil_probe_id(uint8_t plant) {
+  if (plant >= PLANT_COUNT) return "";
+  return channels[plant].id;
+}
+
+void soil_probe_set_calibration(uint8_t plant, int dryRaw, int wetRaw) {
+  if (plant >= PLANT_COUNT) return;
+  channels[plant].cal.dryRaw = dryRaw;
+  channels[plant].cal.wetRaw = wetRaw;
+}
+
+void soil_probes_set_smoothing(uint8_t size) {
+  for (int p = 0; p < PLANT_COUNT; p++) {
+    SoilChannel& ch = channels[p];
+    ch.filter.resize(size);
+    ch.smoothed = ch.filter.value();
+  }
+}
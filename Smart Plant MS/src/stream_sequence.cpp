@@ -0,0 +1,41 @@
+#include "stream_sequence.h"
+#include <Preferences.h>
+#include "firmware_profile.h"
+#include "irrigation_zones.h"
+#include "soil_probes.h"
+
+// ============ Sequence State ============
+static uint32_t bootCount = 0;
+static uint32_t streamSeq[SEQUENCE_STREAM_COUNT];
+
+void sequence_begin() {
+  Preferences prefs;
+  if (prefs.begin(SEQUENCE_NVS_NAMESPACE, false)) {
+    bootCount = prefs.getUInt(SEQUENCE_NVS_KEY, 0) + 1;
+    if (prefs.putUInt(SEQUENCE_NVS_KEY, bootCount) != sizeof(bootCount)) {
+      Log::println("[Sequence] Could not store the boot counter");
+    }
+    prefs.end();
+  } else {
+    // Boot 0 tells consumers the counter is unavailable; reboots then show
+    // only as seq restarting at 1
+    bootCount = 0;
+    Log::println("[Sequence] NVS unavailable, boot counter disabled");
+  }
+  memset(streamSeq, 0, sizeof(streamSeq));
+  Log::printf("[Sequence] Boot %u\n", (unsigned)bootCount);
+}
+
+uint32_t sequence_boot() {
+  return bootCount;
+}
+
+SequenceStamp sequence_peek(uint16_t stream) {
+  SequenceStamp stamp = {bootCount, 0};
+  if (stream < SEQUENCE_STREAM_COUNT) stamp.seq = streamSeq[stream] + 1;
+  return stamp;
+}
+
+void sequence_commit(uint16_t stream) {
+  if (stream < SEQUENCE_STREAM_COUNT) streamSeq[stream]++;
+}
@@ -0,0 +1,476 @@
+#include "tls_client.h"
+
+#if FEATURE_MQTT_TLS
+
+#include "firmware_profile.h"
+
+#include <stddef.h>
+#include <mutex>
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/error.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+// ============ Buffer Pool ============
+// First-fit allocator over a static array. Each block starts with a
+// 16-byte header; freed blocks merge with free neighbours. mbedTLS holds a
+// handful of allocations at a time (record buffers, handshake state,
+// certificates), so a linear walk is cheap.
+namespace {
+
+struct Block {
+  uint32_t size;                // Including this header
+  uint32_t used;
+  uint32_t requested;
+  uint32_t reserved;
+};
+
+const size_t POOL_ALIGN = sizeof(Block);
+
+alignas(16) uint8_t pool[TLS_POOL_SIZE];
+std::mutex poolLock;            // mbedTLS is also used by other tasks (WPA supplicant)
+TlsPoolStats poolStats = {};
+
+Block* first_block() {
+  return (Block*)pool;
+}
+
+Block* next_block(Block* b) {
+  return (Block*)((uint8_t*)b + b->size);
+}
+
+bool in_pool(const void* p) {
+  return (const uint8_t*)p >= pool && (const uint8_t*)p < pool + sizeof(pool);
+}
+
+void* pool_calloc(size_t count, size_t size) {
+  if (count && size > SIZE_MAX / count) return nullptr;
+  size_t bytes = count * size;
+  size_t need = (bytes + sizeof(Block) + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+
+  {
+    std::lock_guard<std::mutex> guard(poolLock);
+    uint8_t* end = pool + sizeof(pool);
+    for (Block* b = first_block(); (uint8_t*)b < end; b = next_block(b)) {
+      if (b->used || b->size < need) continue;
+      if (b->size - need >= 2 * sizeof(Block)) {
+        Block* rest = (Block*)((uint8_t*)b + need);
+        rest->size = b->size - need;
+        rest->used = 0;
+        b->size = need;
+      }
+      b->used = 1;
+      b->requested = bytes;
+      poolStats.inUse += b->size;
+      if (poolStats.inUse > poolStats.peak) poolStats.peak = poolStats.inUse;
+      poolStats.allocations++;
+      memset(b + 1, 0, bytes);
+      return b + 1;
+    }
+    poolStats.fallbacks++;
+    poolStats.fallbackBytes += bytes;
+  }
+  return calloc(count, size);
+}
+
+void pool_free(void* p) {
+  if (!p) return;
+  if (!in_pool(p)) {
+    free(p);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(poolLock);
+  Block* freed = (Block*)p - 1;
+  freed->used = 0;
+  poolStats.inUse -= freed->size;
+
+  uint8_t* end = pool + sizeof(pool);
+  for (Block* b = first_block(); (uint8_t*)b < end; b = next_block(b)) {
+    while (!b->used && (uint8_t*)next_block(b) < end && !next_block(b)->used) {
+      b->size += next_block(b)->size;
+    }
+  }
+}
+
+void pool_install() {
+  static bool installed = false;
+  if (installed) return;
+  installed = true;
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)
+  first_block()->size = sizeof(pool);
+  first_block()->used = 0;
+  poolStats.installed = true;
+  poolStats.size = sizeof(pool);
+  mbedtls_platform_set_calloc_free(pool_calloc, pool_free);
+#endif
+}
+
+}  // namespace
+
+TlsPoolStats tls_pool_stats() {
+  std::lock_guard<std::mutex> guard(poolLock);
+  return poolStats;
+}
+
+void tls_pool_reset_peak() {
+  std::lock_guard<std::mutex> guard(poolLock);
+  poolStats.peak = poolStats.inUse;
+}
+
+// ============ Session Cache ============
+// One saved session in RTC memory. RTC_NOINIT_ATTR memory holds garbage
+// after power-on: the magic and checksum tell a real entry from noise.
+namespace {
+
+const uint32_t SESSION_MAGIC = 0x544c5331;  // "TLS1"
+
+struct SavedSession {
+  uint32_t magic;
+  uint32_t checksum;            // Over everything below
+  uint16_t port;
+  uint16_t length;
+  char host[64];
+  uint8_t data[TLS_SESSION_CACHE_SIZE];
+};
+
+RTC_NOINIT_ATTR SavedSession savedSession;
+
+// FNV-1a
+uint32_t session_checksum() {
+  const uint8_t* p = (const uint8_t*)&savedSession.port;
+  size_t length = offsetof(SavedSession, data) - offsetof(SavedSession, port) + savedSession.length;
+  if (savedSession.length > sizeof(savedSession.data)) return 0;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < length; i++) hash = (hash ^ p[i]) * 16777619UL;
+  return hash;
+}
+
+bool load_session(const char* host, uint16_t port, mbedtls_ssl_session* session) {
+  if (savedSession.magic != SESSION_MAGIC || savedSession.checksum != session_checksum()) return false;
+  if (savedSession.port != port || strncmp(savedSession.host, host, sizeof(savedSession.host)) != 0) return false;
+  // Fails after a firmware update that changed the mbedTLS build: full handshake
+  return mbedtls_ssl_session_load(session, savedSession.data, savedSession.length) == 0;
+}
+
+void save_session(mbedtls_ssl_context* ssl, const char* host, uint16_t port) {
+  savedSession.magic = 0;
+  if (strlen(host) >= sizeof(savedSession.host)) return;
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  size_t length = 0;
+  int rc = mbedtls_ssl_get_session(ssl, &session);
+  if (rc == 0) rc = mbedtls_ssl_session_save(&session, savedSession.data, sizeof(savedSession.data), &length);
+  mbedtls_ssl_session_free(&session);
+  if (rc != 0) {
+    Log::printf("[TLS] Session not saved (-0x%04x)\n", -rc);
+    return;
+  }
+
+  memset(savedSession.host, 0, sizeof(savedSession.host));
+  strcpy(savedSession.host, host);
+  savedSession.port = port;
+  savedSession.length = length;
+  savedSession.checksum = session_checksum();
+  savedSession.magic = SESSION_MAGIC;
+}
+
+}  // namespace
+
+void TlsClient::forgetSession() {
+  savedSession.magic = 0;
+}
+
+// ============ mbedTLS State ============
+namespace {
+
+// Covered by the AES, SHA and RSA accelerators (see tls_client.h)
+const int ciphersuites[] = {
+#if MQTT_TLS_ECDHE
+  MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+#endif
+  MBEDTLS_TLS_RSA_WITH_AES_128_GCM_SHA256,
+  0,
+};
+
+#if MQTT_TLS_ECDHE
+// X25519 first: the cheaper of the two in software
+const mbedtls_ecp_group_id curves[] = {
+  MBEDTLS_ECP_DP_CURVE25519,
+  MBEDTLS_ECP_DP_SECP256R1,
+  MBEDTLS_ECP_DP_NONE,
+};
+#endif
+
+mbedtls_entropy_context entropy;
+mbedtls_ctr_drbg_context drbg;
+mbedtls_x509_crt caChain;
+mbedtls_ssl_config sslConfig;
+mbedtls_ssl_context ssl;
+const char* configuredCa = nullptr;
+bool certificateVerified = false;
+
+// Called for each certificate of the broker's chain, which a resumed
+// handshake does not send
+int on_verify(void*, mbedtls_x509_crt*, int, uint32_t*) {
+  certificateVerified = true;
+  return 0;
+}
+
+int configure(const char* caPem) {
+  if (configuredCa == caPem) return 0;
+  if (configuredCa) {
+    mbedtls_ssl_config_free(&sslConfig);
+    mbedtls_x509_crt_free(&caChain);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+    configuredCa = nullptr;
+  }
+  mbedtls_entropy_init(&entropy);
+  mbedtls_ctr_drbg_init(&drbg);
+  mbedtls_x509_crt_init(&caChain);
+  mbedtls_ssl_config_init(&sslConfig);
+
+  static const char personalization[] = "plant-iot";
+  int rc = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, (const unsigned char*)personalization,
+                                 sizeof(personalization) - 1);
+  if (rc == 0) rc = mbedtls_x509_crt_parse(&caChain, (const unsigned char*)caPem, strlen(caPem) + 1);
+  if (rc == 0) {
+    rc = mbedtls_ssl_config_defaults(&sslConfig, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                     MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (rc != 0) {
+    mbedtls_ssl_config_free(&sslConfig);
+    mbedtls_x509_crt_free(&caChain);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+    return rc;
+  }
+
+  mbedtls_ssl_conf_authmode(&sslConfig, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_ca_chain(&sslConfig, &caChain, nullptr);
+  mbedtls_ssl_conf_verify(&sslConfig, on_verify, nullptr);
+  mbedtls_ssl_conf_rng(&sslConfig, mbedtls_ctr_drbg_random, &drbg);
+  mbedtls_ssl_conf_min_version(&sslConfig, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+  mbedtls_ssl_conf_max_version(&sslConfig, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+  mbedtls_ssl_conf_ciphersuites(&sslConfig, ciphersuites);
+#if MQTT_TLS_ECDHE
+  mbedtls_ssl_conf_curves(&sslConfig, curves);
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&sslConfig, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+  configuredCa = caPem;
+  return 0;
+}
+
+// ---- Record I/O over the TCP Client ----
+int transport_send(void* context, const unsigned char* data, size_t length) {
+  Client* transport = (Client*)context;
+  if (!transport->connected()) return MBEDTLS_ERR_NET_CONN_RESET;
+  size_t n = transport->write(data, length);
+  return n > 0 ? (int)n : MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+int transport_recv(void* context, unsigned char* data, size_t length) {
+  Client* transport = (Client*)context;
+  int available = transport->available();
+  if (available <= 0) return transport->connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+  int n = transport->read(data, length < (size_t)available ? length : (size_t)available);
+  return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+bool would_block(int rc) {
+  return rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+}  // namespace
+
+// ============ TlsClient ============
+TlsClient::TlsClient(Client& transport) : transport_(transport) {
+  pool_install();
+}
+
+TlsClient::~TlsClient() {
+  stop();
+}
+
+void TlsClient::setCACert(const char* pem) {
+  caPem_ = pem;
+}
+
+void TlsClient::setResumption(bool enabled) {
+  resumption_ = enabled;
+}
+
+bool TlsClient::hardwareCrypto() {
+#if defined(CONFIG_MBEDTLS_HARDWARE_AES) && defined(CONFIG_MBEDTLS_HARDWARE_SHA) && defined(CONFIG_MBEDTLS_HARDWARE_MPI)
+  return true;
+#else
+  return false;
+#endif
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+// The host name is sent as SNI and checked against the certificate. mbedTLS
+// 2.x compares it as a string with the DNS names, so a broker addressed by
+// IP needs its address as a DNS SAN (mqtt-broker/tls/generate-certs.sh).
+int TlsClient::connect(const char* host, uint16_t port) {
+  stop();
+  handshake_ = {};
+  if (!caPem_) {
+    Log::println("[TLS] No CA certificate set");
+    return 0;
+  }
+  int rc = configure(caPem_);
+  if (rc != 0) {
+    fail(rc);
+    return 0;
+  }
+  if (!transport_.connect(host, port)) return 0;
+
+  unsigned long start = millis();
+  mbedtls_ssl_init(&ssl);
+  rc = mbedtls_ssl_setup(&ssl, &sslConfig);
+  if (rc == 0) rc = mbedtls_ssl_set_hostname(&ssl, host);
+  if (rc != 0) {
+    fail(rc);
+    return 0;
+  }
+  mbedtls_ssl_set_bio(&ssl, &transport_, transport_send, transport_recv, nullptr);
+  open_ = true;
+
+  if (resumption_) {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    handshake_.offered = load_session(host, port, &session) && mbedtls_ssl_set_session(&ssl, &session) == 0;
+    mbedtls_ssl_session_free(&session);
+  }
+
+  certificateVerified = false;
+  while ((rc = mbedtls_ssl_handshake(&ssl)) != 0) {
+    if (!would_block(rc) || millis() - start > TLS_HANDSHAKE_TIMEOUT_MS) {
+      uint32_t flags = mbedtls_ssl_get_verify_result(&ssl);
+      if (flags != 0 && flags != (uint32_t)-1) Log::printf("[TLS] Certificate rejected (flags 0x%x)\n", flags);
+      // A session the broker chokes on is not offered again
+      if (handshake_.offered) forgetSession();
+      fail(would_block(rc) ? MBEDTLS_ERR_SSL_TIMEOUT : rc);
+      return 0;
+    }
+    delay(1);
+  }
+
+  handshake_.durationMs = millis() - start;
+  handshake_.resumed = handshake_.offered && !certificateVerified;
+  handshake_.ciphersuite = mbedtls_ssl_get_ciphersuite(&ssl);
+  // Also after a resumption: the broker may have issued a fresh ticket
+  if (resumption_) save_session(&ssl, host, port);
+  Log::printf("[TLS] %s handshake in %lu ms, %s\n", handshake_.resumed ? "Resumed" : "Full",
+              (unsigned long)handshake_.durationMs, handshake_.ciphersuite);
+  return 1;
+}
+
+void TlsClient::fail(int error) {
+  char text[80];
+  mbedtls_strerror(error, text, sizeof(text));
+  Log::printf("[TLS] Error -0x%04x: %s\n", -error, text);
+  handshake_.error = error;
+  if (open_) {
+    open_ = false;
+    mbedtls_ssl_free(&ssl);
+  }
+  transport_.stop();
+}
+
+void TlsClient::stop() {
+  if (open_) {
+    mbedtls_ssl_close_notify(&ssl);
+    open_ = false;
+    mbedtls_ssl_free(&ssl);
+  }
+  peeked_ = -1;
+  transport_.stop();
+}
+
+uint8_t TlsClient::connected() {
+  if (!open_) return 0;
+  if (transport_.connected() || peeked_ >= 0 || mbedtls_ssl_get_bytes_avail(&ssl) > 0) return 1;
+  stop();
+  return 0;
+}
+
+// ============ Application Data ============
+size_t TlsClient::write(uint8_t byte) {
+  return write(&byte, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buffer, size_t size) {
+  if (!open_) return 0;
+  size_t sent = 0;
+  unsigned long start = millis();
+  while (sent < size) {
+    int rc = mbedtls_ssl_write(&ssl, buffer + sent, size - sent);
+    if (rc > 0) {
+      sent += rc;
+    } else if (!would_block(rc)) {
+      fail(rc);
+      break;
+    } else if (millis() - start > TLS_WRITE_TIMEOUT_MS) {
+      break;
+    } else {
+      delay(1);
+    }
+  }
+  return sent;
+}
+
+// Decrypts a waiting record, if any, so the plaintext can be counted
+int TlsClient::available() {
+  if (!open_) return 0;
+  int rc = mbedtls_ssl_read(&ssl, nullptr, 0);
+  if (rc < 0 && !would_block(rc)) {
+    if (rc != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) fail(rc);
+    else stop();
+    return 0;
+  }
+  return (int)mbedtls_ssl_get_bytes_avail(&ssl) + (peeked_ >= 0 ? 1 : 0);
+}
+
+int TlsClient::read() {
+  uint8_t byte;
+  return read(&byte, 1) == 1 ? byte : -1;
+}
+
+int TlsClient::read(uint8_t* buffer, size_t size) {
+  if (!open_ || size == 0) return -1;
+  size_t offset = 0;
+  if (peeked_ >= 0) {
+    buffer[offset++] = (uint8_t)peeked_;
+    peeked_ = -1;
+    if (offset == size) return 1;
+  }
+  int rc = mbedtls_ssl_read(&ssl, buffer + offset, size - offset);
+  if (rc > 0) return offset + rc;
+  if (rc < 0 && !would_block(rc)) {
+    if (rc != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) fail(rc);
+    else stop();
+  }
+  return offset > 0 ? (int)offset : -1;
+}
+
+int TlsClient::peek() {
+  if (peeked_ < 0) {
+    uint8_t byte;
+    if (open_ && mbedtls_ssl_read(&ssl, &byte, 1) == 1) peeked_ = byte;
+  }
+  return peeked_;
+}
+
+#endif
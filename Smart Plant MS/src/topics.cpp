@@ -0,0 +1,66 @@
+#include "topics.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char* const topicSuffixes[TOPIC_COUNT] = {
+  "sensors/aggregated",
+  "sensors/temperature",
+  "sensors/humidity",
+  "sensors/soil-moisture",
+  "sensors/light",
+  "status/pump",
+  "status/fan",
+  "status/grow-light",
+  "status/all",
+  "events/anomaly",
+  "events/watering",
+  "predictions/soil-dryness",
+  "predictions/trend",
+  "actuators/pump",
+  "actuators/fan",
+  "actuators/grow-light",
+  "control/all",
+};
+
+static char topicTable[TOPIC_COUNT][TOPIC_MAX_LEN];
+static char devicePrefix[TOPIC_MAX_LEN];
+static size_t commonPrefixLength = 0;
+
+void topics_begin(const char* deviceId) {
+  snprintf(devicePrefix, sizeof(devicePrefix), TOPIC_ROOT "/%s/", deviceId);
+
+  const char* prefix = TOPIC_COMPAT_FLAT ? TOPIC_ROOT "/" : devicePrefix;
+  commonPrefixLength = strlen(prefix);
+
+  for (int i = 0; i < TOPIC_COUNT; i++) {
+    topic_build(topicTable[i], TOPIC_MAX_LEN, prefix, (TopicId)i);
+  }
+}
+
+const char* topic_name(TopicId id) {
+  return id < TOPIC_COUNT ? topicTable[id] : "";
+}
+
+const char* topic_device_prefix() {
+  return devicePrefix;
+}
+
+const char* topic_suffix(TopicId id) {
+  return id < TOPIC_COUNT ? topicSuffixes[id] : "";
+}
+
+size_t topic_build(char* out, size_t size, const char* prefix, TopicId id) {
+  int length = snprintf(out, size, "%s%s", prefix, topic_suffix(id));
+  return length < 0 || (size_t)length >= size ? 0 : length;
+}
+
+int topic_lookup(const char* name) {
+  // Every table entry shares the same prefix; check it once, then compare suffixes
+  if (strncmp(name, topicTable[0], commonPrefixLength) != 0) return -1;
+  const char* suffix = name + commonPrefixLength;
+
+  for (int i = TOPIC_FIRST_COMMAND; i < TOPIC_COUNT; i++) {
+    if (strcmp(suffix, topicSuffixes[i]) == 0) return i;
+  }
+  return -1;
+}
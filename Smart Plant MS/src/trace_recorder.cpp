@@ -0,0 +1,197 @@
+#include "trace_recorder.h"
+#include "soil_probes.h"
+#include "trace_format.h"
+#include "firmware_profile.h"
+
+#if TRACE_FLASH_ENABLED
+#include <SPIFFS.h>
+#endif
+
+// ============ Recorder State ============
+static uint8_t chunk[TRACE_CHUNK_SIZE];
+static trace::ChunkWriter writer(chunk, sizeof(chunk), PLANT_COUNT);
+static const char* traceDeviceId = "";
+static TraceChunkWriter publishChunk = nullptr;
+static TraceSink sink = TRACE_SINK_OFF;
+static uint32_t sequence = 0;
+static unsigned long chunkStartedAt = 0;
+static uint8_t lastActuators = 0xFF;
+static uint32_t bytesWritten = 0;
+static uint32_t chunksDropped = 0;
+
+#if TRACE_FLASH_ENABLED
+static bool flashReady = false;
+static long dumpOffset = -1;      // Next file offset to publish, -1 = no dump running
+#endif
+
+// ============ Chunk Output ============
+static void emit_chunk() {
+  if (writer.empty()) return;
+  size_t size = writer.finish();
+  bool ok = false;
+
+  if (sink == TRACE_SINK_MQTT) {
+    ok = publishChunk && publishChunk(chunk, size);
+  }
+#if TRACE_FLASH_ENABLED
+  else if (sink == TRACE_SINK_FLASH && flashReady) {
+    File file = SPIFFS.open(TRACE_FLASH_PATH, FILE_APPEND);
+    if (file && file.size() + size <= TRACE_FLASH_MAX_BYTES) {
+      ok = file.write(chunk, size) == size;
+    }
+    if (file) file.close();
+  }
+#endif
+
+  if (ok) {
+    bytesWritten += size;
+  } else {
+    chunksDropped++;
+  }
+}
+
+static void next_chunk(unsigned long now) {
+  writer.begin(sequence++, now);
+  chunkStartedAt = now;
+}
+
+// Runs a record writer, starting a new chunk when the current one is full
+template <typename Write>
+static void record(unsigned long now, Write write) {
+  if (write()) return;
+  emit_chunk();
+  next_chunk(now);
+  write();
+}
+
+// ============ Trace Recorder API ============
+void trace_begin(const char* deviceId, TraceChunkWriter mqttWriter) {
+  traceDeviceId = deviceId;
+  publishChunk = mqttWriter;
+}
+
+bool trace_start(TraceSink newSink, unsigned long now) {
+  if (!TRACE_ENABLED || newSink == TRACE_SINK_OFF) return false;
+#if TRACE_FLASH_ENABLED
+  if (newSink == TRACE_SINK_FLASH && !flashReady) {
+    flashReady = SPIFFS.begin(true);
+    if (!flashReady) return false;
+  }
+#else
+  if (newSink == TRACE_SINK_FLASH) return false;
+#endif
+
+  trace_stop();
+  sink = newSink;
+  lastActuators = 0xFF;  // Record the current actuator state straight away
+  next_chunk(now);
+  writer.start(now, traceDeviceId);
+  Log::printf("[Trace] Recording to %s\n", trace_sink_name(sink));
+  return true;
+}
+
+void trace_stop() {
+  if (sink == TRACE_SINK_OFF) return;
+  emit_chunk();
+  Log::printf("[Trace] Stopped (%u bytes, %u chunks dropped)\n", (unsigned)bytesWritten, (unsigned)chunksDropped);
+  sink = TRACE_SINK_OFF;
+}
+
+bool trace_active() {
+  return sink != TRACE_SINK_OFF;
+}
+
+TraceSink trace_sink() {
+  return sink;
+}
+
+const char* trace_sink_name(TraceSink s) {
+  switch (s) {
+    case TRACE_SINK_MQTT: return "mqtt";
+    case TRACE_SINK_FLASH: return "flash";
+    default: return "off";
+  }
+}
+
+void trace_sample(unsigned long now, float temperature, float humidity, int light, const int* soil) {
+  if (sink == TRACE_SINK_OFF) return;
+  record(now, [&]() { return writer.sample(now, temperature, humidity, light, soil); });
+}
+
+void trace_command(unsigned long now, const char* topic, const uint8_t* payload, unsigned int length) {
+  if (sink == TRACE_SINK_OFF) return;
+  record(now, [&]() { return writer.command(now, topic, payload, length); });
+}
+
+void trace_actuators(unsigned long now, bool pump, bool fan, bool growLight) {
+  if (sink == TRACE_SINK_OFF) return;
+  uint8_t mask = (pump ? trace::TRACE_PUMP : 0) | (fan ? trace::TRACE_FAN : 0) |
+                 (growLight ? trace::TRACE_GROW_LIGHT : 0);
+  if (mask == lastActuators) return;
+  lastActuators = mask;
+  record(now, [&]() { return writer.actuators(now, mask); });
+}
+
+void trace_loop(unsigned long now) {
+  if (sink != TRACE_SINK_OFF && !writer.empty() && now - chunkStartedAt >= TRACE_FLUSH_MS) {
+    emit_chunk();
+    next_chunk(now);
+  }
+
+#if TRACE_FLASH_ENABLED
+  // Publish one stored chunk per pass so a dump never blocks the loop
+  if (dumpOffset >= 0 && publishChunk) {
+    File file = SPIFFS.open(TRACE_FLASH_PATH, FILE_READ);
+    static uint8_t buffer[TRACE_CHUNK_SIZE];
+    trace::ChunkInfo info;
+    long size = 0;
+    if (file && file.seek(dumpOffset) && file.read(buffer, trace::CHUNK_HEADER_SIZE) == trace::CHUNK_HEADER_SIZE) {
+      size_t body = buffer[4] | (buffer[5] << 8);
+      if (trace::CHUNK_HEADER_SIZE + body <= sizeof(buffer) &&
+          file.read(buffer + trace::CHUNK_HEADER_SIZE, body) == body) {
+        size = trace::decode_chunk(buffer, trace::CHUNK_HEADER_SIZE + body, info);
+      }
+    }
+    if (file) file.close();
+
+    if (size <= 0) {
+      Log::printf("[Trace] Dump finished at offset %ld\n", dumpOffset);
+      dumpOffset = -1;
+    } else if (publishChunk(buffer, size)) {
+      dumpOffset += size;
+    }
+  }
+#endif
+}
+
+bool trace_dump() {
+#if TRACE_FLASH_ENABLED
+  if (!flashReady && !(flashReady = SPIFFS.begin(true))) return false;
+  if (sink == TRACE_SINK_FLASH) {
+    emit_chunk();
+    next_chunk(millis());
+  }
+  dumpOffset = 0;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool trace_erase() {
+#if TRACE_FLASH_ENABLED
+  if (!flashReady && !(flashReady = SPIFFS.begin(true))) return false;
+  dumpOffset = -1;
+  return !SPIFFS.exists(TRACE_FLASH_PATH) || SPIFFS.remove(TRACE_FLASH_PATH);
+#else
+  return false;
+#endif
+}
+
+uint32_t trace_bytes_written() {
+  return bytesWritten;
+}
+
+uint32_t trace_chunks_dropped() {
+  return chunksDropped;
+}
@@ -0,0 +1,265 @@
+#include "trend_model.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_partition.h>
+#endif
+
+// ============ Model State ============
+struct TrendLayer {
+  const TrendLayerHeader* header;
+  const int32_t* bias;
+  const int32_t* multiplier;
+  const int32_t* shift;
+  const float* outScale;
+  const int8_t* weights;
+};
+
+static const TrendBlobHeader* model = nullptr;
+static TrendLayer layers[TREND_MAX_LAYERS];
+static size_t blobBytes = 0;
+
+// Ping-pong activation buffers: layer inputs and outputs alternate between
+// the two halves, so the arena is twice the widest layer however deep the
+// model is. Word aligned for the kernel's 4-byte loads.
+static int32_t arena[2 * TREND_MAX_WIDTH / sizeof(int32_t)];
+static float outputs[TREND_CHANNELS];           // Last layer (validated to be this wide)
+static TrendReading window[TREND_WINDOW];      // History unrolled oldest first
+
+// One-minute history (ring buffer, oldest at historyIndex once full)
+static TrendReading history[TREND_WINDOW];
+static uint8_t historyIndex = 0;
+static uint8_t historyCount = 0;
+static float stepSum[TREND_CHANNELS];
+static uint16_t stepSamples = 0;
+static unsigned long stepStart = 0;
+static bool stepStarted = false;
+static unsigned long lastPublished = 0;
+static bool published = false;
+static TrendPrediction latest;
+static TrendSink sink = nullptr;
+
+// ============ Int8 Kernel ============
+// Rows are contiguous and padded to a multiple of 4 (the input buffer is
+// zero-padded to match), so the inner loop takes four products per pass
+// with no tail and walks the weights strictly sequentially, which is what
+// the flash cache serves best.
+static inline int8_t requantize(int32_t acc, int32_t multiplier, int32_t shift, bool relu) {
+  int64_t scaled = ((int64_t)acc * multiplier + ((int64_t)1 << (shift - 1))) >> shift;
+  int32_t low = relu ? 0 : -128;
+  return scaled < low ? low : scaled > 127 ? 127 : (int8_t)scaled;
+}
+
+static inline int32_t dot(const int8_t* w, const int8_t* x, uint16_t stride, int32_t acc) {
+  for (uint16_t i = 0; i < stride; i += 4) {
+    acc += (int32_t)w[i] * x[i] + (int32_t)w[i + 1] * x[i + 1] + (int32_t)w[i + 2] * x[i + 2] +
+           (int32_t)w[i + 3] * x[i + 3];
+  }
+  return acc;
+}
+
+void trend_gemv_requant(const int8_t* weights, uint16_t stride, uint16_t rows, const int8_t* input,
+                        const int32_t* bias, const int32_t* multiplier, const int32_t* shift, bool relu,
+                        int8_t* out) {
+  for (uint16_t o = 0; o < rows; o++) {
+    int32_t acc = dot(weights + (size_t)o * stride, input, stride, bias[o]);
+    out[o] = requantize(acc, multiplier[o], shift[o], relu);
+  }
+}
+
+// Last layer: accumulators scaled straight to floats (no int8 rounding)
+static void gemv_dequant(const TrendLayer& layer, const int8_t* input, float* out) {
+  const TrendLayerHeader& h = *layer.header;
+  for (uint16_t o = 0; o < h.outputs; o++) {
+    int32_t acc = dot(layer.weights + (size_t)o * h.stride, input, h.stride, layer.bias[o]);
+    out[o] = (float)acc * layer.outScale[o];
+  }
+}
+
+// ============ Blob Loading ============
+static uint32_t crc32(const uint8_t* data, size_t length) {
+  uint32_t crc = 0xFFFFFFFFUL;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static size_t align4(size_t n) {
+  return (n + 3) & ~(size_t)3;
+}
+
+bool trend_model_load(const uint8_t* blob, size_t size) {
+  model = nullptr;
+  if (!blob || ((uintptr_t)blob & 3) || size < sizeof(TrendBlobHeader)) return false;
+
+  const TrendBlobHeader* header = (const TrendBlobHeader*)blob;
+  if (header->magic != TREND_BLOB_MAGIC || header->version != TREND_BLOB_VERSION ||
+      header->window != TREND_WINDOW || header->channels != TREND_CHANNELS || header->layerCount == 0 ||
+      header->layerCount > TREND_MAX_LAYERS || header->payloadBytes > size - sizeof(TrendBlobHeader) ||
+      !(header->inputScale > 0)) {
+    return false;
+  }
+  const uint8_t* payload = blob + sizeof(TrendBlobHeader);
+  if (crc32(payload, header->payloadBytes) != header->crc32) return false;
+
+  // Walk the layers, checking each section fits and the shapes chain up
+  size_t offset = 0;
+  uint16_t width = TREND_WINDOW * TREND_CHANNELS;
+  for (uint8_t l = 0; l < header->layerCount; l++) {
+    if (offset + sizeof(TrendLayerHeader) > header->payloadBytes) return false;
+    const TrendLayerHeader* h = (const TrendLayerHeader*)(payload + offset);
+    bool last = l == header->layerCount - 1;
+    if (h->inputs != width || h->stride != align4(h->inputs) || h->outputs == 0 ||
+        h->stride > TREND_MAX_WIDTH || h->outputs > TREND_MAX_WIDTH || (h->relu != 0) == last) {
+      return false;
+    }
+    size_t vectors = (size_t)h->outputs * 4 * sizeof(int32_t);
+    size_t weights = align4((size_t)h->outputs * h->stride);
+    if (offset + sizeof(TrendLayerHeader) + vectors + weights > header->payloadBytes) return false;
+
+    TrendLayer& layer = layers[l];
+    const uint8_t* p = payload + offset + sizeof(TrendLayerHeader);
+    layer.header = h;
+    layer.bias = (const int32_t*)p;
+    layer.multiplier = layer.bias + h->outputs;
+    layer.shift = layer.multiplier + h->outputs;
+    layer.outScale = (const float*)(layer.shift + h->outputs);
+    layer.weights = (const int8_t*)(p + vectors);
+
+    if (!last) {
+      for (uint16_t o = 0; o < h->outputs; o++) {
+        if (layer.shift[o] < 1 || layer.shift[o] > 62) return false;
+      }
+    }
+    offset += sizeof(TrendLayerHeader) + vectors + weights;
+    width = h->outputs;
+  }
+  if (width != TREND_CHANNELS) return false;
+
+  model = header;
+  blobBytes = sizeof(TrendBlobHeader) + header->payloadBytes;
+  return true;
+}
+
+bool trend_model_ready() {
+  return model != nullptr;
+}
+
+const char* trend_model_id() {
+  return model ? model->modelId : "";
+}
+
+uint8_t trend_model_horizon() {
+  return model ? model->horizonMinutes : 0;
+}
+
+size_t trend_model_blob_bytes() {
+  return model ? blobBytes : 0;
+}
+
+size_t trend_model_arena_bytes() {
+  return sizeof(arena) + sizeof(outputs);
+}
+
+// ============ Inference ============
+bool trend_model_infer(const TrendReading* input, TrendReading& predicted) {
+  if (!model) return false;
+
+  // Normalize and quantize the window, time-major: x[t * channels + c]
+  int8_t* a = (int8_t*)arena;
+  int8_t* b = a + TREND_MAX_WIDTH;
+  memset(a, 0, TREND_MAX_WIDTH);
+  for (uint8_t t = 0; t < TREND_WINDOW; t++) {
+    for (uint8_t c = 0; c < TREND_CHANNELS; c++) {
+      float normalized = (input[t].value[c] - model->center[c]) / model->span[c];
+      long q = lroundf(normalized / model->inputScale);
+      a[t * TREND_CHANNELS + c] = q < -127 ? -127 : q > 127 ? 127 : (int8_t)q;
+    }
+  }
+
+  uint8_t last = model->layerCount - 1;
+  for (uint8_t l = 0; l < last; l++) {
+    const TrendLayer& layer = layers[l];
+    const TrendLayerHeader& h = *layer.header;
+    trend_gemv_requant(layer.weights, h.stride, h.outputs, a, layer.bias, layer.multiplier, layer.shift, h.relu, b);
+    memset(b + h.outputs, 0, align4(h.outputs) - h.outputs);  // Padding of the next layer's rows
+    int8_t* swap = a;
+    a = b;
+    b = swap;
+  }
+  gemv_dequant(layers[last], a, outputs);
+
+  // The model predicts the normalized change from the latest reading
+  const TrendReading& current = input[TREND_WINDOW - 1];
+  for (uint8_t c = 0; c < TREND_CHANNELS; c++) {
+    predicted.value[c] = current.value[c] + outputs[c] * model->span[c];
+  }
+  return true;
+}
+
+// ============ History and Publishing ============
+bool trend_model_begin(TrendSink trendSink) {
+  sink = trendSink;
+  historyIndex = historyCount = 0;
+  stepStarted = published = false;
+  latest.valid = false;
+
+#if defined(ARDUINO_ARCH_ESP32)
+  const esp_partition_t* partition =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, TREND_PARTITION_LABEL);
+  if (!partition) return false;
+  const void* mapped = nullptr;
+  spi_flash_mmap_handle_t handle;
+  if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapped, &handle) != ESP_OK) {
+    return false;
+  }
+  // The mapping lives as long as the firmware; the handle is never released
+  return trend_model_load((const uint8_t*)mapped, partition->size);
+#else
+  return trend_model_ready();  // Host tools call trend_model_load() first
+#endif
+}
+
+void trend_observe(float temperature, float humidity, float soilPercent, float lightPercent, unsigned long now) {
+  if (!model) return;
+  const float reading[TREND_CHANNELS] = {temperature, humidity, soilPercent, lightPercent};
+  for (uint8_t c = 0; c < TREND_CHANNELS; c++) {
+    if (isnan(reading[c])) return;
+  }
+
+  if (!stepStarted) {
+    stepStarted = true;
+    stepStart = now;
+    stepSamples = 0;
+    memset(stepSum, 0, sizeof(stepSum));
+  }
+  for (uint8_t c = 0; c < TREND_CHANNELS; c++) stepSum[c] += reading[c];
+  stepSamples++;
+  if (now - stepStart < TREND_STEP_MS) return;
+
+  // Close the one-minute step
+  TrendReading& slot = history[historyIndex];
+  for (uint8_t c = 0; c < TREND_CHANNELS; c++) slot.value[c] = stepSum[c] / stepSamples;
+  historyIndex = (historyIndex + 1) % TREND_WINDOW;
+  if (historyCount < TREND_WINDOW) historyCount++;
+  stepStarted = false;
+  if (historyCount < TREND_WINDOW) return;
+
+  for (uint8_t t = 0; t < TREND_WINDOW; t++) window[t] = history[(historyIndex + t) % TREND_WINDOW];
+  latest.valid = trend_model_infer(window, latest.predicted);
+  latest.horizonMinutes = model->horizonMinutes;
+  latest.current = window[TREND_WINDOW - 1];
+
+  if (latest.valid && sink && (!published || now - lastPublished >= TREND_PUBLISH_MS)) {
+    published = true;
+    lastPublished = now;
+    sink(latest);
+  }
+}
+
+const TrendPrediction& trend_latest() {
+  return latest;
+}
@@ -0,0 +1,179 @@
+#include "watering_monitor.h"
+#include "sensor_filter.h"
+#include "soil_probes.h"
+
+// ============ Monitor State ============
+struct PotMonitor {
+  float moisture;                 // Latest reading, NAN before the first
+  bool pumpOn;
+  unsigned long pumpStart;
+  unsigned long pumpStop;
+  bool watered;                   // pumpStop is valid
+
+  // Watering response (CUSUM)
+  bool judging;
+  unsigned long episodeStart;
+  float baseline;
+  float cusum;
+  bool ineffective;
+
+  // Unexpected drop (Page-Hinkley on the change per sample)
+  StreamingStats<WATERING_DROP_WINDOW> rate;
+  float last;                     // Previous reading, NAN after a gap
+  float ph;
+  float dropBaseline;
+  unsigned long dropStart;
+  bool dropping;
+  float droppedFrom;              // Level and time the raised drop began at
+  unsigned long droppedSince;
+  unsigned long quietSince;
+};
+
+static PotMonitor pots[PLANT_COUNT];
+static WateringSink sink = nullptr;
+
+static void report(const PotMonitor& pot, WateringEventType type, uint8_t plant, bool raised, float baseline,
+                   float statistic, unsigned long elapsedMs) {
+  if (!sink) return;
+  WateringEvent event;
+  event.type = type;
+  event.plant = plant;
+  event.raised = raised;
+  event.moisture = pot.moisture;
+  event.baseline = baseline;
+  event.change = pot.moisture - baseline;
+  event.statistic = statistic;
+  event.elapsedMs = elapsedMs;
+  sink(event);
+}
+
+// ============ Watering Response ============
+// S = max(0, S + (x - baseline) - k): grows only while the pot sits clearly
+// above its pre-watering level, so a single noisy sample cannot confirm it
+static void judge_watering(PotMonitor& pot, uint8_t plant, unsigned long now) {
+  pot.cusum += pot.moisture - pot.baseline - WATERING_RISE_SLACK;
+  if (pot.cusum < 0) pot.cusum = 0;
+
+  unsigned long elapsed = now - pot.episodeStart;
+  if (pot.cusum > WATERING_RISE_LIMIT) {
+    pot.judging = false;
+    if (pot.ineffective) {
+      pot.ineffective = false;
+      report(pot, WATERING_INEFFECTIVE, plant, false, pot.baseline, pot.cusum, elapsed);
+    }
+  } else if (elapsed >= WATERING_RESPONSE_MS) {
+    pot.judging = false;
+    if (!pot.ineffective) {
+      pot.ineffective = true;
+      report(pot, WATERING_INEFFECTIVE, plant, true, pot.baseline, pot.cusum, elapsed);
+    }
+  }
+}
+
+// ============ Unexpected Drop ============
+// g = max(0, g - (d - mean + delta)) is the Page-Hinkley statistic for a
+// fall in the mean of d, the change per sample; the mean is the pot's normal
+// drying. g is zero while the pot behaves, so the last reading with g == 0
+// is where a drop began.
+static void watch_drop(PotMonitor& pot, uint8_t plant, unsigned long now) {
+  bool flowing = pot.pumpOn || (pot.watered && now - pot.pumpStop < WATERING_SETTLE_MS);
+  if (flowing || isnan(pot.last)) {
+    pot.last = flowing ? NAN : pot.moisture;
+    pot.ph = 0;
+    pot.dropBaseline = pot.moisture;
+    pot.dropStart = now;
+    return;
+  }
+
+  float d = pot.moisture - pot.last;
+  pot.last = pot.moisture;
+  if (!pot.rate.warm()) {
+    pot.rate.push(d);
+    pot.dropBaseline = pot.moisture;
+    pot.dropStart = now;
+    return;
+  }
+
+  pot.ph -= d - pot.rate.mean + WATERING_DROP_DELTA;
+  if (pot.ph <= 0) {
+    pot.ph = 0;
+    pot.dropBaseline = pot.moisture;
+    pot.dropStart = now;
+  }
+
+  if (!pot.dropping && pot.ph > WATERING_DROP_LIMIT) {
+    pot.dropping = true;
+    pot.droppedFrom = pot.dropBaseline;
+    pot.droppedSince = pot.dropStart;
+    pot.quietSince = now;
+    report(pot, WATERING_MOISTURE_DROP, plant, true, pot.droppedFrom, pot.ph, now - pot.droppedSince);
+    pot.ph = 0;  // Restart, so a fall that goes on crosses the limit again
+  } else if (pot.dropping) {
+    // Crossing the limit again means the level is still falling
+    if (pot.ph > WATERING_DROP_LIMIT) {
+      pot.quietSince = now;
+      pot.ph = 0;
+    } else if (now - pot.quietSince >= WATERING_DROP_QUIET_MS) {
+      pot.dropping = false;
+      report(pot, WATERING_MOISTURE_DROP, plant, false, pot.droppedFrom, pot.ph, now - pot.droppedSince);
+    }
+  }
+
+  // Only normal samples teach the drying rate, so a drop does not become
+  // the new normal while it is happening
+  if (!pot.dropping && pot.ph < WATERING_DROP_LIMIT / 4) pot.rate.push(d);
+}
+
+// ============ Public API ============
+void watering_begin(WateringSink wateringSink) {
+  sink = wateringSink;
+  for (uint8_t p = 0; p < PLANT_COUNT; p++) {
+    PotMonitor& pot = pots[p];
+    pot.moisture = NAN;
+    pot.pumpOn = pot.watered = false;
+    pot.judging = pot.ineffective = false;
+    pot.rate.reset();
+    pot.last = NAN;
+    pot.ph = 0;
+    pot.dropping = false;
+  }
+}
+
+void watering_pump(uint8_t plant, bool on, unsigned long now) {
+  if (plant >= PLANT_COUNT) return;
+  PotMonitor& pot = pots[plant];
+  if (on == pot.pumpOn) return;
+  pot.pumpOn = on;
+
+  if (on) {
+    pot.pumpStart = now;
+    // A restart while the last run is still being judged extends that run
+    if (!pot.judging && !isnan(pot.moisture)) {
+      pot.judging = true;
+      pot.episodeStart = now;
+      pot.baseline = pot.moisture;
+      pot.cusum = 0;
+    }
+  } else {
+    pot.pumpStop = now;
+    pot.watered = true;
+    if (pot.judging && now - pot.episodeStart < WATERING_MIN_PUMP_MS) pot.judging = false;
+  }
+}
+
+void watering_observe(uint8_t plant, float moisture, unsigned long now) {
+  if (plant >= PLANT_COUNT || isnan(moisture)) return;
+  PotMonitor& pot = pots[plant];
+  pot.moisture = moisture;
+  if (pot.judging) judge_watering(pot, plant, now);
+  watch_drop(pot, plant, now);
+}
+
+bool watering_active(WateringEventType type, uint8_t plant) {
+  if (plant >= PLANT_COUNT) return false;
+  return type == WATERING_INEFFECTIVE ? pots[plant].ineffective : pots[plant].dropping;
+}
+
+const char* watering_event_name(WateringEventType type) {
+  return type == WATERING_INEFFECTIVE ? "watering_ineffective" : "moisture_drop";
+}
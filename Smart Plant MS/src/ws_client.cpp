@@ -0,0 +1,412 @@
+#include "ws_client.h"
+
+#if FEATURE_MQTT_WS
+
+#include "firmware_profile.h"
+
+#include <esp_system.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+namespace {
+
+enum Opcode : uint8_t {
+  OP_CONTINUATION = 0x0,
+  OP_TEXT = 0x1,
+  OP_BINARY = 0x2,
+  OP_CLOSE = 0x8,
+  OP_PING = 0x9,
+  OP_PONG = 0xA,
+};
+
+// Sent frames: 2-byte header, 16-bit extended length, 4-byte mask key
+const size_t SEND_HEADER_MAX = 8;
+const size_t FRAME_PAYLOAD_MAX = WS_FRAME_BUFFER_SIZE - SEND_HEADER_MAX;
+static_assert(FRAME_PAYLOAD_MAX >= 125 && FRAME_PAYLOAD_MAX < 65536, "WS_FRAME_BUFFER_SIZE out of range");
+
+const char WS_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// ============ Upgrade Helpers ============
+// SHA-1 and Base64 for Sec-WebSocket-Accept only: once per connect, on
+// about 60 bytes, so this favours size over speed
+uint32_t rotl(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+void sha1(const uint8_t* data, size_t length, uint8_t digest[20]) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  uint64_t bits = (uint64_t)length * 8;
+  size_t total = (length + 9 + 63) / 64 * 64;   // Message, 0x80, length, padded to blocks
+  for (size_t offset = 0; offset < total; offset += 64) {
+    uint8_t block[64];
+    for (size_t i = 0; i < 64; i++) {
+      size_t n = offset + i;
+      block[i] = n < length ? data[n] : n == length ? 0x80 : 0;
+    }
+    if (offset + 64 == total) {
+      for (int i = 0; i < 8; i++) block[63 - i] = (uint8_t)(bits >> (8 * i));
+    }
+
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 |
+             block[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t t = rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotl(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+  for (int i = 0; i < 20; i++) digest[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+// Writes 4 * ceil(length / 3) characters and a NUL
+void base64(const uint8_t* data, size_t length, char* out) {
+  static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t v = (uint32_t)data[i] << 16 | (i + 1 < length ? data[i + 1] << 8 : 0) | (i + 2 < length ? data[i + 2] : 0);
+    *out++ = ALPHABET[(v >> 18) & 63];
+    *out++ = ALPHABET[(v >> 12) & 63];
+    *out++ = i + 1 < length ? ALPHABET[(v >> 6) & 63] : '=';
+    *out++ = i + 2 < length ? ALPHABET[v & 63] : '=';
+  }
+  *out = '\0';
+}
+
+}  // namespace
+
+void ws_accept_key(const char* key, char accept[29]) {
+  char keyGuid[64 + sizeof(WS_GUID)];
+  snprintf(keyGuid, sizeof(keyGuid), "%.64s%s", key, WS_GUID);
+  uint8_t digest[20];
+  sha1((const uint8_t*)keyGuid, strlen(keyGuid), digest);
+  base64(digest, sizeof(digest), accept);
+}
+
+// ============ Connection ============
+int WsClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+int WsClient::connect(const char* host, uint16_t port) {
+  stop();
+  if (!transport_.connect(host, port)) return 0;
+  rx_ = Rx::Header;
+  headerLength_ = 0;
+  remaining_ = 0;
+  if (!upgrade(host, port)) return 0;
+  open_ = true;
+  return 1;
+}
+
+// HTTP/1.1 upgrade with subprotocol "mqtt". The response is read a byte at
+// a time so nothing after its blank line is consumed.
+bool WsClient::upgrade(const char* host, uint16_t port) {
+  uint8_t nonce[16];
+  for (int i = 0; i < 4; i++) {
+    uint32_t r = esp_random();
+    memcpy(nonce + 4 * i, &r, 4);
+  }
+  char key[25];
+  base64(nonce, sizeof(nonce), key);
+
+  int length = snprintf((char*)frame_, sizeof(frame_),
+                        "GET %s HTTP/1.1\r\n"
+                        "Host: %s:%u\r\n"
+                        "Upgrade: websocket\r\n"
+                        "Connection: Upgrade\r\n"
+                        "Sec-WebSocket-Key: %s\r\n"
+                        "Sec-WebSocket-Version: 13\r\n"
+                        "Sec-WebSocket-Protocol: mqtt\r\n"
+                        "\r\n",
+                        path_, host, port, key);
+  if (length < 0 || (size_t)length >= sizeof(frame_)) {
+    fail("Upgrade request does not fit WS_FRAME_BUFFER_SIZE");
+    return false;
+  }
+  if (transport_.write(frame_, length) != (size_t)length) {
+    fail("Upgrade request not sent");
+    return false;
+  }
+
+  char expected[29];
+  ws_accept_key(key, expected);
+
+  char line[96];
+  size_t lineLength = 0;
+  bool statusLine = true;
+  bool accepted = false;
+  unsigned long start = millis();
+  while (true) {
+    int c = transport_.read();
+    if (c < 0) {
+      if (!transport_.connected()) {
+        fail("Connection closed during the upgrade");
+        return false;
+      }
+      if (millis() - start > WS_HANDSHAKE_TIMEOUT_MS) {
+        fail("Upgrade timed out");
+        return false;
+      }
+      delay(1);
+      continue;
+    }
+    if (c != '\n') {
+      if (c != '\r' && lineLength < sizeof(line) - 1) line[lineLength++] = (char)c;
+      continue;
+    }
+    line[lineLength] = '\0';
+    if (lineLength == 0) break;                     // End of the headers
+    if (statusLine && strncmp(line, "HTTP/1.1 101", 12) != 0) {
+      Log::printf("[WS] Upgrade refused: %s\n", line);
+      fail("Upgrade refused");
+      return false;
+    }
+    if (strncasecmp(line, "Sec-WebSocket-Accept:", 21) == 0) {
+      const char* value = line + 21;
+      while (*value == ' ') value++;
+      accepted = strcmp(value, expected) == 0;
+    }
+    statusLine = false;
+    lineLength = 0;
+  }
+  if (!accepted) {
+    fail("Missing or wrong Sec-WebSocket-Accept");
+    return false;
+  }
+  return true;
+}
+
+void WsClient::fail(const char* reason) {
+  Log::printf("[WS] %s\n", reason);
+  open_ = false;
+  transport_.stop();
+}
+
+void WsClient::stop() {
+  if (open_) {
+    static const uint8_t NORMAL_CLOSURE[] = {0x03, 0xE8};   // 1000
+    send_frame(OP_CLOSE, NORMAL_CLOSURE, sizeof(NORMAL_CLOSURE));
+    open_ = false;
+  }
+  peeked_ = -1;
+  transport_.stop();
+}
+
+uint8_t WsClient::connected() {
+  if (!open_) return 0;
+  if (transport_.connected() || peeked_ >= 0) return 1;
+  open_ = false;
+  transport_.stop();
+  return 0;
+}
+
+// ============ Sending ============
+// One frame, masked into frame_ with a fresh key (RFC 6455 5.3)
+size_t WsClient::send_frame(uint8_t opcode, const uint8_t* payload, size_t length) {
+  uint8_t* p = frame_;
+  *p++ = 0x80 | opcode;                             // FIN
+  if (length < 126) {
+    *p++ = 0x80 | (uint8_t)length;
+  } else {
+    *p++ = 0x80 | 126;
+    *p++ = (uint8_t)(length >> 8);
+    *p++ = (uint8_t)length;
+  }
+  uint32_t mask = esp_random();
+  uint8_t key[4];
+  memcpy(key, &mask, 4);
+  memcpy(p, key, 4);
+  p += 4;
+
+  size_t header = p - frame_;
+  for (size_t i = 0; i < length; i++) p[i] = payload[i] ^ key[i & 3];
+  if (transport_.write(frame_, header + length) != header + length) {
+    fail("Frame not sent");
+    return 0;
+  }
+  stats_.framesSent++;
+  stats_.overheadBytes += header;
+  return length;
+}
+
+size_t WsClient::write(uint8_t byte) {
+  return write(&byte, 1);
+}
+
+size_t WsClient::write(const uint8_t* buffer, size_t size) {
+  size_t sent = 0;
+  while (open_ && sent < size) {
+    size_t chunk = size - sent < FRAME_PAYLOAD_MAX ? size - sent : FRAME_PAYLOAD_MAX;
+    if (send_frame(OP_BINARY, buffer + sent, chunk) != chunk) break;
+    sent += chunk;
+  }
+  return sent;
+}
+
+// ============ Receiving ============
+// Consumes frame headers and control frames until the next data payload
+// byte, or until the transport has nothing more. Data payload stays in the
+// transport until read().
+void WsClient::receive() {
+  while (open_) {
+    if (rx_ == Rx::Payload) {
+      if (remaining_ > 0) return;
+      rx_ = Rx::Header;
+    }
+
+    if (rx_ == Rx::Header) {
+      size_t need = 2;
+      if (headerLength_ >= 2) {
+        uint8_t length7 = header_[1] & 0x7F;
+        need += (length7 == 126 ? 2 : length7 == 127 ? 8 : 0) + (header_[1] & 0x80 ? 4 : 0);
+      }
+      if (headerLength_ < need) {
+        int n = transport_.read(header_ + headerLength_, need - headerLength_);
+        if (n <= 0) return;
+        headerLength_ += n;
+        continue;                                   // Re-check: the length bytes may add to need
+      }
+      if (!header_complete()) return;
+      continue;
+    }
+
+    if (controlLength_ < remaining_) {
+      int n = transport_.read(control_ + controlLength_, remaining_ - controlLength_);
+      if (n <= 0) return;
+      controlLength_ += n;
+      continue;
+    }
+    control_complete();
+  }
+}
+
+bool WsClient::header_complete() {
+  uint8_t opcode = header_[0] & 0x0F;
+  uint8_t length7 = header_[1] & 0x7F;
+  uint64_t length = length7;
+  if (length7 == 126) {
+    length = (uint64_t)header_[2] << 8 | header_[3];
+  } else if (length7 == 127) {
+    length = 0;
+    for (int i = 0; i < 8; i++) length = length << 8 | header_[2 + i];
+  }
+  stats_.overheadBytes += headerLength_;
+  headerLength_ = 0;
+
+  if ((header_[0] & 0x70) || (header_[1] & 0x80)) {
+    fail("Reserved bits or a mask on a frame from the broker");
+    return false;
+  }
+  switch (opcode) {
+    case OP_CONTINUATION:
+    case OP_BINARY:
+      stats_.framesReceived++;
+      rx_ = Rx::Payload;
+      remaining_ = length;
+      return true;
+    case OP_CLOSE:
+    case OP_PING:
+    case OP_PONG:
+      if (length > sizeof(control_) || !(header_[0] & 0x80)) {
+        fail("Malformed control frame");
+        return false;
+      }
+      opcode_ = opcode;
+      rx_ = Rx::Control;
+      remaining_ = length;
+      controlLength_ = 0;
+      return true;
+    default:
+      fail(opcode == OP_TEXT ? "Text frame on an MQTT connection" : "Unknown frame opcode");
+      return false;
+  }
+}
+
+void WsClient::control_complete() {
+  rx_ = Rx::Header;
+  remaining_ = 0;
+  if (opcode_ == OP_PING) {
+    stats_.pings++;
+    send_frame(OP_PONG, control_, controlLength_);
+  } else if (opcode_ == OP_CLOSE) {
+    // Echo the status code, then drop the connection
+    send_frame(OP_CLOSE, control_, controlLength_ < 2 ? controlLength_ : 2);
+    Log::println("[WS] Closed by the broker");
+    open_ = false;
+    transport_.stop();
+  }
+}
+
+int WsClient::available() {
+  if (!open_) return 0;
+  receive();
+  int peeked = peeked_ >= 0 ? 1 : 0;
+  if (!open_ || rx_ != Rx::Payload) return peeked;
+  uint64_t waiting = (uint64_t)transport_.available();
+  return (int)(waiting < remaining_ ? waiting : remaining_) + peeked;
+}
+
+int WsClient::read() {
+  uint8_t byte;
+  return read(&byte, 1) == 1 ? byte : -1;
+}
+
+// Returns payload from one frame at most; MQTT clients read until they
+// have a whole packet anyway
+int WsClient::read(uint8_t* buffer, size_t size) {
+  if (!open_ || size == 0) return -1;
+  size_t offset = 0;
+  if (peeked_ >= 0) {
+    buffer[offset++] = (uint8_t)peeked_;
+    peeked_ = -1;
+    if (offset == size) return 1;
+  }
+  receive();
+  if (open_ && rx_ == Rx::Payload) {
+    size_t want = size - offset < remaining_ ? size - offset : (size_t)remaining_;
+    int n = transport_.read(buffer + offset, want);
+    if (n > 0) {
+      remaining_ -= n;
+      offset += n;
+    }
+  }
+  return offset > 0 ? (int)offset : -1;
+}
+
+int WsClient::peek() {
+  if (peeked_ < 0) {
+    uint8_t byte;
+    if (read(&byte, 1) == 1) peeked_ = byte;
+  }
+  return peeked_;
+}
+
+#endif
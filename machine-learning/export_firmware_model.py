@@ -0,0 +1,263 @@
+"""
+Firmware Export - Compiles the actuator forests into C++ for the ESP32
+
+Turns the RandomForestClassifiers of ActuatorController into the generated
+header that `Smart Plant MS/src/actuator_forest.cpp` compiles in with
+-DFEATURE_ACTUATOR_MODEL=1. Every tree is flattened in preorder into 4-byte
+nodes (see include/actuator_forest.h): fixed-point thresholds, the right
+child's index and the feature code, with P(on) in the leaves.
+
+Thresholds are quantized so the firmware takes exactly the branch sklearn
+takes for any input on the firmware's fixed-point grid, and a parity CSV of
+grid inputs with the Python predictions lets the host harness check that.
+"""
+
+import argparse
+import hashlib
+import logging
+import os
+from typing import Dict, List, Optional, Tuple
+
+import numpy as np
+import pandas as pd
+
+from actuator_model import ActuatorController, train_and_save_model
+from config import FEATURE_NAMES, TARGET_ACTUATORS
+from data_handler import SyntheticDataGenerator
+
+logger = logging.getLogger(__name__)
+
+# Must match include/actuator_forest.h
+INPUT_SCALE = 100
+LEAF_SCALE = 32767
+LEAF_FEATURE = 7
+MAX_TREE_NODES = 1 << 13
+INT16_MIN, INT16_MAX = -32768, 32767
+
+FIRMWARE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Smart Plant MS')
+DEFAULT_HEADER_PATH = os.path.join(FIRMWARE_DIR, 'include', 'actuator_forest_model.h')
+
+
+def quantize_threshold(threshold: float) -> int:
+    """
+    Largest grid value q for which an input of q / INPUT_SCALE goes left
+
+    sklearn compares the float32 input with the float64 threshold, so the
+    same comparison decides the split for every grid point.
+
+    Args:
+        threshold: Split threshold of a tree node
+
+    Returns:
+        Fixed-point threshold, clamped to int16
+    """
+    q = int(np.floor(threshold * INPUT_SCALE))
+    while q + 1 <= INT16_MAX and float(np.float32((q + 1) / INPUT_SCALE)) <= threshold:
+        q += 1
+    while q >= INT16_MIN and float(np.float32(q / INPUT_SCALE)) > threshold:
+        q -= 1
+    return max(INT16_MIN, min(INT16_MAX, q))
+
+
+def quantize_inputs(features: np.ndarray) -> np.ndarray:
+    """Fixed-point inputs as the firmware computes them (lroundf)"""
+    q = np.floor(np.asarray(features, dtype=np.float32) * INPUT_SCALE + 0.5)
+    return np.clip(q, INT16_MIN, INT16_MAX).astype(np.int32)
+
+
+def leaf_probability(tree, node: int, classes: np.ndarray) -> float:
+    """P(on) at a leaf, as the tree's predict_proba() reports it"""
+    counts = tree.value[node][0]
+    total = counts.sum()
+    if total <= 0:
+        return 0.0
+    on = np.where(classes == 1)[0]
+    return float(counts[on[0]] / total) if len(on) else 0.0
+
+
+def flatten_tree(estimator) -> List[Tuple[int, int]]:
+    """
+    Flatten one decision tree into (value, link) nodes in preorder
+
+    Args:
+        estimator: Fitted DecisionTreeClassifier
+
+    Returns:
+        List of (value, link) pairs matching struct ForestNode
+    """
+    tree = estimator.tree_
+    classes = np.asarray(estimator.classes_)
+    nodes: List[Tuple[int, int]] = []
+
+    # Iterative preorder; right children are patched once their index is known
+    stack = [(0, None)]
+    while stack:
+        node, parent = stack.pop()
+        index = len(nodes)
+        if parent is not None:
+            value, link = nodes[parent]
+            nodes[parent] = (value, link | index)
+
+        left = tree.children_left[node]
+        if left == -1:
+            probability = leaf_probability(tree, node, classes)
+            nodes.append((int(round(probability * LEAF_SCALE)), LEAF_FEATURE << 13))
+        else:
+            feature = int(tree.feature[node])
+            nodes.append((quantize_threshold(float(tree.threshold[node])), feature << 13))
+            stack.append((tree.children_right[node], index))
+            stack.append((left, None))
+
+    if len(nodes) > MAX_TREE_NODES:
+        raise ValueError(f"Tree has {len(nodes)} nodes; the firmware format holds {MAX_TREE_NODES}")
+    return nodes
+
+
+def evaluate_flat_tree(nodes: List[Tuple[int, int]], q: np.ndarray) -> int:
+    """Walk a flattened tree exactly as forest_vote() does"""
+    i = 0
+    while True:
+        value, link = nodes[i]
+        feature = link >> 13
+        if feature == LEAF_FEATURE:
+            return value
+        i = i + 1 if q[feature] <= value else link & 0x1FFF
+
+
+def flatten_forest(model) -> Tuple[List[Tuple[int, int]], List[int]]:
+    """Concatenate the flattened trees of a forest, returning (nodes, roots)"""
+    nodes: List[Tuple[int, int]] = []
+    roots: List[int] = []
+    for estimator in model.estimators_:
+        roots.append(len(nodes))
+        nodes.extend(flatten_tree(estimator))
+    return nodes, roots
+
+
+def _c_array(name: str, ctype: str, items: List[str], per_line: int) -> str:
+    lines = [f"static const {ctype} {name}[] = {{"]
+    for start in range(0, len(items), per_line):
+        lines.append("  " + ", ".join(items[start:start + per_line]) + ",")
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def generate_header(controller: ActuatorController) -> Tuple[str, Dict[str, int]]:
+    """
+    Render the generated C++ header for a trained controller
+
+    Returns:
+        (header source, node count per actuator)
+    """
+    if not controller.is_trained:
+        raise ValueError("Models must be trained before export")
+    if list(controller.feature_names) != FEATURE_NAMES or list(controller.target_names) != TARGET_ACTUATORS:
+        raise ValueError("Firmware expects the FEATURE_NAMES and TARGET_ACTUATORS order of config.py")
+
+    digest = hashlib.sha256()
+    sections = []
+    forests = []
+    node_counts = {}
+    for actuator in TARGET_ACTUATORS:
+        nodes, roots = flatten_forest(controller.models[actuator])
+        digest.update(np.asarray(nodes, dtype=np.int32).tobytes())
+        digest.update(np.asarray(roots, dtype=np.int32).tobytes())
+        node_counts[actuator] = len(nodes)
+        sections.append(_c_array(f"{actuator}Nodes", "ForestNode",
+                                 [f"{{{value}, 0x{link:04x}}}" for value, link in nodes], 8))
+        sections.append(_c_array(f"{actuator}Trees", "uint32_t", [str(r) for r in roots], 16))
+        forests.append(f"  {{{actuator}Nodes, {actuator}Trees, {len(roots)}, {len(nodes)}}},")
+
+    version = digest.hexdigest()[:12]
+    header = "\n".join([
+        "// Generated by machine-learning/export_firmware_model.py - do not edit.",
+        "// Included only by src/actuator_forest.cpp (FEATURE_ACTUATOR_MODEL=1).",
+        "#ifndef ACTUATOR_FOREST_MODEL_H",
+        "#define ACTUATOR_FOREST_MODEL_H",
+        "",
+        '#include "actuator_forest.h"',
+        "",
+        f'#define ACTUATOR_MODEL_VERSION "{version}"',
+        "",
+        "\n\n".join(sections),
+        "",
+        "static const ActuatorForest actuatorForests[MODEL_ACTUATOR_COUNT] = {",
+        *forests,
+        "};",
+        "",
+        "#endif",
+        "",
+    ])
+    return header, node_counts
+
+
+def export_header(controller: ActuatorController, path: str = DEFAULT_HEADER_PATH) -> Dict[str, int]:
+    """
+    Write the generated header for the firmware
+
+    Returns:
+        Node count per actuator
+    """
+    header, node_counts = generate_header(controller)
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, 'w') as f:
+        f.write(header)
+
+    total_nodes = sum(node_counts.values())
+    trees = sum(len(controller.models[a].estimators_) for a in TARGET_ACTUATORS)
+    logger.info(f"Exported {trees} trees, {total_nodes} nodes "
+                f"({total_nodes * 4 + trees * 4} bytes of flash) to {path}")
+    return node_counts
+
+
+def parity_dataset(controller: ActuatorController, num_samples: int = 1000) -> pd.DataFrame:
+    """
+    Synthetic readings on the firmware's fixed-point grid with the Python
+    model's predictions, for the host parity harness
+
+    Columns: the four features (grid values), then per actuator the
+    predicted state (0/1) and the mean P(on) over the trees.
+    """
+    features_df, _ = SyntheticDataGenerator(num_samples=num_samples).generate_training_data()
+    q = quantize_inputs(features_df[FEATURE_NAMES].values)
+    grid = pd.DataFrame(q / INPUT_SCALE, columns=FEATURE_NAMES)
+
+    dataset = grid.copy()
+    for actuator in TARGET_ACTUATORS:
+        model = controller.models[actuator]
+        proba = model.predict_proba(grid[FEATURE_NAMES])
+        on = np.where(model.classes_ == 1)[0]
+        p_on = proba[:, on[0]] if len(on) else np.zeros(len(grid))
+        dataset[actuator] = model.predict(grid[FEATURE_NAMES]).astype(int)
+        dataset[f"{actuator}_p"] = p_on
+    return dataset
+
+
+def write_parity_csv(controller: ActuatorController, path: str, num_samples: int = 1000) -> None:
+    """Write parity_dataset() as the CSV read by the native-forest harness"""
+    dataset = parity_dataset(controller, num_samples)
+    columns = FEATURE_NAMES + [c for a in TARGET_ACTUATORS for c in (a, f"{a}_p")]
+    dataset[columns].to_csv(path, index=False, float_format='%.8f')
+    logger.info(f"Wrote {len(dataset)} parity samples to {path}")
+
+
+def main(argv: Optional[List[str]] = None) -> None:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--model', help='saved ActuatorController (default: config.ACTUATOR_MODEL_PATH)')
+    parser.add_argument('--out', default=DEFAULT_HEADER_PATH, help='generated header path')
+    parser.add_argument('--parity', help='also write a parity CSV for the native-forest harness')
+    parser.add_argument('--samples', type=int, default=1000, help='parity samples (1000)')
+    args = parser.parse_args(argv)
+
+    controller = ActuatorController(model_path=args.model)
+    if not controller.is_trained:
+        controller = train_and_save_model()
+
+    export_header(controller, args.out)
+    if args.parity:
+        write_parity_csv(controller, args.parity, args.samples)
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.INFO)
+    main()
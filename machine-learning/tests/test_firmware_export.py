@@ -0,0 +1,145 @@
+"""
+Test cases for the firmware export of the actuator forests
+"""
+
+import json
+import os
+import shutil
+import subprocess
+
+import numpy as np
+import pytest
+from actuator_model import ActuatorController
+from config import FEATURE_NAMES, TARGET_ACTUATORS
+from data_handler import SyntheticDataGenerator
+from export_firmware_model import (
+    FIRMWARE_DIR,
+    INPUT_SCALE,
+    LEAF_SCALE,
+    evaluate_flat_tree,
+    flatten_tree,
+    generate_header,
+    parity_dataset,
+    quantize_inputs,
+    quantize_threshold,
+    write_parity_csv,
+)
+
+
+@pytest.fixture(scope="module")
+def trained_controller():
+    """Fixture providing a controller trained on the synthetic dataset"""
+    data_gen = SyntheticDataGenerator(num_samples=500)
+    features_df, targets_df = data_gen.generate_training_data()
+
+    controller = ActuatorController(model_path="models/does-not-exist.pkl")
+    controller.train(features_df, targets_df)
+
+    return controller
+
+
+class TestQuantization:
+    """Fixed-point thresholds must split grid inputs like sklearn does"""
+
+    def test_threshold_matches_float32_comparison(self):
+        """Every grid input goes left exactly when sklearn's compare does"""
+        rng = np.random.RandomState(0)
+        for threshold in rng.uniform(-10, 110, 2000):
+            q = quantize_threshold(threshold)
+            for grid in range(q - 2, q + 3):
+                goes_left = float(np.float32(grid / INPUT_SCALE)) <= threshold
+                assert goes_left == (grid <= q), f"threshold {threshold}, grid {grid}"
+
+    def test_threshold_on_grid_point(self):
+        """A threshold exactly on the grid keeps that point on the left"""
+        assert quantize_threshold(30.0) == 3000
+        assert quantize_threshold(29.995) == 2999
+
+    def test_inputs_round_to_grid(self):
+        """Inputs are rounded to hundredths like the firmware's lroundf"""
+        q = quantize_inputs(np.array([[24.004, 24.006, 0.0, 100.0]]))
+        assert list(q[0]) == [2400, 2401, 0, 10000]
+
+
+class TestFlattening:
+    """Flattened trees must reproduce the sklearn trees"""
+
+    def test_flat_tree_matches_predict_proba(self, trained_controller):
+        """Walking a flattened tree gives the tree's P(on) on grid inputs"""
+        features_df, _ = SyntheticDataGenerator(num_samples=200).generate_training_data()
+        q = quantize_inputs(features_df[FEATURE_NAMES].values)
+        grid = (q / INPUT_SCALE).astype(np.float32)
+
+        for actuator in TARGET_ACTUATORS:
+            estimator = trained_controller.models[actuator].estimators_[0]
+            nodes = flatten_tree(estimator)
+            proba = estimator.predict_proba(grid)
+            on = list(estimator.classes_).index(1) if 1 in estimator.classes_ else None
+
+            for row in range(len(grid)):
+                expected = proba[row, on] if on is not None else 0.0
+                leaf = evaluate_flat_tree(nodes, q[row])
+                assert abs(leaf / LEAF_SCALE - expected) <= 0.5 / LEAF_SCALE + 1e-9
+
+    def test_left_child_follows_split(self, trained_controller):
+        """Preorder layout: the left child of a split is the next node"""
+        estimator = trained_controller.models['pump'].estimators_[0]
+        tree = estimator.tree_
+        nodes = flatten_tree(estimator)
+
+        assert len(nodes) == tree.node_count
+        leaves = sum(1 for _, link in nodes if link >> 13 == 7)
+        assert leaves == int((tree.children_left == -1).sum())
+
+    def test_header_lists_every_forest(self, trained_controller):
+        """The generated header defines one forest per actuator"""
+        header, node_counts = generate_header(trained_controller)
+
+        assert '#define ACTUATOR_MODEL_VERSION' in header
+        for actuator in TARGET_ACTUATORS:
+            assert f"static const ForestNode {actuator}Nodes[]" in header
+            assert node_counts[actuator] > 0
+
+
+class TestFirmwareParity:
+    """The compiled firmware inference must agree with the Python model"""
+
+    def test_parity_dataset_is_on_grid(self, trained_controller):
+        """Parity inputs are exactly representable on the fixed-point grid"""
+        dataset = parity_dataset(trained_controller, num_samples=100)
+        scaled = dataset[FEATURE_NAMES].values * INPUT_SCALE
+
+        assert np.allclose(scaled, np.round(scaled))
+        for actuator in TARGET_ACTUATORS:
+            assert set(dataset[actuator].unique()) <= {0, 1}
+
+    @pytest.mark.skipif(shutil.which("g++") is None, reason="needs a host C++ compiler")
+    def test_host_inference_matches_python(self, trained_controller, tmp_path):
+        """Build the native-forest harness and check parity on the synthetic dataset"""
+        header, _ = generate_header(trained_controller)
+        (tmp_path / "actuator_forest_model.h").write_text(header)
+        parity = tmp_path / "parity.csv"
+        write_parity_csv(trained_controller, str(parity), num_samples=1000)
+
+        program = tmp_path / "forest"
+        subprocess.run(
+            [
+                "g++", "-std=gnu++17", "-O2", "-DFEATURE_ACTUATOR_MODEL=1",
+                "-I", str(tmp_path),
+                "-I", os.path.join(FIRMWARE_DIR, "include"),
+                os.path.join(FIRMWARE_DIR, "src", "actuator_forest.cpp"),
+                os.path.join(FIRMWARE_DIR, "src", "host", "forest", "forest_main.cpp"),
+                "-o", str(program),
+            ],
+            check=True,
+        )
+        run = subprocess.run([str(program), str(parity), "--json", "--min-time", "20"],
+                             capture_output=True, text=True)
+        result = json.loads(run.stdout)
+
+        assert run.returncode == 0, run.stderr
+        assert result["parity"] is True
+        assert result["samples"] == 1000
+        for actuator in TARGET_ACTUATORS:
+            assert result[actuator]["mismatches"] == 0
+            assert result[actuator]["max_p_error"] <= 1.0 / LEAF_SCALE
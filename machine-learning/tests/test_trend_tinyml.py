@@ -0,0 +1,126 @@
+"""
+Test cases for the int8 trend model and its firmware kernel
+"""
+
+import json
+import os
+import shutil
+import struct
+import subprocess
+import zlib
+
+import numpy as np
+import pytest
+from trend_tinyml import (
+    BLOB_MAGIC,
+    CHANNELS,
+    FIRMWARE_DIR,
+    WINDOW,
+    accuracy_report,
+    build,
+    infer_int8,
+    make_windows,
+    predict_float,
+    quantize_multiplier,
+    to_blob,
+    training_history,
+    write_eval_csv,
+)
+
+
+@pytest.fixture(scope="module")
+def trained_models():
+    """Fixture providing a float model and its int8 quantization"""
+    return build(hours=24, seed=7)
+
+
+@pytest.fixture(scope="module")
+def held_out():
+    """Fixture providing held-out windows and targets"""
+    return make_windows(training_history(12, seed=8))
+
+
+class TestQuantization:
+    """Fixed-point requantization parameters"""
+
+    def test_multiplier_round_trip(self):
+        """multiplier / 2^shift reproduces the real multiplier"""
+        for real in [1e-6, 0.0031, 0.25, 0.5, 0.999, 1.7]:
+            multiplier, shift = quantize_multiplier(real)
+            assert 2**30 <= multiplier < 2**31
+            assert 1 <= shift <= 62
+            assert abs(multiplier / 2**shift - real) <= real * 2**-30
+
+    def test_multiplier_too_large(self):
+        """Multipliers the kernel cannot shift are rejected"""
+        with pytest.raises(ValueError):
+            quantize_multiplier(2.0**40)
+
+
+class TestInt8Model:
+    """The int8 model must stay close to the float model"""
+
+    def test_int8_tracks_float(self, trained_models, held_out):
+        """Int8 predictions differ from the float ones by a small fraction of the error"""
+        model, quantized = trained_models
+        windows, targets = held_out
+        report = accuracy_report(model, quantized, windows, targets)
+
+        for metric, row in report.iterrows():
+            assert row['int8_mae'] <= row['float_mae'] * 1.1 + 0.05, metric
+
+    def test_prediction_shape(self, trained_models, held_out):
+        """One prediction per window and channel"""
+        model, quantized = trained_models
+        windows, _ = held_out
+
+        assert infer_int8(quantized, windows).shape == (len(windows), CHANNELS)
+        assert predict_float(model, windows).shape == (len(windows), CHANNELS)
+
+
+class TestBlob:
+    """The weights blob layout the firmware validates"""
+
+    def test_header_and_crc(self, trained_models):
+        """Header fields and checksum match the payload"""
+        _, quantized = trained_models
+        blob = to_blob(quantized)
+        magic, _, window, channels, layers, _, _ = struct.unpack_from('<IHBBBBH', blob)
+        payload_bytes, crc = struct.unpack_from('<II', blob, 48)
+
+        assert magic == BLOB_MAGIC
+        assert (window, channels, layers) == (WINDOW, CHANNELS, len(quantized.layers))
+        assert payload_bytes == len(blob) - 72
+        assert crc == zlib.crc32(blob[72:]) & 0xFFFFFFFF
+        assert len(blob) % 4 == 0
+
+    @pytest.mark.skipif(shutil.which("g++") is None, reason="needs a host C++ compiler")
+    def test_host_kernel_matches_python(self, trained_models, held_out, tmp_path):
+        """Build the native-tinyml harness and check it against the Python int8 model"""
+        model, quantized = trained_models
+        windows, targets = held_out
+        blob = tmp_path / "trend_model.bin"
+        blob.write_bytes(to_blob(quantized))
+        evaluation = tmp_path / "trend_eval.csv"
+        write_eval_csv(model, quantized, windows, targets, str(evaluation))
+
+        program = tmp_path / "tinyml"
+        subprocess.run(
+            [
+                "g++", "-std=gnu++17", "-O2",
+                "-I", os.path.join(FIRMWARE_DIR, "include"),
+                os.path.join(FIRMWARE_DIR, "src", "trend_model.cpp"),
+                os.path.join(FIRMWARE_DIR, "src", "host", "tinyml", "tinyml_main.cpp"),
+                "-o", str(program),
+            ],
+            check=True,
+        )
+        run = subprocess.run([str(program), str(blob), str(evaluation), "--json", "--min-time", "20"],
+                             capture_output=True, text=True)
+        result = json.loads(run.stdout)
+
+        assert run.returncode == 0, run.stderr
+        assert result["ok"] is True
+        assert result["reference_mismatches"] == 0
+        assert result["windows"] == len(windows)
+        assert result["model"] == quantized.model_id
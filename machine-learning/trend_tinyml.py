@@ -0,0 +1,351 @@
+"""
+TinyML Trend Model - Int8 MLP for trend prediction on the ESP32
+
+Trains a small MLP on windows of one-minute readings from
+generate_synthetic_history(), quantizes it to int8 and writes the weights
+blob that the firmware maps from its "trendmodel" flash partition (see
+`Smart Plant MS/include/trend_model.h` for the layout).
+
+The int8 reference in this module (infer_int8) follows the firmware kernel
+operation for operation, so the host harness can check the compiled kernel
+against it exactly and report the accuracy cost of quantization against
+the float model.
+"""
+
+import argparse
+import hashlib
+import logging
+import math
+import os
+import struct
+import zlib
+from dataclasses import dataclass, field
+from typing import List, Optional, Tuple
+
+import numpy as np
+import pandas as pd
+from sklearn.neural_network import MLPRegressor
+
+from config import FORECAST_INTERVAL_MINUTES
+from trend_predictor import generate_synthetic_history
+
+logger = logging.getLogger(__name__)
+
+# Must match include/trend_model.h
+WINDOW = 32
+CHANNELS = 4
+MAX_WIDTH = 128
+MAX_LAYERS = 4
+BLOB_MAGIC = 0x444E5254
+BLOB_VERSION = 1
+
+METRICS = ['temperature', 'humidity', 'soil_moisture', 'light_intensity']
+HORIZON_MINUTES = FORECAST_INTERVAL_MINUTES
+HIDDEN_LAYERS = (32, 16)
+
+# normalized = (value - center) / span, per metric
+CENTER = np.array([25.0, 55.0, 50.0, 50.0], dtype=np.float32)
+SPAN = np.array([10.0, 20.0, 25.0, 50.0], dtype=np.float32)
+
+FIRMWARE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Smart Plant MS')
+
+
+@dataclass
+class QuantizedLayer:
+    """One dense layer in the firmware's int8 format"""
+    inputs: int
+    outputs: int
+    relu: bool
+    weights: np.ndarray          # int8 [outputs, stride], rows zero-padded
+    bias: np.ndarray             # int32 [outputs]
+    multiplier: np.ndarray       # int32 [outputs] (hidden layers)
+    shift: np.ndarray            # int32 [outputs] (hidden layers)
+    out_scale: np.ndarray        # float32 [outputs] (last layer)
+
+    @property
+    def stride(self) -> int:
+        return _align4(self.inputs)
+
+
+@dataclass
+class QuantizedTrendModel:
+    """Int8 trend model as stored in the weights blob"""
+    input_scale: np.float32
+    layers: List[QuantizedLayer] = field(default_factory=list)
+    model_id: str = ''
+    horizon_minutes: int = HORIZON_MINUTES
+
+
+def _align4(n: int) -> int:
+    return (n + 3) & ~3
+
+
+# ============ Data ============
+
+def make_windows(history: pd.DataFrame) -> Tuple[np.ndarray, np.ndarray]:
+    """
+    Cut one-minute history into model windows
+
+    Args:
+        history: DataFrame with one row per minute and the METRICS columns
+
+    Returns:
+        (windows, targets): float32 [n, WINDOW, CHANNELS] readings, oldest
+        first, and float32 [n, CHANNELS] readings HORIZON_MINUTES after
+        each window's last step
+    """
+    values = history[METRICS].values.astype(np.float32)
+    ends = np.arange(WINDOW - 1, len(values) - HORIZON_MINUTES)
+    windows = np.stack([values[end - WINDOW + 1:end + 1] for end in ends])
+    targets = values[ends + HORIZON_MINUTES]
+    return windows, targets
+
+
+def normalize(windows: np.ndarray) -> np.ndarray:
+    """Model input: normalized windows flattened time-major"""
+    return ((windows - CENTER) / SPAN).reshape(len(windows), -1)
+
+
+def training_history(hours: int = 96, seed: int = 42) -> pd.DataFrame:
+    """Reproducible synthetic history (generate_synthetic_history is unseeded)"""
+    np.random.seed(seed)
+    return generate_synthetic_history(hours=hours)
+
+
+# ============ Float Model ============
+
+def train_float_model(history: pd.DataFrame, seed: int = 42) -> MLPRegressor:
+    """
+    Train the float MLP on the normalized change over the horizon
+
+    Predicting the change from the latest reading, rather than the level,
+    keeps the targets small and centred, which suits int8 well.
+    """
+    windows, targets = make_windows(history)
+    X = normalize(windows)
+    y = (targets - windows[:, -1, :]) / SPAN
+
+    model = MLPRegressor(
+        hidden_layer_sizes=HIDDEN_LAYERS,
+        activation='relu',
+        max_iter=400,
+        early_stopping=True,
+        random_state=seed
+    )
+    model.fit(X, y)
+    logger.info(f"Float trend MLP trained on {len(X)} windows, R² = {model.score(X, y):.4f}")
+    return model
+
+
+def predict_float(model: MLPRegressor, windows: np.ndarray) -> np.ndarray:
+    """Float model predictions in physical units"""
+    change = model.predict(normalize(windows))
+    return windows[:, -1, :] + change * SPAN
+
+
+# ============ Quantization ============
+
+def quantize_multiplier(real: float) -> Tuple[int, int]:
+    """
+    Express a positive real multiplier as (multiplier, shift) with
+    real ~= multiplier / 2^shift and multiplier in [2^30, 2^31)
+
+    Returns:
+        (multiplier, shift), shift within the 1-62 the firmware accepts
+    """
+    if real <= 0:
+        return 0, 31
+    mantissa, exponent = math.frexp(real)
+    multiplier = int(round(mantissa * (1 << 31)))
+    if multiplier == 1 << 31:
+        multiplier //= 2
+        exponent += 1
+    shift = 31 - exponent
+    while shift > 62:
+        multiplier >>= 1
+        shift -= 1
+    if shift < 1:
+        raise ValueError(f"Multiplier {real} is too large for the int8 kernel")
+    return multiplier, shift
+
+
+def quantize_model(model: MLPRegressor, calibration: np.ndarray) -> QuantizedTrendModel:
+    """
+    Quantize a trained MLP to int8
+
+    Args:
+        model: Float MLP from train_float_model()
+        calibration: Normalized inputs used to pick activation scales
+
+    Returns:
+        QuantizedTrendModel ready for to_blob()
+    """
+    if len(model.coefs_) > MAX_LAYERS:
+        raise ValueError(f"The firmware runs at most {MAX_LAYERS} layers")
+
+    input_scale = np.float32(max(float(np.abs(calibration).max()), 1e-6) / 127)
+    quantized = QuantizedTrendModel(input_scale=input_scale)
+
+    activations = calibration.astype(np.float64)
+    in_scale = float(input_scale)
+    last_layer = len(model.coefs_) - 1
+    for index, (coefs, intercepts) in enumerate(zip(model.coefs_, model.intercepts_)):
+        weights = coefs.T                                   # [outputs, inputs]
+        outputs, inputs = weights.shape
+        if _align4(inputs) > MAX_WIDTH or outputs > MAX_WIDTH:
+            raise ValueError(f"Layer {index} ({inputs}x{outputs}) exceeds the {MAX_WIDTH}-wide arena")
+
+        w_scale = np.abs(weights).max(axis=1) / 127
+        w_scale[w_scale == 0] = 1.0
+        padded = np.zeros((outputs, _align4(inputs)), dtype=np.int8)
+        padded[:, :inputs] = np.clip(np.round(weights / w_scale[:, None]), -127, 127)
+
+        acc_scale = w_scale * in_scale
+        bias = np.clip(np.round(intercepts / acc_scale), -2**31, 2**31 - 1).astype(np.int32)
+        multiplier = np.zeros(outputs, dtype=np.int32)
+        shift = np.zeros(outputs, dtype=np.int32)
+        out_scale = np.zeros(outputs, dtype=np.float32)
+
+        relu = index != last_layer
+        if relu:
+            activations = np.maximum(activations @ weights.T + intercepts, 0)
+            act_scale = max(float(activations.max()), 1e-6) / 127
+            for o in range(outputs):
+                multiplier[o], shift[o] = quantize_multiplier(acc_scale[o] / act_scale)
+            in_scale = act_scale
+        else:
+            out_scale = acc_scale.astype(np.float32)
+
+        quantized.layers.append(QuantizedLayer(inputs, outputs, relu, padded, bias, multiplier, shift, out_scale))
+
+    if quantized.layers[-1].outputs != CHANNELS:
+        raise ValueError(f"The last layer must have {CHANNELS} outputs")
+
+    digest = hashlib.sha256()
+    for coefs, intercepts in zip(model.coefs_, model.intercepts_):
+        digest.update(np.ascontiguousarray(coefs).tobytes())
+        digest.update(np.ascontiguousarray(intercepts).tobytes())
+    quantized.model_id = digest.hexdigest()[:12]
+    return quantized
+
+
+def quantize_inputs(quantized: QuantizedTrendModel, windows: np.ndarray) -> np.ndarray:
+    """Int8 model input exactly as the firmware computes it (float32, lroundf)"""
+    normalized = (windows.astype(np.float32) - CENTER) / SPAN
+    scaled = (normalized / quantized.input_scale).astype(np.float64)
+    q = np.sign(scaled) * np.floor(np.abs(scaled) + 0.5)
+    return np.clip(q, -127, 127).astype(np.int64).reshape(len(windows), -1)
+
+
+def infer_int8(quantized: QuantizedTrendModel, windows: np.ndarray) -> np.ndarray:
+    """
+    Int8 inference, operation for operation as trend_model_infer() runs it
+
+    Returns:
+        float32 [n, CHANNELS] predictions in physical units
+    """
+    x = quantize_inputs(quantized, windows)
+    for layer in quantized.layers[:-1]:
+        padded = np.zeros((len(x), layer.stride), dtype=np.int64)
+        padded[:, :x.shape[1]] = x
+        acc = padded @ layer.weights.astype(np.int64).T + layer.bias.astype(np.int64)
+        shift = layer.shift.astype(np.int64)
+        scaled = (acc * layer.multiplier.astype(np.int64) + np.left_shift(1, shift - 1)) >> shift
+        x = np.clip(scaled, 0, 127)
+
+    last = quantized.layers[-1]
+    padded = np.zeros((len(x), last.stride), dtype=np.int64)
+    padded[:, :x.shape[1]] = x
+    acc = padded @ last.weights.astype(np.int64).T + last.bias.astype(np.int64)
+    change = acc.astype(np.float32) * last.out_scale
+    return windows[:, -1, :].astype(np.float32) + change * SPAN
+
+
+# ============ Blob ============
+
+def to_blob(quantized: QuantizedTrendModel) -> bytes:
+    """Serialize to the firmware's weights blob (TrendBlobHeader + layers)"""
+    payload = bytearray()
+    for layer in quantized.layers:
+        payload += struct.pack('<HHHBB', layer.inputs, layer.outputs, layer.stride, int(layer.relu), 0)
+        payload += layer.bias.astype('<i4').tobytes()
+        payload += layer.multiplier.astype('<i4').tobytes()
+        payload += layer.shift.astype('<i4').tobytes()
+        payload += layer.out_scale.astype('<f4').tobytes()
+        weights = layer.weights.astype(np.int8).tobytes()
+        payload += weights + bytes(_align4(len(weights)) - len(weights))
+
+    header = struct.pack(
+        '<IHBBBBHf4f4fII16s',
+        BLOB_MAGIC, BLOB_VERSION, WINDOW, CHANNELS, len(quantized.layers), quantized.horizon_minutes, 0,
+        float(quantized.input_scale), *CENTER.tolist(), *SPAN.tolist(),
+        len(payload), zlib.crc32(bytes(payload)) & 0xFFFFFFFF,
+        quantized.model_id.encode()[:15]
+    )
+    return header + bytes(payload)
+
+
+def write_eval_csv(model: MLPRegressor, quantized: QuantizedTrendModel, windows: np.ndarray,
+                   targets: np.ndarray, path: str) -> None:
+    """
+    Evaluation windows for the native-tinyml harness
+
+    Columns: WINDOW * CHANNELS readings (time-major, oldest first), then the
+    actual readings after the horizon, the float model's predictions and
+    this module's int8 predictions, CHANNELS each.
+    """
+    float_pred = predict_float(model, windows)
+    int8_pred = infer_int8(quantized, windows)
+    rows = np.concatenate([windows.reshape(len(windows), -1), targets, float_pred, int8_pred], axis=1)
+    header = ([f"{m}_{t}" for t in range(WINDOW) for m in METRICS] +
+              [f"actual_{m}" for m in METRICS] + [f"float_{m}" for m in METRICS] + [f"int8_{m}" for m in METRICS])
+    # 9 significant digits round-trip float32 exactly through strtof
+    np.savetxt(path, rows.astype(np.float32), fmt='%.9g', delimiter=',', header=','.join(header), comments='')
+    logger.info(f"Wrote {len(rows)} evaluation windows to {path}")
+
+
+def accuracy_report(model: MLPRegressor, quantized: QuantizedTrendModel, windows: np.ndarray,
+                    targets: np.ndarray) -> pd.DataFrame:
+    """Mean absolute error per metric: float vs actual, int8 vs actual, int8 vs float"""
+    float_pred = predict_float(model, windows)
+    int8_pred = infer_int8(quantized, windows)
+    return pd.DataFrame({
+        'float_mae': np.abs(float_pred - targets).mean(axis=0),
+        'int8_mae': np.abs(int8_pred - targets).mean(axis=0),
+        'int8_vs_float_mae': np.abs(int8_pred - float_pred).mean(axis=0),
+    }, index=METRICS)
+
+
+def build(hours: int = 96, seed: int = 42) -> Tuple[MLPRegressor, QuantizedTrendModel]:
+    """Train and quantize on synthetic history"""
+    history = training_history(hours, seed)
+    model = train_float_model(history, seed)
+    windows, _ = make_windows(history)
+    return model, quantize_model(model, normalize(windows))
+
+
+def main(argv: Optional[List[str]] = None) -> None:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--out', default='models/trend_model.bin', help='weights blob path')
+    parser.add_argument('--eval', help='also write evaluation windows for the native-tinyml harness')
+    parser.add_argument('--hours', type=int, default=96, help='hours of synthetic training history (96)')
+    parser.add_argument('--seed', type=int, default=42)
+    args = parser.parse_args(argv)
+
+    model, quantized = build(args.hours, args.seed)
+    blob = to_blob(quantized)
+    os.makedirs(os.path.dirname(os.path.abspath(args.out)), exist_ok=True)
+    with open(args.out, 'wb') as f:
+        f.write(blob)
+    logger.info(f"Wrote {len(blob)}-byte weights blob {quantized.model_id} to {args.out}")
+
+    # Held-out history from another seed
+    windows, targets = make_windows(training_history(24, args.seed + 1))
+    logger.info(f"Accuracy on held-out windows:\n{accuracy_report(model, quantized, windows, targets)}")
+    if args.eval:
+        write_eval_csv(model, quantized, windows, targets, args.eval)
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.INFO)
+    main()
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+# Local CA and broker certificate for the TLS listener (mosquitto-tls.conf),
+# plus the firmware's copy of the CA: Smart Plant MS/include/mqtt_ca_cert.h
+# (FEATURE_MQTT_TLS builds need it).
+#
+# The broker certificate names every host in HOSTS. mbedTLS 2.x compares
+# the host name the firmware connects to (mqtt_server) with the DNS names
+# only, so IP addresses are listed as DNS names as well as IP addresses.
+#
+# Usage: ./generate-certs.sh
+#        HOSTS="localhost 10.0.0.5" ./generate-certs.sh
+
+set -euo pipefail
+cd "$(dirname "$0")"
+
+HOSTS="${HOSTS:-localhost 127.0.0.1 192.168.240.1 mosquitto mosquitto-tls}"
+HEADER="../../Smart Plant MS/include/mqtt_ca_cert.h"
+
+mkdir -p certs
+san=""
+for h in $HOSTS; do
+  san="${san:+$san,}DNS:$h"
+  if [[ "$h" =~ ^[0-9.]+$ ]]; then san="$san,IP:$h"; fi
+done
+
+# RSA keys: certificate checks and RSA key exchange use the ESP32's
+# big-number accelerator
+openssl req -x509 -newkey rsa:2048 -nodes -days 3650 -subj "/CN=Smart Plant MS local CA" \
+  -keyout certs/ca.key -out certs/ca.crt
+openssl req -newkey rsa:2048 -nodes -subj "/CN=mosquitto" -keyout certs/server.key -out certs/server.csr
+printf "subjectAltName=%s\nextendedKeyUsage=serverAuth\n" "$san" > certs/server.ext
+openssl x509 -req -in certs/server.csr -CA certs/ca.crt -CAkey certs/ca.key -CAcreateserial -days 825 \
+  -extfile certs/server.ext -out certs/server.crt
+rm certs/server.csr certs/server.ext
+# Readable by the mosquitto user inside the container
+chmod 644 certs/server.key
+
+{
+  echo "// Generated by mqtt-broker/tls/generate-certs.sh"
+  echo "#ifndef MQTT_CA_CERT_H"
+  echo "#define MQTT_CA_CERT_H"
+  echo
+  echo 'static const char MQTT_CA_CERT[] = R"PEM('
+  cat certs/ca.crt
+  echo ')PEM";'
+  echo
+  echo "#endif"
+} > "$HEADER"
+
+echo "Broker certificate for: $san"
+echo "Wrote certs/ and $HEADER"
@@ -23,6 +23,7 @@ logger = logging.getLogger(__name__)
 MQTT_BROKER = os.getenv('MQTT_BROKER', 'localhost')
 MQTT_PORT = int(os.getenv('MQTT_PORT', 1883))
 AUTO_CONTROL = os.getenv('AUTO_CONTROL', 'true').lower() == 'true'
+AUTO_SOURCE = 'auto-control'  # Marks commands this service sends to the device
 
 # Global state
 current_sensor_data = {}
@@ -73,6 +74,10 @@ def on_message(client, userdata, msg):
             if AUTO_CONTROL:
                 perform_auto_control()
         
+        # Our own auto-control commands come back on the command topics
+        elif payload.get('source') == AUTO_SOURCE:
+            return
+        
         # Handle actuator commands
         elif topic == "plant-iot/actuators/pump":
             handle_pump_command(payload)
@@ -226,6 +231,7 @@ def perform_auto_control():
             if moisture < 30 and actuator_status['pump']['status'] == 'OFF':
                 logger.info("Auto: Soil dry, activating pump")
                 control_logic.activate_pump(duration=300)  # 5 minutes
+                send_device_command('pump', 'ON', 300)
                 actuator_status['pump'] = {
                     'status': 'ON',
                     'last_command': int(time.time() * 1000),
@@ -235,6 +241,7 @@ def perform_auto_control():
             elif moisture > 70 and actuator_status['pump']['status'] == 'ON':
                 logger.info("Auto: Soil moist enough, deactivating pump")
                 control_logic.deactivate_pump()
+                send_device_command('pump', 'OFF')
                 actuator_status['pump']['status'] = 'OFF'
                 publish_status('pump')
         
@@ -243,11 +250,13 @@ def perform_auto_control():
             if temp > 30 and actuator_status['fan']['status'] == 'OFF':
                 logger.info("Auto: High temperature, activating fan")
                 control_logic.activate_fan()
+                send_device_command('fan', 'ON')
                 actuator_status['fan']['status'] = 'ON'
                 publish_status('fan')
             elif temp < 25 and actuator_status['fan']['status'] == 'ON':
                 logger.info("Auto: Temperature normal, deactivating fan")
                 control_logic.deactivate_fan()
+                send_device_command('fan', 'OFF')
                 actuator_status['fan']['status'] = 'OFF'
                 publish_status('fan')
         
@@ -256,11 +265,13 @@ def perform_auto_control():
             if light < 20 and actuator_status['grow_light']['status'] == 'OFF':
                 logger.info("Auto: Low light, activating grow light")
                 control_logic.activate_light()
+                send_device_command('grow-light', 'ON')
                 actuator_status['grow_light']['status'] = 'ON'
                 publish_status('grow_light')
             elif light > 60 and actuator_status['grow_light']['status'] == 'ON':
                 logger.info("Auto: Sufficient light, deactivating grow light")
                 control_logic.deactivate_light()
+                send_device_command('grow-light', 'OFF')
                 actuator_status['grow_light']['status'] = 'OFF'
                 publish_status('grow_light')
         
@@ -268,6 +279,17 @@ def perform_auto_control():
         logger.error(f"Error in auto-control: {e}")
 
 
+def send_device_command(actuator, action, duration=0):
+    """Send an auto-control decision to the device on its command topic"""
+    try:
+        payload = {'action': action, 'source': AUTO_SOURCE}
+        if duration:
+            payload['duration'] = duration
+        client.publish(f"plant-iot/actuators/{actuator}", json.dumps(payload), qos=1)
+    except Exception as e:
+        logger.error(f"Error sending {actuator} command: {e}")
+
+
 def publish_status(actuator):
     """Publish status of a specific actuator"""
     try:
@@ -22,6 +22,10 @@ logger = logging.getLogger(__name__)
 MQTT_BROKER = os.getenv('MQTT_BROKER', 'localhost')
 MQTT_PORT = int(os.getenv('MQTT_PORT', 1883))
 
+# 'device': boards publish their own learned soil-dryness ETA (source "device")
+# on predictions/soil-dryness, so the fixed-coefficient predictor is skipped
+DRYNESS_SOURCE = os.getenv('DRYNESS_SOURCE', 'service')
+
 # Global state
 sensor_data = {}
 last_prediction = {}
@@ -60,7 +64,8 @@ def on_message(client, userdata, msg):
             current_time = time.time()
             
             # Perform predictions at intervals
-            if current_time - last_dryness_prediction >= DRYNESS_PREDICTION_INTERVAL:
+            if (DRYNESS_SOURCE == 'service' and
+                    current_time - last_dryness_prediction >= DRYNESS_PREDICTION_INTERVAL):
                 predict_soil_dryness(sensor_data)
                 last_dryness_prediction = current_time
             
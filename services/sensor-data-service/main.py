@@ -25,6 +25,12 @@ MQTT_PORT = int(os.getenv('MQTT_PORT', 1883))
 MQTT_USERNAME = os.getenv('MQTT_USERNAME', '')
 MQTT_PASSWORD = os.getenv('MQTT_PASSWORD', '')
 
+# Where anomalies come from: 'service' runs DataProcessor.detect_anomalies() on
+# every sample; 'device' only forwards the firmware's events/anomaly messages.
+# Device events are forwarded in both modes.
+ANOMALY_SOURCE = os.getenv('ANOMALY_SOURCE', 'service')
+DEVICE_EVENT_TOPICS = ("plant-iot/events/anomaly", "plant-iot/+/events/anomaly")
+
 # Global state
 sensor_data = {
     'temperature': None,
@@ -50,6 +56,8 @@ def on_connect(client, userdata, flags, rc):
         client.subscribe("plant-iot/sensors/light")
         client.subscribe("plant-iot/sensors/aggregated")  # Subscribe to aggregated data from simulator
         client.subscribe("plant-iot/status/actuators")
+        for topic in DEVICE_EVENT_TOPICS:
+            client.subscribe(topic)
     else:
         logger.error(f"Failed to connect, return code {rc}")
 
@@ -63,6 +71,11 @@ def on_message(client, userdata, msg):
         logger.info(f"MESSAGE RECEIVED on {topic}: {payload}")  # Always log incoming messages
         logger.debug(f"Received on {topic}: {payload}")
         
+        # Anomaly events detected on the device
+        if topic.endswith("/events/anomaly"):
+            handle_device_anomaly(payload)
+            return
+        
         # Handle aggregated data from simulator
         if topic == "plant-iot/sensors/aggregated":
             logger.info(f"Processing aggregated sensor data: {payload}")
@@ -121,8 +134,8 @@ def process_aggregated_data():
             # Add quality assessment
             sensor_data['quality'] = processor.assess_quality(sensor_data)
             
-            # Detect anomalies
-            anomalies = processor.detect_anomalies(sensor_data)
+            # Detect anomalies (devices report their own when ANOMALY_SOURCE=device)
+            anomalies = processor.detect_anomalies(sensor_data) if ANOMALY_SOURCE == 'service' else []
             
             # Publish aggregated data
             publisher.publish_aggregated(sensor_data)
@@ -143,6 +156,26 @@ def process_aggregated_data():
         logger.error(f"Error processing aggregated data: {e}")
 
 
+def handle_device_anomaly(event):
+    """Forward a device anomaly event in the service's anomaly format"""
+    if event.get('event') != 'anomaly_raised':
+        logger.info(f"Anomaly cleared on {event.get('device_id')}: {event.get('sensor')}")
+        return
+    anomaly = {
+        'sensor': event.get('sensor'),
+        'value': event.get('value'),
+        'expected': event.get('expected'),
+        'deviation': event.get('deviation'),
+        'z_score': event.get('z_score'),
+        'reason': event.get('reason'),
+        'device_id': event.get('device_id'),
+        'plant_id': event.get('plant_id'),
+        'context': event.get('context'),
+    }
+    logger.warning(f"Device anomaly: {anomaly}")
+    publisher.publish_anomalies([anomaly])
+
+
 def on_disconnect(client, userdata, rc):
     """MQTT disconnection callback"""
     if rc != 0: